@@ -61,23 +61,17 @@ namespace ba {
       m_S = S;
     }
 
-    // Covariance Calculator
-    // __________________________________________________
-    // This routine inverts a sparse matrix S, and prints the individual
-    // covariance matrices for each camera
-    void covCalc(){
+    typedef Matrix<double, BundleAdjustModelT::camera_params_n, BundleAdjustModelT::camera_params_n> matrix_camera_camera;
 
+    /// The covariance of each camera's parameters, from a dense
+    /// inverse of S.
+    std::vector<matrix_camera_camera> camera_covariances() {
       // camera params
       unsigned num_cam_params = BundleAdjustModelT::camera_params_n;
       unsigned num_cameras = this->m_model.num_cameras();
 
       unsigned inverse_size = num_cam_params * num_cameras;
 
-      typedef Matrix<double, BundleAdjustModelT::camera_params_n, BundleAdjustModelT::camera_params_n> matrix_camera_camera;
-
-      // final vector of camera covariance matrices
-      vw::Vector< matrix_camera_camera > sparse_cov(num_cameras);
-
       // Get the S matrix from the model
       Matrix<double> S = this->S();
       Matrix<double> Id(inverse_size, inverse_size);
@@ -85,13 +79,28 @@ namespace ba {
       Matrix<double> Cov = multi_solve_symmetric(S, Id);
 
       //pick out covariances of individual cameras
-      for(unsigned i = 0; i < num_cameras; i++){
-         sparse_cov(i) = submatrix(Cov, i*num_cam_params, i*num_cam_params, num_cam_params, num_cam_params);
-      }
+      std::vector<matrix_camera_camera> result( num_cameras );
+      for ( unsigned i = 0; i < num_cameras; i++ )
+        result[i] = submatrix(Cov, i*num_cam_params,
+                              i*num_cam_params,
+                              num_cam_params,
+                              num_cam_params);
+      return result;
+    }
+
+    // Covariance Calculator
+    // __________________________________________________
+    // This routine inverts a sparse matrix S, and prints the individual
+    // covariance matrices for each camera
+    void covCalc(){
+      std::vector<matrix_camera_camera> covariances = camera_covariances();
+
+      // final vector of camera covariance matrices
+      vw::Vector< matrix_camera_camera > sparse_cov(covariances.size());
+      std::copy( covariances.begin(), covariances.end(), sparse_cov.begin() );
 
       std::cout << "Covariance matrices for cameras are:"
                 << sparse_cov << "\n\n";
-      return;
     }
 
     // UPDATE IMPLEMENTATION
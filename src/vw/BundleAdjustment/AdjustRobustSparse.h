@@ -15,6 +15,7 @@
 // Vision Workbench
 #include <vw/BundleAdjustment/AdjustBase.h>
 #include <vw/Math/MatrixSparseSkyline.h>
+#include <vw/Math/MatrixSparseBlock.h>
 
 // Boost
 #include <boost/numeric/ublas/matrix_sparse.hpp>
@@ -47,6 +48,7 @@ namespace ba {
     typedef Matrix<double,BundleAdjustModelT::camera_params_n,BundleAdjustModelT::point_params_n> matrix_camera_point;
     typedef Vector<double,BundleAdjustModelT::camera_params_n> vector_camera;
     typedef Vector<double,BundleAdjustModelT::point_params_n> vector_point;
+    typedef typename BundleAdjustModelT::Linearization linearization_type;
 
     math::MatrixSparseSkyline<double> m_S;
     std::vector<size_t> m_ideal_ordering;
@@ -80,34 +82,23 @@ namespace ba {
 
     math::MatrixSparseSkyline<double> S() const { return m_S; }
 
+    /// The covariance of each camera's parameters, i.e. the diagonal
+    /// blocks of inverse(S), found by selected inversion of S's sparse
+    /// factor rather than by inverting all of S.
+    std::vector<matrix_camera_camera> camera_covariances() const {
+      math::MatrixSparseBlock<double> S =
+        math::sparse_block_matrix( this->S(), BundleAdjustModelT::camera_params_n );
+      math::SparseBlockLDL<double> ldl( S );
+      std::vector< Matrix<double> > blocks = ldl.inverse_diagonal_blocks();
+      return std::vector<matrix_camera_camera>( blocks.begin(), blocks.end() );
+    }
+
     // Covariance Calculator
     // __________________________________________________
-    // This routine inverts a sparse matrix S, and prints the individual
-    // covariance matrices for each camera
+    // This routine computes the individual covariance matrices for
+    // each camera
     void covCalc() {
-      // camera params
-      size_t num_cam_params = BundleAdjustModelT::camera_params_n;
-      size_t num_cameras = this->m_model.num_cameras();
-
-      size_t inverse_size = num_cam_params * num_cameras;
-
-      typedef Matrix<double, BundleAdjustModelT::camera_params_n, BundleAdjustModelT::camera_params_n> matrix_camera_camera;
-
-      // final vector of camera covariance matrices
-      vw::Vector< matrix_camera_camera > sparse_cov(num_cameras);
-
-      // Get the S matrix from the model
-      math::MatrixSparseSkyline<double> S = this->S();
-      Matrix<double> Id(inverse_size, inverse_size);
-      Id.set_identity();
-      Matrix<double> Cov = multi_sparse_solve(S, Id);
-
-      //pick out covariances of indvidual cameras
-      for ( size_t i = 0; i < num_cameras; i++ )
-        sparse_cov(i) = submatrix(Cov, i*num_cam_params,
-                                  i*num_cam_params,
-                                  num_cam_params,
-                                  num_cam_params);
+      std::vector<matrix_camera_camera> sparse_cov = camera_covariances();
     }
 
     // UPDATE IMPLEMENTATION
@@ -147,23 +138,28 @@ namespace ba {
       // matrix.
       time.reset(new Timer("Solve for Image Error, Jacobian, U, V, and W:", DebugMessage, "ba"));
       double robust_objective = 0.0;
+      std::vector<size_t> points;
+      std::vector<linearization_type> linearizations;
       for ( size_t j = 0; j < m_crn.size(); j++ ) {
+        // Evaluate all of this camera's measurements at once
+        points.clear();
+        for ( crn_iter fiter = m_crn[j].begin();
+              fiter != m_crn[j].end(); fiter++ )
+          points.push_back( (**fiter).m_point_id );
+        this->m_model.camera_jacobians( j, points, linearizations );
+
+        size_t k = 0;
         for ( crn_iter fiter = m_crn[j].begin();
               fiter != m_crn[j].end(); fiter++ ) {
           size_t i = (**fiter).m_point_id;
-
-          matrix_2_camera A = this->m_model.A_jacobian(i,j,this->m_model.A_parameters(j),
-                                                       this->m_model.B_parameters(i));
-          matrix_2_point B = this->m_model.B_jacobian(i,j,this->m_model.A_parameters(j),
-                                                      this->m_model.B_parameters(i));
+          linearization_type const& linearization = linearizations[k++];
+          matrix_2_camera const& A = linearization.A;
+          matrix_2_point const& B = linearization.B;
 
           // Apply robust cost function weighting
           Vector2 unweighted_error;
-          try {
-            unweighted_error = (**fiter).m_location -
-              this->m_model(i,j,this->m_model.A_parameters(j),
-                            this->m_model.B_parameters(i));
-          } catch (const camera::PixelToRayErr& e) {}
+          if ( linearization.valid )
+            unweighted_error = (**fiter).m_location - linearization.value;
 
           Vector2 pixel_sigma = (**fiter).m_scale;
           Matrix2x2 inverse_cov;
@@ -14,7 +14,10 @@
 
 // Vision Workbench
 #include <vw/Math/MatrixSparseSkyline.h>
+#include <vw/Math/MatrixSparseBlock.h>
+#include <vw/Math/ConjugateGradient.h>
 #include <vw/Core/Debugging.h>
+#include <vw/Core/ThreadPool.h>
 #include <vw/BundleAdjustment/AdjustBase.h>
 #include <vw/BundleAdjustment/CameraRelation.h>
 
@@ -38,6 +41,15 @@
 namespace vw {
 namespace ba {
 
+  /// How AdjustSparse solves the reduced camera system.  The skyline
+  /// solver fills in everything under each row's first non-zero; the
+  /// supernodal one only fills in what its minimum degree ordering
+  /// requires; and conjugate gradients never factor at all, for
+  /// networks too large for either.
+  enum SparseSolverType { SKYLINE_LDL_SOLVER = 0,
+                          SUPERNODAL_LDL_SOLVER,
+                          BLOCK_JACOBI_PCG_SOLVER };
+
   template <class BundleAdjustModelT, class RobustCostT>
   class AdjustSparse : public AdjustBase<BundleAdjustModelT, RobustCostT> {
 
@@ -49,11 +61,16 @@ namespace ba {
     typedef Matrix<double,BundleAdjustModelT::camera_params_n,BundleAdjustModelT::point_params_n> matrix_camera_point;
     typedef Vector<double,BundleAdjustModelT::camera_params_n> vector_camera;
     typedef Vector<double,BundleAdjustModelT::point_params_n> vector_point;
+    typedef typename BundleAdjustModelT::Linearization linearization_type;
 
     math::MatrixSparseSkyline<double> m_S;
     std::vector<size_t> m_ideal_ordering;
     Vector<size_t> m_ideal_skyline;
     bool m_found_ideal_ordering;
+    SparseSolverType m_solver;
+    math::SparseBlockLDL<double> m_ldl; // analyzed once, refactored each update
+    double m_pcg_tolerance;
+    int m_pcg_max_iterations;
     CameraRelationNetwork<JFeature> m_crn;
     typedef CameraNode<JFeature>::iterator crn_iter;
 
@@ -63,6 +80,212 @@ namespace ba {
     std::vector< vector_camera > epsilon_a;
     std::vector< vector_point > epsilon_b;
 
+    // Parallel assembly.  Each chunk of points gets its own camera
+    // accumulators (chunk 0 uses U and epsilon_a themselves), which
+    // are summed once every chunk is done.
+    typedef boost::shared_ptr<JFeature> f_ptr;
+    int m_num_threads;
+    std::vector< std::vector<f_ptr> > m_camera_features; // sorted by point
+    std::vector< std::vector< matrix_camera_camera > > m_chunk_U;
+    std::vector< std::vector< vector_camera > > m_chunk_epsilon_a;
+    std::vector< double > m_chunk_error;
+    std::vector< vector_camera > m_e_blocks;
+    std::vector< std::vector< std::pair<size_t, matrix_camera_camera> > > m_S_blocks;
+
+    struct PointIdLess {
+      bool operator()( f_ptr const& a, f_ptr const& b ) const { return a->m_point_id < b->m_point_id; }
+      bool operator()( f_ptr const& a, size_t b ) const { return a->m_point_id < b; }
+    };
+
+    typedef void (AdjustSparse::*range_func)( size_t chunk, size_t begin, size_t end );
+
+    class RangeTask : public Task {
+      AdjustSparse& m_adjuster;
+      range_func m_func;
+      size_t m_chunk, m_begin, m_end;
+      TaskErrors& m_errors;
+    public:
+      RangeTask( AdjustSparse& adjuster, range_func func, size_t chunk, size_t begin, size_t end,
+                 TaskErrors& errors ) :
+        m_adjuster(adjuster), m_func(func), m_chunk(chunk), m_begin(begin), m_end(end),
+        m_errors(errors) {}
+      virtual void operator()() {
+        try {
+          (m_adjuster.*m_func)( m_chunk, m_begin, m_end );
+        } catch ( ... ) {
+          m_errors.capture();
+        }
+      }
+    };
+
+    // Loads the blocks from schur_cameras() into a skyline matrix
+    void load_skyline( math::MatrixSparseSkyline<double>& S ) const {
+      size_t num_cam_params = BundleAdjustModelT::camera_params_n;
+      for ( size_t j = 0; j < m_S_blocks.size(); j++ ) {
+        typedef typename std::vector< std::pair<size_t, matrix_camera_camera> >::const_iterator block_iter;
+        for ( block_iter block = m_S_blocks[j].begin(); block != m_S_blocks[j].end(); block++ ) {
+          size_t k = block->first;
+          if ( k == j ) {
+            // Loading the diagonal into sparse matrix
+            size_t offset = j * num_cam_params;
+            for ( size_t aa = 0; aa < num_cam_params; aa++ ) {
+              for ( size_t bb = aa; bb < num_cam_params; bb++ ) {
+                S( offset+bb, offset+aa ) = block->second(aa,bb);  // Transposing
+              }
+            }
+          } else {
+            // Loading in off diagonal
+            // - if it seems we are loading in oddly, it's because the sparse
+            //   matrix is row major.
+            submatrix( S, k*num_cam_params, j*num_cam_params,
+                       num_cam_params, num_cam_params ) = transpose(block->second);
+          }
+        }
+      }
+    }
+
+    // The same blocks, lower triangle only, for the block solvers
+    void load_blocks( math::MatrixSparseBlock<double>& S ) const {
+      for ( size_t j = 0; j < m_S_blocks.size(); j++ ) {
+        typedef typename std::vector< std::pair<size_t, matrix_camera_camera> >::const_iterator block_iter;
+        for ( block_iter block = m_S_blocks[j].begin(); block != m_S_blocks[j].end(); block++ )
+          S.block( block->first, j ) = transpose( block->second );
+      }
+    }
+
+    // Splits [0,n) into the given number of chunks and runs func on
+    // each, in parallel when there is more than one thread.
+    void for_ranges( size_t n, size_t chunks, range_func func ) {
+      if ( chunks > n ) chunks = n;
+      if ( chunks == 0 ) return;
+      if ( m_num_threads <= 1 || chunks == 1 ) {
+        for ( size_t c = 0; c < chunks; c++ )
+          (this->*func)( c, n*c/chunks, n*(c+1)/chunks );
+        return;
+      }
+      TaskErrors errors;
+      {
+        FifoWorkQueue queue( m_num_threads );
+        for ( size_t c = 0; c < chunks; c++ )
+          queue.add_task( boost::shared_ptr<Task>( new RangeTask( *this, func, c, n*c/chunks, n*(c+1)/chunks, errors ) ) );
+        queue.join_all();
+      }
+      errors.rethrow();
+    }
+
+    // Accumulates the measurements of points [p0,p1), a camera at a
+    // time, into this chunk's camera blocks and the points' own.
+    void assemble_points( size_t chunk, size_t p0, size_t p1 ) {
+      std::vector< matrix_camera_camera >& U_c = chunk ? m_chunk_U[chunk] : U;
+      std::vector< vector_camera >& epsilon_a_c = chunk ? m_chunk_epsilon_a[chunk] : epsilon_a;
+      double error_total = 0;
+      std::vector<size_t> points;
+      std::vector<linearization_type> linearizations;
+      for ( size_t j = 0; j < m_camera_features.size(); j++ ) {
+        typedef typename std::vector<f_ptr>::const_iterator f_iter;
+        std::vector<f_ptr> const& features = m_camera_features[j];
+        f_iter first = std::lower_bound( features.begin(), features.end(), p0, PointIdLess() );
+        f_iter last = std::lower_bound( first, features.end(), p1, PointIdLess() );
+        if ( first == last ) continue;
+
+        // Evaluate all of this camera's measurements at once
+        points.clear();
+        for ( f_iter fiter = first; fiter != last; fiter++ )
+          points.push_back( (**fiter).m_point_id );
+        this->m_model.camera_jacobians( j, points, linearizations );
+
+        size_t k = 0;
+        for ( f_iter fiter = first; fiter != last; fiter++ ) {
+          JFeature& measure = **fiter;
+          size_t i = measure.m_point_id;
+          linearization_type const& linearization = linearizations[k++];
+          matrix_2_camera const& A = linearization.A;
+          matrix_2_point const& B = linearization.B;
+
+          // Apply robust cost function weighting
+          Vector2 error;
+          if ( linearization.valid )
+            error = measure.m_location - linearization.value;
+
+          if ( error != Vector2() ) {
+            double mag = norm_2(error);
+            double weight = sqrt(this->m_robust_cost_func(mag)) / mag;
+            error *= weight;
+          }
+
+          Matrix2x2 inverse_cov;
+          Vector2 pixel_sigma = measure.m_scale;
+          inverse_cov(0,0) = 1/(pixel_sigma(0)*pixel_sigma(0));
+          inverse_cov(1,1) = 1/(pixel_sigma(1)*pixel_sigma(1));
+          error_total += .5 * transpose(error) *
+            inverse_cov * error;
+
+          // Storing intermediate values
+          U_c[j] += transpose(A) * inverse_cov * A;
+          V[i] += transpose(B) * inverse_cov * B;
+          epsilon_a_c[j] += transpose(A) * inverse_cov * error;
+          epsilon_b[i] += transpose(B) * inverse_cov * error;
+          measure.m_w = transpose(A) * inverse_cov * B;
+        }
+      }
+      m_chunk_error[chunk] = error_total;
+    }
+
+    void invert_points( size_t /*chunk*/, size_t p0, size_t p1 ) {
+      for ( size_t i = p0; i < p1; i++ ) {
+        Matrix<double> V_temp = V[i];
+        chol_inverse( V_temp );
+        V_inverse[i] = transpose(V_temp)*V_temp;
+      }
+    }
+
+    // Computes the blocks of Y and each camera's part of 'e'
+    void camera_rhs( size_t /*chunk*/, size_t j0, size_t j1 ) {
+      for ( size_t j = j0; j < j1; j++ ) {
+        vector_camera e_j = epsilon_a[j];
+        for ( crn_iter fiter = m_crn[j].begin();
+              fiter != m_crn[j].end(); fiter++ ) {
+          (**fiter).m_y = (**fiter).m_w * V_inverse[(**fiter).m_point_id];
+          e_j -= (**fiter).m_y * epsilon_b[ (**fiter).m_point_id ];
+        }
+        m_e_blocks[j] = e_j;
+      }
+    }
+
+    // Computes row j of S: its diagonal block, then a block for each
+    // later camera k that shares points with camera j.
+    void schur_cameras( size_t /*chunk*/, size_t j0, size_t j1 ) {
+      typedef std::multimap< size_t, f_ptr >::const_iterator mm_iterator;
+      for ( size_t j = j0; j < j1; j++ ) {
+        std::vector< std::pair<size_t, matrix_camera_camera> >& blocks = m_S_blocks[j];
+        blocks.clear();
+
+        // Iterate across all features seen by the camera
+        matrix_camera_camera S_jj;
+        for ( crn_iter fiter = m_crn[j].begin();
+              fiter != m_crn[j].end(); fiter++ ) {
+          S_jj -= (**fiter).m_y*transpose((**fiter).m_w);
+        }
+        S_jj += U[j];
+        blocks.push_back( std::make_pair( j, S_jj ) );
+
+        // The map is keyed by the other camera, so the features shared
+        // with each later camera are contiguous. find() rather than
+        // operator[] keeps the features' maps untouched across threads.
+        mm_iterator f_j_iter = m_crn[j].map.upper_bound( j );
+        mm_iterator end = m_crn[j].map.end();
+        while ( f_j_iter != end ) {
+          size_t k = f_j_iter->first;
+          matrix_camera_camera S_jk;
+          for ( ; f_j_iter != end && f_j_iter->first == k; f_j_iter++ ) {
+            f_ptr f_k = f_j_iter->second->m_map.find( k )->second.lock();
+            S_jk -= f_j_iter->second->m_y * transpose( f_k->m_w );
+          }
+          blocks.push_back( std::make_pair( k, S_jk ) );
+        }
+      }
+    }
+
   public:
 
     AdjustSparse( BundleAdjustModelT & model,
@@ -72,41 +295,73 @@ namespace ba {
     AdjustBase<BundleAdjustModelT,RobustCostT>( model, robust_cost_func,
                                                 use_camera_constraint,
                                                 use_gcp_constraint ),
+      m_solver(SKYLINE_LDL_SOLVER), m_pcg_tolerance(1e-10), m_pcg_max_iterations(1000),
       U( this->m_model.num_cameras() ), V( this->m_model.num_points() ),
       V_inverse( this->m_model.num_points() ),
-      epsilon_a( this->m_model.num_cameras() ), epsilon_b( this->m_model.num_points() ) {
+      epsilon_a( this->m_model.num_cameras() ), epsilon_b( this->m_model.num_points() ),
+      m_num_threads(1) {
       vw_out(DebugMessage,"ba") << "Constructed Sparse Bundle Adjuster.\n";
       m_crn.read_controlnetwork( *(this->m_control_net).get() );
       m_found_ideal_ordering = false;
+
+      m_camera_features.resize( m_crn.size() );
+      for ( size_t j = 0; j < m_crn.size(); j++ ) {
+        m_camera_features[j].assign( m_crn[j].begin(), m_crn[j].end() );
+        std::sort( m_camera_features[j].begin(), m_camera_features[j].end(), PointIdLess() );
+      }
+      m_e_blocks.resize( m_crn.size() );
+      m_S_blocks.resize( m_crn.size() );
     }
 
-    math::MatrixSparseSkyline<double> S() const { return m_S; }
+    /// Builds the normal equations on this many threads: the
+    /// measurements split up by point, and the per-point inverses and
+    /// the rows of S split up as well.  The model's camera_jacobians()
+    /// (or its operator()) must then be safe to call concurrently.
+    void set_num_threads( int num_threads ) { m_num_threads = num_threads; }
+    int num_threads() const { return m_num_threads; }
+
+    /// Selects the solver for the reduced camera system.  The
+    /// tolerance and iteration limit only apply to conjugate gradients.
+    void set_solver( SparseSolverType solver, double pcg_tolerance = 1e-10,
+                     int pcg_max_iterations = 1000 ) {
+      m_solver = solver;
+      m_pcg_tolerance = pcg_tolerance;
+      m_pcg_max_iterations = pcg_max_iterations;
+    }
+    SparseSolverType solver() const { return m_solver; }
+
+    math::MatrixSparseSkyline<double> S() const {
+      if ( m_solver == SKYLINE_LDL_SOLVER )
+        return m_S;
+      // Only the skyline solver keeps it; build it from the blocks.
+      size_t size = this->m_model.num_cameras() * BundleAdjustModelT::camera_params_n;
+      math::MatrixSparseSkyline<double> S( size, size );
+      load_skyline( S );
+      return S;
+    }
+
+    /// The covariance of each camera's parameters, i.e. the diagonal
+    /// blocks of inverse(S), found by selected inversion of S's sparse
+    /// factor rather than by inverting all of S.
+    std::vector<matrix_camera_camera> camera_covariances() const {
+      math::MatrixSparseBlock<double> S( this->m_model.num_cameras(),
+                                         BundleAdjustModelT::camera_params_n );
+      load_blocks( S );
+      math::SparseBlockLDL<double> ldl( S );
+      std::vector< Matrix<double> > blocks = ldl.inverse_diagonal_blocks();
+      return std::vector<matrix_camera_camera>( blocks.begin(), blocks.end() );
+    }
 
     // Covariance Calculator
     // ___________________________________________________________
-    // This routine inverts a sparse matrix S, and prints the individual
-    // covariance matrices for each camera
+    // This routine prints the individual covariance matrices for
+    // each camera
     void covCalc(){
-      // camera params
-      size_t num_cam_params = BundleAdjustModelT::camera_params_n;
-      size_t num_cameras = this->m_model.num_cameras();
-
-      size_t inverse_size = num_cam_params * num_cameras;
-
-      typedef Matrix<double, BundleAdjustModelT::camera_params_n, BundleAdjustModelT::camera_params_n> matrix_camera_camera;
+      std::vector<matrix_camera_camera> covariances = camera_covariances();
 
       // final vector of camera covariance matrices
-      vw::Vector< matrix_camera_camera > sparse_cov(num_cameras);
-
-      // Get the S matrix from the model
-      math::MatrixSparseSkyline<double> S = this->S();  // Make copy as solve is destructive
-      Matrix<double> Id(inverse_size, inverse_size);
-      Id.set_identity();
-      Matrix<double> Cov = multi_sparse_solve(S, Id);
-
-      //pick out covariances of individual cameras
-      for ( size_t i = 0; i < num_cameras; i++ )
-        sparse_cov(i) = submatrix(Cov, i*num_cam_params, i*num_cam_params, num_cam_params, num_cam_params);
+      vw::Vector< matrix_camera_camera > sparse_cov(covariances.size());
+      std::copy( covariances.begin(), covariances.end(), sparse_cov.begin() );
 
       std::cout << "Covariance matrices for cameras are:"
                 << sparse_cov << "\n\n";
@@ -139,47 +394,24 @@ namespace ba {
       // matrices A & B, as well as the error matrix and the W
       // matrix.
       time.reset(new Timer("Solve for Image Error, Jacobian, U, V, and W:", DebugMessage, "ba"));
-      double error_total = 0; // assume this is r^T\Sigma^{-1}r
-      for ( size_t j = 0; j < m_crn.size(); j++ ) {
-        BOOST_FOREACH( boost::shared_ptr<JFeature> measure, m_crn[j] ) {
-          size_t i = measure->m_point_id;
-
-          matrix_2_camera A =
-            this->m_model.A_jacobian( i, j,
-                                      this->m_model.A_parameters(j),
-                                      this->m_model.B_parameters(i) );
-          matrix_2_point B =
-            this->m_model.B_jacobian( i, j,
-                                      this->m_model.A_parameters(j),
-                                      this->m_model.B_parameters(i) );
-
-          // Apply robust cost function weighting
-          Vector2 error;
-          try {
-            error = measure->m_location -
-              this->m_model(i,j,this->m_model.A_parameters(j),
-                            this->m_model.B_parameters(i) );
-          } catch (const camera::PixelToRayErr& e) {}
-
-          if ( error != Vector2() ) {
-            double mag = norm_2(error);
-            double weight = sqrt(this->m_robust_cost_func(mag)) / mag;
-            error *= weight;
-          }
-
-          Matrix2x2 inverse_cov;
-          Vector2 pixel_sigma = measure->m_scale;
-          inverse_cov(0,0) = 1/(pixel_sigma(0)*pixel_sigma(0));
-          inverse_cov(1,1) = 1/(pixel_sigma(1)*pixel_sigma(1));
-          error_total += .5 * transpose(error) *
-            inverse_cov * error;
+      size_t num_points = this->m_model.num_points();
+      size_t chunks = std::max( size_t(1), std::min( size_t(std::max( m_num_threads, 1 )), num_points ) );
+      m_chunk_U.resize( chunks );
+      m_chunk_epsilon_a.resize( chunks );
+      m_chunk_error.assign( chunks, 0 );
+      for ( size_t c = 1; c < chunks; c++ ) {
+        m_chunk_U[c].assign( U.size(), matrix_camera_camera() );
+        m_chunk_epsilon_a[c].assign( epsilon_a.size(), vector_camera() );
+      }
+      for_ranges( num_points, chunks, &AdjustSparse::assemble_points );
 
-          // Storing intermediate values
-          U[j] += transpose(A) * inverse_cov * A;
-          V[i] += transpose(B) * inverse_cov * B;
-          epsilon_a[j] += transpose(A) * inverse_cov * error;
-          epsilon_b[i] += transpose(B) * inverse_cov * error;
-          measure->m_w = transpose(A) * inverse_cov * B;
+      double error_total = 0; // assume this is r^T\Sigma^{-1}r
+      for ( size_t c = 0; c < chunks; c++ ) {
+        error_total += m_chunk_error[c];
+        if ( c == 0 ) continue;
+        for ( size_t j = 0; j < U.size(); j++ ) {
+          U[j] += m_chunk_U[c][j];
+          epsilon_a[j] += m_chunk_epsilon_a[c][j];
         }
       }
       time.reset();
@@ -255,29 +487,16 @@ namespace ba {
       // to "flatten" our block structure to a vector that contains
       // scalar entries.
       time.reset(new Timer("Create special e vector", DebugMessage, "ba"));
-      Vector<double> e(this->m_model.num_cameras() * BundleAdjustModelT::camera_params_n);
-      for (size_t j = 0; j < epsilon_a.size(); ++j) {
-        subvector(e, j*BundleAdjustModelT::camera_params_n, BundleAdjustModelT::camera_params_n) =
-          epsilon_a[j];
-      }
-
       // Compute V inverse
-      for ( size_t i = 0; i < this->m_model.num_points(); i++ ) {
-        Matrix<double> V_temp = V[i];
-        chol_inverse( V_temp );
-        V_inverse[i] = transpose(V_temp)*V_temp;
-      }
+      size_t work_chunks = 4 * std::max( m_num_threads, 1 );
+      for_ranges( this->m_model.num_points(), work_chunks, &AdjustSparse::invert_points );
 
       // Compute Y and finish constructing e.
-      for ( size_t j = 0; j < m_crn.size(); j++ ) {
-        for ( crn_iter fiter = m_crn[j].begin();
-              fiter != m_crn[j].end(); fiter++ ) {
-          // Compute the blocks of Y
-          (**fiter).m_y = (**fiter).m_w * V_inverse[(**fiter).m_point_id];
-          // Flatten the block structure to compute 'e'
-          subvector(e, j*num_cam_params, num_cam_params) -= (**fiter).m_y
-            * epsilon_b[ (**fiter).m_point_id ];
-        }
+      for_ranges( m_crn.size(), work_chunks, &AdjustSparse::camera_rhs );
+      Vector<double> e(this->m_model.num_cameras() * BundleAdjustModelT::camera_params_n);
+      for (size_t j = 0; j < m_e_blocks.size(); ++j) {
+        subvector(e, j*BundleAdjustModelT::camera_params_n, BundleAdjustModelT::camera_params_n) =
+          m_e_blocks[j];
       }
 
       time.reset();
@@ -286,86 +505,57 @@ namespace ba {
       time.reset(new Timer("Build Sparse", DebugMessage, "ba"));
 
       // The S matrix is a m x m block matrix with blocks that are
-      // camera_params_n x camera_params_n in size.  It has a sparse
-      // skyline structure, which makes it more efficient to solve
-      // through L*D*L^T decomposition and forward/back substitution
-      // below.
-      math::MatrixSparseSkyline<double> S(this->m_model.num_cameras()*num_cam_params,
-                                          this->m_model.num_cameras()*num_cam_params);
-      for ( size_t j = 0; j < m_crn.size(); j++ ) {
-        { // Filling in diagonal
-          matrix_camera_camera S_jj;
-
-          // Iterate across all features seen by the camera
-          for ( crn_iter fiter = m_crn[j].begin();
-                fiter != m_crn[j].end(); fiter++ ) {
-            S_jj -= (**fiter).m_y*transpose((**fiter).m_w);
-          }
+      // camera_params_n x camera_params_n in size.  It is sparse,
+      // which the solver chosen with set_solver() exploits below.
+      for_ranges( m_crn.size(), work_chunks, &AdjustSparse::schur_cameras );
+      Vector<double> delta_a;
+      if ( m_solver == SKYLINE_LDL_SOLVER ) {
+        math::MatrixSparseSkyline<double> S(this->m_model.num_cameras()*num_cam_params,
+                                            this->m_model.num_cameras()*num_cam_params);
+        load_skyline( S );
+
+        m_S = S; // S is modified in sparse solve. Keeping a copy.
+        time.reset();
 
-          // Augmenting Diagonal
-          S_jj += U[j];
+        // Computing ideal ordering
+        if (!m_found_ideal_ordering) {
+          time.reset(new Timer("Solving Cuthill-Mckee", DebugMessage, "ba"));
+          m_ideal_ordering = cuthill_mckee_ordering(S,num_cam_params);
+          math::MatrixReorganize<math::MatrixSparseSkyline<double> > mod_S( S, m_ideal_ordering );
+          m_ideal_skyline = solve_for_skyline(mod_S);
 
-          // Loading into sparse matrix
-          size_t offset = j * num_cam_params;
-          for ( size_t aa = 0; aa < num_cam_params; aa++ ) {
-            for ( size_t bb = aa; bb < num_cam_params; bb++ ) {
-              S( offset+bb, offset+aa ) = S_jj(aa,bb);  // Transposing
-            }
-          }
+          m_found_ideal_ordering = true;
+          time.reset();
         }
 
-        // Filling in off diagonal
-        for ( size_t k = j+1; k < m_crn.size(); k++ ) {
-          typedef boost::weak_ptr<JFeature> w_ptr;
-          typedef boost::shared_ptr<JFeature> f_ptr;
-          typedef std::multimap< size_t, f_ptr >::iterator mm_iterator;
-          std::pair< mm_iterator, mm_iterator > feature_range;
-          feature_range = m_crn[j].map.equal_range( k );
-
-          // Iterating through all features in camera j that have
-          // connections to camera k.
-          matrix_camera_camera S_jk;
-          bool found = false;
-          for ( mm_iterator f_j_iter = feature_range.first;
-                f_j_iter != feature_range.second; f_j_iter++ ) {
-            w_ptr f_k = (*f_j_iter).second->m_map[k];
-            found = true;
-            S_jk -= (*f_j_iter).second->m_y *
-              transpose( f_k.lock()->m_w );
-          }
+        time.reset(new Timer("Solve Delta A", DebugMessage, "ba"));
+
+        // Compute the LDL^T decomposition and solve using sparse methods.
+        math::MatrixReorganize<math::MatrixSparseSkyline<double> > modified_S( S, m_ideal_ordering );
+        delta_a = sparse_solve( modified_S,
+                                reorganize(e, m_ideal_ordering),
+                                m_ideal_skyline );
+        delta_a = reorganize(delta_a, modified_S.inverse());
+      } else {
+        math::MatrixSparseBlock<double> S( this->m_model.num_cameras(), num_cam_params );
+        load_blocks( S );
+        time.reset();
 
-          // Loading into sparse matrix
-          // - if it seems we are loading in oddly, it's because the sparse
-          //   matrix is row major.
-          if ( found ) {
-            submatrix( S, k*num_cam_params, j*num_cam_params,
-                       num_cam_params, num_cam_params ) = transpose(S_jk);
-          }
+        time.reset(new Timer("Solve Delta A", DebugMessage, "ba"));
+        if ( m_solver == SUPERNODAL_LDL_SOLVER ) {
+          // The camera network, and so the pattern of S, never
+          // changes: order and analyze it once.
+          if ( !m_ldl.analyzed() )
+            m_ldl.analyze( S );
+          m_ldl.factor( S );
+          delta_a = m_ldl.solve( e );
+        } else {
+          delta_a = Vector<double>( e.size() );
+          math::preconditioned_conjugate_gradient( math::SparseBlockOperator<double>( S ),
+                                                   math::BlockJacobiPreconditioner<double>( S ),
+                                                   e, delta_a, m_pcg_tolerance, m_pcg_max_iterations );
         }
       }
-
-      m_S = S; // S is modified in sparse solve. Keeping a copy.
-      time.reset();
-
-      // Computing ideal ordering
-      if (!m_found_ideal_ordering) {
-        time.reset(new Timer("Solving Cuthill-Mckee", DebugMessage, "ba"));
-        m_ideal_ordering = cuthill_mckee_ordering(S,num_cam_params);
-        math::MatrixReorganize<math::MatrixSparseSkyline<double> > mod_S( S, m_ideal_ordering );
-        m_ideal_skyline = solve_for_skyline(mod_S);
-
-        m_found_ideal_ordering = true;
-        time.reset();
-      }
-
-      time.reset(new Timer("Solve Delta A", DebugMessage, "ba"));
-
-      // Compute the LDL^T decomposition and solve using sparse methods.
-      math::MatrixReorganize<math::MatrixSparseSkyline<double> > modified_S( S, m_ideal_ordering );
-      Vector<double> delta_a = sparse_solve( modified_S,
-                                             reorganize(e, m_ideal_ordering),
-                                             m_ideal_skyline );
-      delta_a = reorganize(delta_a, modified_S.inverse());
       BOOST_FOREACH( double& e, delta_a )
         if ( std::isnan( e ) ) e = 0;
       time.reset();
@@ -53,6 +53,7 @@
 //    30  - Write Stereo Triangulation Error Max/Mean/Min
 //    35  - Write Bundlevis Stereo Triangulation Error (binary state
 //          information)
+//    40  - Write Camera Covariance statistics at the end
 //    100 - Write Debug Error Vectors   (big human readable)
 //    110 - Write Debug Jacobian Matrix (massive human readable)
 
@@ -71,6 +72,7 @@ namespace ba {
     TriangulationReportAtEnds = 27,
     TriangulationReport = 30,
     BundlevisTriangulation = 35,
+    CovarianceReport = 40,
     DebugErrorReport = 100,
     DebugJacobianReport = 110
   };
@@ -225,6 +227,8 @@ namespace ba {
         generic_readings();
       if ( report_level >= TriangulationReportAtEnds )
         triangulation_readings();
+      if ( report_level >= CovarianceReport )
+        covariance_readings();
 
       // Closing all files out
       m_human_both.remove( m_human_report );
@@ -291,6 +295,21 @@ namespace ba {
       m_human_both << std::flush;
     }
 
+    // Standard deviation of each camera parameter, over all cameras
+    void covariance_readings() {
+      m_human_both << "\tCamera parameter sigmas:\n";
+      typedef Matrix<double, ModelType::camera_params_n, ModelType::camera_params_n> matrix_camera_camera;
+      std::vector<matrix_camera_camera> covariances = m_adjuster.camera_covariances();
+      for ( size_t k = 0; k < m_model.camera_params_n; k++ ) {
+        math::CDFAccumulator<double> sigma_cdf;
+        BOOST_FOREACH( matrix_camera_camera const& cov, covariances )
+          sigma_cdf( sqrt( cov(k,k) ) );
+        std::ostringstream tag;
+        tag << "Param " << k;
+        write_statistics( sigma_cdf, tag.str(), "" );
+      }
+    }
+
     void stereo_errors( std::vector<double>& stereo_errors ) {
       // Where all the measurement errors will go
       stereo_errors.clear();
@@ -0,0 +1,143 @@
+// __BEGIN_LICENSE__
+// Copyright (C) 2006-2011 United States Government as represented by
+// the Administrator of the National Aeronautics and Space Administration.
+// All Rights Reserved.
+// __END_LICENSE__
+
+
+/// \file DualNumber.h
+///
+/// Forward-mode automatic differentiation.  A model written once for
+/// any scalar type T can be evaluated with T = DualNumber<N> to get
+/// its value and its exact derivatives with respect to N parameters
+/// in a single pass.
+
+#ifndef __VW_BUNDLEADJUSTMENT_DUAL_NUMBER_H__
+#define __VW_BUNDLEADJUSTMENT_DUAL_NUMBER_H__
+
+#include <cmath>
+
+#include <vw/Math/Vector.h>
+
+namespace vw {
+namespace ba {
+
+  // The elementary functions below live in their own namespace, found
+  // by argument-dependent lookup, so they never hide the ones for
+  // plain doubles from other code in vw::ba.
+  namespace dual {
+
+  /// A value together with its gradient with respect to N independent
+  /// variables.  Plain doubles convert to constants (zero gradient).
+  template <size_t N>
+  struct DualNumber {
+    double value;
+    Vector<double, N> grad;
+
+    DualNumber() : value(0) {}
+    DualNumber( double v ) : value(v) {}
+
+    /// The n'th independent variable, currently equal to v.
+    DualNumber( double v, size_t n ) : value(v) { grad[n] = 1; }
+
+    DualNumber& operator+=( DualNumber const& x ) { value += x.value; grad += x.grad; return *this; }
+    DualNumber& operator-=( DualNumber const& x ) { value -= x.value; grad -= x.grad; return *this; }
+    DualNumber& operator*=( DualNumber const& x ) {
+      grad = grad * x.value + x.grad * value;
+      value *= x.value;
+      return *this;
+    }
+    DualNumber& operator/=( DualNumber const& x ) {
+      double inv = 1.0 / x.value;
+      value *= inv;
+      grad = ( grad - x.grad * value ) * inv;
+      return *this;
+    }
+  };
+
+  template <size_t N>
+  inline DualNumber<N> operator-( DualNumber<N> const& x ) {
+    DualNumber<N> r;
+    r.value = -x.value;
+    r.grad = -x.grad;
+    return r;
+  }
+
+#define VW_DUAL_NUMBER_BINARY_OPERATOR( op )                                              \
+  template <size_t N>                                                                     \
+  inline DualNumber<N> operator op( DualNumber<N> x, DualNumber<N> const& y ) { return x op##= y; } \
+  template <size_t N>                                                                     \
+  inline DualNumber<N> operator op( DualNumber<N> x, double y ) { return x op##= DualNumber<N>(y); } \
+  template <size_t N>                                                                     \
+  inline DualNumber<N> operator op( double x, DualNumber<N> const& y ) { return DualNumber<N>(x) op##= y; }
+
+  VW_DUAL_NUMBER_BINARY_OPERATOR( + )
+  VW_DUAL_NUMBER_BINARY_OPERATOR( - )
+  VW_DUAL_NUMBER_BINARY_OPERATOR( * )
+  VW_DUAL_NUMBER_BINARY_OPERATOR( / )
+
+#undef VW_DUAL_NUMBER_BINARY_OPERATOR
+
+  // Comparisons look only at the value, so branches in a model go
+  // the same way they would for plain doubles.
+  template <size_t N> inline bool operator<( DualNumber<N> const& x, DualNumber<N> const& y ) { return x.value < y.value; }
+  template <size_t N> inline bool operator>( DualNumber<N> const& x, DualNumber<N> const& y ) { return x.value > y.value; }
+  template <size_t N> inline bool operator<( DualNumber<N> const& x, double y ) { return x.value < y; }
+  template <size_t N> inline bool operator>( DualNumber<N> const& x, double y ) { return x.value > y; }
+
+  // Elementary functions, by the chain rule
+  template <size_t N>
+  inline DualNumber<N> chain( DualNumber<N> const& x, double value, double derivative ) {
+    DualNumber<N> r;
+    r.value = value;
+    r.grad = x.grad * derivative;
+    return r;
+  }
+
+  template <size_t N> inline DualNumber<N> sqrt( DualNumber<N> const& x ) {
+    double s = std::sqrt( x.value );
+    return chain( x, s, 0.5 / s );
+  }
+  template <size_t N> inline DualNumber<N> sin( DualNumber<N> const& x ) {
+    return chain( x, std::sin( x.value ), std::cos( x.value ) );
+  }
+  template <size_t N> inline DualNumber<N> cos( DualNumber<N> const& x ) {
+    return chain( x, std::cos( x.value ), -std::sin( x.value ) );
+  }
+  template <size_t N> inline DualNumber<N> tan( DualNumber<N> const& x ) {
+    double t = std::tan( x.value );
+    return chain( x, t, 1 + t*t );
+  }
+  template <size_t N> inline DualNumber<N> atan( DualNumber<N> const& x ) {
+    return chain( x, std::atan( x.value ), 1 / ( 1 + x.value*x.value ) );
+  }
+  template <size_t N> inline DualNumber<N> atan2( DualNumber<N> const& y, DualNumber<N> const& x ) {
+    double d = x.value*x.value + y.value*y.value;
+    DualNumber<N> r;
+    r.value = std::atan2( y.value, x.value );
+    r.grad = ( y.grad * x.value - x.grad * y.value ) / d;
+    return r;
+  }
+  template <size_t N> inline DualNumber<N> exp( DualNumber<N> const& x ) {
+    double e = std::exp( x.value );
+    return chain( x, e, e );
+  }
+  template <size_t N> inline DualNumber<N> log( DualNumber<N> const& x ) {
+    return chain( x, std::log( x.value ), 1 / x.value );
+  }
+  template <size_t N> inline DualNumber<N> fabs( DualNumber<N> const& x ) {
+    return x.value < 0 ? -x : x;
+  }
+
+  /// The value of a scalar, dual or not.
+  inline double dual_value( double x ) { return x; }
+  template <size_t N> inline double dual_value( DualNumber<N> const& x ) { return x.value; }
+
+  } // namespace dual
+
+  using dual::DualNumber;
+  using dual::dual_value;
+
+}} // namespace vw::ba
+
+#endif//__VW_BUNDLEADJUSTMENT_DUAL_NUMBER_H__
@@ -15,16 +15,19 @@
 
 // Standard
 #include <string>
+#include <vector>
 
 // Vision Workbench
 #include <vw/Math/Matrix.h>
 #include <vw/Math/Vector.h>
 #include <vw/BundleAdjustment/ControlNetwork.h>
+#include <vw/BundleAdjustment/DualNumber.h>
 #include <vw/Core/Log.h>
 #include <vw/Camera/CameraModel.h>
 
 // Boost
 #include <boost/smart_ptr.hpp>
+#include <boost/mpl/bool.hpp>
 
 namespace vw {
 namespace ba {
@@ -37,6 +40,29 @@ namespace ba {
     static const size_t camera_params_n = CameraParamsN;
     static const size_t point_params_n = PointParamsN;
 
+    /// Models that can write their projection for any scalar type set
+    /// this to true and provide
+    ///
+    ///   template <class T>
+    ///   Vector<T,2> evaluate( size_t i, size_t j,
+    ///                         Vector<T,CameraParamsN> const& a_j,
+    ///                         Vector<T,PointParamsN> const& b_i );
+    ///
+    /// Their jacobians are then exact, and come from one evaluation
+    /// with dual numbers rather than one per parameter.
+    static const bool analytic_jacobians = false;
+
+    /// The model's value at one measurement, and its jacobians there.
+    /// If the point could not be projected, valid is false and the
+    /// rest is zero.
+    struct Linearization {
+      Vector2 value;
+      Matrix<double, 2, CameraParamsN> A;
+      Matrix<double, 2, PointParamsN> B;
+      bool valid;
+      Linearization() : valid(false) {}
+    };
+
     /// \cond INTERNAL
     // Methods to access the derived type
     inline ImplT& impl() { return static_cast<ImplT&>(*this); }
@@ -51,7 +77,8 @@ namespace ba {
     }
 
     // Approximate the jacobian for small variations in the a_j
-    // parameters (camera parameters).
+    // parameters (camera parameters).  Models with analytic jacobians
+    // get the exact one instead.
     inline Matrix<double, 2, CameraParamsN> A_jacobian ( size_t i, size_t j,
                                                          Vector<double, CameraParamsN> const& a_j,
                                                          Vector<double, PointParamsN> const& b_i ) {
@@ -59,6 +86,12 @@ namespace ba {
       // Jacobian is #outputs x #params
       Matrix<double, 2, CameraParamsN> J;
 
+      if ( ImplT::analytic_jacobians ) {
+        Linearization result;
+        jacobians( i, j, a_j, b_i, result );
+        return result.A;
+      }
+
       Vector2 h0;
       try {
         // Get nominal function value
@@ -91,7 +124,8 @@ namespace ba {
     }
 
     // Approximate the jacobian for small variations in the b_i
-    // parameters (3d point locations).
+    // parameters (3d point locations).  Models with analytic jacobians
+    // get the exact one instead.
     inline Matrix<double, 2, PointParamsN> B_jacobian ( size_t i, size_t j,
                                                         Vector<double, CameraParamsN> const& a_j,
                                                         Vector<double, PointParamsN> const& b_i ) {
@@ -99,6 +133,12 @@ namespace ba {
       // Jacobian is #outputs x #params
       Matrix<double, 2, PointParamsN> J;
 
+      if ( ImplT::analytic_jacobians ) {
+        Linearization result;
+        jacobians( i, j, a_j, b_i, result );
+        return result.B;
+      }
+
       Vector2 h0;
       try {
         // Get nominal function value
@@ -129,6 +169,151 @@ namespace ba {
       return J;
     }
 
+    // Evaluates the model along with both of its jacobians.  This
+    // is analytic if the model supports it.  Otherwise it calls the
+    // model's own A_jacobian() and B_jacobian() if it hides either of
+    // ours, and failing that shares the nominal evaluation between the
+    // forward differences for A and B.
+    void jacobians( size_t i, size_t j,
+                    Vector<double, CameraParamsN> const& a_j,
+                    Vector<double, PointParamsN> const& b_i,
+                    Linearization& result ) {
+      linearize( i, j, a_j, b_i, result, boost::mpl::bool_<ImplT::analytic_jacobians>() );
+    }
+
+    // Evaluates every measurement of camera j, of the given points,
+    // in one call.  Models with per-camera setup worth sharing between
+    // measurements can provide their own.
+    void camera_jacobians( size_t j, std::vector<size_t> const& points,
+                           std::vector<Linearization>& results ) {
+      results.resize( points.size() );
+      camera_linearize( j, points, results, boost::mpl::bool_<ImplT::analytic_jacobians>() );
+    }
+
+  private:
+    typedef DualNumber<CameraParamsN+PointParamsN> dual_type;
+
+    // Only our own A_jacobian() and B_jacobian() convert to these
+    // pointers; ones the model declares are members of ImplT instead.
+    typedef Matrix<double, 2, CameraParamsN> (ModelBase::*A_jacobian_ptr)
+      ( size_t, size_t, Vector<double, CameraParamsN> const&, Vector<double, PointParamsN> const& );
+    typedef Matrix<double, 2, PointParamsN> (ModelBase::*B_jacobian_ptr)
+      ( size_t, size_t, Vector<double, CameraParamsN> const&, Vector<double, PointParamsN> const& );
+    static char inherited_jacobian( A_jacobian_ptr );
+    static char inherited_jacobian( B_jacobian_ptr );
+    static long inherited_jacobian( ... );
+
+    void linearize( size_t i, size_t j,
+                    Vector<double, CameraParamsN> const& a_j,
+                    Vector<double, PointParamsN> const& b_i,
+                    Linearization& result, boost::mpl::false_ ) {
+      linearize_numeric( i, j, a_j, b_i, result,
+                         boost::mpl::bool_< sizeof( inherited_jacobian( &ImplT::A_jacobian ) ) == 1 &&
+                                            sizeof( inherited_jacobian( &ImplT::B_jacobian ) ) == 1 >() );
+    }
+
+    // The model has jacobians of its own
+    void linearize_numeric( size_t i, size_t j,
+                            Vector<double, CameraParamsN> const& a_j,
+                            Vector<double, PointParamsN> const& b_i,
+                            Linearization& result, boost::mpl::false_ ) {
+      result = Linearization();
+      try {
+        result.value = impl()(i,j,a_j,b_i);
+      } catch (const camera::PixelToRayErr& e) {
+        return;
+      }
+      result.valid = true;
+      result.A = impl().A_jacobian(i,j,a_j,b_i);
+      result.B = impl().B_jacobian(i,j,a_j,b_i);
+    }
+
+    void linearize_numeric( size_t i, size_t j,
+                            Vector<double, CameraParamsN> const& a_j,
+                            Vector<double, PointParamsN> const& b_i,
+                            Linearization& result, boost::mpl::true_ ) {
+      result = Linearization();
+      try {
+        result.value = impl()(i,j,a_j,b_i);
+      } catch (const camera::PixelToRayErr& e) {
+        return;
+      }
+      result.valid = true;
+
+      for ( size_t n=0; n < CameraParamsN; ++n ){
+        Vector<double, CameraParamsN> a_j_prime = a_j;
+        double epsilon = 1e-7 + fabs(a_j(n)*1e-7);
+        a_j_prime(n) += epsilon;
+        try {
+          select_col(result.A,n) = (impl()(i,j,a_j_prime,b_i)-result.value)/epsilon;
+        } catch (const camera::PixelToRayErr& e) {}
+      }
+      for ( size_t n=0; n < PointParamsN; ++n ){
+        Vector<double, PointParamsN> b_i_prime = b_i;
+        double epsilon = 1e-7 + fabs(b_i(n)*1e-7);
+        b_i_prime(n) += epsilon;
+        try {
+          select_col(result.B,n) = (impl()(i,j,a_j,b_i_prime)-result.value)/epsilon;
+        } catch (const camera::PixelToRayErr& e) {}
+      }
+    }
+
+    void linearize( size_t i, size_t j,
+                    Vector<double, CameraParamsN> const& a_j,
+                    Vector<double, PointParamsN> const& b_i,
+                    Linearization& result, boost::mpl::true_ ) {
+      linearize_dual( i, j, seed_camera( a_j ), b_i, result );
+    }
+
+    void camera_linearize( size_t j, std::vector<size_t> const& points,
+                           std::vector<Linearization>& results, boost::mpl::false_ ) {
+      Vector<double, CameraParamsN> a_j = impl().A_parameters(j);
+      for ( size_t k=0; k < points.size(); ++k )
+        impl().jacobians( points[k], j, a_j, impl().B_parameters(points[k]), results[k] );
+    }
+
+    // The camera's parameters are seeded once for all its points
+    void camera_linearize( size_t j, std::vector<size_t> const& points,
+                           std::vector<Linearization>& results, boost::mpl::true_ ) {
+      Vector<dual_type, CameraParamsN> a_j = seed_camera( impl().A_parameters(j) );
+      for ( size_t k=0; k < points.size(); ++k )
+        linearize_dual( points[k], j, a_j, impl().B_parameters(points[k]), results[k] );
+    }
+
+    // Camera parameters are the first variables, then the point's
+    static Vector<dual_type, CameraParamsN> seed_camera( Vector<double, CameraParamsN> const& a_j ) {
+      Vector<dual_type, CameraParamsN> a;
+      for ( size_t n=0; n < CameraParamsN; ++n )
+        a[n] = dual_type( a_j[n], n );
+      return a;
+    }
+
+    void linearize_dual( size_t i, size_t j,
+                         Vector<dual_type, CameraParamsN> const& a_j,
+                         Vector<double, PointParamsN> const& b_i,
+                         Linearization& result ) {
+      result = Linearization();
+      Vector<dual_type, PointParamsN> b;
+      for ( size_t n=0; n < PointParamsN; ++n )
+        b[n] = dual_type( b_i[n], CameraParamsN+n );
+
+      Vector<dual_type, 2> h;
+      try {
+        h = impl().evaluate( i, j, a_j, b );
+      } catch (const camera::PixelToRayErr& e) {
+        return;
+      }
+      result.valid = true;
+      for ( size_t r=0; r < 2; ++r ) {
+        result.value[r] = h[r].value;
+        for ( size_t n=0; n < CameraParamsN; ++n )
+          result.A(r,n) = h[r].grad[n];
+        for ( size_t n=0; n < PointParamsN; ++n )
+          result.B(r,n) = h[r].grad[CameraParamsN+n];
+      }
+    }
+
+  public:
     // -- Report Functions -------------------------------------------
 
     std::string image_unit() { return "pixels"; }
@@ -24,8 +24,12 @@ using namespace vw::ba;
 
 // Building a Model
 // ------------------------
-class TestBAModel : public ba::ModelBase< TestBAModel, 6, 3 > {
+// Everything but the projection itself, which the models below
+// provide in different ways.
+template <class ImplT>
+class TestBAModelBase : public ba::ModelBase< ImplT, 6, 3 > {
 
+protected:
   typedef Vector<double, 6> camera_vector_t;
   typedef Vector<double, 3> point_vector_t;
 
@@ -37,8 +41,8 @@ class TestBAModel : public ba::ModelBase< TestBAModel, 6, 3 > {
 
 public:
   // Constructor
-  TestBAModel( std::vector< boost::shared_ptr<PinholeModel> > const& cameras,
-               boost::shared_ptr<ControlNetwork> network ) : m_cameras(cameras), m_cnet(network) {
+  TestBAModelBase( std::vector< boost::shared_ptr<PinholeModel> > const& cameras,
+                   boost::shared_ptr<ControlNetwork> network ) : m_cameras(cameras), m_cnet(network) {
 
     // Compute the number of observations from the bundle.
     m_num_pixel_observations = 0;
@@ -65,18 +69,6 @@ public:
 
   // -- REQUIRED STUFF ---------------------------------------
 
-  // Access to the cameras
-  Vector2 operator() ( size_t /*i*/, size_t j,
-                       camera_vector_t const& a_j,
-                       point_vector_t const& b_i ) const {
-    // Quaternions are the last half of this equation
-    AdjustedCameraModel cam( m_cameras[j],
-                             subvector(a_j,0,3),
-                             math::euler_to_quaternion(a_j[3],a_j[4],a_j[5],"xyz") );
-
-    return cam.point_to_pixel( b_i );
-  }
-
   inline Matrix<double,6,6> A_inverse_covariance( size_t /*j*/ ) {
     Matrix<double,6,6> result;
     result.set_identity();
@@ -104,6 +96,96 @@ public:
     return m_cnet; }
 };
 
+// Projects through the cameras, and leaves the jacobians to forward
+// differences.
+class TestBAModel : public TestBAModelBase< TestBAModel > {
+public:
+  TestBAModel( std::vector< boost::shared_ptr<PinholeModel> > const& cameras,
+               boost::shared_ptr<ControlNetwork> network ) : TestBAModelBase<TestBAModel>(cameras, network) {}
+
+  // Access to the cameras
+  Vector2 operator() ( size_t /*i*/, size_t j,
+                       camera_vector_t const& a_j,
+                       point_vector_t const& b_i ) const {
+    // Quaternions are the last half of this equation
+    AdjustedCameraModel cam( m_cameras[j],
+                             subvector(a_j,0,3),
+                             math::euler_to_quaternion(a_j[3],a_j[4],a_j[5],"xyz") );
+
+    return cam.point_to_pixel( b_i );
+  }
+};
+
+// The same projection written out for any scalar type, so that its
+// jacobians can be found with dual numbers.
+class TestAnalyticBAModel : public TestBAModelBase< TestAnalyticBAModel > {
+public:
+  static const bool analytic_jacobians = true;
+
+  TestAnalyticBAModel( std::vector< boost::shared_ptr<PinholeModel> > const& cameras,
+                       boost::shared_ptr<ControlNetwork> network ) : TestBAModelBase<TestAnalyticBAModel>(cameras, network) {}
+
+  template <class T>
+  Vector<T,2> evaluate( size_t /*i*/, size_t j,
+                        Vector<T,6> const& a_j,
+                        Vector<T,3> const& b_i ) const {
+    Vector3 center = m_cameras[j]->camera_center();
+    Matrix<double,3,4> P = m_cameras[j]->camera_matrix();
+
+    // Undo the adjustment: translate, then apply the inverse of
+    // R = Rz(a5) Ry(a4) Rx(a3) about the camera center.
+    T x = b_i[0] - center[0] - a_j[0];
+    T y = b_i[1] - center[1] - a_j[1];
+    T z = b_i[2] - center[2] - a_j[2];
+    T c = cos(a_j[5]), s = sin(a_j[5]);
+    T t = c*x + s*y;
+    y = c*y - s*x; x = t;
+    c = cos(a_j[4]); s = sin(a_j[4]);
+    t = c*x - s*z;
+    z = s*x + c*z; x = t;
+    c = cos(a_j[3]); s = sin(a_j[3]);
+    t = c*y + s*z;
+    z = c*z - s*y; y = t;
+    x = x + center[0]; y = y + center[1]; z = z + center[2];
+
+    T w = P(2,0)*x + P(2,1)*y + P(2,2)*z + P(2,3);
+    return Vector<T,2>( (P(0,0)*x + P(0,1)*y + P(0,2)*z + P(0,3)) / w,
+                        (P(1,0)*x + P(1,1)*y + P(1,2)*z + P(1,3)) / w );
+  }
+
+  Vector2 operator() ( size_t i, size_t j,
+                       camera_vector_t const& a_j,
+                       point_vector_t const& b_i ) {
+    return evaluate( i, j, a_j, b_i );
+  }
+};
+
+// Supplies its own jacobians by hiding A_jacobian() and B_jacobian(),
+// here borrowed from the analytic model.
+class TestHandJacobianBAModel : public TestBAModelBase< TestHandJacobianBAModel > {
+  TestAnalyticBAModel m_analytic;
+public:
+  TestHandJacobianBAModel( std::vector< boost::shared_ptr<PinholeModel> > const& cameras,
+                           boost::shared_ptr<ControlNetwork> network ) :
+    TestBAModelBase<TestHandJacobianBAModel>(cameras, network), m_analytic(cameras, network) {}
+
+  Vector2 operator() ( size_t i, size_t j,
+                       camera_vector_t const& a_j,
+                       point_vector_t const& b_i ) {
+    return m_analytic( i, j, a_j, b_i );
+  }
+  Matrix<double,2,6> A_jacobian( size_t i, size_t j,
+                                 camera_vector_t const& a_j,
+                                 point_vector_t const& b_i ) {
+    return m_analytic.A_jacobian( i, j, a_j, b_i );
+  }
+  Matrix<double,2,3> B_jacobian( size_t i, size_t j,
+                                 camera_vector_t const& a_j,
+                                 point_vector_t const& b_i ) {
+    return m_analytic.B_jacobian( i, j, a_j, b_i );
+  }
+};
+
 // Generating Data
 // ----------------------
 
@@ -349,3 +431,200 @@ TEST_F( ComparisonTest, RobustRef_VS_RobustSparse ) {
                         spr_solution[i],
                         1e-2 );
 }
+
+// Analytic Tests
+// -----------------------
+TEST_F( NullTest, AdjustRobustSparseAnalytic ) {
+  TestAnalyticBAModel model( cameras, cnet );
+  AdjustRobustSparse< TestAnalyticBAModel, L2Error > adjuster( model, L2Error(), false, false);
+
+  // Running BA
+  double abs_tol = 1e10, rel_tol = 1e10;
+  for ( uint32 i = 0; i < 5; i++ )
+    adjuster.update(abs_tol,rel_tol);
+
+  // Checking solutions
+  Vector<double,6> zero_vector;
+  for ( uint32 i = 0; i < 5; i++ ) {
+    Vector<double> solution = model.A_parameters(i);
+    EXPECT_VECTOR_NEAR( solution, zero_vector, 1e-1 );
+  }
+}
+
+TEST_F( ComparisonTest, AnalyticJacobians ) {
+  TestBAModel fd_model( cameras, cnet );
+  TestAnalyticBAModel model( cameras, cnet );
+  for ( uint32 j = 0; j < 5; j++ ) {
+    Vector<double,6> a_j;
+    subvector(a_j,0,3) = Vector3( 0.3, -0.2, 0.1 );
+    subvector(a_j,3,3) = Vector3( 0.01*j, -0.02, 0.015 );
+    fd_model.set_A_parameters( j, a_j );
+    model.set_A_parameters( j, a_j );
+  }
+
+  std::vector<size_t> points;
+  for ( uint32 i = 0; i < cnet->size(); i++ )
+    points.push_back( i );
+  for ( uint32 j = 0; j < 5; j++ ) {
+    std::vector<TestBAModel::Linearization> expected;
+    std::vector<TestAnalyticBAModel::Linearization> result;
+    fd_model.camera_jacobians( j, points, expected );
+    model.camera_jacobians( j, points, result );
+    ASSERT_EQ( points.size(), result.size() );
+    for ( size_t k = 0; k < points.size(); k++ ) {
+      ASSERT_TRUE( result[k].valid );
+      EXPECT_VECTOR_NEAR( expected[k].value, result[k].value, 1e-8 );
+      EXPECT_MATRIX_NEAR( expected[k].A, result[k].A, 1e-3 * (1 + norm_frobenius(result[k].A)) );
+      EXPECT_MATRIX_NEAR( expected[k].B, result[k].B, 1e-3 * (1 + norm_frobenius(result[k].B)) );
+    }
+  }
+}
+
+TEST_F( ComparisonTest, ModelJacobians ) {
+  TestAnalyticBAModel analytic( cameras, cnet );
+  TestHandJacobianBAModel model( cameras, cnet );
+
+  std::vector<size_t> points;
+  for ( uint32 i = 0; i < cnet->size(); i++ )
+    points.push_back( i );
+  for ( uint32 j = 0; j < 5; j++ ) {
+    std::vector<TestAnalyticBAModel::Linearization> expected;
+    std::vector<TestHandJacobianBAModel::Linearization> result;
+    analytic.camera_jacobians( j, points, expected );
+    model.camera_jacobians( j, points, result );
+    for ( size_t k = 0; k < points.size(); k++ ) {
+      ASSERT_TRUE( result[k].valid );
+      // The sparse adjusters' path uses the model's own jacobians...
+      EXPECT_MATRIX_NEAR( expected[k].A, result[k].A, 1e-12 );
+      EXPECT_MATRIX_NEAR( expected[k].B, result[k].B, 1e-12 );
+      // ...and the Ref adjusters' path the analytic ones
+      Matrix<double,2,6> A = analytic.A_jacobian( points[k], j, analytic.A_parameters(j),
+                                                  analytic.B_parameters(points[k]) );
+      EXPECT_MATRIX_NEAR( expected[k].A, A, 1e-12 );
+    }
+  }
+}
+
+TEST_F( ComparisonTest, Analytic_VS_FiniteDifference ) {
+  std::vector<Vector<double> > fd_solution;
+  std::vector<Vector<double> > analytic_solution;
+
+  { // Performing BA with forward differences
+    TestBAModel model( cameras, cnet );
+    AdjustSparse< TestBAModel, L2Error > adjuster( model, L2Error(), false, false);
+
+    double abs_tol = 1e10, rel_tol = 1e10;
+    for ( unsigned i = 0; i < 10; i++ )
+      adjuster.update(abs_tol,rel_tol);
+
+    for ( uint32 i = 0; i < 5; i++ )
+      fd_solution.push_back( model.A_parameters(i) );
+  }
+
+  { // Performing BA with exact jacobians
+    TestAnalyticBAModel model( cameras, cnet );
+    AdjustSparse< TestAnalyticBAModel, L2Error > adjuster( model, L2Error(), false, false);
+
+    double abs_tol = 1e10, rel_tol = 1e10;
+    for ( unsigned i = 0; i < 10; i++ )
+      adjuster.update(abs_tol,rel_tol);
+
+    for ( uint32 i = 0; i < 5; i++ )
+      analytic_solution.push_back( model.A_parameters(i) );
+  }
+
+  for ( uint32 i = 0; i < 5; i++ )
+    ASSERT_VECTOR_NEAR( fd_solution[i],
+                        analytic_solution[i],
+                        1e-3 );
+}
+
+TEST_F( ComparisonTest, Serial_VS_Threaded ) {
+  std::vector<Vector<double> > serial_solution;
+  std::vector<Vector<double> > threaded_solution;
+
+  { // Performing BA on one thread
+    TestBAModel model( cameras, cnet );
+    AdjustSparse< TestBAModel, L2Error > adjuster( model, L2Error(), false, false);
+
+    double abs_tol = 1e10, rel_tol = 1e10;
+    for ( unsigned i = 0; i < 10; i++ )
+      adjuster.update(abs_tol,rel_tol);
+
+    for ( uint32 i = 0; i < 5; i++ )
+      serial_solution.push_back( model.A_parameters(i) );
+  }
+
+  { // Performing BA with the normal equations built on several threads
+    TestBAModel model( cameras, cnet );
+    AdjustSparse< TestBAModel, L2Error > adjuster( model, L2Error(), false, false);
+    adjuster.set_num_threads( 4 );
+
+    double abs_tol = 1e10, rel_tol = 1e10;
+    for ( unsigned i = 0; i < 10; i++ )
+      adjuster.update(abs_tol,rel_tol);
+
+    for ( uint32 i = 0; i < 5; i++ )
+      threaded_solution.push_back( model.A_parameters(i) );
+  }
+
+  for ( uint32 i = 0; i < 5; i++ )
+    ASSERT_VECTOR_NEAR( serial_solution[i],
+                        threaded_solution[i],
+                        1e-6 );
+}
+
+TEST_F( ComparisonTest, Skyline_VS_BlockSolvers ) {
+  SparseSolverType solvers[] = { SKYLINE_LDL_SOLVER, SUPERNODAL_LDL_SOLVER,
+                                 BLOCK_JACOBI_PCG_SOLVER };
+  std::vector<Vector<double> > solutions[3];
+
+  for ( uint32 s = 0; s < 3; s++ ) {
+    TestBAModel model( cameras, cnet );
+    AdjustSparse< TestBAModel, L2Error > adjuster( model, L2Error(), false, false);
+    adjuster.set_solver( solvers[s], 1e-14 );
+
+    double abs_tol = 1e10, rel_tol = 1e10;
+    for ( unsigned i = 0; i < 10; i++ )
+      adjuster.update(abs_tol,rel_tol);
+
+    for ( uint32 i = 0; i < 5; i++ )
+      solutions[s].push_back( model.A_parameters(i) );
+  }
+
+  for ( uint32 s = 1; s < 3; s++ )
+    for ( uint32 i = 0; i < 5; i++ )
+      ASSERT_VECTOR_NEAR( solutions[0][i],
+                          solutions[s][i],
+                          1e-6 );
+}
+
+template <class AdjusterT>
+void check_camera_covariances( AdjusterT& adjuster, size_t num_cameras ) {
+  double abs_tol = 1e10, rel_tol = 1e10;
+  for ( unsigned i = 0; i < 2; i++ )
+    adjuster.update(abs_tol,rel_tol);
+
+  Matrix<double> S = adjuster.S();
+  Matrix<double> expected = inverse( S );
+  std::vector<Matrix<double,6,6> > covariances = adjuster.camera_covariances();
+  ASSERT_EQ( num_cameras, covariances.size() );
+  for ( uint32 j = 0; j < num_cameras; j++ )
+    for ( uint32 r = 0; r < 6; r++ )
+      for ( uint32 c = 0; c < 6; c++ )
+        EXPECT_NEAR( expected(j*6+r, j*6+c), covariances[j](r,c),
+                     1e-5 * fabs(expected(j*6+r, j*6+c)) + 1e-10 );
+}
+
+TEST_F( ComparisonTest, SparseCovariances ) {
+  {
+    TestBAModel model( cameras, cnet );
+    AdjustSparse< TestBAModel, L2Error > adjuster( model, L2Error(), false, false);
+    check_camera_covariances( adjuster, 5 );
+  }
+  {
+    TestBAModel model( cameras, cnet );
+    AdjustRobustSparse< TestBAModel, L2Error > adjuster( model, L2Error(), false, false);
+    check_camera_covariances( adjuster, 5 );
+  }
+}
@@ -6,6 +6,9 @@
 
 
 #include <vw/Cartography/CameraBBox.h>
+#include <vw/Core/ThreadPool.h>
+
+#include <map>
 
 using namespace vw;
 
@@ -44,42 +47,232 @@ cartography::geospatial_intersect( Vector2 pix,
   return geospatial_point;
 }
 
+bool cartography::detail::camera_bbox_center_on_zero( camera::CameraModel const& camera_model ) {
+  // Testing to see if we should be centering on zero
+  Vector3 camera_llr =
+    XYZtoLonLatRadFunctor::apply(camera_model.camera_center(Vector2()));
+  return !( camera_llr[0] < -90 || camera_llr[0] > 90 );
+}
+
+cartography::detail::CameraDatumIntersector::CameraDatumIntersector( GeoReference const& georef,
+                                                                     boost::shared_ptr<camera::CameraModel> camera,
+                                                                     bool center_on_zero )
+  : m_georef(georef), m_camera(camera), m_center_on_zero(center_on_zero) {
+  m_z_scale = m_georef.datum().semi_major_axis() / m_georef.datum().semi_minor_axis();
+}
+
+bool cartography::detail::CameraDatumIntersector::operator()( Vector2 const& pixel, Vector2& point ) const {
+  bool did_intersect;
+  point = geospatial_intersect( pixel, m_georef, m_camera, m_z_scale, did_intersect );
+  if ( did_intersect && m_center_on_zero && point[0] > 180 )
+    point[0] -= 360.0;
+  return did_intersect;
+}
+
+namespace {
+
+  using namespace vw::cartography;
+
+  // One sample along one of the lines
+  struct BBoxSample {
+    Vector2 point;
+    bool valid;
+    BBoxSample() : valid(false) {}
+  };
+
+  // A stretch between two samples on a line, t0 < t1
+  struct BBoxSpan {
+    int32 line, t0, t1;
+    BBoxSpan( int32 line, int32 t0, int32 t1 ) : line(line), t0(t0), t1(t1) {}
+  };
+
+  // Intersects a batch of pixels
+  class IntersectTask : public Task {
+    detail::CameraBBoxIntersector const& m_intersect;
+    std::vector<Vector2> const& m_pixels;
+    std::vector<BBoxSample>& m_samples;
+    size_t m_begin, m_end;
+  public:
+    IntersectTask( detail::CameraBBoxIntersector const& intersect,
+                   std::vector<Vector2> const& pixels, std::vector<BBoxSample>& samples,
+                   size_t begin, size_t end )
+      : m_intersect(intersect), m_pixels(pixels), m_samples(samples), m_begin(begin), m_end(end) {}
+
+    virtual void operator()() {
+      for ( size_t i = m_begin; i < m_end; ++i ) {
+        try {
+          m_samples[i].valid = m_intersect( m_pixels[i], m_samples[i].point );
+        } catch ( const vw::Exception& ) {
+          // Rays the camera can't produce don't hit the planet either
+          m_samples[i].valid = false;
+        }
+      }
+    }
+  };
+
+  void intersect_all( detail::CameraBBoxIntersector const& intersect,
+                      std::vector<Vector2> const& pixels, std::vector<BBoxSample>& samples,
+                      int num_threads ) {
+    samples.resize( pixels.size() );
+    if ( num_threads <= 1 || pixels.size() < 2 ) {
+      IntersectTask( intersect, pixels, samples, 0, pixels.size() )();
+      return;
+    }
+    FifoWorkQueue queue( num_threads );
+    size_t chunk = std::max( size_t(1), pixels.size() / (4 * size_t(num_threads)) );
+    for ( size_t begin = 0; begin < pixels.size(); begin += chunk )
+      queue.add_task( boost::shared_ptr<Task>( new IntersectTask( intersect, pixels, samples, begin,
+                                                                  std::min( begin + chunk, pixels.size() ) ) ) );
+    queue.join_all();
+  }
+
+  // Queues a span for judging, along with its midpoint for
+  // intersecting. Spans one pixel long are already done.
+  void queue_span( std::vector<BBoxSpan>& spans,
+                   std::vector<std::pair<int32, int32> >& pending,
+                   BBoxSpan const& span ) {
+    if ( span.t1 - span.t0 <= 1 )
+      return;
+    spans.push_back( span );
+    pending.push_back( std::make_pair( span.line, (span.t0 + span.t1) / 2 ) );
+  }
+
+  // Walks the four edges of the image and then once through the
+  // diagonal. Each line is parameterized by an integer t from 0 to
+  // length(line), one step per pixel along its longer axis.
+  class BBoxLines {
+    Vector2 m_start[5], m_end[5];
+    int32 m_length[5];
+  public:
+    BBoxLines( int32 cols, int32 rows ) {
+      Vector2 c[4] = { Vector2(0,0), Vector2(cols-1,0), Vector2(cols-1,rows-1), Vector2(0,rows-1) };
+      for ( int32 l = 0; l < 4; ++l ) {
+        m_start[l] = c[l];
+        m_end[l] = c[(l+1)%4];
+      }
+      m_start[4] = c[0];
+      m_end[4] = c[2];
+      for ( int32 l = 0; l < 5; ++l )
+        m_length[l] = int32( std::max( fabs(m_end[l].x() - m_start[l].x()),
+                                       fabs(m_end[l].y() - m_start[l].y()) ) );
+    }
+    static int32 size() { return 5; }
+    int32 length( int32 l ) const { return m_length[l]; }
+    Vector2 pixel( int32 l, int32 t ) const {
+      if ( m_length[l] == 0 ) return m_start[l];
+      return m_start[l] + (m_end[l] - m_start[l]) * (double(t) / m_length[l]);
+    }
+  };
+
+} // namespace
+
+cartography::CameraBBoxResult
+cartography::detail::camera_bbox_adaptive( CameraBBoxIntersector const& intersect,
+                                           int32 cols, int32 rows,
+                                           double tolerance, int num_threads ) {
+  VW_ASSERT( cols > 0 && rows > 0,
+             ArgumentErr() << "camera_bbox: image must have a nonzero size." );
+  if ( num_threads == 0 )
+    num_threads = vw_settings().default_num_threads();
+
+  BBoxLines lines( cols, rows );
+  std::vector<std::map<int32, BBoxSample> > samples( lines.size() );
+  std::vector<std::pair<int32, int32> > pending;
+  std::vector<BBoxSpan> spans;
+
+  // Start with a coarse, even spread on every line
+  static const int32 initial_samples = 32;
+  for ( int32 l = 0; l < lines.size(); ++l ) {
+    int32 n = std::min( lines.length(l), initial_samples );
+    pending.push_back( std::make_pair( l, 0 ) );
+    for ( int32 k = 1, prev = 0; k <= n; ++k ) {
+      int32 t = int32( (int64(k) * lines.length(l)) / n );
+      pending.push_back( std::make_pair( l, t ) );
+      queue_span( spans, pending, BBoxSpan( l, prev, t ) );
+      prev = t;
+    }
+  }
+
+  CameraBBoxResult result;
+  std::vector<Vector2> pixels;
+  std::vector<BBoxSample> batch;
+  while ( true ) {
+    // Intersect everything new in one parallel batch
+    pixels.resize( pending.size() );
+    for ( size_t i = 0; i < pending.size(); ++i )
+      pixels[i] = lines.pixel( pending[i].first, pending[i].second );
+    intersect_all( intersect, pixels, batch, num_threads );
+    for ( size_t i = 0; i < pending.size(); ++i )
+      samples[pending[i].first][pending[i].second] = batch[i];
+    result.samples += int32( pending.size() );
+    pending.clear();
+
+    // Judge every span; their midpoints came back this round. A span
+    // is accepted once the midpoint lies within tolerance pixels
+    // (measured in the local output spacing) of the chord between
+    // its ends. Spans that cross the limb are split down to a
+    // single pixel; spans that miss the planet entirely are dropped.
+    std::vector<BBoxSpan> current;
+    current.swap( spans );
+    for ( size_t i = 0; i < current.size(); ++i ) {
+      BBoxSpan const& span = current[i];
+      int32 tm = (span.t0 + span.t1) / 2;
+      std::map<int32, BBoxSample>& line = samples[span.line];
+      BBoxSample const& a = line[span.t0];
+      BBoxSample const& m = line[tm];
+      BBoxSample const& b = line[span.t1];
+      bool split = a.valid || m.valid || b.valid;
+      if ( a.valid && m.valid && b.valid ) {
+        Vector2 chord = a.point + (b.point - a.point) * (double(tm - span.t0) / (span.t1 - span.t0));
+        double spacing = norm_2( b.point - a.point ) / (span.t1 - span.t0);
+        double deviation = norm_2( m.point - chord );
+        split = deviation > tolerance * spacing;
+        if ( !split )
+          result.error = std::max( result.error, deviation );
+      }
+      if ( split ) {
+        queue_span( spans, pending, BBoxSpan( span.line, span.t0, tm ) );
+        queue_span( spans, pending, BBoxSpan( span.line, tm, span.t1 ) );
+      }
+    }
+    if ( pending.empty() )
+      break;
+  }
+
+  // Grow the box, and find the finest spacing between neighbors
+  for ( int32 l = 0; l < lines.size(); ++l ) {
+    std::map<int32, BBoxSample>::const_iterator prev = samples[l].end();
+    for ( std::map<int32, BBoxSample>::const_iterator it = samples[l].begin(); it != samples[l].end(); ++it ) {
+      if ( it->second.valid ) {
+        result.bbox.grow( it->second.point );
+        if ( prev != samples[l].end() && prev->second.valid ) {
+          double spacing = norm_2( it->second.point - prev->second.point ) / (it->first - prev->first);
+          if ( spacing < result.scale )
+            result.scale = spacing;
+        }
+      }
+      prev = it;
+    }
+  }
+  return result;
+}
+
 // Compute the bounding box in points (georeference space) that is
 // defined by georef. Scale is MPP as georeference space is in meters.
+cartography::CameraBBoxResult
+cartography::camera_bbox_adaptive( cartography::GeoReference const& georef,
+                                   boost::shared_ptr<camera::CameraModel> camera_model,
+                                   int32 cols, int32 rows,
+                                   double tolerance, int num_threads ) {
+  detail::CameraDatumIntersector intersect( georef, camera_model,
+                                            detail::camera_bbox_center_on_zero(*camera_model) );
+  return detail::camera_bbox_adaptive( intersect, cols, rows, tolerance, num_threads );
+}
+
 BBox2 cartography::camera_bbox( cartography::GeoReference const& georef,
                                 boost::shared_ptr<camera::CameraModel> camera_model,
                                 int32 cols, int32 rows, float &scale ) {
-
-  // Testing to see if we should be centering on zero
-  bool center_on_zero = true;
-  Vector3 camera_llr =
-    XYZtoLonLatRadFunctor::apply(camera_model->camera_center(Vector2()));
-  if ( camera_llr[0] < -90 ||
-       camera_llr[0] > 90 )
-    center_on_zero = false;
-
-  int32 step_amount = (2*cols+2*rows)/100;
-  detail::CameraDatumBBoxHelper functor( georef, camera_model,
-                                         center_on_zero );
-
-  // Running the edges
-  bresenham_apply( BresenhamLine(0,0,cols,0),
-                   step_amount, functor );
-  functor.last_valid = false;
-  bresenham_apply( BresenhamLine(cols-1,0,cols-1,rows),
-                   step_amount, functor );
-  functor.last_valid = false;
-  bresenham_apply( BresenhamLine(cols-1,rows-1,0,rows-1),
-                   step_amount, functor );
-  functor.last_valid = false;
-  bresenham_apply( BresenhamLine(0,rows-1,0,0),
-                   step_amount, functor );
-  functor.last_valid = false;
-
-  // Running once through the center
-  bresenham_apply( BresenhamLine(0,0,cols,rows),
-                   step_amount, functor );
-
-  scale = functor.scale/double(step_amount);
-  return functor.box;
+  CameraBBoxResult result = camera_bbox_adaptive( georef, camera_model, cols, rows, 0.5, 1 );
+  scale = result.scale;
+  return result.bbox;
 }
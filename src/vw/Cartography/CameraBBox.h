@@ -14,11 +14,11 @@
 #include <vw/Image/ImageViewRef.h>
 #include <vw/Image/Algorithms.h>
 #include <vw/Image/Interpolation.h>
+#include <vw/Image/Manipulation.h>
 #include <vw/Math/LevenbergMarquardt.h>
 #include <vw/Camera/CameraModel.h>
 #include <vw/Cartography/SimplePointImageManipulation.h>
 #include <vw/Cartography/GeoReference.h>
-#include <vw/Cartography/detail/BresenhamLine.h>
 
 #include <boost/shared_ptr.hpp>
 
@@ -82,126 +82,171 @@ namespace cartography {
     }
   };
 
+  /// What camera_bbox_adaptive() found.
+  struct CameraBBoxResult {
+    /// Bounds of the footprint, in georeference point units
+    BBox2 bbox;
+    /// The smallest distance between neighboring samples, in point
+    /// units per image pixel
+    double scale;
+    /// How far the footprint could reach past bbox between samples,
+    /// in point units.  This is the largest distance between an
+    /// accepted sample and the chord through its neighbors.
+    double error;
+    /// How many camera rays were intersected
+    int32 samples;
+
+    CameraBBoxResult() : scale( std::numeric_limits<double>::max() ), error(0), samples(0) {}
+  };
+
   namespace detail {
 
-    template <class FunctionT>
-    void bresenham_apply( BresenhamLine line, size_t step,
-                          FunctionT& f ) {
-      while ( line.is_good() ) {
-        f( *line );
-        for ( size_t i = 0; i < step; i++ )
-          ++line;
-      }
-    }
+    /// Finds where the ray through an image pixel meets the planet, in
+    /// georeference point units.  Called from several threads at once.
+    class CameraBBoxIntersector {
+    public:
+      virtual ~CameraBBoxIntersector() {}
+      virtual bool operator()( Vector2 const& pixel, Vector2& point ) const = 0;
+    };
 
-    class CameraDatumBBoxHelper {
+    /// Intersects against the datum
+    class CameraDatumIntersector : public CameraBBoxIntersector {
+    protected:
       GeoReference m_georef;
       boost::shared_ptr<camera::CameraModel> m_camera;
       double m_z_scale;
-      Vector2 m_last_intersect;
-
+      bool m_center_on_zero;
     public:
-      bool last_valid, center_on_zero;
-      BBox2 box;
-      double scale;
-
-      CameraDatumBBoxHelper( GeoReference const& georef,
-                             boost::shared_ptr<camera::CameraModel> camera,
-                             bool center=false) : m_georef(georef), m_camera(camera), last_valid(false), center_on_zero(center), scale( std::numeric_limits<double>::max() ) {
-        m_z_scale = m_georef.datum().semi_major_axis() / m_georef.datum().semi_minor_axis();
-      }
-
-      void operator() ( Vector2 pixel ) {
-        bool test_intersect;
-        Vector2 geospatial_point =
-          geospatial_intersect( pixel, m_georef, m_camera,
-                                m_z_scale, test_intersect );
-        if ( !test_intersect ) {
-          last_valid = false;
-          return;
-        }
-
-        if ( center_on_zero && geospatial_point[0] > 180 )
-          geospatial_point[0] -= 360.0;
-
-        if ( last_valid ) {
-          double current_scale =
-            norm_2( geospatial_point - m_last_intersect );
-          if ( current_scale < scale )
-            scale = current_scale;
-        }
-        m_last_intersect = geospatial_point;
-        box.grow( geospatial_point );
-        last_valid = true;
-      }
+      CameraDatumIntersector( GeoReference const& georef,
+                              boost::shared_ptr<camera::CameraModel> camera,
+                              bool center_on_zero );
+      virtual bool operator()( Vector2 const& pixel, Vector2& point ) const;
     };
 
+    /// Intersects against the datum first, then against each level of
+    /// a DEM pyramid from coarse to fine, each solution seeding the
+    /// next, and finally against the DEM itself.
     template <class DEMImageT>
-    class CameraDEMBBoxHelper {
-      GeoReference m_georef;
-      boost::shared_ptr<camera::CameraModel> m_camera;
-      ImageViewBase<DEMImageT> const& m_dem;
-      double m_z_scale;
-      Vector2 m_last_intersect;
+    class CameraDEMIntersector : public CameraDatumIntersector {
+      typedef typename DEMImageT::pixel_type dem_pixel_type;
+      typedef ImageView<dem_pixel_type> level_type;
+
+      DEMIntersectionLMA<DEMImageT> m_model;
+      std::vector<boost::shared_ptr<DEMIntersectionLMA<level_type> > > m_levels;
 
     public:
-      bool last_valid, center_on_zero;
-      BBox2 box;
-      double scale;
-
-      CameraDEMBBoxHelper( ImageViewBase<DEMImageT> const& dem_image,
-                           GeoReference const& georef,
-                           boost::shared_ptr<camera::CameraModel> camera,
-                           bool center=false ) : m_georef(georef), m_camera(camera), m_dem(dem_image), last_valid(false), center_on_zero(center), scale( std::numeric_limits<double>::max() ) {
-        m_z_scale = m_georef.datum().semi_major_axis() / m_georef.datum().semi_minor_axis();
+      CameraDEMIntersector( ImageViewBase<DEMImageT> const& dem_image,
+                            GeoReference const& georef,
+                            boost::shared_ptr<camera::CameraModel> camera,
+                            bool center_on_zero, int32 pyramid_levels )
+        : CameraDatumIntersector( georef, camera, center_on_zero ),
+          m_model( dem_image, georef, camera ) {
+
+        // The pixel that is (0,0) in a level is (0,0) in the DEM, so
+        // the level's georeference is the DEM's with its pixels
+        // scaled up, in the pixel-as-point convention.
+        Matrix3x3 native = georef.transform();
+        if ( georef.pixel_interpretation() == GeoReference::PixelAsArea ) {
+          native(0,2) += 0.5*native(0,0);
+          native(1,2) += 0.5*native(1,1);
+        }
+        for ( int32 level = pyramid_levels; level > 0; --level ) {
+          int32 factor = 1 << level;
+          if ( dem_image.impl().cols() / factor < 2 || dem_image.impl().rows() / factor < 2 )
+            continue;
+          level_type dem = subsample( dem_image.impl(), factor );
+          Matrix3x3 scale = math::identity_matrix<3>();
+          scale(0,0) = scale(1,1) = factor;
+          GeoReference level_georef = georef;
+          level_georef.set_pixel_interpretation( GeoReference::PixelAsPoint );
+          level_georef.set_transform( native * scale );
+          m_levels.push_back( boost::shared_ptr<DEMIntersectionLMA<level_type> >
+                              ( new DEMIntersectionLMA<level_type>( dem, level_georef, camera ) ) );
+        }
       }
 
-      void operator() ( Vector2 pixel ) {
-        bool test_intersect;
-        Vector2 geospatial_point =
-          geospatial_intersect( pixel, m_georef, m_camera,
-                                m_z_scale, test_intersect );
-        if ( !test_intersect ) {
-          last_valid = false;
-          return;
-        }
+      virtual bool operator()( Vector2 const& pixel, Vector2& point ) const {
+        bool did_intersect;
+        Vector2 guess = geospatial_intersect( pixel, m_georef, m_camera,
+                                              m_z_scale, did_intersect );
+        if ( !did_intersect )
+          return false;
 
-        // Refining with more accurate intersection
-        DEMIntersectionLMA<DEMImageT> model( m_dem, m_georef, m_camera );
+        // The coarse levels only need to get close
         int status = 0;
-        geospatial_point = math::levenberg_marquardt( model, geospatial_point,
-                                                      pixel, status );
-        if ( status < 0 ) {
-          last_valid = false;
-          return;
+        for ( size_t i = 0; i < m_levels.size(); ++i ) {
+          Vector2 refined = math::levenberg_marquardt( *m_levels[i], guess, pixel, status,
+                                                       1e-4, 1e-4, 20 );
+          if ( status >= 0 )
+            guess = refined;
         }
 
-        if ( center_on_zero && geospatial_point[0] > 180 )
-          geospatial_point[0] -= 360.0;
-        else if ( center_on_zero && geospatial_point[0] < -180 )
-          geospatial_point[0] += 360.0;
-        else if ( !center_on_zero && geospatial_point[0] < 0 )
-          geospatial_point[0] += 360.0;
-        else if ( !center_on_zero && geospatial_point[0] > 360 )
-          geospatial_point[0] -= 360.0;
-
-        if ( last_valid ) {
-          double current_scale =
-            norm_2( geospatial_point - m_last_intersect );
-          if ( current_scale < scale )
-            scale = current_scale;
-        }
-        m_last_intersect = geospatial_point;
-        box.grow( geospatial_point );
-        last_valid = true;
+        point = math::levenberg_marquardt( m_model, guess, pixel, status );
+        if ( status < 0 )
+          return false;
+
+        if ( m_center_on_zero && point[0] > 180 )
+          point[0] -= 360.0;
+        else if ( m_center_on_zero && point[0] < -180 )
+          point[0] += 360.0;
+        else if ( !m_center_on_zero && point[0] < 0 )
+          point[0] += 360.0;
+        else if ( !m_center_on_zero && point[0] > 360 )
+          point[0] -= 360.0;
+        return true;
       }
     };
+
+    /// Whether the footprint of a camera should be reported with
+    /// longitudes in [-180,180] rather than [0,360]
+    bool camera_bbox_center_on_zero( camera::CameraModel const& camera_model );
+
+    CameraBBoxResult camera_bbox_adaptive( CameraBBoxIntersector const& intersect,
+                                           int32 cols, int32 rows,
+                                           double tolerance, int num_threads );
   }
 
   // Functions for Users
   //////////////////////////////////////////////////////
 
-  // Simple Intersection interfaces
+  /// Finds the footprint of a camera image on the datum by sampling
+  /// the image edges and one diagonal.  Each line is first sampled
+  /// coarsely; a stretch between two samples is then split in half
+  /// until the footprint between them is within tolerance image
+  /// pixels of a straight line, or until they are a pixel apart.
+  /// Stretches where the rays start or stop hitting the planet are
+  /// always split down to a pixel.  Each round of samples is
+  /// intersected on num_threads threads, the system default if zero.
+  /// Only ask for more than one if the camera model is safe to use
+  /// from several threads; Proj.4 georeferences are not, since they
+  /// report errors through a global.
+  CameraBBoxResult camera_bbox_adaptive( GeoReference const& georef,
+                                         boost::shared_ptr<vw::camera::CameraModel> camera_model,
+                                         int32 cols, int32 rows,
+                                         double tolerance = 0.5, int num_threads = 1 );
+
+  /// As above, but intersects each ray with the DEM.  If
+  /// pyramid_levels is nonzero, each ray is first intersected with
+  /// that many subsampled copies of the DEM (by 2^pyramid_levels down
+  /// to 2), coarse to fine, which makes the final solve against the
+  /// DEM itself converge faster on rough terrain.  The copies are
+  /// rasterized up front.
+  template <class DEMImageT>
+  CameraBBoxResult camera_bbox_adaptive( ImageViewBase<DEMImageT> const& dem_image,
+                                         GeoReference const& georef,
+                                         boost::shared_ptr<vw::camera::CameraModel> camera_model,
+                                         int32 cols, int32 rows,
+                                         double tolerance = 0.5, int num_threads = 1,
+                                         int32 pyramid_levels = 0 ) {
+    detail::CameraDEMIntersector<DEMImageT> intersect( dem_image, georef, camera_model,
+                                                       detail::camera_bbox_center_on_zero(*camera_model),
+                                                       pyramid_levels );
+    return detail::camera_bbox_adaptive( intersect, cols, rows, tolerance, num_threads );
+  }
+
+
+  // Simple Intersection interfaces.  These always run on the calling
+  // thread; use camera_bbox_adaptive() to intersect on several.
   BBox2 camera_bbox( GeoReference const& georef,
                      boost::shared_ptr<vw::camera::CameraModel> camera_model,
                      int32 cols, int32 rows, float &scale );
@@ -219,39 +264,9 @@ namespace cartography {
                      GeoReference const& georef,
                      boost::shared_ptr<vw::camera::CameraModel> camera_model,
                      int32 cols, int32 rows, float &scale ) {
-
-    // Testing to see if we should be centering on zero
-    bool center_on_zero = true;
-    Vector3 camera_llr =
-      XYZtoLonLatRadFunctor::apply(camera_model->camera_center(Vector2()));
-    if ( camera_llr[0] < -90 ||
-         camera_llr[0] > 90 )
-      center_on_zero = false;
-
-    int32 step_amount = (2*cols+2*rows)/100;
-    detail::CameraDEMBBoxHelper<DEMImageT> functor( dem_image, georef, camera_model,
-                                                    center_on_zero );
-
-    // Running the edges
-    bresenham_apply( BresenhamLine(0,0,cols,0),
-                     step_amount, functor );
-    functor.last_valid = false;
-    bresenham_apply( BresenhamLine(cols-1,0,cols-1,rows),
-                     step_amount, functor );
-    functor.last_valid = false;
-    bresenham_apply( BresenhamLine(cols-1,rows-1,0,rows-1),
-                     step_amount, functor );
-    functor.last_valid = false;
-    bresenham_apply( BresenhamLine(0,rows-1,0,0),
-                     step_amount, functor );
-    functor.last_valid = false;
-
-    // Running once through the center
-    bresenham_apply( BresenhamLine(0,0,cols,rows),
-                     step_amount, functor );
-
-    scale = functor.scale/double(step_amount);
-    return functor.box;
+    CameraBBoxResult result = camera_bbox_adaptive( dem_image, georef, camera_model, cols, rows, 0.5, 1 );
+    scale = result.scale;
+    return result.bbox;
   }
 
   template< class DEMImageT >
@@ -427,6 +427,79 @@ namespace cartography {
     return Vector2(projected.u, projected.v);
   }
 
+  // Applies a projective 3x3 transform to an array of points.
+  static void apply_transform(Matrix3x3 const& M, Vector2 const* in, Vector2* out, size_t n) {
+    if (M(2,0) == 0 && M(2,1) == 0 && M(2,2) == 1) {
+      // The usual case: a plain affine transform, so no divide.
+      for (size_t i = 0; i < n; ++i) {
+        double x = in[i][0], y = in[i][1];
+        out[i][0] = x * M(0,0) + y * M(0,1) + M(0,2);
+        out[i][1] = x * M(1,0) + y * M(1,1) + M(1,2);
+      }
+    } else {
+      for (size_t i = 0; i < n; ++i) {
+        double x = in[i][0], y = in[i][1];
+        double denom = x * M(2,0) + y * M(2,1) + M(2,2);
+        out[i][0] = (x * M(0,0) + y * M(0,1) + M(0,2)) / denom;
+        out[i][1] = (x * M(1,0) + y * M(1,1) + M(1,2)) / denom;
+      }
+    }
+  }
+
+  void GeoReference::pixels_to_points(Vector2 const* in, Vector2* out, size_t n) const {
+    apply_transform(this->vw_native_transform(), in, out, n);
+  }
+
+  void GeoReference::points_to_pixels(Vector2 const* in, Vector2* out, size_t n) const {
+    apply_transform(this->vw_native_inverse_transform(), in, out, n);
+  }
+
+  void GeoReference::points_to_lonlats(Vector2 const* in, Vector2* out, size_t n) const {
+    if ( ! m_is_projected ) {
+      if (in != out) std::copy(in, in + n, out);
+      return;
+    }
+
+    PJ* proj = m_proj_context->proj_ptr();
+    XY projected;
+    LP unprojected;
+    for (size_t i = 0; i < n; ++i) {
+      projected.u = in[i][0];
+      projected.v = in[i][1];
+
+      unprojected = pj_inv(projected, proj);
+      CHECK_PROJ_ERROR;
+
+      out[i][0] = unprojected.u * RAD_TO_DEG;
+      out[i][1] = unprojected.v * RAD_TO_DEG;
+    }
+  }
+
+  void GeoReference::lonlats_to_points(Vector2 const* in, Vector2* out, size_t n) const {
+    if ( ! m_is_projected ) {
+      if (in != out) std::copy(in, in + n, out);
+      return;
+    }
+    // See lonlat_to_point() for why the latitude is clamped.
+    static const double BOUND = HALFPI-(1e-10)-std::numeric_limits<double>::epsilon();
+
+    PJ* proj = m_proj_context->proj_ptr();
+    XY projected;
+    LP unprojected;
+    for (size_t i = 0; i < n; ++i) {
+      unprojected.u = in[i][0] * DEG_TO_RAD;
+      unprojected.v = in[i][1] * DEG_TO_RAD;
+      if(unprojected.v > BOUND)        unprojected.v = BOUND;
+      else if(unprojected.v < -BOUND) unprojected.v = -BOUND;
+
+      projected = pj_fwd(unprojected, proj);
+      CHECK_PROJ_ERROR;
+
+      out[i][0] = projected.u;
+      out[i][1] = projected.v;
+    }
+  }
+
   /************** Functions for class ProjContext *******************/
   char** ProjContext::split_proj4_string(std::string const& proj4_str, int &num_strings) {
     std::vector<std::string> arg_strings;
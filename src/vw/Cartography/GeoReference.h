@@ -177,6 +177,14 @@ namespace cartography {
     /// the location in the projected coordinate system.
     virtual Vector2 lonlat_to_point(Vector2 lon_lat) const;
 
+    /// Batch versions of the above. The affine transform is looked up
+    /// once per call rather than once per point, and geographic
+    /// georeferences don't go through Proj.4 at all.
+    virtual void pixels_to_points(Vector2 const* in, Vector2* out, size_t n) const;
+    virtual void points_to_pixels(Vector2 const* in, Vector2* out, size_t n) const;
+    virtual void points_to_lonlats(Vector2 const* in, Vector2* out, size_t n) const;
+    virtual void lonlats_to_points(Vector2 const* in, Vector2* out, size_t n) const;
+
     /// For a bbox in pixel coordinates, find what that bbox covers
     /// in lonlat 
     virtual BBox2 pixel_to_lonlat_bbox(BBox2i pixel_bbox) const {
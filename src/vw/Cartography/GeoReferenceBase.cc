@@ -11,6 +11,26 @@
 namespace vw {
 namespace cartography {
 
+  void GeoReferenceBase::pixels_to_points(Vector2 const* in, Vector2* out, size_t n) const {
+    for (size_t i = 0; i < n; ++i)
+      out[i] = pixel_to_point(in[i]);
+  }
+
+  void GeoReferenceBase::points_to_pixels(Vector2 const* in, Vector2* out, size_t n) const {
+    for (size_t i = 0; i < n; ++i)
+      out[i] = point_to_pixel(in[i]);
+  }
+
+  void GeoReferenceBase::points_to_lonlats(Vector2 const* in, Vector2* out, size_t n) const {
+    for (size_t i = 0; i < n; ++i)
+      out[i] = point_to_lonlat(in[i]);
+  }
+
+  void GeoReferenceBase::lonlats_to_points(Vector2 const* in, Vector2* out, size_t n) const {
+    for (size_t i = 0; i < n; ++i)
+      out[i] = lonlat_to_point(in[i]);
+  }
+
   /// For a bbox in projected space, return the corresponding bbox in
   /// pixels on the image
   BBox2i GeoReferenceBase::point_to_pixel_bbox(BBox2 const& point_bbox) const {
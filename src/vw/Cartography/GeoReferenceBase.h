@@ -113,6 +113,31 @@ namespace cartography {
       return point_to_pixel(lonlat_to_point(lat_lon));
     }
 
+    /// Batch versions of the conversions above. Each converts the n
+    /// points starting at 'in' and stores the results starting at
+    /// 'out'; 'in' and 'out' may be the same array. The defaults just
+    /// call the single point versions in a loop, but subclasses that
+    /// can do better (hoisting the affine transform, skipping an
+    /// identity projection, handing a whole array to the projection
+    /// library) should override them. If a point fails to convert,
+    /// the same exception the single point version would throw is
+    /// thrown and the contents of 'out' are undefined.
+    virtual void pixels_to_points(Vector2 const* in, Vector2* out, size_t n) const;
+    virtual void points_to_pixels(Vector2 const* in, Vector2* out, size_t n) const;
+    virtual void points_to_lonlats(Vector2 const* in, Vector2* out, size_t n) const;
+    virtual void lonlats_to_points(Vector2 const* in, Vector2* out, size_t n) const;
+
+    /// Composed from the batch conversions above, one whole array at
+    /// a time.
+    virtual void pixels_to_lonlats(Vector2 const* in, Vector2* out, size_t n) const {
+      pixels_to_points(in, out, n);
+      points_to_lonlats(out, out, n);
+    }
+    virtual void lonlats_to_pixels(Vector2 const* in, Vector2* out, size_t n) const {
+      lonlats_to_points(in, out, n);
+      points_to_pixels(out, out, n);
+    }
+
     /// For a given pixel bbox, return the corresponding bbox in projected
     /// space
     virtual BBox2 pixel_to_point_bbox(BBox2i pixel_bbox) const {
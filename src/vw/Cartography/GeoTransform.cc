@@ -11,6 +11,10 @@
 // Vision Workbench
 #include <vw/Image/ImageView.h>
 
+// Boost
+#include <boost/numeric/conversion/cast.hpp>
+#include <boost/static_assert.hpp>
+
 // Proj.4
 #include <projects.h>
 
@@ -76,6 +80,46 @@ namespace cartography {
     return Vector2(x, y);
   }
 
+  void GeoTransform::datum_convert(Vector2* v, size_t n, bool forward) const {
+    if (n == 0) return;
+    // pj_transform() takes the x and y coordinates as strided arrays,
+    // which a packed array of Vector2s already is. Without a z array
+    // the heights are taken to be zero.
+    BOOST_STATIC_ASSERT( sizeof(Vector2) == 2*sizeof(double) );
+    double* x = &v[0][0];
+    double* y = &v[0][1];
+
+    if(forward)
+      pj_transform(m_src_datum->proj_ptr(), m_dst_datum->proj_ptr(), boost::numeric_cast<long>(n), 2, x, y, NULL);
+    else
+      pj_transform(m_dst_datum->proj_ptr(), m_src_datum->proj_ptr(), boost::numeric_cast<long>(n), 2, x, y, NULL);
+    CHECK_PROJ_ERROR;
+  }
+
+  void GeoTransform::reverse(Vector2 const* in, Vector2* out, size_t n) const {
+    if (m_skip_map_projection) {
+      m_dst_georef.pixels_to_points(in, out, n);
+      m_src_georef.points_to_pixels(out, out, n);
+      return;
+    }
+    m_dst_georef.pixels_to_lonlats(in, out, n);
+    if (!m_skip_datum_conversion)
+      datum_convert(out, n, false);
+    m_src_georef.lonlats_to_pixels(out, out, n);
+  }
+
+  void GeoTransform::forward(Vector2 const* in, Vector2* out, size_t n) const {
+    if (m_skip_map_projection) {
+      m_src_georef.pixels_to_points(in, out, n);
+      m_dst_georef.points_to_pixels(out, out, n);
+      return;
+    }
+    m_src_georef.pixels_to_lonlats(in, out, n);
+    if (!m_skip_datum_conversion)
+      datum_convert(out, n, true);
+    m_dst_georef.lonlats_to_pixels(out, out, n);
+  }
+
   BBox2i GeoTransform::forward_bbox( BBox2i const& bbox ) const {
     BBox2 r = TransformHelper<GeoTransform,ContinuousFunction,ContinuousFunction>::forward_bbox(bbox);
     BresenhamLine l1( bbox.min(), bbox.max() );
@@ -124,18 +168,29 @@ namespace cartography {
 
     GeoTransform gtx(src_georef, dst_georef);
 
-    // Iterate over the image, transforming the first two coordinates
-    // in the Vector one at a time.  The third coordinate is taken to
-    // be the altitude value, and this value is not touched.
+    // Iterate over the image a row at a time, transforming the first
+    // two coordinates of every valid point in one batch.  The third
+    // coordinate is taken to be the altitude value, and this value is
+    // not touched.
+    std::vector<Vector2> points;
+    std::vector<int32> cols;
+    points.reserve(point_image.cols());
+    cols.reserve(point_image.cols());
     for (int32 j=0; j < point_image.rows(); ++j) {
+      points.clear();
+      cols.clear();
       for (int32 i=0; i < point_image.cols(); ++i) {
         if (point_image(i,j) != Vector3()) {
-          Vector2 in(point_image(i,j)[0], point_image(i,j)[1]);
-          Vector2 out = gtx.forward(in);
-          point_image(i,j).x() = out[0];
-          point_image(i,j).y() = out[1];
+          points.push_back(Vector2(point_image(i,j)[0], point_image(i,j)[1]));
+          cols.push_back(i);
         }
       }
+      if (points.empty()) continue;
+      gtx.forward(&points[0], &points[0], points.size());
+      for (size_t k=0; k < points.size(); ++k) {
+        point_image(cols[k],j).x() = points[k][0];
+        point_image(cols[k],j).y() = points[k][1];
+      }
     }
   }
 
@@ -32,6 +32,11 @@ namespace cartography {
     */
     Vector2 datum_convert(Vector2 const& v, bool forward) const;
 
+    /* Converts an array of points between datums in place, with one
+     * call into Proj.4 for the whole array.
+    */
+    void datum_convert(Vector2* v, size_t n, bool forward) const;
+
   public:
     /// Normal constructor
     GeoTransform(GeoReference const& src_georef, GeoReference const& dst_georef);
@@ -62,6 +67,15 @@ namespace cartography {
       return m_dst_georef.lonlat_to_pixel(src_lonlat);
     }
 
+    /// Batch version of reverse(): converts n pixels starting at 'in'
+    /// and stores the results starting at 'out', which may be the
+    /// same array. Much cheaper per point than calling reverse() in a
+    /// loop when the georeferences involve a map projection.
+    void reverse(Vector2 const* in, Vector2* out, size_t n) const;
+
+    /// Batch version of forward(); see reverse() above.
+    void forward(Vector2 const* in, Vector2* out, size_t n) const;
+
     // We override forward_bbox so it understands to check if the image
     // crosses the poles or not.
     BBox2i forward_bbox( BBox2i const& bbox ) const;
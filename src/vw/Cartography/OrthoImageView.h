@@ -9,8 +9,10 @@
 #define __VW_CARTOGRAPHY_ORTHOIMAGEVIEW_H__
 
 #include <vw/Image/ImageViewBase.h>
+#include <vw/Image/ImageView.h>
 #include <vw/Image/EdgeExtension.h>
 #include <vw/Image/Interpolation.h>
+#include <vw/Image/BlockRasterize.h>
 #include <vw/Cartography/GeoReference.h>
 #include <vw/Camera/CameraModel.h>
 
@@ -25,6 +27,16 @@ namespace cartography {
   /// This image view assumes the dimensions and georeferencing of the
   /// Terrain image (i.e. the DTM), but it assumes the pixel type of
   /// the camera image.
+  ///
+  /// By default every DEM pixel is projected into the camera exactly,
+  /// which is expensive for camera models whose point_to_pixel() is an
+  /// iterative solve.  If a tolerance (in camera pixels) is set, each
+  /// rasterized block is instead covered by a grid of exactly
+  /// projected DEM samples, and camera positions in between are
+  /// interpolated bilinearly.  A grid cell is split in four wherever
+  /// the interpolated position at its center or edge midpoints is off
+  /// by more than the tolerance, down to single pixels if need be.
+  /// Looking up individual pixels with operator() is always exact.
   template <class TerrainImageT, class CameraImageT, class InterpT, class EdgeT>
   class OrthoImageView : public ImageViewBase<OrthoImageView<TerrainImageT, CameraImageT, InterpT, EdgeT> > {
 
@@ -37,6 +49,10 @@ namespace cartography {
     CameraImageT m_camera_image_ref;
     InterpT m_interp_func;
     EdgeT m_edge_func;
+    double m_tolerance;
+
+    // Largest grid cell tried when approximating, in DEM pixels
+    static const int32 max_cell_size = 32;
 
     // Provide safe interaction with DEMs that are scalar or compound
     template <class PixelT>
@@ -58,14 +74,21 @@ namespace cartography {
 
     OrthoImageView(TerrainImageT const& terrain, GeoReference const& georef,
                    CameraImageT const& camera_image, boost::shared_ptr<vw::camera::CameraModel> camera_model,
-                   InterpT const& interp_func, EdgeT const& edge_func) :
+                   InterpT const& interp_func, EdgeT const& edge_func, double tolerance = 0) :
       m_terrain(terrain),
       m_georef(georef),
       m_camera_model(camera_model),
       m_camera_image(interpolate(camera_image, m_interp_func, m_edge_func)),
       m_camera_image_ref(camera_image),
       m_interp_func(interp_func),
-      m_edge_func(edge_func) {}
+      m_edge_func(edge_func),
+      m_tolerance(tolerance) {}
+
+    /// The error (in camera pixels) allowed when approximating the
+    /// DEM to camera projection during rasterization.  Zero, the
+    /// default, projects every pixel exactly.
+    double tolerance() const { return m_tolerance; }
+    void set_tolerance( double tolerance ) { m_tolerance = tolerance; }
 
     inline int32 cols() const { return m_terrain.cols(); }
     inline int32 rows() const { return m_terrain.rows(); }
@@ -85,6 +108,13 @@ namespace cartography {
         return result_type();
       }
 
+      Vector2 pix = project(i,j);
+      return m_camera_image(pix[0], pix[1], p);
+    }
+
+    /// Returns the camera pixel that sees DEM pixel (i,j).  The DEM
+    /// pixel must not be transparent.
+    inline Vector2 project( offset_type i, offset_type j ) const {
       // We need to convert the georefernced positions into a
       // cartesian coordinate system so that they can be imaged by the
       // camera model.  Doing so require we proceed through 3 steps:
@@ -97,10 +127,8 @@ namespace cartography {
       Vector2 lon_lat( m_georef.pixel_to_lonlat(Vector2(i,j)) );
       Vector3 xyz = m_georef.datum().geodetic_to_cartesian( Vector3( lon_lat.x(), lon_lat.y(), Helper<typename TerrainImageT::pixel_type>(i,j) ) );
 
-      // Now we can image the point using the camera model and return
-      // the resulting pixel from the camera image.
-      Vector2 pix = m_camera_model->point_to_pixel(xyz);
-      return m_camera_image(pix[0], pix[1], p);
+      // Now we can image the point using the camera model.
+      return m_camera_model->point_to_pixel(xyz);
     }
 
     /// \cond INTERNAL
@@ -108,9 +136,134 @@ namespace cartography {
     inline prerasterize_type prerasterize( BBox2i const& bbox ) const {
       return prerasterize_type( m_terrain.prerasterize(bbox),
                                 m_georef, m_camera_image_ref,
-                                m_camera_model, m_interp_func, m_edge_func);
+                                m_camera_model, m_interp_func, m_edge_func,
+                                m_tolerance );
+    }
+    template <class DestT> inline void rasterize( DestT const& dest, BBox2i const& bbox ) const {
+      if ( m_tolerance > 0 )
+        prerasterize(bbox).rasterize_approximate( dest, bbox );
+      else
+        vw::rasterize( prerasterize(bbox), dest, bbox );
+    }
+
+  private:
+    template <class T1, class T2, class T3, class T4> friend class OrthoImageView;
+
+    // Camera positions of the block's pixels, projected on demand
+    struct ProjectionGrid {
+      enum { Unknown = 0, Valid, Invalid };
+      ImageView<Vector2> pix;
+      ImageView<uint8> state;
+      ProjectionGrid( int32 cols, int32 rows ) : pix(cols, rows), state(cols, rows) {}
+    };
+
+    // Projects pixel (x,y) of the block, relative to its origin, once.
+    bool grid_node( ProjectionGrid& grid, BBox2i const& bbox, int32 x, int32 y ) const {
+      uint8& state = grid.state(x,y);
+      if ( state == ProjectionGrid::Unknown ) {
+        offset_type i = bbox.min().x() + x, j = bbox.min().y() + y;
+        if ( is_transparent(m_terrain(i,j)) ) {
+          state = ProjectionGrid::Invalid;
+        } else {
+          grid.pix(x,y) = project(i,j);
+          state = ProjectionGrid::Valid;
+        }
+      }
+      return state == ProjectionGrid::Valid;
     }
-    template <class DestT> inline void rasterize( DestT const& dest, BBox2i const& bbox ) const { vw::rasterize( prerasterize(bbox), dest, bbox ); }
+
+    // Fills grid.pix for the cell with corners (x0,y0) and (x1,y1),
+    // inclusive, splitting it wherever bilinear interpolation between
+    // the corners is not good enough.
+    void fill_cell( ProjectionGrid& grid, BBox2i const& bbox, int32 x0, int32 y0, int32 x1, int32 y1 ) const {
+      // Small enough that every pixel is a corner
+      if ( x1 - x0 <= 1 && y1 - y0 <= 1 ) {
+        for ( int32 y = y0; y <= y1; ++y )
+          for ( int32 x = x0; x <= x1; ++x )
+            grid_node( grid, bbox, x, y );
+        return;
+      }
+
+      int32 mx = (x0 + x1) / 2, my = (y0 + y1) / 2;
+      bool split = !( grid_node( grid, bbox, x0, y0 ) && grid_node( grid, bbox, x1, y0 ) &&
+                      grid_node( grid, bbox, x0, y1 ) && grid_node( grid, bbox, x1, y1 ) );
+
+      Vector2 c00, c10, c01, c11;
+      if ( !split ) {
+        c00 = grid.pix(x0,y0); c10 = grid.pix(x1,y0);
+        c01 = grid.pix(x0,y1); c11 = grid.pix(x1,y1);
+
+        // Check the center and the edge midpoints against the exact
+        // projection.  Those points become corners if the cell is split.
+        int32 check_x[5] = { mx, mx, mx, x0, x1 };
+        int32 check_y[5] = { my, y0, y1, my, my };
+        double tol_sqr = m_tolerance * m_tolerance;
+        for ( int k = 0; k < 5 && !split; ++k ) {
+          if ( !grid_node( grid, bbox, check_x[k], check_y[k] ) ) {
+            split = true;
+            break;
+          }
+          double fx = x1 > x0 ? double(check_x[k] - x0) / (x1 - x0) : 0;
+          double fy = y1 > y0 ? double(check_y[k] - y0) / (y1 - y0) : 0;
+          Vector2 interp = (c00*(1-fx) + c10*fx)*(1-fy) + (c01*(1-fx) + c11*fx)*fy;
+          if ( norm_2_sqr( interp - grid.pix(check_x[k],check_y[k]) ) > tol_sqr )
+            split = true;
+        }
+      }
+
+      if ( split ) {
+        // Degenerate cells (one pixel wide) split along one axis only
+        if ( x1 - x0 <= 1 ) {
+          fill_cell( grid, bbox, x0, y0, x1, my );
+          fill_cell( grid, bbox, x0, my, x1, y1 );
+        } else if ( y1 - y0 <= 1 ) {
+          fill_cell( grid, bbox, x0, y0, mx, y1 );
+          fill_cell( grid, bbox, mx, y0, x1, y1 );
+        } else {
+          fill_cell( grid, bbox, x0, y0, mx, my );
+          fill_cell( grid, bbox, mx, y0, x1, my );
+          fill_cell( grid, bbox, x0, my, mx, y1 );
+          fill_cell( grid, bbox, mx, my, x1, y1 );
+        }
+        return;
+      }
+
+      // Interpolate the rest.  Transparent DEM pixels inside the cell
+      // get a position too, but it is never used.
+      for ( int32 y = y0; y <= y1; ++y ) {
+        double fy = y1 > y0 ? double(y - y0) / (y1 - y0) : 0;
+        for ( int32 x = x0; x <= x1; ++x ) {
+          if ( grid.state(x,y) != ProjectionGrid::Unknown )
+            continue;
+          double fx = x1 > x0 ? double(x - x0) / (x1 - x0) : 0;
+          grid.pix(x,y) = (c00*(1-fx) + c10*fx)*(1-fy) + (c01*(1-fx) + c11*fx)*fy;
+        }
+      }
+    }
+
+    template <class DestT> void rasterize_approximate( DestT const& dest, BBox2i const& bbox ) const {
+      ProjectionGrid grid( bbox.width(), bbox.height() );
+      for ( int32 y0 = 0; y0 < bbox.height(); y0 += max_cell_size ) {
+        int32 y1 = std::min( y0 + max_cell_size, bbox.height() - 1 );
+        for ( int32 x0 = 0; x0 < bbox.width(); x0 += max_cell_size ) {
+          int32 x1 = std::min( x0 + max_cell_size, bbox.width() - 1 );
+          fill_cell( grid, bbox, x0, y0, x1, y1 );
+        }
+      }
+
+      ImageView<pixel_type> block( bbox.width(), bbox.height(), planes() );
+      for ( int32 y = 0; y < bbox.height(); ++y ) {
+        for ( int32 x = 0; x < bbox.width(); ++x ) {
+          if ( is_transparent(m_terrain(offset_type(bbox.min().x() + x), offset_type(bbox.min().y() + y))) )
+            continue;
+          Vector2 const& pix = grid.pix(x,y);
+          for ( int32 p = 0; p < planes(); ++p )
+            block(x,y,p) = m_camera_image(pix[0], pix[1], p);
+        }
+      }
+      vw::rasterize( block, dest, BBox2i(0, 0, bbox.width(), bbox.height()) );
+    }
+  public:
     /// \endcond
   };
 
@@ -128,6 +281,42 @@ namespace cartography {
     return OrthoImageView<TerrainImageT, CameraImageT, InterpT, EdgeT>( terrain_image.impl(), georef, camera_image.impl(), camera_model, interp_func, edge_extend_func);
   }
 
+
+  /// As above, but approximating the projection into the camera to
+  /// within tolerance camera pixels when rasterizing.  See
+  /// OrthoImageView.
+  template <class TerrainImageT, class CameraImageT, class InterpT, class EdgeT>
+  OrthoImageView<TerrainImageT, CameraImageT, InterpT, EdgeT>
+  orthoproject( ImageViewBase<TerrainImageT> const& terrain_image,
+                GeoReference const& georef,
+                ImageViewBase<CameraImageT> const& camera_image,
+                boost::shared_ptr<vw::camera::CameraModel> camera_model,
+                InterpT const& interp_func,
+                EdgeT const& edge_extend_func,
+                double tolerance ) {
+    return OrthoImageView<TerrainImageT, CameraImageT, InterpT, EdgeT>( terrain_image.impl(), georef, camera_image.impl(), camera_model, interp_func, edge_extend_func, tolerance);
+  }
+
+  /// Orthoprojects block by block on num_threads threads (the system
+  /// default if zero), approximating the projection into the camera
+  /// to within tolerance camera pixels, and keeps the finished blocks
+  /// in the system cache.  This is the one to use for large images.
+  template <class TerrainImageT, class CameraImageT, class InterpT, class EdgeT>
+  BlockRasterizeView<OrthoImageView<TerrainImageT, CameraImageT, InterpT, EdgeT> >
+  block_orthoproject( ImageViewBase<TerrainImageT> const& terrain_image,
+                      GeoReference const& georef,
+                      ImageViewBase<CameraImageT> const& camera_image,
+                      boost::shared_ptr<vw::camera::CameraModel> camera_model,
+                      InterpT const& interp_func,
+                      EdgeT const& edge_extend_func,
+                      double tolerance,
+                      Vector2i const& block_size = Vector2i(256, 256),
+                      int num_threads = 0 ) {
+    return block_cache( orthoproject( terrain_image, georef, camera_image, camera_model,
+                                      interp_func, edge_extend_func, tolerance ),
+                        block_size, num_threads );
+  }
+
 } // namespace cartography
 
   /// \cond INTERNAL
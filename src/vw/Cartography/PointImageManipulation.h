@@ -110,14 +110,84 @@ namespace cartography {
     return UnaryPerPixelView<ImageT,ProjectPointFunctor>( image.impl(), ProjectPointFunctor(dst_georef, forward) );
   }
 
+  /// The view returned by dem_to_point_image().  Each pixel holds the
+  /// (lon, lat, altitude) of the matching DEM pixel, or Vector3() where
+  /// the DEM is transparent.  Rasterizing converts the valid pixel
+  /// locations of each row to lon/lat in one batch rather than one
+  /// projection call per pixel.
+  template <class ImageT>
+  class DemToPointImageView : public ImageViewBase<DemToPointImageView<ImageT> > {
+    ImageT m_dem;
+    GeoReference m_georef;
+
+  public:
+    typedef Vector3 pixel_type;
+    typedef Vector3 result_type;
+    typedef ProceduralPixelAccessor<DemToPointImageView> pixel_accessor;
+
+    DemToPointImageView(ImageT const& dem, GeoReference const& georef) : m_dem(dem), m_georef(georef) {}
+
+    inline int32 cols() const { return m_dem.cols(); }
+    inline int32 rows() const { return m_dem.rows(); }
+    inline int32 planes() const { return m_dem.planes(); }
+
+    inline pixel_accessor origin() const { return pixel_accessor(*this); }
+
+    inline result_type operator()( int32 i, int32 j, int32 p=0 ) const {
+      typename ImageT::pixel_type alt = m_dem(i,j,p);
+      if (is_transparent(alt))
+        return Vector3();
+
+      Vector3 result;
+      subvector(result, 0, 2) = m_georef.pixel_to_lonlat(Vector2(i,j));
+      result.z() = alt;
+      return result;
+    }
+
+    /// \cond INTERNAL
+    typedef DemToPointImageView<typename ImageT::prerasterize_type> prerasterize_type;
+    inline prerasterize_type prerasterize( BBox2i const& bbox ) const {
+      return prerasterize_type( m_dem.prerasterize(bbox), m_georef );
+    }
+    template <class DestT> inline void rasterize( DestT const& dest, BBox2i const& bbox ) const {
+      typename ImageT::prerasterize_type dem = m_dem.prerasterize(bbox);
+      ImageView<Vector3> result(bbox.width(), bbox.height(), planes());
+      std::vector<Vector2> lonlat;
+      lonlat.reserve(bbox.width());
+      for (int32 p = 0; p < planes(); ++p) {
+        for (int32 j = bbox.min().y(); j < bbox.max().y(); ++j) {
+          lonlat.clear();
+          for (int32 i = bbox.min().x(); i < bbox.max().x(); ++i)
+            if (!is_transparent(dem(i,j,p)))
+              lonlat.push_back(Vector2(i,j));
+          if (lonlat.empty())
+            continue;
+          m_georef.pixels_to_lonlats(&lonlat[0], &lonlat[0], lonlat.size());
+
+          // Walk the row again in the same order to place the results
+          std::vector<Vector2>::const_iterator ll = lonlat.begin();
+          for (int32 i = bbox.min().x(); i < bbox.max().x(); ++i) {
+            typename ImageT::pixel_type alt = dem(i,j,p);
+            if (is_transparent(alt))
+              continue;
+            Vector3& out = result(i - bbox.min().x(), j - bbox.min().y(), p);
+            out[0] = (*ll)[0];
+            out[1] = (*ll)[1];
+            out[2] = alt;
+            ++ll;
+          }
+        }
+      }
+      vw::rasterize( result, dest, BBox2i(0, 0, bbox.width(), bbox.height()) );
+    }
+    /// \endcond
+  };
+
   // This utility function converts a DEM to a point image
   template <class ImageT>
-  BinaryPerPixelView<PerPixelIndexView<VectorIndexFunctor>, ImageT, DemToPointImageFunctor<typename ImageT::pixel_type> >
+  DemToPointImageView<ImageT>
   inline dem_to_point_image(ImageViewBase<ImageT> const& dem, GeoReference georef) {
-    typedef DemToPointImageFunctor<typename ImageT::pixel_type> func_type;
-    typedef BinaryPerPixelView<PerPixelIndexView<VectorIndexFunctor>, ImageT, func_type> result_type;
-    func_type func(georef);
-    return result_type(pixel_index_view(dem), dem.impl(), func);
+    return DemToPointImageView<ImageT>(dem.impl(), georef);
   }
 }} // namespace vw::cartography
 
@@ -6,6 +6,87 @@
 
 
 #include <vw/Cartography/ToastTransform.h>
+#include <vw/Core/Cache.h>
+#include <vw/Core/System.h>
+
+#include <algorithm>
+#include <map>
+
+namespace {
+
+  using namespace vw;
+
+  // The lon/lat of the nodes of one lattice in TOAST pixel space.
+  // These depend only on the lattice and the TOAST resolution, never
+  // on the source image, so every image placed into the same tile
+  // shares them.
+  class ToastLatticeGenerator {
+    cartography::ToastTransform m_txform;
+    BBox2i m_bbox;
+    int32 m_n;
+  public:
+    typedef ImageView<Vector2> value_type;
+
+    ToastLatticeGenerator( int32 resolution, BBox2i const& bbox, int32 n )
+      : m_txform( cartography::GeoReference(), resolution ), m_bbox( bbox ), m_n( n ) {}
+
+    size_t size() const { return m_n * m_n * sizeof(Vector2); }
+
+    boost::shared_ptr<value_type> generate() const {
+      boost::shared_ptr<value_type> lonlat( new value_type( m_n, m_n ) );
+      Vector2 origin = m_bbox.min(), diag = m_bbox.size();
+      for ( int32 y = 0; y < m_n; ++y )
+        for ( int32 x = 0; x < m_n; ++x )
+          (*lonlat)(x,y) = m_txform.reverse_lonlat( origin + elem_prod( Vector2(x,y) / (m_n-1), diag ) );
+      return lonlat;
+    }
+  };
+
+  struct LatticeKey {
+    int32 v[6];
+    LatticeKey( int32 resolution, BBox2i const& bbox, int32 n ) {
+      v[0] = resolution; v[1] = n;
+      v[2] = bbox.min().x(); v[3] = bbox.min().y();
+      v[4] = bbox.max().x(); v[5] = bbox.max().y();
+    }
+    bool operator<( LatticeKey const& other ) const {
+      return std::lexicographical_compare( v, v+6, other.v, other.v+6 );
+    }
+  };
+
+  typedef Cache::Handle<ToastLatticeGenerator> LatticeHandle;
+  typedef std::map<LatticeKey, LatticeHandle> LatticeMap;
+
+  // Handles are small; the lattices themselves live in the system
+  // cache and are evicted from there.  The map is dropped wholesale
+  // every so often so that it doesn't grow without bound when
+  // building a large plate.
+  static const size_t max_lattice_handles = 16384;
+
+  vw::RunOnce lattice_once = VW_RUNONCE_INIT;
+  vw::Mutex  *lattice_mutex = 0;
+  LatticeMap *lattice_map   = 0;
+
+  void init_lattices() {
+    lattice_mutex = new vw::Mutex();
+    lattice_map = new LatticeMap();
+  }
+
+  LatticeHandle toast_lattice( int32 resolution, BBox2i const& bbox, int32 n ) {
+    lattice_once.run( init_lattices );
+    LatticeKey key( resolution, bbox, n );
+    Mutex::Lock lock( *lattice_mutex );
+    LatticeMap::iterator it = lattice_map->find( key );
+    if ( it != lattice_map->end() )
+      return it->second;
+    if ( lattice_map->size() >= max_lattice_handles )
+      lattice_map->clear();
+    LatticeHandle handle = vw_system_cache().insert( ToastLatticeGenerator( resolution, bbox, n ) );
+    lattice_map->insert( std::make_pair( key, handle ) );
+    return handle;
+  }
+
+}
 
 
 // A helper function to convert a point on the unit sphere to
@@ -211,9 +292,9 @@ vw::Vector2 vw::cartography::ToastTransform::forward(vw::Vector2 const& point) c
 }
 
 
-// Back-projects a pixel location in the TOAST image space into a
-// pixel location in the projected source image space.
-vw::Vector2 vw::cartography::ToastTransform::reverse(vw::Vector2 const& point) const {
+// Back-projects a pixel location in the TOAST image space onto the
+// sphere, in degrees.
+vw::Vector2 vw::cartography::ToastTransform::reverse_lonlat(vw::Vector2 const& point) const {
   // There is a fundamental eight-fold symmetry to the TOAST
   // projection which we exploit here.  We first determine which
   // top-level triangle (i.e. which octant) the requested point lies
@@ -227,22 +308,22 @@ vw::Vector2 vw::cartography::ToastTransform::reverse(vw::Vector2 const& point) c
       // Lower left: 0 to 90E
       if( y < 0.5 - x ) {
         Vector2 lonlat = octant_point_to_lonlat(2*x, 2*y);
-        return m_georef.lonlat_to_pixel(Vector2(90-lonlat.x(), -lonlat.y()));
+        return Vector2(90-lonlat.x(), -lonlat.y());
       }
       else {
         Vector2 lonlat = octant_point_to_lonlat(1-2*x, 1-2*y);
-        return m_georef.lonlat_to_pixel(Vector2(lonlat.x(), lonlat.y()));
+        return Vector2(lonlat.x(), lonlat.y());
       }
     }
     else {
       // Upper left: 0 to 90W
       if( y > 0.5 + x ) {
         Vector2 lonlat = octant_point_to_lonlat(2*x, 2-2*y);
-        return m_georef.lonlat_to_pixel(Vector2(-90+lonlat.x(), -lonlat.y()));
+        return Vector2(-90+lonlat.x(), -lonlat.y());
       }
       else {
         Vector2 lonlat = octant_point_to_lonlat(1-2*x,2*y-1);
-        return m_georef.lonlat_to_pixel(Vector2(-lonlat.x(), lonlat.y()));
+        return Vector2(-lonlat.x(), lonlat.y());
       }
     }
   }
@@ -251,28 +332,47 @@ vw::Vector2 vw::cartography::ToastTransform::reverse(vw::Vector2 const& point) c
     if( y < 0.5 ) {
       if( y < x - 0.5 ) {
         Vector2 lonlat = octant_point_to_lonlat(2-2*x, 2*y);
-        return m_georef.lonlat_to_pixel(Vector2(90+lonlat.x(), -lonlat.y()));
+        return Vector2(90+lonlat.x(), -lonlat.y());
       }
       else {
         Vector2 lonlat = octant_point_to_lonlat(2*x-1, 1-2*y);
-        return m_georef.lonlat_to_pixel(Vector2(180-lonlat.x(), lonlat.y()));
+        return Vector2(180-lonlat.x(), lonlat.y());
       }
     }
     else {
       // Upper right: 90W to 180
       if( y > 1.5 - x ) {
         Vector2 lonlat = octant_point_to_lonlat(2-2*x, 2-2*y);
-        return m_georef.lonlat_to_pixel(Vector2(-90-lonlat.x(), -lonlat.y()));
+        return Vector2(-90-lonlat.x(), -lonlat.y());
       }
       else {
         Vector2 lonlat = octant_point_to_lonlat(2*x-1, 2*y-1);
-        return m_georef.lonlat_to_pixel(Vector2(-180+lonlat.x(), lonlat.y()));
+        return Vector2(-180+lonlat.x(), lonlat.y());
       }
     }
   }
 }
 
 
+// Back-projects a pixel location in the TOAST image space into a
+// pixel location in the projected source image space.
+vw::Vector2 vw::cartography::ToastTransform::reverse(vw::Vector2 const& point) const {
+  return m_georef.lonlat_to_pixel(reverse_lonlat(point));
+}
+
+
+// Reverse-transforms every node of the lattice at once: the lon/lat
+// of the nodes come from the cache, and the georeference converts
+// them all to source pixels in one batch.
+void vw::cartography::ToastTransform::reverse_lattice( vw::BBox2i const& bbox, vw::int32 n,
+                                                       vw::ImageView<vw::Vector2>& table ) const {
+  VW_ASSERT( n >= 2, ArgumentErr() << "ToastTransform::reverse_lattice: need at least 2 nodes per side." );
+  boost::shared_ptr<ImageView<Vector2> > lonlat = toast_lattice( m_resolution, bbox, n );
+  table.set_size( n, n );
+  m_georef.lonlats_to_pixels( &(*lonlat)(0,0), &table(0,0), n*n );
+}
+
+
 // We override forward_bbox so it understands to check if the image
 // crosses the poles or not.
 vw::BBox2i vw::cartography::ToastTransform::forward_bbox( vw::BBox2i const& bbox ) const {
@@ -54,13 +54,12 @@
 //
 // The TOAST transform is not cheap, and we work around that by using
 // the lookup-table-based approximation capabilities of TransformView.
+// The nodes of those tables fall at the same places in TOAST space
+// for every image placed into a given tile, so their lon/lat are
+// computed once and kept in the system cache (see reverse_lattice).
 // We could get back some precision, and possibly make things even
 // faster, by exploiting the fact that the first many iterations will
-// be identical for nearby points.  We typically compute the reverse
-// transform for a large number of nearby points at a time.  We could
-// either cache the stack used in the most recent calculation, or
-// directly expose a the ability to reverse-transform a block of
-// points at a time.
+// be identical for nearby points.
 
 #include <vw/Math/Vector.h>
 #include <vw/Math/BBox.h>
@@ -117,6 +116,19 @@ namespace cartography {
     virtual Vector2 forward( Vector2 const& point ) const;
     virtual Vector2 reverse( Vector2 const& point ) const;
 
+    // The first half of reverse(): the lon/lat, in degrees, of a
+    // point in TOAST pixel space.  Depends only on the resolution.
+    Vector2 reverse_lonlat( Vector2 const& point ) const;
+
+    // Computes reverse() at every node of the n-by-n lattice spanning
+    // bbox, where node (x,y) lies at bbox.min() + (x,y)/(n-1) *
+    // bbox.size().  The lon/lat of the nodes are computed once per
+    // lattice and resolution and kept in the system cache, so placing
+    // many images into the same TOAST tiles only pays for the
+    // georeference.  ApproximateTransform builds its lookup tables
+    // this way.
+    void reverse_lattice( BBox2i const& bbox, int32 n, ImageView<Vector2>& table ) const;
+
     virtual BBox2i forward_bbox( BBox2i const& bbox ) const;
 
     // We override reverse_bbox so it understands to check if the image crosses
@@ -144,6 +156,13 @@ namespace cartography {
 
 } // namespace vw::cartography
 
+  // Build TransformView's lookup tables from the cached lattices.
+  template <>
+  inline void ApproximateTransform<cartography::ToastTransform>::reverse_lattice( int32 n, ImageView<Vector2> const& /*prev*/,
+                                                                                  ImageView<Vector2>& table ) const {
+    cartography::ToastTransform::reverse_lattice( m_bbox, n, table );
+  }
+
   template <class ChildT>
   class SparseImageCheck<TransformView<ChildT, cartography::ToastTransform> > {
 
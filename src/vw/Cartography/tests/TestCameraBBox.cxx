@@ -75,4 +75,45 @@ TEST_F( CameraBBoxTest, CameraBBoxDEM ) {
   EXPECT_VECTOR_NEAR( image_bbox.max(), Vector2(94,6), 2 );
 }
 
+TEST_F( CameraBBoxTest, CameraBBoxAdaptive ) {
+  CameraBBoxResult result = camera_bbox_adaptive( moon, apollo, 4096, 4096 );
+  EXPECT_VECTOR_NEAR( result.bbox.min(), Vector2(86,-1), 2 );
+  EXPECT_VECTOR_NEAR( result.bbox.max(), Vector2(95,7), 2 );
+  EXPECT_NEAR( result.scale, (95-86.)/sqrt(4096*4096*2), 1e-3 );
+  EXPECT_GE( result.error, 0 );
+  EXPECT_LT( result.error, 0.5*result.scale );
+  EXPECT_LT( result.samples, 5*4096 );
+
+  // Threading must not change the answer
+  CameraBBoxResult threaded = camera_bbox_adaptive( moon, apollo, 4096, 4096, 0.5, 4 );
+  EXPECT_VECTOR_NEAR( threaded.bbox.min(), result.bbox.min(), 1e-10 );
+  EXPECT_VECTOR_NEAR( threaded.bbox.max(), result.bbox.max(), 1e-10 );
+  EXPECT_EQ( threaded.samples, result.samples );
+
+  // Tighter tolerance only ever grows the box
+  CameraBBoxResult fine = camera_bbox_adaptive( moon, apollo, 4096, 4096, 0.01 );
+  EXPECT_GE( fine.samples, result.samples );
+  EXPECT_NEAR( fine.bbox.min().x(), result.bbox.min().x(), 1e-3 );
+  EXPECT_NEAR( fine.bbox.max().y(), result.bbox.max().y(), 1e-3 );
+}
+
+TEST_F( CameraBBoxTest, CameraBBoxAdaptiveDEM ) {
+  ImageView<float> DEM(20,20);
+  for ( uint32 i = 0; i < 20; i++ )
+    for ( uint32 j = 0; j <20; j++ )
+      DEM(i,j) = 1000 - 10*(pow(10.-i,2.)+pow(10.-j,2));
+  Matrix<double> geotrans = vw::math::identity_matrix<3>();
+  geotrans(0,2) = 80;
+  geotrans(1,1) = -1;
+  geotrans(1,2) = 10;
+  moon.set_transform(geotrans);
+
+  CameraBBoxResult direct = camera_bbox_adaptive( DEM, moon, apollo, 4096, 4096 );
+  CameraBBoxResult pyramid = camera_bbox_adaptive( DEM, moon, apollo, 4096, 4096, 0.5, 0, 2 );
+  EXPECT_VECTOR_NEAR( direct.bbox.min(), Vector2(87,0), 2 );
+  EXPECT_VECTOR_NEAR( direct.bbox.max(), Vector2(94,6), 2 );
+  EXPECT_VECTOR_NEAR( pyramid.bbox.min(), direct.bbox.min(), 1e-3 );
+  EXPECT_VECTOR_NEAR( pyramid.bbox.max(), direct.bbox.max(), 1e-3 );
+}
+
 #endif
@@ -226,6 +226,46 @@ TEST( GeoReference, UTM_to_LonLat ) {
   }
 }
 
+TEST( GeoReference, BatchConversions ) {
+  Matrix3x3 map;
+  map(0,0) =  0.5;
+  map(1,1) = -0.25;
+  map(0,2) = -20;
+  map(1,2) = 40;
+  map(2,2) = 1;
+  GeoReference georef(Datum("WGS84"), map);
+
+  std::vector<Vector2> pix;
+  for (int i = 0; i < 12; ++i)
+    pix.push_back(Vector2(7*i, 3*i+1));
+  const size_t n = pix.size();
+
+  for (int projected = 0; projected < 2; ++projected) {
+    if (projected)
+      georef.set_sinusoidal(10);
+    for (int interp = 0; interp < 2; ++interp) {
+      georef.set_pixel_interpretation(interp ? GeoReference::PixelAsPoint : GeoReference::PixelAsArea);
+
+      std::vector<Vector2> point(n), lonlat(n), back(n);
+      georef.pixels_to_points(&pix[0], &point[0], n);
+      georef.pixels_to_lonlats(&pix[0], &lonlat[0], n);
+      georef.lonlats_to_pixels(&lonlat[0], &back[0], n);
+      for (size_t i = 0; i < n; ++i) {
+        EXPECT_VECTOR_DOUBLE_EQ( georef.pixel_to_point(pix[i]), point[i] );
+        EXPECT_VECTOR_DOUBLE_EQ( georef.pixel_to_lonlat(pix[i]), lonlat[i] );
+        EXPECT_VECTOR_DOUBLE_EQ( georef.lonlat_to_pixel(lonlat[i]), back[i] );
+        EXPECT_VECTOR_NEAR( pix[i], back[i], 1e-6 );
+      }
+
+      // In place
+      std::vector<Vector2> v = pix;
+      georef.pixels_to_lonlats(&v[0], &v[0], n);
+      for (size_t i = 0; i < n; ++i)
+        EXPECT_VECTOR_DOUBLE_EQ( lonlat[i], v[i] );
+    }
+  }
+}
+
 TEST( GeoReference, IOLoop ) {
   ImageView<PixelRGB<float> > test_image(2,2);
   test_image(0,0) = PixelRGB<float>(1,2,3);
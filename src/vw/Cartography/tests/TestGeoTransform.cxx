@@ -97,3 +97,40 @@ TEST( GeoTransform, StereographicSingularity ) {
   EXPECT_NO_THROW( output = geotx.forward_bbox(input) );
   EXPECT_NEAR( 0, output.min()[1], 2 );
 }
+
+TEST( GeoTransform, Batch ) {
+  GeoReference src_georef, dst_georef;
+  Matrix3x3 map;
+  map(0,0) =  0.1;
+  map(1,1) = -0.1;
+  map(0,2) = 30;
+  map(1,2) = 10;
+  map(2,2) = 1;
+  src_georef.set_transform(map);
+  dst_georef.set_sinusoidal(35);
+  map(0,0) =  1000;
+  map(1,1) = -1000;
+  map(0,2) = -50000;
+  map(1,2) = 1200000;
+  dst_georef.set_transform(map);
+
+  std::vector<Vector2> pix;
+  for (int i = 0; i < 20; ++i)
+    pix.push_back(Vector2(5*i, 40 - 2*i));
+  const size_t n = pix.size();
+
+  GeoTransform geotx(src_georef, dst_georef);
+
+  std::vector<Vector2> fwd(n), rev(n);
+  geotx.forward(&pix[0], &fwd[0], n);
+  geotx.reverse(&pix[0], &rev[0], n);
+  for (size_t i = 0; i < n; ++i) {
+    EXPECT_VECTOR_DOUBLE_EQ( geotx.forward(pix[i]), fwd[i] );
+    EXPECT_VECTOR_DOUBLE_EQ( geotx.reverse(pix[i]), rev[i] );
+  }
+
+  // In place
+  geotx.reverse(&fwd[0], &fwd[0], n);
+  for (size_t i = 0; i < n; ++i)
+    EXPECT_VECTOR_NEAR( pix[i], fwd[i], 1e-6 );
+}
@@ -71,6 +71,31 @@ TestPatternView<PixelT> test_pattern_view( PixelT const& /*value*/, int32 cols,
 }
 
 
+// A camera image whose value is a linear function of position, so
+// that differences in value measure differences in camera position.
+class RampView : public ImageViewBase<RampView> {
+public:
+  typedef float pixel_type;
+  typedef float result_type;
+  typedef ProceduralPixelAccessor<RampView> pixel_accessor;
+
+  inline int32 cols() const { return 5725; }
+  inline int32 rows() const { return 5725; }
+  inline int32 planes() const { return 1; }
+
+  inline pixel_accessor origin() const { return pixel_accessor( *this ); }
+
+  inline result_type operator()( int32 col, int32 row, int32 /*plane*/=0 ) const {
+    return float(col) + 0.5f*float(row);
+  }
+
+  typedef RampView prerasterize_type;
+  inline prerasterize_type prerasterize( BBox2i /*bbox*/ ) const { return *this; }
+  template <class DestT> inline void rasterize( DestT const& dest, BBox2i bbox ) const {
+    vw::rasterize( prerasterize(bbox), dest, bbox );
+  }
+};
+
 // Test Framework
 class OrthoImageTest :  public ::testing::Test {
 protected:
@@ -136,6 +161,32 @@ TEST_F( OrthoImageTest, OrthoImageRun ) {
 }
 
 
+TEST_F( OrthoImageTest, Approximate ) {
+  ImageView<float> exact =
+    orthoproject( interpolate(DEM,BicubicInterpolation()), moon, RampView(),
+                  apollo, BilinearInterpolation(), ZeroEdgeExtension() );
+  ImageView<float> approx =
+    orthoproject( interpolate(DEM,BicubicInterpolation()), moon, RampView(),
+                  apollo, BilinearInterpolation(), ZeroEdgeExtension(), 0.1 );
+  ImageView<float> blocked =
+    block_orthoproject( interpolate(DEM,BicubicInterpolation()), moon, RampView(),
+                        apollo, BilinearInterpolation(), ZeroEdgeExtension(), 0.1,
+                        Vector2i(8,8), 2 );
+
+  // A tenth of a pixel either way moves the ramp at most 0.15
+  for ( int32 j = 0; j < exact.rows(); ++j ) {
+    for ( int32 i = 0; i < exact.cols(); ++i ) {
+      EXPECT_NEAR( exact(i,j), approx(i,j), 0.15 );
+      EXPECT_NEAR( exact(i,j), blocked(i,j), 0.15 );
+    }
+  }
+
+  // Looking up single pixels is always exact
+  EXPECT_EQ( exact(7,11),
+             orthoproject( interpolate(DEM,BicubicInterpolation()), moon, RampView(),
+                           apollo, BilinearInterpolation(), ZeroEdgeExtension(), 0.1 )(7,11) );
+}
+
 TEST_F( OrthoImageTest, OrthoTraits ) {
   OrthoImageView<ImageView<float>,TestPatternView<PixelGray<uint8> >,
     BicubicInterpolation, ZeroEdgeExtension>
@@ -10,6 +10,8 @@
 #include <test/Helpers.h>
 
 #include <vw/Cartography/PointImageManipulation.h>
+#include <vw/Image/Manipulation.h>
+#include <vw/Image/PixelMask.h>
 
 using namespace vw;
 using namespace vw::cartography;
@@ -38,3 +40,43 @@ TEST( PointImageManip, XYZ_to_LonLat ) {
   EXPECT_VECTOR_NEAR( xyz, xyz2, 1e-2 );
 }
 
+TEST( PointImageManip, DemToPointImage ) {
+  ImageView<PixelMask<float> > dem(23, 9);
+  for (int32 j = 0; j < dem.rows(); ++j)
+    for (int32 i = 0; i < dem.cols(); ++i)
+      dem(i,j) = PixelMask<float>(float(i*j) - 3);
+  dem(4,2).invalidate();
+  dem(0,5).invalidate();
+  for (int32 i = 0; i < dem.cols(); ++i)
+    dem(i,7).invalidate();
+
+  GeoReference georef;
+  Matrix3x3 map;
+  map(0,0) =  0.5;
+  map(1,1) = -0.5;
+  map(0,2) = 100;
+  map(1,2) = 20;
+  map(2,2) = 1;
+  georef.set_transform(map);
+  georef.set_sinusoidal(90);
+
+  // Rasterizing goes a row at a time; pixel access goes one at a time.
+  // They should agree exactly.
+  ImageView<Vector3> points = dem_to_point_image(dem, georef);
+  ImageView<Vector3> cropped = crop(dem_to_point_image(dem, georef), BBox2i(3,1,12,7));
+  for (int32 j = 0; j < dem.rows(); ++j) {
+    for (int32 i = 0; i < dem.cols(); ++i) {
+      Vector3 expected = dem_to_point_image(dem, georef)(i,j);
+      EXPECT_VECTOR_DOUBLE_EQ( expected, points(i,j) );
+      if (is_transparent(dem(i,j))) {
+        EXPECT_EQ( Vector3(), points(i,j) );
+      } else {
+        EXPECT_VECTOR_DOUBLE_EQ( Vector3(georef.pixel_to_lonlat(Vector2(i,j))[0],
+                                         georef.pixel_to_lonlat(Vector2(i,j))[1],
+                                         dem(i,j).child()), points(i,j) );
+      }
+      if (i >= 3 && i < 15 && j >= 1 && j < 8)
+        EXPECT_VECTOR_DOUBLE_EQ( points(i,j), cropped(i-3,j-1) );
+    }
+  }
+}
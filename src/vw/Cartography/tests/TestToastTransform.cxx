@@ -321,3 +321,38 @@ TEST_F( ToastTransformTest, StereographicBBox ) {
   BBox2i global(0,0,toast_resolution,toast_resolution);
   EXPECT_TRUE( global.contains(out_box) );
 }
+
+TEST_F( ToastTransformTest, ReverseLattice ) {
+  BBox2i tile( 255, 510, 256, 256 );
+  for ( int32 n = 2; n <= 17; n = 2*n-1 ) {
+    ImageView<Vector2> table;
+    txform.reverse_lattice( tile, n, table );
+    ASSERT_EQ( n, table.cols() );
+    ASSERT_EQ( n, table.rows() );
+    for ( int32 y = 0; y < n; ++y )
+      for ( int32 x = 0; x < n; ++x )
+        EXPECT_VECTOR_NEAR( table(x,y),
+                            txform.reverse( tile.min() + elem_prod( Vector2(x,y)/(n-1), tile.size() ) ),
+                            1e-9 );
+  }
+
+  // A second image at the same resolution reuses the cached lon/lat
+  GeoReference shifted = basicref;
+  Matrix3x3 M = shifted.transform();
+  M(0,2) += 10;
+  shifted.set_transform( M );
+  ToastTransform other( shifted, toast_resolution );
+  ImageView<Vector2> table;
+  other.reverse_lattice( tile, 9, table );
+  EXPECT_VECTOR_NEAR( table(4,4), other.reverse( tile.min() + tile.size()/2 ), 1e-9 );
+}
+
+TEST_F( ToastTransformTest, ApproximateMatchesExact ) {
+  BBox2i tile( 255, 255, 256, 256 );
+  ApproximateTransform<ToastTransform> approx( txform, tile );
+  double max_err = 0;
+  for ( int32 y = tile.min().y(); y < tile.max().y(); y += 5 )
+    for ( int32 x = tile.min().x(); x < tile.max().x(); x += 5 )
+      max_err = std::max( max_err, norm_2( approx.reverse( Vector2(x,y) ) - txform.reverse( Vector2(x,y) ) ) );
+  EXPECT_LT( max_err, txform.tolerance() );
+}
@@ -102,6 +102,7 @@
 
 #if defined(VW_ENABLE_EXCEPTIONS) && (VW_ENABLE_EXCEPTIONS==1)
 #include <exception>
+#include <boost/throw_exception.hpp>
 #define VW_IF_EXCEPTIONS(x) x
 #else
 #define VW_IF_EXCEPTIONS(x)
@@ -150,7 +151,9 @@ namespace vw {
     void set( std::string const& s ) { m_desc.str(s); }
     void reset() { m_desc.str(""); }
 
-    VW_IF_EXCEPTIONS( virtual void default_throw() const { throw *this; } )
+    // Thrown through enable_current_exception() so that a copy taken
+    // with boost::current_exception() (see TaskErrors) keeps the type.
+    VW_IF_EXCEPTIONS( virtual void default_throw() const { throw boost::enable_current_exception(*this); } )
 
   protected:
       virtual std::ostringstream& stream() {return m_desc;}
@@ -206,7 +209,8 @@ namespace vw {
 
   #define VW_EXCEPTION_API(exception_type)                                     \
     virtual std::string name() const { return #exception_type; }               \
-    VW_IF_EXCEPTIONS( virtual void default_throw() const { throw *this; } )    \
+    VW_IF_EXCEPTIONS( virtual void default_throw() const {                     \
+      throw boost::enable_current_exception(*this); } )                        \
     template <class T>                                                         \
     exception_type& operator<<( T const& t ) { stream() << t; return *this; }
 
@@ -24,6 +24,8 @@
 // STL
 #include <map>
 
+#include <boost/exception_ptr.hpp>
+
 namespace vw {
   // ----------------------  --------------  ---------------------------
   // ----------------------       Task       ---------------------------
@@ -58,6 +60,48 @@ namespace vw {
     }
   };
 
+  // ----------------------  --------------  ---------------------------
+  // ----------------------    TaskErrors    ---------------------------
+  // ----------------------  --------------  ---------------------------
+
+  /// Exceptions can't leave a worker thread, so a group of tasks that
+  /// can fail shares one of these: each task calls capture() from a
+  /// catch block, and whoever waits on the group calls rethrow() once
+  /// the tasks are joined.  Only the first exception is kept, and it is
+  /// rethrown with its original type (vw exceptions are thrown so that
+  /// this holds; others may arrive as boost::unknown_exception).
+  class TaskErrors : private boost::noncopyable {
+    mutable Mutex m_mutex;
+    boost::exception_ptr m_error;
+
+  public:
+    /// Keeps the exception currently being handled, unless an earlier
+    /// one is already kept.  Must be called from inside a catch block.
+    void capture() {
+      boost::exception_ptr error = boost::current_exception();
+      Mutex::Lock lock(m_mutex);
+      if (!m_error)
+        m_error = error;
+    }
+
+    /// True once any task has failed.
+    bool failed() const {
+      Mutex::Lock lock(m_mutex);
+      return m_error ? true : false;
+    }
+
+    /// Rethrows the kept exception, if there is one.
+    void rethrow() const {
+      boost::exception_ptr error;
+      {
+        Mutex::Lock lock(m_mutex);
+        error = m_error;
+      }
+      if (error)
+        boost::rethrow_exception(error);
+    }
+  };
+
   // ----------------------  --------------  ---------------------------
   // ----------------------  Task Generator  ---------------------------
   // ----------------------  --------------  ---------------------------
@@ -212,3 +212,40 @@ TEST(ThreadPool, OrderedWorkQueue) {
 
   queue.join_all();
 }
+
+class FailingTask : public Task {
+  TaskErrors& m_errors;
+  int m_id;
+public:
+  FailingTask( TaskErrors& errors, int id ) : m_errors(errors), m_id(id) {}
+  void operator()() {
+    try {
+      if (m_id % 2)
+        vw_throw( IOErr() << "task " << m_id << " failed" );
+    } catch (...) {
+      m_errors.capture();
+    }
+  }
+};
+
+TEST(ThreadPool, TaskErrors) {
+  TaskErrors errors;
+  EXPECT_FALSE( errors.failed() );
+  EXPECT_NO_THROW( errors.rethrow() );
+
+  FifoWorkQueue queue(4);
+  for (int i = 0; i < 16; ++i)
+    queue.add_task( boost::shared_ptr<Task>( new FailingTask(errors, i) ) );
+  queue.join_all();
+
+  EXPECT_TRUE( errors.failed() );
+  // The first error keeps its type, and keeps being rethrown
+  EXPECT_THROW( errors.rethrow(), IOErr );
+  try {
+    errors.rethrow();
+    FAIL() << "rethrow() didn't throw";
+  } catch (const IOErr& e) {
+    EXPECT_EQ( std::string::npos, std::string(e.what()).find("task 0 ") );
+    EXPECT_NE( std::string::npos, std::string(e.what()).find("failed") );
+  }
+}
@@ -92,6 +92,50 @@ void vw::DiskImageResource::set_default_rescale(bool rescale) {
   default_rescale = rescale;
 }
 
+vw::Vector2i vw::DiskImageResource::level_size( int32 level ) const {
+  VW_ASSERT( level == 0, ArgumentErr() << "DiskImageResource: " << m_filename << " has no resolution level " << level << "." );
+  return Vector2i( cols(), rows() );
+}
+
+vw::Vector2i vw::DiskImageResource::level_block_read_size( int32 level ) const {
+  VW_ASSERT( level == 0, ArgumentErr() << "DiskImageResource: " << m_filename << " has no resolution level " << level << "." );
+  return block_read_size();
+}
+
+void vw::DiskImageResource::read_level( ImageBuffer const& buf, BBox2i const& bbox, int32 level ) const {
+  VW_ASSERT( level == 0, ArgumentErr() << "DiskImageResource: " << m_filename << " has no resolution level " << level << "." );
+  read( buf, bbox );
+}
+
+vw::int32 vw::DiskImageResource::level_for_subsample( int32 factor ) const {
+  VW_ASSERT( factor >= 1, ArgumentErr() << "DiskImageResource: invalid subsample factor " << factor << "." );
+  // The smallest size we may read, per axis, rounding up the way subsample() does
+  const int32 min_cols = (cols() + factor - 1) / factor;
+  const int32 min_rows = (rows() + factor - 1) / factor;
+  int32 level = 0;
+  for ( int32 i = 1; i < num_levels(); ++i ) {
+    Vector2i size = level_size( i );
+    if ( size.x() < min_cols || size.y() < min_rows )
+      break;
+    level = i;
+  }
+  return level;
+}
+
+vw::DiskImageResourceLevel::DiskImageResourceLevel( boost::shared_ptr<DiskImageResource> resource, int32 level )
+  : m_rsrc( resource ), m_level( level ), m_format( resource->format() )
+{
+  VW_ASSERT( level >= 0 && level < resource->num_levels(),
+             ArgumentErr() << "DiskImageResourceLevel: " << resource->filename() << " has no resolution level " << level << "." );
+  Vector2i size = resource->level_size( level );
+  m_format.cols = size.x();
+  m_format.rows = size.y();
+}
+
+void vw::DiskImageResourceLevel::read( ImageBuffer const& buf, BBox2i const& bbox ) const {
+  m_rsrc->read_level( buf, bbox, m_level );
+}
+
 namespace vw {
   namespace internal {
 
@@ -104,6 +104,28 @@ namespace vw {
     // TODO: This has always been the default, but it probably shouldn't be.
     virtual void flush() {}
 
+    /// Returns the number of resolution levels that can be read straight
+    /// from the file (from internal overviews, or by decoding at reduced
+    /// scale). Level 0 is the full resolution image and each level after
+    /// it is about half the size of the one before. Most file types only
+    /// have level 0.
+    virtual int32 num_levels() const { return 1; }
+
+    /// Returns the size in pixels of the given resolution level.
+    virtual Vector2i level_size( int32 level ) const;
+
+    /// Returns the preferred block size for reads at the given level.
+    virtual Vector2i level_block_read_size( int32 level ) const;
+
+    /// Read part of the given resolution level into a buffer. The bbox is
+    /// in the pixel coordinates of that level.
+    virtual void read_level( ImageBuffer const& buf, BBox2i const& bbox, int32 level ) const;
+
+    /// Returns the smallest level that is still at least 1/factor the size
+    /// of the full image, i.e. the cheapest level to read and then subsample
+    /// by what's left of the factor.
+    int32 level_for_subsample( int32 factor ) const;
+
   protected:
     DiskImageResource( std::string const& filename ) : m_filename(filename), m_rescale(default_rescale) {}
     ImageFormat m_format;
@@ -113,6 +135,30 @@ namespace vw {
   };
 
 
+  /// A read-only resource presenting one resolution level of a
+  /// DiskImageResource as an image of its own. Reads go through
+  /// DiskImageResource::read_level(), so nothing at a finer resolution is
+  /// read.
+  class DiskImageResourceLevel : public SrcImageResource {
+    boost::shared_ptr<DiskImageResource> m_rsrc;
+    int32 m_level;
+    ImageFormat m_format;
+  public:
+    DiskImageResourceLevel( boost::shared_ptr<DiskImageResource> resource, int32 level );
+
+    virtual ImageFormat format() const { return m_format; }
+    virtual void read( ImageBuffer const& buf, BBox2i const& bbox ) const;
+
+    virtual bool has_block_read() const { return m_rsrc->has_block_read(); }
+    virtual Vector2i block_read_size() const { return m_rsrc->level_block_read_size( m_level ); }
+
+    virtual bool has_nodata_read() const { return m_rsrc->has_nodata_read(); }
+    virtual double nodata_read() const { return m_rsrc->nodata_read(); }
+
+    int32 level() const { return m_level; }
+    boost::shared_ptr<DiskImageResource> resource() const { return m_rsrc; }
+  };
+
   // *******************************************************************
   // Free functions using the DiskImageResource interface
   // *******************************************************************
@@ -31,6 +31,8 @@
 #include <boost/algorithm/string.hpp>
 #include <boost/filesystem/convenience.hpp>
 #include <boost/foreach.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_array.hpp>
 namespace fs = boost::filesystem;
 
 namespace d = vw::fileio::detail;
@@ -52,8 +54,80 @@ namespace {
     if (x)
       ::GDALClose(x);
   }
+
+  bool default_concurrent_read = false;
 }
 
+namespace vw {
+namespace fileio {
+namespace detail {
+
+  // A GDALDataset can only be used by one thread at a time, but separate
+  // datasets (even ones on the same file) can be used from separate threads
+  // at once. This keeps a set of read-only datasets for one file, opened
+  // the first time they're needed and handed out one reader at a time, so
+  // there's never more open than there have been simultaneous readers.
+  class GdalReadPool : private boost::noncopyable {
+      std::string m_filename;
+      Mutex m_mutex;
+      std::vector<GDALDataset*> m_free;
+      size_t m_open;
+
+    public:
+      GdalReadPool(std::string const& filename) : m_filename(filename), m_open(0) {}
+
+      ~GdalReadPool() {
+        Mutex::Lock lock(gdal());
+        if (m_free.size() != m_open)
+          vw_out(WarningMessage, "fileio") << "GdalReadPool for " << m_filename << " destroyed with datasets still in use" << std::endl;
+        BOOST_FOREACH(GDALDataset* ds, m_free)
+          GDALClose(ds);
+      }
+
+      GDALDataset* acquire() {
+        {
+          Mutex::Lock lock(m_mutex);
+          if (!m_free.empty()) {
+            GDALDataset* ds = m_free.back();
+            m_free.pop_back();
+            return ds;
+          }
+        }
+
+        // Opening goes through GDAL's driver manager, which isn't reliably
+        // thread-safe, so it takes the global lock like every other call.
+        // Only the reads on the dataset it returns run without it.
+        GDALDataset* ds;
+        {
+          Mutex::Lock lock(gdal());
+          ds = (GDALDataset*)GDALOpen(m_filename.c_str(), GA_ReadOnly);
+        }
+        if (!ds)
+          vw_throw( IOErr() << "GDAL: Failed to reopen " << m_filename << " for reading." );
+
+        Mutex::Lock lock(m_mutex);
+        m_open++;
+        return ds;
+      }
+
+      void release(GDALDataset* ds) {
+        Mutex::Lock lock(m_mutex);
+        m_free.push_back(ds);
+      }
+  };
+
+  // Borrows a dataset from the pool for the life of the object
+  class GdalReadLease : private boost::noncopyable {
+      GdalReadPool& m_pool;
+      GDALDataset* m_ds;
+    public:
+      GdalReadLease(GdalReadPool& pool) : m_pool(pool), m_ds(pool.acquire()) {}
+      ~GdalReadLease() { m_pool.release(m_ds); }
+      GDALDataset* get() const { return m_ds; }
+  };
+
+}}} // namespace vw::fileio::detail
+
 namespace vw {
 
   /// \cond INTERNAL
@@ -199,6 +273,27 @@ namespace vw {
     m_read_dataset_ptr.reset();
   }
 
+  void DiskImageResourceGDAL::set_default_concurrent_read(bool enable) {
+    default_concurrent_read = enable;
+  }
+
+  void DiskImageResourceGDAL::set_concurrent_read(bool enable) {
+    // m_read_pool is only touched under the global lock.  A pool being
+    // turned off is closed once the lock is released (old_pool outlives
+    // it), since closing takes the lock itself.
+    boost::shared_ptr<d::GdalReadPool> old_pool;
+    Mutex::Lock lock(d::gdal());
+    if (!enable)
+      m_read_pool.swap(old_pool);
+    else if (!m_read_pool && m_read_dataset_ptr && !m_write_dataset_ptr)
+      m_read_pool.reset(new d::GdalReadPool(m_filename));
+  }
+
+  bool DiskImageResourceGDAL::concurrent_read() const {
+    Mutex::Lock lock(d::gdal());
+    return bool(m_read_pool);
+  }
+
   bool DiskImageResourceGDAL::nodata_read_ok(double& value) const {
     Mutex::Lock lock(d::gdal());
     boost::shared_ptr<GDALDataset> dataset = get_dataset_ptr();
@@ -308,6 +403,9 @@ namespace vw {
     }
 
     m_blocksize = default_block_size();
+
+    if (default_concurrent_read)
+      m_read_pool.reset(new d::GdalReadPool(m_filename));
   }
 
   /// Bind the resource to a file for writing.
@@ -414,8 +512,92 @@ namespace vw {
     GDALSetCacheMax(size);
   }
 
+  /// \cond INTERNAL
+  // Band n (counting from 1) of the dataset at the given resolution level,
+  // where level 0 is the band itself and level k its (k-1)th overview.
+  static GDALRasterBand* gdal_level_band( GDALDataset* dataset, int n, int32 level ) {
+    GDALRasterBand *band = dataset->GetRasterBand(n);
+    if ( level > 0 ) {
+      band = band->GetOverview(level-1);
+      if ( !band )
+        vw_throw( IOErr() << "GDAL: Band " << n << " has no overview " << level-1 << "." );
+    }
+    return band;
+  }
+
+  // The GDAL half of read(). The caller is responsible for making sure
+  // nobody else is using the dataset.
+  static void gdal_read_block( GDALDataset* dataset, ImageBuffer const& src, BBox2i const& bbox,
+                               std::vector<PixelRGBA<uint8> > const& palette, int32 level )
+  {
+    if( palette.empty() ) {
+      GDALDataType gdal_pix_fmt = vw_channel_id_to_gdal_pix_fmt::value(src.format.channel_type);
+      const int32 channels = num_channels(src.format.pixel_format);
+      for ( int32 p = 0; p < int32(src.format.planes); ++p ) {
+        for ( int32 c = 0; c < channels; ++c ) {
+          // Only one of channels() or planes() will be nonzero.
+          GDALRasterBand  *band = gdal_level_band(dataset, c+p+1, level);
+          band->RasterIO( GF_Read, bbox.min().x(), bbox.min().y(), bbox.width(), bbox.height(),
+                          (uint8*)src(0,0,p) + channel_size(src.format.channel_type)*c,
+                          src.format.cols, src.format.rows, gdal_pix_fmt, src.cstride, src.rstride );
+        }
+      }
+    }
+    else { // palette conversion
+      GDALRasterBand  *band = gdal_level_band(dataset, 1, level);
+      std::vector<uint8> index_data(bbox.width() * bbox.height());
+      band->RasterIO( GF_Read, bbox.min().x(), bbox.min().y(), bbox.width(), bbox.height(),
+                      &index_data[0], bbox.width(), bbox.height(), GDT_Byte, 1, bbox.width() );
+      PixelRGBA<uint8> *rgba_data = (PixelRGBA<uint8>*) src.data;
+      for( int i=0; i<bbox.width()*bbox.height(); ++i )
+        rgba_data[i] = palette[index_data[i]];
+    }
+  }
+  /// \endcond
+
   /// Read the disk image into the given buffer.
   void DiskImageResourceGDAL::read( ImageBuffer const& dest, BBox2i const& bbox ) const
+  {
+    read_level( dest, bbox, 0 );
+  }
+
+  int32 DiskImageResourceGDAL::num_levels() const {
+    Mutex::Lock lock(d::gdal());
+    boost::shared_ptr<GDALDataset> dataset = get_dataset_ptr();
+    // Only count the overviews every band has
+    int overviews = dataset->GetRasterBand(1)->GetOverviewCount();
+    for ( int i = 2; i <= dataset->GetRasterCount(); ++i )
+      overviews = std::min( overviews, dataset->GetRasterBand(i)->GetOverviewCount() );
+    return 1 + overviews;
+  }
+
+  Vector2i DiskImageResourceGDAL::level_size( int32 level ) const {
+    if ( level == 0 )
+      return Vector2i( cols(), rows() );
+    VW_ASSERT( level > 0 && level < num_levels(),
+               ArgumentErr() << "DiskImageResourceGDAL: " << m_filename << " has no resolution level " << level << "." );
+    Mutex::Lock lock(d::gdal());
+    GDALRasterBand *band = gdal_level_band( get_dataset_ptr().get(), 1, level );
+    return Vector2i( band->GetXSize(), band->GetYSize() );
+  }
+
+  Vector2i DiskImageResourceGDAL::level_block_read_size( int32 level ) const {
+    if ( level == 0 )
+      return block_read_size();
+    VW_ASSERT( level > 0 && level < num_levels(),
+               ArgumentErr() << "DiskImageResourceGDAL: " << m_filename << " has no resolution level " << level << "." );
+    Mutex::Lock lock(d::gdal());
+    GDALRasterBand *band = gdal_level_band( get_dataset_ptr().get(), 1, level );
+    int xsize, ysize;
+    band->GetBlockSize(&xsize,&ysize);
+    // Same caution as default_block_size(): don't trust single-line blocks
+    if (ysize == 1 && !blocksize_whitelist(get_dataset_ptr()->GetDriver()))
+      return Vector2i( band->GetXSize(), band->GetYSize() );
+    return Vector2i(xsize, ysize);
+  }
+
+  /// Read part of a resolution level into the given buffer.
+  void DiskImageResourceGDAL::read_level( ImageBuffer const& dest, BBox2i const& bbox, int32 level ) const
   {
     VW_ASSERT( channels() == 1 || planes()==1,
                LogicErr() << "DiskImageResourceGDAL: cannot read an image that has both multiple channels and multiple planes." );
@@ -427,33 +609,19 @@ namespace vw {
     boost::scoped_array<uint8> src_data(new uint8[src_fmt.byte_size()]);
     ImageBuffer src(src_fmt, src_data.get());
 
+    // Take our own reference, in case concurrent reads get turned off while
+    // we're in here.
+    boost::shared_ptr<d::GdalReadPool> pool;
     {
       Mutex::Lock lock(d::gdal());
-
-      boost::shared_ptr<GDALDataset> dataset = get_dataset_ptr();
-
-      if( m_palette.empty() ) {
-        for ( int32 p = 0; p < planes(); ++p ) {
-          for ( int32 c = 0; c < channels(); ++c ) {
-            // Only one of channels() or planes() will be nonzero.
-            GDALRasterBand  *band = dataset->GetRasterBand(c+p+1);
-            GDALDataType gdal_pix_fmt = vw_channel_id_to_gdal_pix_fmt::value(channel_type());
-            band->RasterIO( GF_Read, bbox.min().x(), bbox.min().y(), bbox.width(), bbox.height(),
-                            (uint8*)src(0,0,p) + channel_size(src.format.channel_type)*c,
-                            src.format.cols, src.format.rows, gdal_pix_fmt, src.cstride, src.rstride );
-          }
-        }
-      }
-      else { // palette conversion
-        GDALRasterBand  *band = dataset->GetRasterBand(1);
-        uint8 *index_data = new uint8[bbox.width() * bbox.height()];
-        band->RasterIO( GF_Read, bbox.min().x(), bbox.min().y(), bbox.width(), bbox.height(),
-                        index_data, bbox.width(), bbox.height(), GDT_Byte, 1, bbox.width() );
-        PixelRGBA<uint8> *rgba_data = (PixelRGBA<uint8>*) src.data;
-        for( int i=0; i<bbox.width()*bbox.height(); ++i )
-          rgba_data[i] = m_palette[index_data[i]];
-        delete [] index_data;
-      }
+      pool = m_read_pool;
+    }
+    if (pool) {
+      d::GdalReadLease dataset(*pool);
+      gdal_read_block( dataset.get(), src, bbox, m_palette, level );
+    } else {
+      Mutex::Lock lock(d::gdal());
+      gdal_read_block( get_dataset_ptr().get(), src, bbox, m_palette, level );
     }
 
     convert( dest, src, m_rescale );
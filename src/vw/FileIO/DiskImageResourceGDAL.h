@@ -22,6 +22,15 @@
 ///                                   options );
 ///   write_image( resource, image );
 ///
+/// By default every call into GDAL holds a single process-wide lock. A
+/// resource opened for reading can instead be put into concurrent read mode,
+/// in which each reading thread borrows its own GDALDataset for the file
+/// (opened lazily and kept for reuse), so block reads from several threads
+/// proceed in parallel:
+///
+///   DiskImageResourceGDAL::set_default_concurrent_read(true);
+///   DiskImageView<PixelRGB<uint8> > image( "huge.tif" );
+///
 #ifndef __VW_FILEIO_DISKIMAGERESOUCEGDAL_H__
 #define __VW_FILEIO_DISKIMAGERESOUCEGDAL_H__
 
@@ -41,6 +50,10 @@
 class GDALDataset;
 namespace vw {
   class Mutex;
+namespace fileio {
+namespace detail {
+  class GdalReadPool;
+}}
 }
 
 namespace vw {
@@ -80,14 +93,31 @@ namespace vw {
     static std::string type_static() { return "GDAL"; }
     static void set_gdal_cache_size(int size);  // Set GDAL cache size in bytes
 
+    /// Whether resources opened for reading from now on start out in
+    /// concurrent read mode. Off by default.
+    static void set_default_concurrent_read(bool enable);
+
+    /// Turn concurrent read mode on or off for this resource. Only has an
+    /// effect on resources opened for reading.
+    void set_concurrent_read(bool enable);
+    bool concurrent_read() const;
+
     /// Returns the type of disk image resource.
     virtual std::string type() { return type_static(); }
 
     virtual void read( ImageBuffer const& dest, BBox2i const& bbox ) const;
     virtual void write( ImageBuffer const& dest, BBox2i const& bbox );
 
+    /// Level 0 is the image itself; the levels after it are the overviews
+    /// GDAL knows about (internal, or in an .ovr file), finest first.
+    virtual int32 num_levels() const;
+    virtual Vector2i level_size( int32 level ) const;
+    virtual Vector2i level_block_read_size( int32 level ) const;
+    virtual void read_level( ImageBuffer const& dest, BBox2i const& bbox, int32 level ) const;
+
     virtual bool has_block_read()   const {return true;}
     virtual bool has_block_write()  const {return true;}
+    virtual bool has_unordered_block_write() const {return true;}
     virtual bool has_nodata_read()  const;
     virtual bool has_nodata_write() const {return true;}
 
@@ -154,6 +184,8 @@ namespace vw {
     Vector2i m_blocksize;
     Options m_options;
     boost::shared_ptr<GDALDataset> m_read_dataset_ptr;
+    // Extra read handles, for concurrent read mode
+    boost::shared_ptr<fileio::detail::GdalReadPool> m_read_pool;
   };
 
   void UnloadGDAL();
@@ -18,8 +18,12 @@
 #endif
 
 #include <vw/FileIO/DiskImageResourceJPEG.h>
+#include <vw/FileIO/JpegIO.h>
 #include <vw/Core/Exception.h>
+#include <vw/Core/Settings.h>
+#include <vw/Core/Thread.h>
 
+#include <map>
 #include <vector>
 #include <boost/scoped_array.hpp>
 
@@ -44,133 +48,67 @@ static void vw_jpeg_error_exit(j_common_ptr cinfo) {
     vw_throw( IOErr() << "DiskImageResourceJPEG error: " << buffer );
 }
 
-/* A struct to handle the data for jpeglib's internals. Have to use it so
- * we can hide the various types from our own header file, which is not
- * allowed to depend on libjpeg header files.
+using fileio::detail::JpegSource;
+using fileio::detail::JpegFileSource;
+using fileio::detail::JpegRestartIndex;
+using fileio::detail::JpegIOStreamDecompress;
+
+/* Hands out streaming decoders for the file. Decoders are kept between
+ * reads, so a read that carries on where another stopped doesn't decode
+ * anything twice. The restart marker index is only built the first time
+ * some read can't be served that way.
 */
-class DiskImageResourceJPEG::vw_jpeg_decompress_context
+class DiskImageResourceJPEG::Reader
 {
-  // The enclosing class. Need the pointer so we can access its member
-  // variables.
-  DiskImageResourceJPEG *outer;
+  typedef boost::shared_ptr<JpegIOStreamDecompress> Decoder;
+  typedef std::multimap<int, Decoder> IdleMap;
 
-  jpeg_error_mgr jerr;
+  boost::shared_ptr<const JpegSource> m_src;
+  boost::shared_ptr<const JpegRestartIndex> m_index;
+  bool m_indexed;
+  IdleMap m_idle;
+  Mutex m_mutex;
 
 public:
-  int current_line;
-  jpeg_decompress_struct decompress_ctx;
-  JSAMPARRAY scanline;
-  int cstride;
-
-  vw_jpeg_decompress_context(DiskImageResourceJPEG *outer) : outer(outer)
-  {
-    current_line = -1;
-
-    // Set the position of the input stream at zero. Create a new decompress
-    // context.
-    fseek(outer->m_file_ptr, outer->m_byte_offset, SEEK_SET);
-
-    decompress_ctx.err = jpeg_std_error(&jerr);
-    jerr.error_exit = &vw_jpeg_error_exit;
-
-    jpeg_create_decompress(&decompress_ctx);
-    jpeg_stdio_src(&decompress_ctx, outer->m_file_ptr);
-
-    // Read the header information and parse it
-    jpeg_read_header(&decompress_ctx, TRUE);
-
-    // If the user has requested a grayscale image, we can speed up the
-    // decoding process by forcing the jpeg driver to decode the image
-    // in grayscale (since the color components need not be processed).
-    // This is commented out for now because it seems to be involved
-    // in some screwey behavior on Linux.
-#if 0
-    if (dest.format.pixel_format == VW_PIXEL_GRAY)
-      decompress_ctx.out_color_space = JCS_GRAYSCALE;
-#endif
-
-    // If the user has requested a subsampled version of the original
-    // image, we pass this request along to the JPEG driver here.
-    decompress_ctx.scale_num = 1;
-    decompress_ctx.scale_denom = outer->m_subsample_factor;
-
-    // Start the decompression
-    jpeg_start_decompress(&decompress_ctx);
-
-    // Set the parent class's format.
-    outer->m_format.cols = decompress_ctx.output_width;
-    outer->m_format.rows = decompress_ctx.output_height;
-    outer->m_format.channel_type = VW_CHANNEL_UINT8;
-
-    switch (decompress_ctx.output_components)
-    {
-      case 1:
-        outer->m_format.pixel_format = VW_PIXEL_GRAY;
-        outer->m_format.planes=1;
-        break;
-      case 2:
-        outer->m_format.pixel_format = VW_PIXEL_GRAYA;
-        outer->m_format.planes=1;
-        break;
-      case 3:
-        outer->m_format.pixel_format = VW_PIXEL_RGB;
-        outer->m_format.planes=1;
-        break;
-      case 4:
-        outer->m_format.pixel_format = VW_PIXEL_RGBA;
-        outer->m_format.planes=1; break;
-      default:
-        outer->m_format.planes = decompress_ctx.output_components;
-        outer->m_format.pixel_format = VW_PIXEL_SCALAR;
-        break;
-    }
-
-    // Allocate the scanline
-    cstride = decompress_ctx.output_components;
-    scanline = (*(decompress_ctx.mem->alloc_sarray))
-      ((j_common_ptr) &decompress_ctx, JPOOL_IMAGE, cstride * decompress_ctx.output_width, 1);
-
-    // Finally, we're now at line 0, so set it.
-    current_line = 0;
-  }
-
-  ~vw_jpeg_decompress_context()
-  {
-    if(current_line >= 0) {
-      jpeg_abort_decompress(&decompress_ctx);
-      jpeg_destroy_decompress(&decompress_ctx);
-    }
-  }
-
-
-  /* Reads the next line into scanline. Advances current_line appropriately.
-   *
-   * Warning!
-   * We set up error handling here using the struct's error context. This
-   * will clobber any error handling you already have, so be sure to
-   * reset it!
-   */
-  void readline() {
-    advance(1);
-  }
+  Reader(std::string const& filename, size_t byte_offset)
+    : m_src(new JpegFileSource(filename, byte_offset)), m_indexed(false) {}
 
-  /* Advances the current point in the file "lines" number of lines.
-   * Sets current_line accordingly.
-   *
-   * Warning!
-   * We set up error handling here using the struct's error context. This
-   * will clobber any error handling you already have, so be sure to
-   * reset it!
+  /* A decoder at the given scale, preferably one that can reach row
+   * without starting over.
   */
-  void advance(size_t lines)
-  {
-    for(size_t i=0; i < lines; i++)
-    {
-      jpeg_read_scanlines(&decompress_ctx, scanline, 1);
-      current_line++;
+  Decoder get(int scale, size_t row) {
+    Mutex::Lock lock(m_mutex);
+    IdleMap::iterator best = m_idle.end();
+    for (IdleMap::iterator i = m_idle.lower_bound(scale); i != m_idle.upper_bound(scale); ++i)
+      if (i->second->next_row() <= row &&
+          (best == m_idle.end() || i->second->next_row() > best->second->next_row()))
+        best = i;
+
+    Decoder d;
+    if (best != m_idle.end()) {
+      d = best->second;
+      m_idle.erase(best);
+    } else {
+      if (row > 0 && !m_indexed) {
+        m_index = JpegRestartIndex::build(*m_src);
+        m_indexed = true;
+        vw_out(DebugMessage, "fileio") << "DiskImageResourceJPEG: "
+                                       << (m_index ? "indexed restart markers" : "no usable restart markers") << "\n";
+      }
+      d.reset(new JpegIOStreamDecompress(m_src, scale));
+      d->open();
     }
+    d->set_index(m_index);
+    return d;
   }
 
+  /* Returns a decoder once a read is done with it. */
+  void put(Decoder d) {
+    Mutex::Lock lock(m_mutex);
+    if (m_idle.size() > vw_settings().default_num_threads())
+      m_idle.erase(m_idle.begin());
+    m_idle.insert(std::make_pair(d->scale(), d));
+  }
 };
 
 /// Close the JPEG file when the object is destroyed
@@ -203,20 +141,15 @@ void DiskImageResourceJPEG::open( std::string const& filename, int subsample_fac
   if(m_file_ptr)
     vw_throw( IOErr() << "DiskImageResourceJPEG: A file is already open." );
 
-  // Open the file on disk
-  FILE * infile;
-  if ((infile = fopen(filename.c_str(), "rb")) == NULL) {
-    vw_throw( ArgumentErr() << "Failed to open \"" << filename << "\" using libJPEG." );
-  }
-  if (byte_offset) fseek(infile, byte_offset, SEEK_SET);
-
   m_byte_offset = byte_offset;
   m_filename = filename;
-  m_file_ptr = infile;
 
-  // Now that all the needed members are set up, initialize the
-  // decompress context.
-  ctx = boost::shared_ptr<DiskImageResourceJPEG::vw_jpeg_decompress_context>(new DiskImageResourceJPEG::vw_jpeg_decompress_context(this));
+  // Read the header with the first decoder, and keep it for the first read.
+  m_reader.reset( new Reader( filename, byte_offset ) );
+  boost::shared_ptr<JpegIOStreamDecompress> d = m_reader->get( m_subsample_factor, 0 );
+  m_format = d->fmt();
+  m_mcu_rows = int32(d->mcu_rows()) * m_subsample_factor;
+  m_reader->put( d );
 }
 
 /// Bind the resource to a file for writing.
@@ -253,78 +186,70 @@ void DiskImageResourceJPEG::create( std::string const& filename,
   }
 }
 
-/* Read the disk image, or a number of scanlines past the current point,
- * into the given buffer. If you're reading lines, it reads them in
- * starting at the top of the ImageBuffer given. It detects whether to read
- * lines automatically depending on whether bbox represents the whole
- * image or not.
-*/
 void DiskImageResourceJPEG::read( ImageBuffer const& dest, BBox2i const& bbox) const
 {
-  VW_ASSERT( int(dest.format.cols)==bbox.width() && int(dest.format.rows)==bbox.height(),
-             ArgumentErr() << "DiskImageResourceJPEG (read) Error: Destination buffer has wrong dimensions!" );
+  read_level( dest, bbox, 0 );
+}
 
-  const int start_row = bbox.min().y();
-  const unsigned int end_row = bbox.max().y();
+Vector2i DiskImageResourceJPEG::block_read_size() const {
+  return level_block_read_size( 0 );
+}
 
-  // If we're starting from the beginning, or if we don't have an open
-  // decompress context, restart from the beginning of the file.
-  if(ctx->current_line != start_row)
-  {
-    if(ctx->current_line > start_row)
-      read_reset();
-    ctx->advance(start_row - ctx->current_line);
-  }
+int32 DiskImageResourceJPEG::strip_rows( int32 level ) const {
+  // Whole MCU rows, so one strip doesn't decode rows that belong to the next
+  int32 mcu = std::max( 1, m_mcu_rows / (m_subsample_factor << level) );
+  int32 tile = vw_settings().default_tile_size();
+  return std::min( (tile + mcu - 1) / mcu * mcu, level_size( level ).y() );
+}
 
-  // Now read.
-  boost::scoped_array<uint8> buf( new uint8[ctx->cstride * bbox.width() * bbox.height()] );
+int32 DiskImageResourceJPEG::num_levels() const {
+  int32 levels = 1;
+  for( int factor = m_subsample_factor; factor < 8; factor *= 2 )
+    ++levels;
+  return levels;
+}
 
-  int32 offset = 0;
-  while ( ctx->decompress_ctx.output_scanline < end_row)
-  {
-    ctx->readline();
-
-    // Copy the data over into a contiguous buffer, which is what
-    // convert() expects when we call it below.  This extra copy of
-    // the data is undesirable, but probably not a huge performance
-    // hit compared to reading the data from disk.
-      std::memcpy(buf.get() + offset,
-                  ctx->scanline[0] + ctx->cstride * bbox.min().x(),
-                  bbox.width() * ctx->cstride);
-      offset += bbox.width() * ctx->cstride;
-
-    //for (int i = 0; i < ctx->scanline_size; i++)
-    //  buf[ctx->scanline_size * (ctx->decompress_ctx.output_scanline - start_row - 1) + i]
-    //    = (uint8)(((JSAMPARRAY)(ctx->scanline))[0][i]);
-  }
+Vector2i DiskImageResourceJPEG::level_size( int32 level ) const {
+  VW_ASSERT( level >= 0 && level < num_levels(),
+             ArgumentErr() << "DiskImageResourceJPEG: " << m_filename << " has no resolution level " << level << "." );
+  // libjpeg rounds the scaled size up
+  return Vector2i( (cols() + (1 << level) - 1) >> level, (rows() + (1 << level) - 1) >> level );
+}
 
-  // Set up an image buffer around the tdata_t buf object that
-  // jpeg used to copy it's data.
+Vector2i DiskImageResourceJPEG::level_block_read_size( int32 level ) const {
+  return Vector2i( level_size( level ).x(), strip_rows( level ) );
+}
+
+/* Reads part of the image, or of a reduced resolution level. Only the
+ * rows of bbox are decoded into memory; the columns are cropped out while
+ * converting.
+*/
+void DiskImageResourceJPEG::read_level( ImageBuffer const& dest, BBox2i const& bbox, int32 level ) const
+{
+  Vector2i size = level_size( level );
+  VW_ASSERT( int(dest.format.cols)==bbox.width() && int(dest.format.rows)==bbox.height(),
+             ArgumentErr() << "DiskImageResourceJPEG (read) Error: Destination buffer has wrong dimensions!" );
+  VW_ASSERT( BBox2i(0,0,size.x(),size.y()).contains(bbox),
+             ArgumentErr() << "DiskImageResourceJPEG: bounding box " << bbox << " is outside level " << level << "." );
+
+  boost::shared_ptr<JpegIOStreamDecompress> d = m_reader->get( m_subsample_factor << level, bbox.min().y() );
+
+  const size_t line = d->line_bytes();
+  boost::scoped_array<uint8> buf( new uint8[line * bbox.height()] );
+  d->read_rows( buf.get(), line * bbox.height(), bbox.min().y(), bbox.height() );
+  m_reader->put( d );
+
+  // Set up an image buffer around the decoded rows, skipping the columns
+  // outside bbox.
   ImageBuffer src;
-  src.data = buf.get();
   src.format = m_format;
-
-  // The number of rows we're reading may be different, seeing as how we
-  // can read sequential lines.
   src.format.rows = bbox.height();
   src.format.cols = bbox.width();
-
-  // This is part of the grayscale optimization that we remove due to
-  // wonkiness on Linux.
-#if 0
-  if (dest.format.pixel_format == VW_PIXEL_GRAY)
-    src.format.pixel_format = VW_PIXEL_GRAY;
-#endif
-
-  src.cstride = ctx->cstride;
-  src.rstride = src.cstride * src.format.cols;
+  src.cstride = d->chan_bytes();
+  src.rstride = line;
   src.pstride = src.rstride * src.format.rows;
+  src.data = buf.get() + src.cstride * bbox.min().x();
   convert( dest, src, m_rescale );
-
-}
-
-void DiskImageResourceJPEG::read_reset() const {
-  ctx = boost::shared_ptr<DiskImageResourceJPEG::vw_jpeg_decompress_context>(new DiskImageResourceJPEG::vw_jpeg_decompress_context(const_cast<DiskImageResourceJPEG*>(this)));
 }
 
 // Write the given buffer into the disk image.
@@ -56,8 +56,20 @@ namespace vw {
     /// Returns the type of disk image resource.
     virtual std::string type() { return type_static(); }
 
+    /// Reads are streamed: only the rows of bbox are held in memory, and
+    /// a read that doesn't follow on from an earlier one starts decoding
+    /// at the nearest restart marker (if the file has them) rather than
+    /// at the top. Reads from several threads use separate decoders.
     virtual void read( ImageBuffer const& dest, BBox2i const& bbox ) const;
 
+    /// JPEG can decode at 1/2, 1/4 and 1/8 scale for little more than the
+    /// cost of entropy decoding, so those (relative to the subsample
+    /// factor) are offered as resolution levels 1 to 3.
+    virtual int32 num_levels() const;
+    virtual Vector2i level_size( int32 level ) const;
+    virtual Vector2i level_block_read_size( int32 level ) const;
+    virtual void read_level( ImageBuffer const& dest, BBox2i const& bbox, int32 level ) const;
+
     virtual void write( ImageBuffer const& dest, BBox2i const& bbox );
 
     virtual void flush();
@@ -99,13 +111,15 @@ namespace vw {
 
     virtual bool has_block_write()  const {return false;}
     virtual bool has_nodata_write() const {return false;}
-    virtual bool has_block_read()   const {return false;}
+    virtual bool has_block_read()   const {return true;}
     virtual bool has_nodata_read()  const {return false;}
 
+    /// Full-width strips of whole MCU rows, about default_tile_size tall
+    virtual Vector2i block_read_size() const;
+
   private:
-    // Forward declare an abstraction class that contains jpeg stuff.
-    class vw_jpeg_decompress_context;
-    friend class vw_jpeg_decompress_context;
+    // Forward declare the decoders, which need the jpeg headers.
+    class Reader;
 
     std::string m_filename;
     float m_quality;
@@ -114,23 +128,22 @@ namespace vw {
     void* m_jpg_compress_header;
     FILE* m_file_ptr;
     size_t m_byte_offset;
+    int32 m_mcu_rows;
 
     static int default_subsampling_factor;
     static float default_quality;
 
-    /* The decompression context. We can't use an auto_ptr here because
-     * vw_jpeg_decompress_context is forward-declared and the compiler
-     * will not see its destructor, which means its destructor won't
-     * actually get called :-( (See the compiler warnings when you try to
-     * use std::auto_ptr<> here.) Boost's shared_ptr class, however, does
-     * _not_ have this problem, and is perfectly safe to use in this case.
+    /* The decoders. We can't use an auto_ptr here because Reader is
+     * forward-declared and the compiler will not see its destructor, which
+     * means its destructor won't actually get called :-( (See the compiler
+     * warnings when you try to use std::auto_ptr<> here.) Boost's
+     * shared_ptr class, however, does _not_ have this problem, and is
+     * perfectly safe to use in this case.
     */
-    mutable boost::shared_ptr<vw_jpeg_decompress_context> ctx;
+    boost::shared_ptr<Reader> m_reader;
 
-    /* Resets the decompression context and current point in the file to
-     * the beginning.
-    */
-    void read_reset() const;
+    /* Rows in a read block at the given scale */
+    int32 strip_rows( int32 level ) const;
 
   };
 
@@ -66,6 +66,7 @@ namespace vw {
                                                 ImageFormat const& format );
 
     virtual bool has_block_write()  const {return true;}
+    virtual bool has_unordered_block_write() const {return m_tiled;}
     virtual bool has_nodata_write() const {return false;}
     virtual bool has_block_read()   const {return true;}
     virtual bool has_nodata_read()  const {return false;}
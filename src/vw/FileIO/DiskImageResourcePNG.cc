@@ -21,11 +21,16 @@
 #include <vw/FileIO/DiskImageResourcePNG.h>
 #include <vw/Core/FundamentalTypes.h>
 #include <vw/Core/Exception.h>
+#include <vw/Core/Settings.h>
+#include <vw/Core/ThreadPool.h>
 #include <vw/Image/Manipulation.h>
 
 #include <png.h>
+#include <zlib.h>
 #include <vector>
 #include <fstream>
+#include <cstring>
+#include <cstdlib>
 
 using namespace vw;
 
@@ -51,6 +56,232 @@ void DiskImageResourcePNG::set_default_compression_level( int level ) {
   default_compression_level = level;
 }
 
+/************************************************************************
+ ********************** PARALLEL DEFLATE WRITER *************************
+ **** The rows are filtered, then the filtered data is cut into chunks ***
+ **** that are deflated independently and stitched back together into ***
+ **** a single zlib stream. Each chunk is primed with the 32K preceding **
+ **** it, so the output is within a fraction of a percent of serial.  ****
+************************************************************************/
+
+namespace {
+
+  // Roughly how much filtered image data each deflate task gets
+  static const size_t PNG_CHUNK_BYTES = 256*1024;
+  static const size_t PNG_WINDOW_BYTES = 32*1024;
+  // Largest IDAT chunk we emit
+  static const size_t PNG_MAX_IDAT_BYTES = 1024*1024;
+
+  inline uint8 png_paeth(int a, int b, int c) {
+    int p = a + b - c;
+    int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+    if (pa <= pb && pa <= pc) return uint8(a);
+    if (pb <= pc) return uint8(b);
+    return uint8(c);
+  }
+
+  // Filters one row into out (len+1 bytes: filter type, then data). With
+  // adaptive set, this tries all five filters and keeps the one with the
+  // smallest sum of absolute differences, the same heuristic libpng uses.
+  void png_filter_row(const uint8* row, const uint8* prev, size_t len, size_t bpp,
+                      bool adaptive, uint8* out, std::vector<uint8>& scratch)
+  {
+    if (!adaptive) {
+      out[0] = 0;
+      std::copy(row, row+len, out+1);
+      return;
+    }
+
+    scratch.resize(5*len);
+    uint8 *f[5];
+    for (int t = 0; t < 5; ++t)
+      f[t] = &scratch[t*len];
+
+    for (size_t i = 0; i < len; ++i) {
+      int a = i >= bpp ? row[i-bpp]  : 0;
+      int b = prev[i];
+      int c = i >= bpp ? prev[i-bpp] : 0;
+      f[0][i] = row[i];
+      f[1][i] = uint8(row[i] - a);
+      f[2][i] = uint8(row[i] - b);
+      f[3][i] = uint8(row[i] - ((a + b) >> 1));
+      f[4][i] = uint8(row[i] - png_paeth(a, b, c));
+    }
+
+    int best = 0;
+    uint64 best_sum = 0;
+    for (int t = 0; t < 5; ++t) {
+      uint64 sum = 0;
+      for (size_t i = 0; i < len; ++i)
+        sum += f[t][i] < 128 ? f[t][i] : 256 - f[t][i];
+      if (t == 0 || sum < best_sum) {
+        best = t;
+        best_sum = sum;
+      }
+    }
+    out[0] = uint8(best);
+    std::copy(f[best], f[best]+len, out+1);
+  }
+
+  // Filters rows [begin,end) of an image into the matching slice of the
+  // filtered buffer, swapping 16-bit samples to network order on the way.
+  class PngFilterTask : public Task {
+      const uint8* m_image;
+      uint8* m_filtered;
+      size_t m_rowbytes, m_bpp, m_begin, m_end;
+      bool m_swap16, m_adaptive;
+
+      void load(size_t row, std::vector<uint8>& dst) const {
+        const uint8* src = m_image + row*m_rowbytes;
+        if (!m_swap16) {
+          std::copy(src, src+m_rowbytes, dst.begin());
+          return;
+        }
+        for (size_t i = 0; i+1 < m_rowbytes; i += 2) {
+          dst[i]   = src[i+1];
+          dst[i+1] = src[i];
+        }
+      }
+
+    public:
+      PngFilterTask(const uint8* image, uint8* filtered, size_t rowbytes, size_t bpp,
+                    size_t begin, size_t end, bool swap16, bool adaptive)
+        : m_image(image), m_filtered(filtered), m_rowbytes(rowbytes), m_bpp(bpp),
+          m_begin(begin), m_end(end), m_swap16(swap16), m_adaptive(adaptive) {}
+
+      void operator()() {
+        std::vector<uint8> cur(m_rowbytes), prev(m_rowbytes, 0), scratch;
+        if (m_begin > 0)
+          load(m_begin-1, prev);
+        for (size_t row = m_begin; row < m_end; ++row) {
+          load(row, cur);
+          png_filter_row(&cur[0], &prev[0], m_rowbytes, m_bpp, m_adaptive,
+                         m_filtered + row*(m_rowbytes+1), scratch);
+          cur.swap(prev);
+        }
+      }
+  };
+
+  // Deflates data[begin,end) as a raw deflate fragment. Every fragment but
+  // the last ends on a byte boundary (Z_SYNC_FLUSH) without setting the
+  // final-block bit, so the fragments can simply be concatenated.
+  class PngDeflateTask : public Task {
+      const uint8* m_data;
+      size_t m_begin, m_end;
+      int m_level, m_strategy;
+      bool m_last;
+
+    public:
+      std::vector<uint8> output;
+      uLong adler;
+      std::string error;
+
+      PngDeflateTask(const uint8* data, size_t begin, size_t end, int level, int strategy, bool last)
+        : m_data(data), m_begin(begin), m_end(end), m_level(level), m_strategy(strategy),
+          m_last(last), adler(0) {}
+
+      void operator()() {
+        adler = adler32(adler32(0, Z_NULL, 0), m_data + m_begin, uInt(m_end - m_begin));
+
+        z_stream strm;
+        std::memset(&strm, 0, sizeof(strm));
+        if (deflateInit2(&strm, m_level, Z_DEFLATED, -MAX_WBITS, 8, m_strategy) != Z_OK) {
+          error = "deflateInit2 failed";
+          return;
+        }
+
+        if (m_begin > 0) {
+          size_t dict = std::min(m_begin, PNG_WINDOW_BYTES);
+          deflateSetDictionary(&strm, m_data + m_begin - dict, uInt(dict));
+        }
+
+        output.resize(deflateBound(&strm, uLong(m_end - m_begin)) + 64);
+        strm.next_in   = const_cast<Bytef*>(m_data + m_begin);
+        strm.avail_in  = uInt(m_end - m_begin);
+
+        const int flush = m_last ? Z_FINISH : Z_SYNC_FLUSH;
+        size_t done = 0;
+        for (;;) {
+          if (done == output.size())
+            output.resize(output.size() * 2);
+          strm.next_out  = &output[done];
+          strm.avail_out = uInt(output.size() - done);
+          int ret = deflate(&strm, flush);
+          done = output.size() - strm.avail_out;
+          if (ret == Z_STREAM_ERROR) {
+            error = strm.msg ? strm.msg : "deflate failed";
+            break;
+          }
+          // A flush is only complete once deflate leaves output space unused
+          if (m_last ? ret == Z_STREAM_END : (strm.avail_in == 0 && strm.avail_out != 0))
+            break;
+        }
+
+        output.resize(done);
+        deflateEnd(&strm);
+      }
+  };
+
+  // zlib's header for a stream with no preset dictionary
+  void zlib_header(int level, std::vector<uint8>& out) {
+    int level_flags = level == Z_DEFAULT_COMPRESSION ? 2 : level < 2 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3;
+    uint32 header = (0x78 << 8) | (level_flags << 6);
+    header += 31 - (header % 31);
+    out.push_back(uint8(header >> 8));
+    out.push_back(uint8(header & 0xff));
+  }
+
+  // Builds the complete zlib stream for the image data. rows and rowbytes
+  // describe the (unfiltered) image in memory.
+  void png_parallel_deflate(const uint8* image, size_t rows, size_t rowbytes, size_t bpp,
+                            bool swap16, bool adaptive, int level, uint32 threads,
+                            std::vector<uint8>& zstream)
+  {
+    const size_t stride = rowbytes + 1;
+    std::vector<uint8> filtered(rows * stride);
+
+    // Whole rows per chunk
+    const size_t rows_per_chunk = std::max<size_t>(1, PNG_CHUNK_BYTES / stride);
+    const size_t chunks = (rows + rows_per_chunk - 1) / rows_per_chunk;
+
+    {
+      FifoWorkQueue queue(threads);
+      for (size_t c = 0; c < chunks; ++c)
+        queue.add_task(boost::shared_ptr<Task>(
+          new PngFilterTask(image, &filtered[0], rowbytes, bpp, c*rows_per_chunk,
+                            std::min(rows, (c+1)*rows_per_chunk), swap16, adaptive)));
+      queue.join_all();
+    }
+
+    std::vector<boost::shared_ptr<PngDeflateTask> > tasks(chunks);
+    {
+      FifoWorkQueue queue(threads);
+      for (size_t c = 0; c < chunks; ++c) {
+        tasks[c].reset(new PngDeflateTask(&filtered[0], c*rows_per_chunk*stride,
+                                          std::min(rows, (c+1)*rows_per_chunk)*stride,
+                                          level, adaptive ? Z_FILTERED : Z_DEFAULT_STRATEGY,
+                                          c+1 == chunks));
+        queue.add_task(tasks[c]);
+      }
+      queue.join_all();
+    }
+
+    zstream.clear();
+    zlib_header(level, zstream);
+    uLong adler = adler32(0, Z_NULL, 0);
+    for (size_t c = 0; c < chunks; ++c) {
+      PngDeflateTask const& t = *tasks[c];
+      if (!t.error.empty())
+        vw_throw(IOErr() << "DiskImageResourcePNG: " << t.error);
+      zstream.insert(zstream.end(), t.output.begin(), t.output.end());
+      adler = adler32_combine(adler, t.adler, z_off_t(std::min(rows, (c+1)*rows_per_chunk)*stride - c*rows_per_chunk*stride));
+    }
+    for (int shift = 24; shift >= 0; shift -= 8)
+      zstream.push_back(uint8(adler >> shift));
+  }
+
+} // anonymous namespace
+
 
 /************************************************************************
  ********************** PNG CONTEXT STRUCTURES **************************
@@ -448,6 +679,11 @@ struct DiskImageResourcePNG::vw_png_write_context:
     // Set up the scanline for writing.
     cstride = (bit_depth / 8) * channels;
 
+    // Interlaced and palette images always go through libpng
+    m_level = options.compression_level;
+    m_bit_depth = bit_depth;
+    m_parallel = !options.using_interlace && !options.using_palette;
+
     // Finally, write the info out.
     png_write_info(ctx.ptr, ctx.info);
 
@@ -465,6 +701,13 @@ struct DiskImageResourcePNG::vw_png_write_context:
   // to the file. Closing happens when the context is destroyed.
   void write(const ImageBuffer &buf) const
   {
+    const size_t rowbytes = size_t(cstride) * outer->m_format.cols;
+    const uint32 threads = vw_settings().default_num_threads();
+    if (m_parallel && threads > 1 && rowbytes * outer->m_format.rows > 2*PNG_CHUNK_BYTES) {
+      write_parallel(buf, rowbytes, threads);
+      return;
+    }
+
     boost::scoped_array<png_bytep> row_pointers( new png_bytep[outer->m_format.rows] );
 
     for(size_t i=0; i < outer->m_format.rows; i++)
@@ -475,6 +718,29 @@ struct DiskImageResourcePNG::vw_png_write_context:
   }
 
 private:
+  int m_level, m_bit_depth;
+  bool m_parallel;
+
+  // Compresses the image data on the thread pool and emits the IDAT and
+  // IEND chunks ourselves; libpng has already written everything before.
+  void write_parallel(const ImageBuffer &buf, size_t rowbytes, uint32 threads) const
+  {
+    bool swap16 = false;
+#   if VW_BYTE_ORDER == VW_LITTLE_ENDIAN
+      swap16 = (m_bit_depth == 16);
+#   endif
+
+    std::vector<uint8> zstream;
+    png_parallel_deflate(reinterpret_cast<const uint8*>(buf.data), outer->m_format.rows,
+                         rowbytes, cstride, swap16, m_level != 0, m_level, threads, zstream);
+
+    for (size_t i = 0; i < zstream.size(); i += PNG_MAX_IDAT_BYTES)
+      png_write_chunk(ctx.ptr, (png_bytep)"IDAT", &zstream[i],
+                      std::min(PNG_MAX_IDAT_BYTES, zstream.size() - i));
+    png_write_chunk(ctx.ptr, (png_bytep)"IEND", NULL, 0);
+    ctx.file->flush();
+  }
+
   // Function for libpng to use to write as we're not using FILE*.
   static void write_data( png_structp png_ptr, png_bytep data, png_size_t length )
   {
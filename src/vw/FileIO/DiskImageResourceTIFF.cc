@@ -17,13 +17,23 @@
 #endif
 
 #include <vector>
+#include <deque>
+#include <map>
 
 #include <tiffio.h>
+#include <zlib.h>
 
 #include <vw/Core/Exception.h>
 #include <vw/Core/Debugging.h>
+#include <vw/Core/Settings.h>
+#include <vw/Core/Thread.h>
+#include <vw/Core/ThreadPool.h>
 #include <vw/FileIO/DiskImageResourceTIFF.h>
 
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/tss.hpp>
+
 #ifndef VW_ERROR_BUFFER_SIZE
 #define VW_ERROR_BUFFER_SIZE 2048
 #endif
@@ -32,18 +42,530 @@
 #define snprintf _snprintf
 #endif
 
+/// Handle libTIFF warning conditions by outputting message text at the
+/// DebugMessage verbosity level.
+static void tiff_warning_handler(const char* module, const char* frmt, va_list ap) {
+  char msg[VW_ERROR_BUFFER_SIZE];
+  vsnprintf( msg, VW_ERROR_BUFFER_SIZE, frmt, ap );
+  vw::vw_out(vw::WarningMessage, "fileio") << "DiskImageResourceTIFF (" << (module?module:"none") << ") Warning: " << msg << std::endl;
+}
+
+/// Handle libTIFF error conditions by vw_throwing an IOErr with the
+/// message text.
+/*static void tiff_error_handler(const char* module, const char* frmt, va_list ap) {
+  char msg[VW_ERROR_BUFFER_SIZE];
+  vsnprintf( msg, VW_ERROR_BUFFER_SIZE, frmt, ap );
+  vw_throw( vw::IOErr() << "DiskImageResourceTIFF (" << (module?module:"none") << ") Error: " << msg );
+}
+*/
+
+// Handle libTIFF error conditions by writing the error and hope the calling
+// program checks the return value for the function
+//
+// The message is kept per thread, since several threads may be decoding at
+// once.
+static boost::thread_specific_ptr<std::string>& tiff_error_msg() {
+  static boost::thread_specific_ptr<std::string>* msg = new boost::thread_specific_ptr<std::string>();
+  return *msg;
+}
+
+static void tiff_error_handler(const char* module, const char* frmt, va_list ap) {
+  char msg[VW_ERROR_BUFFER_SIZE];
+  vsnprintf( msg, VW_ERROR_BUFFER_SIZE, frmt, ap );
+  if( !tiff_error_msg().get() )
+    tiff_error_msg().reset( new std::string );
+  *tiff_error_msg() = std::string("DiskImageResourceTIFF (") + (module?module:"none") + ") Error: " + msg;
+}
+
+static void tiff_check_retval(const int retval, const int error_val) {
+  if (retval == error_val) {
+    vw_throw( vw::IOErr() << "check_retval: " << (tiff_error_msg().get() ? *tiff_error_msg() : std::string()) );
+  }
+}
+
+// The strip (image width x rows per strip) or tile size of the current
+// directory
+static vw::Vector2i tiff_block_size(TIFF* tif, vw::int32 cols) {
+  if( TIFFIsTiled(tif) ) {
+    vw::uint32 tile_width, tile_length;
+    tiff_check_retval(TIFFGetField( tif, TIFFTAG_TILEWIDTH, &tile_width ), 0);
+    tiff_check_retval(TIFFGetField( tif, TIFFTAG_TILELENGTH, &tile_length ), 0);
+    return vw::Vector2i(tile_width,tile_length);
+  }
+  vw::uint32 rows_per_strip;
+  tiff_check_retval(TIFFGetField( tif, TIFFTAG_ROWSPERSTRIP, &rows_per_strip ), 0);
+  return vw::Vector2i(cols,rows_per_strip);
+}
+
+namespace {
+  using namespace vw;
+
+  // A complete strip or tile, held until its turn to go into the file.
+  // When the output is deflated it is also the task that compresses it,
+  // with zlib directly: that is exactly what libtiff's own deflate codec
+  // would store, and unlike libtiff's codecs it can run on any thread.
+  // Blocks for the other codecs never run, and are compressed by libtiff
+  // as they are written.
+  class TiffBlock : public Task {
+      TaskErrors& m_errors;
+    public:
+      std::vector<uint8> raw, encoded;
+
+      TiffBlock(TaskErrors& errors) : m_errors(errors) {}
+
+      void operator()() {
+        try {
+          uLongf len = compressBound(uLong(raw.size()));
+          encoded.resize(len);
+          if (compress2(&encoded[0], &len, &raw[0], uLong(raw.size()), Z_DEFAULT_COMPRESSION) != Z_OK)
+            vw_throw( IOErr() << "DiskImageResourceTIFF: deflate failed" );
+          encoded.resize(len);
+          std::vector<uint8>().swap(raw);
+        } catch (...) {
+          m_errors.capture();
+        }
+      }
+  };
+
+  // Collects writes into whole strips or tiles and writes each one once it
+  // is complete, in strip or tile order, so the file is laid out the same
+  // however the writes arrive. Deflated blocks are compressed on a thread
+  // pool in the meantime. Partially filled blocks are held until close,
+  // since libtiff can only write a block whole, and a complete block can't
+  // be written to again. Not thread safe; writes to a resource are
+  // serialized anyway.
+  class TiffBlockWriter : private boost::noncopyable {
+      struct Pending {
+        std::vector<uint8> data;
+        // Which pixels of the block have been written
+        std::vector<bool> covered;
+        int64 filled;
+        Pending() : filled(0) {}
+      };
+
+      TIFF* m_tif;
+      bool m_tiled;
+      Vector2i m_block_size, m_image_size;
+      int32 m_blocks_across, m_blocks_per_plane, m_planes;
+      uint32 m_num_blocks;
+      ImageFormat m_block_format;
+      size_t m_pixel_bytes;
+      bool m_deflate;
+
+      std::map<uint32, Pending> m_pending;
+      // Complete blocks not yet written; every block before m_next has been
+      std::map<uint32, boost::shared_ptr<TiffBlock> > m_complete;
+      uint32 m_next;
+      std::deque<boost::shared_ptr<TiffBlock> > m_deflating;
+      size_t m_max_deflating;
+      TaskErrors m_errors;
+      FifoWorkQueue m_queue;
+
+      BBox2i block_bbox(int32 bx, int32 by) const {
+        return BBox2i(bx*m_block_size.x(), by*m_block_size.y(), m_block_size.x(), m_block_size.y());
+      }
+
+      // The pixels of a block that lie in the image
+      BBox2i valid_bbox(uint32 id) const {
+        uint32 b = id % m_blocks_per_plane;
+        BBox2i box = block_bbox(b % m_blocks_across, b / m_blocks_across);
+        box.crop(BBox2i(0, 0, m_image_size.x(), m_image_size.y()));
+        return box;
+      }
+
+      // Bytes stored for a block: tiles are always whole, strips stop at
+      // the bottom of the image.
+      size_t block_bytes(uint32 id) const {
+        int32 rows = m_tiled ? m_block_size.y() : valid_bbox(id).height();
+        return size_t(m_block_size.x()) * rows * m_pixel_bytes;
+      }
+
+      bool complete(uint32 id) const {
+        return id < m_next || m_complete.count(id);
+      }
+
+      void dispatch(uint32 id) {
+        boost::shared_ptr<TiffBlock> block(new TiffBlock(m_errors));
+        std::map<uint32, Pending>::iterator p = m_pending.find(id);
+        if (p != m_pending.end()) {
+          block->raw.swap(p->second.data);
+          m_pending.erase(p);
+        }
+        block->raw.resize(block_bytes(id), 0);
+        m_complete[id] = block;
+
+        if (m_deflate) {
+          m_queue.add_task(block);
+          m_deflating.push_back(block);
+          while (m_deflating.size() > m_max_deflating) {
+            m_deflating.front()->join();
+            m_deflating.pop_front();
+          }
+          while (!m_deflating.empty() && m_deflating.front()->is_finished())
+            m_deflating.pop_front();
+        }
+        write_complete(false);
+      }
+
+      // Write out the complete blocks that are next in the file, waiting
+      // for them to be deflated if wait is set.
+      void write_complete(bool wait) {
+        std::map<uint32, boost::shared_ptr<TiffBlock> >::iterator next;
+        while ((next = m_complete.begin()) != m_complete.end() && next->first == m_next) {
+          TiffBlock& block = *next->second;
+          if (m_deflate) {
+            if (!wait && !block.is_finished())
+              break;
+            block.join();
+            m_errors.rethrow();
+            tsize_t size = tsize_t(block.encoded.size());
+            if (m_tiled)
+              tiff_check_retval(TIFFWriteRawTile(m_tif, m_next, &block.encoded[0], size), -1);
+            else
+              tiff_check_retval(TIFFWriteRawStrip(m_tif, m_next, &block.encoded[0], size), -1);
+          } else {
+            tsize_t size = tsize_t(block.raw.size());
+            if (m_tiled)
+              tiff_check_retval(TIFFWriteEncodedTile(m_tif, m_next, &block.raw[0], size), -1);
+            else
+              tiff_check_retval(TIFFWriteEncodedStrip(m_tif, m_next, &block.raw[0], size), -1);
+          }
+          m_complete.erase(next);
+          ++m_next;
+        }
+      }
+
+    public:
+      TiffBlockWriter(TIFF* tif, ImageFormat const& format, bool tiled, Vector2i const& block_size,
+                      DiskImageResourceTIFF::Compression compression)
+        : m_tif(tif), m_tiled(tiled), m_block_size(block_size),
+          m_image_size(format.cols, format.rows),
+          m_deflate(compression == DiskImageResourceTIFF::DEFLATE_COMPRESSION),
+          m_next(0), m_max_deflating(2 * vw_settings().default_num_threads())
+      {
+        m_blocks_across = (format.cols - 1) / block_size.x() + 1;
+        m_blocks_per_plane = m_blocks_across * ((format.rows - 1) / block_size.y() + 1);
+
+        // Scalar multi-plane images are stored one plane at a time
+        m_block_format = format;
+        m_block_format.cols = block_size.x();
+        m_block_format.rows = block_size.y();
+        m_planes = (format.pixel_format == VW_PIXEL_SCALAR) ? format.planes : 1;
+        m_block_format.planes = 1;
+        m_pixel_bytes = num_channels(format.pixel_format) * channel_size(format.channel_type);
+        m_num_blocks = m_planes * m_blocks_per_plane;
+      }
+
+      ~TiffBlockWriter() {
+        // Don't leave the workers deflating into blocks nobody will write
+        m_queue.join_all();
+      }
+
+      void write(ImageBuffer const& src, BBox2i const& bbox, bool rescale) {
+        const ssize_t block_rstride = m_block_size.x() * m_pixel_bytes;
+        const int32 bx0 = bbox.min().x() / m_block_size.x(), bx1 = (bbox.max().x()-1) / m_block_size.x();
+        const int32 by0 = bbox.min().y() / m_block_size.y(), by1 = (bbox.max().y()-1) / m_block_size.y();
+
+        for (int32 p = 0; p < m_planes; ++p)
+          for (int32 by = by0; by <= by1; ++by)
+            for (int32 bx = bx0; bx <= bx1; ++bx)
+              VW_ASSERT( !complete(p * m_blocks_per_plane + by * m_blocks_across + bx),
+                         ArgumentErr() << "DiskImageResourceTIFF: " << bbox << " overlaps a block that is "
+                                       << "already complete, and can't be written again." );
+
+        for (int32 p = 0; p < m_planes; ++p) {
+          ImageBuffer src_plane = src;
+          src_plane.data = (uint8*)src.data + p * src.pstride;
+          src_plane.format.planes = 1;
+
+          for (int32 by = by0; by <= by1; ++by) {
+            for (int32 bx = bx0; bx <= bx1; ++bx) {
+              const uint32 id = p * m_blocks_per_plane + by * m_blocks_across + bx;
+              const BBox2i block = block_bbox(bx, by);
+              BBox2i isect = block;
+              isect.crop(bbox);
+
+              Pending& pending = m_pending[id];
+              if (pending.data.empty()) {
+                pending.data.resize(size_t(m_block_size.x()) * m_block_size.y() * m_pixel_bytes, 0);
+                pending.covered.resize(size_t(m_block_size.x()) * m_block_size.y(), false);
+              }
+
+              ImageBuffer dst(m_block_format, &pending.data[0] + (isect.min().y() - block.min().y()) * block_rstride
+                                                                + (isect.min().x() - block.min().x()) * m_pixel_bytes);
+              dst.format.cols = isect.width();
+              dst.format.rows = isect.height();
+              dst.rstride = block_rstride;
+              dst.pstride = block_rstride * m_block_size.y();
+
+              ImageBuffer src_part = src_plane;
+              src_part.data = (uint8*)src_plane.data + (isect.min().y() - bbox.min().y()) * src.rstride
+                                                     + (isect.min().x() - bbox.min().x()) * src.cstride;
+              src_part.format.cols = isect.width();
+              src_part.format.rows = isect.height();
+
+              convert(dst, src_part, rescale);
+
+              // Count each pixel once, however many writes cover it
+              for (int32 y = isect.min().y(); y < isect.max().y(); ++y) {
+                size_t i = size_t(y - block.min().y()) * m_block_size.x() + (isect.min().x() - block.min().x());
+                for (int32 x = 0; x < isect.width(); ++x, ++i) {
+                  if (!pending.covered[i]) {
+                    pending.covered[i] = true;
+                    ++pending.filled;
+                  }
+                }
+              }
+              if (pending.filled == int64(valid_bbox(id).width()) * valid_bbox(id).height())
+                dispatch(id);
+            }
+          }
+        }
+      }
+
+      // Write out the complete blocks, as far as the file order allows:
+      // complete blocks after one that isn't stay buffered. Partial blocks
+      // stay pending, so later writes to them don't lose what came before.
+      void flush() {
+        write_complete(true);
+      }
+
+      // Write out every block, partially filled or not, zero-filling what
+      // was never written so the file has no empty strips or tiles.
+      void finish() {
+        for (uint32 id = m_next; id < m_num_blocks; ++id)
+          if (!m_complete.count(id))
+            dispatch(id);
+        write_complete(true);
+      }
+  };
+
+  // Geometry and buffers for decoding the blocks of one TIFF handle
+  class TiffBlockReader : private boost::noncopyable {
+      TIFF* m_tif;
+      ImageFormat m_format;
+      bool m_rescale;
+      uint16 m_nsamples, m_bpsample, m_photometric;
+      bool m_planar, m_tiled;
+      uint32 m_block_cols, m_block_rows, m_blocks_per_row, m_blocks_per_plane;
+      tdata_t m_buf, m_plane_buf, m_palette_buf;
+      uint16 *m_red_table, *m_green_table, *m_blue_table;
+
+      tdata_t alloc(tsize_t size) {
+        tdata_t p = _TIFFmalloc( size );
+        if( !p ) vw_throw( vw::IOErr() << "DiskImageResourceTIFF: Failed to malloc!" );
+        return p;
+      }
+
+      void read_encoded(uint32 block_id, tdata_t buf) {
+        if( m_tiled ) tiff_check_retval(TIFFReadEncodedTile( m_tif, block_id, buf, (tsize_t) -1 ), -1);
+        else tiff_check_retval(TIFFReadEncodedStrip( m_tif, block_id, buf, (tsize_t) -1 ), -1);
+      }
+
+    public:
+      TiffBlockReader(TIFF* tif, ImageFormat const& format, bool rescale)
+        : m_tif(tif), m_format(format), m_rescale(rescale), m_buf(0), m_plane_buf(0), m_palette_buf(0)
+      {
+        uint16 config = 0;
+        tiff_check_retval(TIFFGetField(m_tif, TIFFTAG_PLANARCONFIG, &config), 0);
+        tiff_check_retval(TIFFGetField(m_tif, TIFFTAG_BITSPERSAMPLE, &m_bpsample), 0);
+        tiff_check_retval(TIFFGetField(m_tif, TIFFTAG_SAMPLESPERPIXEL, &m_nsamples), 0);
+        tiff_check_retval(TIFFGetField(m_tif, TIFFTAG_PHOTOMETRIC, &m_photometric), 0);
+
+        m_planar = (config == PLANARCONFIG_SEPARATE) && (m_format.pixel_format != VW_PIXEL_SCALAR);
+        m_tiled = TIFFIsTiled(m_tif);
+
+        // Compute the tile or strip geometry
+        tsize_t block_size;
+        if( m_tiled ) {
+          tiff_check_retval(TIFFGetField(m_tif, TIFFTAG_TILEWIDTH, &m_block_cols), 0);
+          tiff_check_retval(TIFFGetField(m_tif, TIFFTAG_TILELENGTH, &m_block_rows), 0);
+          block_size = TIFFTileSize(m_tif);
+          m_blocks_per_row = (m_format.cols-1) / m_block_cols + 1;
+          m_blocks_per_plane = m_blocks_per_row * ( (m_format.rows-1) / m_block_rows + 1 );
+        }
+        else {
+          m_block_cols = m_format.cols;
+          tiff_check_retval(TIFFGetField( m_tif, TIFFTAG_ROWSPERSTRIP, &m_block_rows ), 0);
+          block_size = TIFFStripSize(m_tif);
+          m_blocks_per_row = 1;
+          m_blocks_per_plane = (m_format.rows-1) / m_block_rows + 1;
+        }
+
+        m_buf = alloc( block_size );
+
+        // Allocate a buffer interleave planar data
+        if( m_planar ) {
+          m_plane_buf = m_buf;
+          m_buf = alloc( block_size * m_nsamples );
+        }
+
+        // Palettized TIFFs are always uint16 RGB
+        if( m_photometric == PHOTOMETRIC_PALETTE ) {
+          m_palette_buf = m_buf;
+          m_buf = alloc( m_block_cols*m_block_rows*6 );
+          tiff_check_retval(TIFFGetField( m_tif, TIFFTAG_COLORMAP, &m_red_table, &m_green_table, &m_blue_table ), 0);
+        }
+      }
+
+      ~TiffBlockReader() {
+        if( m_buf ) _TIFFfree(m_buf);
+        if( m_plane_buf ) _TIFFfree(m_plane_buf);
+        if( m_palette_buf ) _TIFFfree(m_palette_buf);
+      }
+
+      Vector2i block_size() const { return Vector2i(m_block_cols, m_block_rows); }
+
+      // Decode the block at (block_x, block_y) and copy its overlap with bbox
+      // into dest, which covers bbox.
+      void read(int32 block_x, int32 block_y, ImageBuffer const& dest, BBox2i const& bbox) {
+        int block_id = block_y * m_blocks_per_row + block_x;
+        int data_left = (std::max)(block_x*m_block_cols,uint32(bbox.min().x()))-block_x*m_block_cols;
+        int data_top  = (std::max)(block_y*m_block_rows,uint32(bbox.min().y()))-block_y*m_block_rows;
+        int data_right = (std::min)((block_x+1)*m_block_cols,uint32(bbox.max().x()))-block_x*m_block_cols;
+        int data_bottom = (std::min)((block_y+1)*m_block_rows,uint32(bbox.max().y()))-block_y*m_block_rows;
+
+        // Read the block into the buffer, converting planar or palettized data as needed.
+        if( m_planar ) {
+          // At the moment we make an extra copy here to spoof plane contiguity
+          for( int i=0; i<m_nsamples; ++i ) {
+            read_encoded( block_id+i*m_blocks_per_plane, m_plane_buf );
+            // Oh man, this is horrible!
+            switch(m_bpsample/8) {
+            case 1:
+              for( int y=data_top; y<data_bottom; ++y ) {
+                for( int x=data_left; x<data_right; ++x ) {
+                  ((uint8*)m_buf)[(y*m_block_cols+x)*m_nsamples+i] = ((uint8*)m_plane_buf)[y*m_block_cols+x];
+                }
+              }
+              break;
+            case 2:
+              for( int y=data_top; y<data_bottom; ++y ) {
+                for( int x=data_left; x<data_right; ++x ) {
+                  ((uint16*)m_buf)[(y*m_block_cols+x)*m_nsamples+i] = ((uint16*)m_plane_buf)[y*m_block_cols+x];
+                }
+              }
+              break;
+            case 4:
+              for( int y=data_top; y<data_bottom; ++y ) {
+                for( int x=data_left; x<data_right; ++x ) {
+                  ((uint32*)m_buf)[(y*m_block_cols+x)*m_nsamples+i] = ((uint32*)m_plane_buf)[y*m_block_cols+x];
+                }
+              }
+              break;
+            default:
+              vw_throw( NoImplErr() << "Unsupported bit depth in separate-plane TIFF!" );
+            }
+          }
+        }
+        else if( m_photometric == PHOTOMETRIC_PALETTE ) {
+          read_encoded( block_id, m_palette_buf );
+          for( int y=data_top; y<data_bottom; ++y ) {
+            for( int x=data_left; x<data_right; ++x ) {
+              int i = y*m_block_cols + x;
+              int p = ((uint8*)m_palette_buf)[i];
+              ((uint16*)m_buf)[3*i+0] = m_red_table[p];
+              ((uint16*)m_buf)[3*i+1] = m_green_table[p];
+              ((uint16*)m_buf)[3*i+2] = m_blue_table[p];
+            }
+          }
+        }
+        else {
+          read_encoded( block_id, m_buf );
+        }
+
+        // Set up the source and destination image buffers
+        ImageBuffer src_buf, dest_buf=dest;
+        src_buf.format = m_format;
+        if( m_photometric == PHOTOMETRIC_PALETTE ) src_buf.cstride = 6;
+        else src_buf.cstride = m_bpsample * m_nsamples / 8;
+        src_buf.rstride = m_block_cols*src_buf.cstride;
+        src_buf.pstride = m_block_rows*src_buf.rstride;
+
+        src_buf.data = (uint8*)m_buf + data_left*src_buf.cstride + data_top*src_buf.rstride;
+        dest_buf.data = (uint8*)dest.data + (data_left+block_x*m_block_cols-bbox.min().x())*dest.cstride + (data_top+block_y*m_block_rows-bbox.min().y())*dest.rstride;
+        src_buf.format.cols = dest_buf.format.cols = data_right-data_left;
+        src_buf.format.rows = dest_buf.format.rows = data_bottom-data_top;
+
+        convert( dest_buf, src_buf, m_rescale );
+      }
+  };
+
+  // Decodes a run of blocks through a libtiff handle of its own
+  class TiffReadTask : public Task {
+      std::string m_filename;
+      int m_directory;
+      ImageFormat m_format;
+      bool m_rescale;
+      std::vector<Vector2i> m_blocks;
+      ImageBuffer m_dest;
+      BBox2i m_bbox;
+      TaskErrors& m_errors;
+    public:
+      TiffReadTask(std::string const& filename, int directory, ImageFormat const& format, bool rescale,
+                   std::vector<Vector2i> const& blocks, ImageBuffer const& dest, BBox2i const& bbox,
+                   TaskErrors& errors)
+        : m_filename(filename), m_directory(directory), m_format(format), m_rescale(rescale),
+          m_blocks(blocks), m_dest(dest), m_bbox(bbox), m_errors(errors) {}
+
+      void operator()() {
+        TIFF* tif = 0;
+        try {
+          tif = TIFFOpen(m_filename.c_str(), "r");
+          if (!tif)
+            vw_throw( IOErr() << "DiskImageResourceTIFF: Failed to open \"" << m_filename << "\" for reading!" );
+          if (m_directory != 0)
+            tiff_check_retval(TIFFSetDirectory(tif, m_directory), 0);
+          TiffBlockReader reader(tif, m_format, m_rescale);
+          for (size_t i = 0; i < m_blocks.size(); ++i)
+            reader.read(m_blocks[i].x(), m_blocks[i].y(), m_dest, m_bbox);
+        } catch (...) {
+          m_errors.capture();
+        }
+        if (tif)
+          TIFFClose(tif);
+      }
+  };
+
+} // anonymous namespace
+
 namespace vw {
   class DiskImageResourceInfoTIFF {
   public:
+    // One resolution level: the directory holding it, its size, and its
+    // strip or tile size
+    struct Level {
+      int directory;
+      Vector2i size, block_size;
+      Level(int directory, Vector2i const& size, Vector2i const& block_size)
+        : directory(directory), size(size), block_size(block_size) {}
+    };
+
     TIFF *tif;
     Vector2i block_size;
+    std::vector<Level> levels;
     std::string filename;
     int current_line;
     bool striped;
-
-    DiskImageResourceInfoTIFF() : tif(0), block_size(), current_line(0) {}
+    // Output layout, and the encoder once writing has started
+    bool tiled_write;
+    boost::scoped_ptr<TiffBlockWriter> writer;
+    // Threads to decode reads on (0 for the default), and the pool that
+    // does it, kept from one read to the next
+    uint32 read_threads;
+    boost::scoped_ptr<FifoWorkQueue> read_queue;
+
+    DiskImageResourceInfoTIFF() : tif(0), block_size(), current_line(0), striped(false), tiled_write(false), read_threads(0) {}
     ~DiskImageResourceInfoTIFF() {
-      close();
+      try {
+        close();
+      } catch (const vw::Exception& e) {
+        vw_out(ErrorMessage, "fileio") << "DiskImageResourceTIFF: failed to finish writing "
+                                       << filename << ": " << e.what() << std::endl;
+        writer.reset();
+        if (tif) TIFFClose(tif);
+        tif = NULL;
+      }
     }
 
     void reopen_read() {
@@ -54,6 +576,10 @@ namespace vw {
     }
 
     void close() {
+      if( writer ) {
+        writer->finish();
+        writer.reset();
+      }
       if( tif ) {
         TIFFClose(tif);
         tif=NULL;
@@ -62,39 +588,10 @@ namespace vw {
   };
 }
 
-/// Handle libTIFF warning conditions by outputting message text at the
-/// DebugMessage verbosity level.
-static void tiff_warning_handler(const char* module, const char* frmt, va_list ap) {
-  char msg[VW_ERROR_BUFFER_SIZE];
-  vsnprintf( msg, VW_ERROR_BUFFER_SIZE, frmt, ap );
-  vw::vw_out(vw::WarningMessage, "fileio") << "DiskImageResourceTIFF (" << (module?module:"none") << ") Warning: " << msg << std::endl;
-}
-
-/// Handle libTIFF error conditions by vw_throwing an IOErr with the
-/// message text.
-/*static void tiff_error_handler(const char* module, const char* frmt, va_list ap) {
-  char msg[VW_ERROR_BUFFER_SIZE];
-  vsnprintf( msg, VW_ERROR_BUFFER_SIZE, frmt, ap );
-  vw_throw( vw::IOErr() << "DiskImageResourceTIFF (" << (module?module:"none") << ") Error: " << msg );
-}
-*/
-
-// Handle libTIFF error conditions by writing the error and hope the calling
-// program checks the return value for the function
-static char tiff_error_msg[VW_ERROR_BUFFER_SIZE];
-static void tiff_error_handler(const char* module, const char* frmt, va_list ap) {
-  char msg[VW_ERROR_BUFFER_SIZE];
-  vsnprintf( msg, VW_ERROR_BUFFER_SIZE, frmt, ap );
-  snprintf( tiff_error_msg, VW_ERROR_BUFFER_SIZE,
-    "DiskImageResourceTIFF (%s) Error: %s",
-    (module?module:"none"), msg );
-}
-
-
 vw::DiskImageResourceTIFF::DiskImageResourceTIFF( std::string const& filename )
-  : DiskImageResource( filename ), m_info( new DiskImageResourceInfoTIFF() )
+  : DiskImageResource( filename ), m_info( new DiskImageResourceInfoTIFF() ),
+    m_compression( NO_COMPRESSION )
 {
-  m_use_compression = false;
   open( filename );
 }
 
@@ -102,15 +599,49 @@ vw::DiskImageResourceTIFF::DiskImageResourceTIFF( std::string const& filename,
                                                   vw::ImageFormat const& format,
                                                   bool use_compression )
   : DiskImageResource( filename ), m_info( new DiskImageResourceInfoTIFF() ),
-    m_use_compression( use_compression )
+    m_compression( use_compression ? LZW_COMPRESSION : NO_COMPRESSION )
 {
   create( filename, format );
 }
 
+vw::DiskImageResourceTIFF::~DiskImageResourceTIFF() {
+}
+
 vw::Vector2i vw::DiskImageResourceTIFF::block_read_size() const {
   return m_info->block_size;
 }
 
+vw::Vector2i vw::DiskImageResourceTIFF::block_write_size() const {
+  return m_info->block_size;
+}
+
+void vw::DiskImageResourceTIFF::set_block_write_size( Vector2i const& block_size ) {
+  VW_ASSERT( m_info->tif && !m_info->writer,
+             NoImplErr() << "DiskImageResourceTIFF: the block size can only be set before writing." );
+  VW_ASSERT( block_size.x() > 0 && block_size.y() > 0,
+             ArgumentErr() << "DiskImageResourceTIFF: invalid block size " << block_size );
+
+  if (block_size.x() == cols()) {
+    m_info->tiled_write = false;
+    m_info->block_size = block_size;
+  } else {
+    m_info->tiled_write = true;
+    m_info->block_size = Vector2i((block_size.x() + 15) / 16 * 16, (block_size.y() + 15) / 16 * 16);
+  }
+}
+
+void vw::DiskImageResourceTIFF::set_read_threads( uint32 threads ) {
+  if( threads != m_info->read_threads )
+    m_info->read_queue.reset();
+  m_info->read_threads = threads;
+}
+
+void vw::DiskImageResourceTIFF::set_compression( Compression c ) {
+  VW_ASSERT( !m_info->writer,
+             NoImplErr() << "DiskImageResourceTIFF: compression can only be set before writing." );
+  m_compression = c;
+}
+
 /// Bind the resource to a file for reading.  Confirm that we can open
 /// the file and that it has a sane pixel format.
 void vw::DiskImageResourceTIFF::open( std::string const& filename ) {
@@ -199,16 +730,35 @@ void vw::DiskImageResourceTIFF::open( std::string const& filename ) {
     }
   }
 
-  if( TIFFIsTiled(tif) ) {
-    uint32 tile_width, tile_length;
-    check_retval(TIFFGetField( tif, TIFFTAG_TILEWIDTH, &tile_width ), 0);
-    check_retval(TIFFGetField( tif, TIFFTAG_TILELENGTH, &tile_length ), 0);
-    m_info->block_size = Vector2i(tile_width,tile_length);
-  }
-  else {
-    uint32 rows_per_strip;
-    check_retval(TIFFGetField( tif, TIFFTAG_ROWSPERSTRIP, &rows_per_strip ), 0);
-    m_info->block_size = Vector2i(cols(),rows_per_strip);
+  m_info->block_size = tiff_block_size( tif, cols() );
+  m_info->levels.clear();
+  m_info->levels.push_back( DiskImageResourceInfoTIFF::Level( 0, Vector2i(cols(),rows()), m_info->block_size ) );
+
+  // Internal overviews (as written by gdaladdo) are the reduced resolution
+  // images that follow the main one. We only use the ones laid out like the
+  // main image, and each has to be smaller than the one before.
+  uint16 samples = 0;
+  check_retval(TIFFGetFieldDefaulted( tif, TIFFTAG_SAMPLESPERPIXEL, &samples ), 0);
+  for( int dir = 1; TIFFReadDirectory(tif); ++dir ) {
+    uint32 subfile_type = 0, level_cols = 0, level_rows = 0;
+    uint16 level_samples = 0, level_bits = 0, level_format = 0, level_photometric = 0, level_config = 0;
+    if( !TIFFGetField( tif, TIFFTAG_SUBFILETYPE, &subfile_type ) || !(subfile_type & FILETYPE_REDUCEDIMAGE) )
+      continue;
+    if( !TIFFGetField( tif, TIFFTAG_IMAGEWIDTH, &level_cols ) || !TIFFGetField( tif, TIFFTAG_IMAGELENGTH, &level_rows ) )
+      continue;
+    TIFFGetFieldDefaulted( tif, TIFFTAG_SAMPLESPERPIXEL, &level_samples );
+    TIFFGetFieldDefaulted( tif, TIFFTAG_BITSPERSAMPLE, &level_bits );
+    TIFFGetFieldDefaulted( tif, TIFFTAG_SAMPLEFORMAT, &level_format );
+    TIFFGetField( tif, TIFFTAG_PHOTOMETRIC, &level_photometric );
+    TIFFGetField( tif, TIFFTAG_PLANARCONFIG, &level_config );
+    if( level_samples != samples || level_bits != bits_per_sample || level_format != sample_format ||
+        level_photometric != photometric || level_config != plane_configuration )
+      continue;
+    Vector2i const& last = m_info->levels.back().size;
+    if( int32(level_cols) >= last.x() || int32(level_rows) >= last.y() )
+      continue;
+    m_info->levels.push_back( DiskImageResourceInfoTIFF::Level( dir, Vector2i(level_cols,level_rows),
+                                                                tiff_block_size( tif, level_cols ) ) );
   }
 
   TIFFClose(tif);
@@ -242,15 +792,10 @@ void vw::DiskImageResourceTIFF::create( std::string const& filename,
     check_retval(TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK), 0);
   }
 
-  check_retval(TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, 1), 0);
   check_retval(TIFFSetField(tif, TIFFTAG_RESOLUTIONUNIT, RESUNIT_INCH), 0);
   check_retval(TIFFSetField(tif, TIFFTAG_XRESOLUTION, 70.0), 0);
   check_retval(TIFFSetField(tif, TIFFTAG_YRESOLUTION, 70.0), 0);
 
-  if (m_use_compression) {
-    check_retval(TIFFSetField(tif, TIFFTAG_COMPRESSION,COMPRESSION_LZW), 0);
-  }
-
   switch (m_format.channel_type) {
   case VW_CHANNEL_INT8:
   case VW_CHANNEL_INT16:
@@ -285,196 +830,140 @@ void vw::DiskImageResourceTIFF::create( std::string const& filename,
     check_retval(TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, (uint16)num_channels(m_format.pixel_format)), 0);
   }
 
+  // The layout and compression are only committed on the first write, so
+  // they can still be changed until then.
   uint32 rows_per_strip = TIFFDefaultStripSize( tif, 0 );
-  check_retval(TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, rows_per_strip), 0);
   m_info->block_size = Vector2i(cols(),rows_per_strip);
+  m_info->tiled_write = false;
 
   m_info->tif = tif;
 }
 
-/// Read the disk image into the given buffer.
-void vw::DiskImageResourceTIFF::read( ImageBuffer const& dest, BBox2i const& bbox ) const
-{
-  VW_ASSERT( int(dest.format.cols)==bbox.width() && int(dest.format.rows)==bbox.height(),
-             ArgumentErr() << "DiskImageResourceTIFF (read) Error: Destination buffer has wrong dimensions!" );
-
-  // Only support sequential reading on striped TIFFs right now.
-  if( !m_info || !(m_info->tif) || !(m_info->striped) || (m_info->striped && m_info->current_line > bbox.min().y()) )
-    m_info->reopen_read();
+void vw::DiskImageResourceTIFF::start_writing() {
+  VW_ASSERT( m_info->tif, IOErr() << "DiskImageResourceTIFF: " << m_filename << " is not open for writing." );
+  TIFF* tif = m_info->tif;
 
-  uint16 config = 0, bpsample = 0, nsamples = 0, photometric = 0;
-  check_retval(TIFFGetField(m_info->tif, TIFFTAG_PLANARCONFIG, &config), 0);
-  check_retval(TIFFGetField(m_info->tif, TIFFTAG_BITSPERSAMPLE, &bpsample), 0);
-  check_retval(TIFFGetField(m_info->tif, TIFFTAG_SAMPLESPERPIXEL, &nsamples), 0);
-  check_retval(TIFFGetField(m_info->tif, TIFFTAG_PHOTOMETRIC, &photometric), 0);
-
-  bool is_planar = (config == PLANARCONFIG_SEPARATE) && (m_format.pixel_format != VW_PIXEL_SCALAR);
-  bool is_tiled = TIFFIsTiled(m_info->tif);
-  m_info->striped = !is_tiled;
-
-  // Compute the tile or strip geometry
-  uint32 block_cols, block_rows, block_size, blocks_per_row, blocks_per_plane;
-  if( is_tiled ) {
-    check_retval(TIFFGetField(m_info->tif, TIFFTAG_TILEWIDTH, &block_cols), 0);
-    check_retval(TIFFGetField(m_info->tif, TIFFTAG_TILELENGTH, &block_rows), 0);
-    block_size = TIFFTileSize(m_info->tif);
-    blocks_per_row = (cols()-1) / block_cols + 1;
-    blocks_per_plane = blocks_per_row * ( (rows()-1) / block_rows + 1 );
-  }
-  else {
-    block_cols = cols();
-    check_retval(TIFFGetField( m_info->tif, TIFFTAG_ROWSPERSTRIP, &block_rows ), 0);
-    block_size = TIFFStripSize(m_info->tif);
-    blocks_per_row = 1;
-    blocks_per_plane = (rows()-1) / block_rows + 1;
+  if (m_info->tiled_write) {
+    check_retval(TIFFSetField(tif, TIFFTAG_TILEWIDTH,  (uint32)m_info->block_size.x()), 0);
+    check_retval(TIFFSetField(tif, TIFFTAG_TILELENGTH, (uint32)m_info->block_size.y()), 0);
+  } else {
+    check_retval(TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, (uint32)m_info->block_size.y()), 0);
   }
 
-  tdata_t buf = _TIFFmalloc( block_size );
-  if( !buf ) vw_throw( vw::IOErr() << "DiskImageResourceTIFF: Failed to malloc!" );
-
-  // Allocate a buffer interleave planar data
-  tdata_t plane_buf = 0;
-  if( is_planar ) {
-    plane_buf = buf;
-    buf = _TIFFmalloc( block_size * nsamples );
-    if( !buf ) vw_throw( vw::IOErr() << "DiskImageResourceTIFF: Failed to malloc!" );
+  switch (m_compression) {
+  case NO_COMPRESSION:
+    check_retval(TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_NONE), 0);
+    break;
+  case LZW_COMPRESSION:
+    check_retval(TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_LZW), 0);
+    break;
+  case DEFLATE_COMPRESSION:
+    check_retval(TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_ADOBE_DEFLATE), 0);
+    break;
   }
 
-  // Palettized TIFFs are always uint16 RGB
-  tdata_t palette_buf = 0;
-  uint16 *red_table, *green_table, *blue_table;
-  if( photometric == PHOTOMETRIC_PALETTE ) {
-    palette_buf = buf;
-    buf = _TIFFmalloc( block_cols*block_rows*6 );
-    if( !buf ) vw_throw( vw::IOErr() << "DiskImageResourceTIFF: Failed to malloc!" );
+  m_info->writer.reset( new TiffBlockWriter(tif, m_format, m_info->tiled_write, m_info->block_size, m_compression) );
+}
 
-    check_retval(TIFFGetField( m_info->tif, TIFFTAG_COLORMAP, &red_table, &green_table, &blue_table ), 0);
-  }
+/// Read the disk image into the given buffer.
+void vw::DiskImageResourceTIFF::read( ImageBuffer const& dest, BBox2i const& bbox ) const
+{
+  read_level( dest, bbox, 0 );
+}
 
-  // Set up the source and destination image buffers
-  ImageBuffer src_buf, dest_buf=dest;
-  src_buf.format = m_format;
-  if( photometric == PHOTOMETRIC_PALETTE ) src_buf.cstride = 6;
-  else src_buf.cstride = bpsample * nsamples / 8;
-  src_buf.rstride = block_cols*src_buf.cstride;
-  src_buf.pstride = block_rows*src_buf.rstride;
-
-  for( int block_y = bbox.min().y()/block_rows; block_y <= int((bbox.max().y()-1)/block_rows); ++block_y ) {
-    for( int block_x = bbox.min().x()/block_cols; block_x <= int((bbox.max().x()-1)/block_cols); ++block_x ) {
-      int block_id = block_y * blocks_per_row + block_x;
-      int data_left = (std::max)(block_x*block_cols,uint32(bbox.min().x()))-block_x*block_cols;
-      int data_top  = (std::max)(block_y*block_rows,uint32(bbox.min().y()))-block_y*block_rows;
-      int data_right = (std::min)((block_x+1)*block_cols,uint32(bbox.max().x()))-block_x*block_cols;
-      int data_bottom = (std::min)((block_y+1)*block_rows,uint32(bbox.max().y()))-block_y*block_rows;
-
-      // Read the block into the buffer, converting planar or palettized data as needed.
-      if( is_planar ) {
-        // At the moment we make an extra copy here to spoof plane contiguity
-        for( int i=0; i<nsamples; ++i ) {
-          if( is_tiled ) check_retval(TIFFReadEncodedTile( m_info->tif, block_id+i*blocks_per_plane, plane_buf, (tsize_t) -1 ), -1);
-          else check_retval(TIFFReadEncodedStrip( m_info->tif, block_id+i*blocks_per_plane, plane_buf, (tsize_t) -1 ), 0);
-          // Oh man, this is horrible!
-          switch(bpsample/8) {
-          case 1:
-            for( int y=data_top; y<data_bottom; ++y ) {
-              for( int x=data_left; x<data_right; ++x ) {
-                ((uint8*)buf)[(y*block_cols+x)*nsamples+i] = ((uint8*)plane_buf)[y*block_cols+x];
-              }
-            }
-            break;
-          case 2:
-            for( int y=data_top; y<data_bottom; ++y ) {
-              for( int x=data_left; x<data_right; ++x ) {
-                ((uint16*)buf)[(y*block_cols+x)*nsamples+i] = ((uint16*)plane_buf)[y*block_cols+x];
-              }
-            }
-            break;
-          case 4:
-            for( int y=data_top; y<data_bottom; ++y ) {
-              for( int x=data_left; x<data_right; ++x ) {
-                ((uint32*)buf)[(y*block_cols+x)*nsamples+i] = ((uint32*)plane_buf)[y*block_cols+x];
-              }
-            }
-            break;
-          default:
-            vw_throw( NoImplErr() << "Unsupported bit depth in separate-plane TIFF!" );
-          }
-        }
-      }
-      else if( photometric == PHOTOMETRIC_PALETTE ) {
-        if( is_tiled ) check_retval(TIFFReadEncodedTile( m_info->tif, block_id, palette_buf, (tsize_t) -1 ), -1);
-        else check_retval(TIFFReadEncodedStrip( m_info->tif, block_id, palette_buf, (tsize_t) -1 ), 0);
-        if( photometric == PHOTOMETRIC_PALETTE ) {
-          for( int y=data_top; y<data_bottom; ++y ) {
-            for( int x=data_left; x<data_right; ++x ) {
-              int i = y*block_cols + x;
-              int p = ((uint8*)palette_buf)[i];
-              ((uint16*)buf)[3*i+0] = red_table[p];
-              ((uint16*)buf)[3*i+1] = green_table[p];
-              ((uint16*)buf)[3*i+2] = blue_table[p];
-            }
-          }
-        }
-      }
-      else {
-        if( is_tiled )  {
-          check_retval(TIFFReadEncodedTile( m_info->tif, block_id, buf, (tsize_t) -1 ), -1);
-        } else {
-          check_retval(TIFFReadEncodedStrip( m_info->tif, block_id, buf, (tsize_t) -1 ), -1);
-          m_info->current_line++;
-        }
-      }
+vw::int32 vw::DiskImageResourceTIFF::num_levels() const {
+  return m_info->levels.empty() ? 1 : int32(m_info->levels.size());
+}
 
-      src_buf.data = (uint8*)buf + data_left*src_buf.cstride + data_top*src_buf.rstride;
-      dest_buf.data = (uint8*)dest.data + (data_left+block_x*block_cols-bbox.min().x())*dest.cstride + (data_top+block_y*block_rows-bbox.min().y())*dest.rstride;
-      src_buf.format.cols = dest_buf.format.cols = data_right-data_left;
-      src_buf.format.rows = dest_buf.format.rows = data_bottom-data_top;
+vw::Vector2i vw::DiskImageResourceTIFF::level_size( int32 level ) const {
+  if( level == 0 ) return Vector2i( cols(), rows() );
+  VW_ASSERT( level > 0 && level < num_levels(),
+             ArgumentErr() << "DiskImageResourceTIFF: " << m_filename << " has no resolution level " << level << "." );
+  return m_info->levels[level].size;
+}
 
-      convert( dest_buf, src_buf, m_rescale );
-    }
+vw::Vector2i vw::DiskImageResourceTIFF::level_block_read_size( int32 level ) const {
+  if( level == 0 ) return block_read_size();
+  VW_ASSERT( level > 0 && level < num_levels(),
+             ArgumentErr() << "DiskImageResourceTIFF: " << m_filename << " has no resolution level " << level << "." );
+  return m_info->levels[level].block_size;
+}
 
+/// Read part of a resolution level into the given buffer.
+void vw::DiskImageResourceTIFF::read_level( ImageBuffer const& dest, BBox2i const& bbox, int32 level ) const
+{
+  VW_ASSERT( int(dest.format.cols)==bbox.width() && int(dest.format.rows)==bbox.height(),
+             ArgumentErr() << "DiskImageResourceTIFF (read) Error: Destination buffer has wrong dimensions!" );
+
+  ImageFormat format = m_format;
+  int directory = 0;
+  if( level != 0 ) {
+    Vector2i size = level_size( level );
+    format.cols = size.x();
+    format.rows = size.y();
+    directory = m_info->levels[level].directory;
   }
 
-  _TIFFfree(buf);
-  if( plane_buf ) _TIFFfree(plane_buf);
-  if( palette_buf ) _TIFFfree(palette_buf);
+  // Only support sequential reading on striped TIFFs right now.
+  if( !m_info || !(m_info->tif) || !(m_info->striped) || (m_info->striped && m_info->current_line > bbox.min().y()) )
+    m_info->reopen_read();
+  if( directory != 0 )
+    check_retval(TIFFSetDirectory( m_info->tif, directory ), 0);
+  m_info->striped = !TIFFIsTiled(m_info->tif);
+
+  std::vector<Vector2i> blocks;
+  uint32 threads = m_info->read_threads ? m_info->read_threads : vw_settings().default_num_threads();
+  {
+    TiffBlockReader reader( m_info->tif, format, m_rescale );
+    Vector2i block_size = reader.block_size();
+    for( int block_y = bbox.min().y()/block_size.y(); block_y <= int((bbox.max().y()-1)/block_size.y()); ++block_y )
+      for( int block_x = bbox.min().x()/block_size.x(); block_x <= int((bbox.max().x()-1)/block_size.x()); ++block_x )
+        blocks.push_back( Vector2i(block_x, block_y) );
+
+    threads = (std::min)( uint32(blocks.size()), threads );
+    if( threads <= 1 ) {
+      for( size_t i = 0; i < blocks.size(); ++i )
+        reader.read( blocks[i].x(), blocks[i].y(), dest, bbox );
+    }
+  }
   // Sorry .. this keeps us from incrementally reading
   m_info->close();
+  if( threads <= 1 )
+    return;
+
+  // libtiff handles can't be shared between threads, so each task decodes
+  // a contiguous run of blocks through a handle of its own.
+  if( !m_info->read_queue )
+    m_info->read_queue.reset( new FifoWorkQueue( m_info->read_threads ? m_info->read_threads : vw_settings().default_num_threads() ) );
+  TaskErrors errors;
+  for( uint32 t = 0; t < threads; ++t ) {
+    std::vector<Vector2i> run( blocks.begin() + blocks.size() * t / threads,
+                               blocks.begin() + blocks.size() * (t+1) / threads );
+    m_info->read_queue->add_task( boost::shared_ptr<Task>( new TiffReadTask( m_info->filename, directory, format, m_rescale, run, dest, bbox, errors ) ) );
+  }
+  m_info->read_queue->join_all();
+  errors.rethrow();
 }
 
 // Write the given buffer into the disk image.
 void vw::DiskImageResourceTIFF::write( ImageBuffer const& src, BBox2i const& bbox )
 {
-  VW_ASSERT(bbox.width() == m_format.cols,
-            ArgumentErr() << "DiskImageResourceTIFF: bounding box must be the same width as image.\n");
-
-  // Allocate some buffer memory for the output data
-  uint32 scanline_size = num_channels(m_format.pixel_format) * channel_size(m_format.channel_type) * m_format.cols;
-  tdata_t buf = _TIFFmalloc(scanline_size);
-  if( !buf ) vw_throw( vw::IOErr() << "DiskImageResourceTIFF: Failed to malloc!" );
-
-  // Set up the image buffer and convert the data into this buffer.
-  ImageBuffer dst(m_format, buf);
-
-  ImageBuffer src_plane = src;
-  src_plane.format.rows = 1;
-  src_plane.format.planes = 1;
-  dst.format.rows = 1;
-  dst.format.planes = 1;
-
-  // Write the image data to disk.
-  for (int32 p = 0; p < m_format.planes; p++) {
-    ImageBuffer src_row = src_plane;
-    for (int32 row = 0; row < bbox.height(); row++) {
-      convert( dst, src_row, m_rescale );
-      check_retval(TIFFWriteScanline(m_info->tif, (uint8*)buf, bbox.min()[1]+row, p), -1);
-      src_row.data = (uint8*)src_row.data + src_row.rstride;
-    }
-    src_plane.data = (uint8*)src_plane.data + src_plane.pstride;
-  }
+  VW_ASSERT( int(src.format.cols)==bbox.width() && int(src.format.rows)==bbox.height(),
+             ArgumentErr() << "DiskImageResourceTIFF: source buffer has wrong dimensions." );
+  VW_ASSERT( BBox2i(0,0,cols(),rows()).contains(bbox),
+             ArgumentErr() << "DiskImageResourceTIFF: bounding box " << bbox << " is outside the image." );
+
+  if( !m_info->writer )
+    start_writing();
+  m_info->writer->write( src, bbox, m_rescale );
+}
 
-  // Clean up
-  _TIFFfree(buf);
+void vw::DiskImageResourceTIFF::flush() {
+  if( !m_info->writer )
+    return;
+  // No TIFFFlush here: it would write out the directory and end the image,
+  // and the partial blocks are still to come.
+  m_info->writer->flush();
 }
 
 // A FileIO hook to open a file for reading
@@ -491,8 +980,6 @@ vw::DiskImageResource* vw::DiskImageResourceTIFF::construct_create( std::string
 // Helper routine for TIFF functions to check their return values and throw
 // if there was an error.
 void vw::DiskImageResourceTIFF::check_retval(const int retval, const int error_val) const {
-  if (retval == error_val) {
-    vw_throw( vw::IOErr() << "check_retval: " << tiff_error_msg );
-  }
+  tiff_check_retval(retval, error_val);
 }
 
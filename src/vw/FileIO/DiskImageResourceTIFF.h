@@ -9,6 +9,15 @@
 ///
 /// Provides support for TIFF image files.
 ///
+/// Writes are collected into whole strips (or tiles, after
+/// set_block_write_size()), and each one is written once it is complete,
+/// in strip or tile order. Deflated blocks are compressed on a thread pool
+/// while they wait. Reads that span several blocks decode them in
+/// parallel (see set_read_threads()), each thread with its own libtiff
+/// handle.
+/// Internal overviews are exposed as resolution levels (see
+/// DiskImageResource::read_level()).
+///
 #ifndef __VW_FILEIO_DISKIMAGERESOUCETIFF_H__
 #define __VW_FILEIO_DISKIMAGERESOUCETIFF_H__
 
@@ -23,13 +32,19 @@ namespace vw {
   class DiskImageResourceTIFF : public DiskImageResource {
   public:
 
+    enum Compression {
+      NO_COMPRESSION,
+      LZW_COMPRESSION,
+      DEFLATE_COMPRESSION
+    };
+
     DiskImageResourceTIFF( std::string const& filename );
 
     DiskImageResourceTIFF( std::string const& filename,
                            ImageFormat const& format,
                            bool use_compression = false );
 
-    virtual ~DiskImageResourceTIFF() {}
+    virtual ~DiskImageResourceTIFF();
 
     /// Returns the type of disk image resource.
     static std::string type_static() { return "TIFF"; }
@@ -37,17 +52,45 @@ namespace vw {
     /// Returns the type of disk image resource.
     virtual std::string type() { return type_static(); }
 
-    virtual bool has_block_write()  const {return false;}
+    virtual bool has_block_write()  const {return true;}
+    virtual bool has_unordered_block_write() const {return true;}
     virtual bool has_nodata_write() const {return false;}
     virtual bool has_block_read()   const {return true;}
     virtual bool has_nodata_read()  const {return false;}
 
     virtual Vector2i block_read_size() const;
 
+    /// The strip (cols x rows per strip) or tile size of the output file.
+    virtual Vector2i block_write_size() const;
+
+    /// Choose the output layout. A block as wide as the image keeps the file
+    /// striped with that many rows per strip; anything else makes it tiled,
+    /// with the tile size rounded up to a multiple of 16 as TIFF requires.
+    /// Must be called before the first write().
+    virtual void set_block_write_size(const Vector2i& block_size);
+
     virtual void read( ImageBuffer const& buf, BBox2i const& bbox ) const;
 
+    /// Level 0 is the main image; the levels after it are the reduced
+    /// resolution images (e.g. from gdaladdo) stored in the same file.
+    virtual int32 num_levels() const;
+    virtual Vector2i level_size( int32 level ) const;
+    virtual Vector2i level_block_read_size( int32 level ) const;
+    virtual void read_level( ImageBuffer const& buf, BBox2i const& bbox, int32 level ) const;
+
+    /// Write part of the image. The bbox need not line up with the blocks
+    /// of the file, and writes may overlap until a block is complete: it
+    /// is written out once all of its pixels have been, and can't be
+    /// written to after that. Blocks left partial are written out (padded
+    /// with zeros) when the resource is destroyed. Complete blocks wait in
+    /// memory until every block before them in the file is complete.
     virtual void write( ImageBuffer const& dest, BBox2i const& bbox );
 
+    /// Wait for the completed blocks to be compressed and written, as far
+    /// as the file order allows. Partially written blocks are kept until
+    /// the resource is closed.
+    virtual void flush();
+
     void open( std::string const& filename );
 
     void create( std::string const& filename,
@@ -58,14 +101,27 @@ namespace vw {
     static DiskImageResource* construct_create( std::string const& filename,
                                                 ImageFormat const& format );
 
-    void use_lzw_compression(bool state) { m_use_compression = state; }
+    /// Set the compression of the output file. Must be called before the
+    /// first write().
+    void set_compression(Compression c);
+    void use_lzw_compression(bool state) { set_compression(state ? LZW_COMPRESSION : NO_COMPRESSION); }
+
+    /// Decode reads that span several blocks on up to this many threads,
+    /// from a pool kept for the life of the resource. Zero (the default)
+    /// means the system default. Callers that already read from many
+    /// threads at once should set 1.
+    void set_read_threads(uint32 threads);
 
   protected:
     void check_retval(const int retval, const int error_val) const;
 
   private:
     boost::shared_ptr<DiskImageResourceInfoTIFF> m_info;
-    bool m_use_compression;
+    Compression m_compression;
+
+    // Commits the output layout and compression to the file and starts the
+    // block encoder.
+    void start_writing();
   };
 
 } // namespace vw
@@ -34,8 +34,15 @@ namespace vw {
     // the block rasterize view simplifies construction and access
     // to the underlying resource.
     boost::shared_ptr<DiskImageResource> m_rsrc;
+    int32 m_level;
     impl_type m_impl;
 
+    static boost::shared_ptr<SrcImageResource> level_resource( boost::shared_ptr<DiskImageResource> rsrc, int32 level ) {
+      if ( level == 0 )
+        return rsrc;
+      return boost::shared_ptr<SrcImageResource>( new DiskImageResourceLevel( rsrc, level ) );
+    }
+
   public:
     typedef typename impl_type::pixel_type pixel_type;
     typedef typename impl_type::result_type result_type;
@@ -44,24 +51,38 @@ namespace vw {
     /// Constructs a DiskImageView of the given file on disk
     /// using the specified cache area. NULL cache means skip it.
     DiskImageView( std::string const& filename, Cache* cache = &vw_system_cache() )
-      : m_rsrc( DiskImageResource::open( filename ) ), m_impl( boost::shared_ptr<SrcImageResource>(m_rsrc), m_rsrc->block_read_size(), 1, cache ) {}
+      : m_rsrc( DiskImageResource::open( filename ) ), m_level( 0 ), m_impl( boost::shared_ptr<SrcImageResource>(m_rsrc), m_rsrc->block_read_size(), 1, cache ) {}
 
     /// Constructs a DiskImageView of the given resource using the
     /// specified cache area.
     DiskImageView( boost::shared_ptr<DiskImageResource> resource, Cache* cache = &vw_system_cache())
-      : m_rsrc( resource ), m_impl( boost::shared_ptr<SrcImageResource>(m_rsrc), m_rsrc->block_read_size(), 1, cache ) {}
+      : m_rsrc( resource ), m_level( 0 ), m_impl( boost::shared_ptr<SrcImageResource>(m_rsrc), m_rsrc->block_read_size(), 1, cache ) {}
 
     /// Constructs a DiskImageView of the given resource using the
     /// specified cache area.  Takes ownership of the resource object
     /// (i.e. deletes it when it's done using it).
     DiskImageView( DiskImageResource *resource, Cache* cache = &vw_system_cache() )
-      : m_rsrc( resource ), m_impl( boost::shared_ptr<SrcImageResource>(m_rsrc), m_rsrc->block_read_size(), 1, cache ) {}
+      : m_rsrc( resource ), m_level( 0 ), m_impl( boost::shared_ptr<SrcImageResource>(m_rsrc), m_rsrc->block_read_size(), 1, cache ) {}
 
     /// Constructs a DiskImageView of the given resource using the specified
     /// cache area. Does not take ownership, you must ensure resource stays
     /// valid for the lifetime of DiskImageView
     DiskImageView( DiskImageResource &resource, Cache* cache = &vw_system_cache() )
-      : m_rsrc( &resource, NOP() ), m_impl( boost::shared_ptr<SrcImageResource>(m_rsrc), m_rsrc->block_read_size(), 1, cache ) {}
+      : m_rsrc( &resource, NOP() ), m_level( 0 ), m_impl( boost::shared_ptr<SrcImageResource>(m_rsrc), m_rsrc->block_read_size(), 1, cache ) {}
+
+    /// Constructs a DiskImageView of one resolution level of the given
+    /// file (see DiskImageResource::num_levels()) using the specified
+    /// cache area. Only that level is read from disk, so this is the
+    /// cheap way to get a preview or the top of an image pyramid.
+    DiskImageView( std::string const& filename, int32 level, Cache* cache )
+      : m_rsrc( DiskImageResource::open( filename ) ), m_level( level ),
+        m_impl( level_resource(m_rsrc, level), m_rsrc->level_block_read_size(level), 1, cache ) {}
+
+    /// Constructs a DiskImageView of one resolution level of the given
+    /// resource using the specified cache area.
+    DiskImageView( boost::shared_ptr<DiskImageResource> resource, int32 level, Cache* cache )
+      : m_rsrc( resource ), m_level( level ),
+        m_impl( level_resource(m_rsrc, level), m_rsrc->level_block_read_size(level), 1, cache ) {}
 
     ~DiskImageView() {}
 
@@ -78,6 +99,9 @@ namespace vw {
 
     std::string filename() const { return m_rsrc->filename(); }
 
+    /// The resolution level of the file this view reads from.
+    int32 level() const { return m_level; }
+
   };
 
 
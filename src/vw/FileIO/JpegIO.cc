@@ -9,6 +9,9 @@
 #include <vw/Core/Exception.h>
 #include <vw/Core/Log.h>
 
+#include <cstring>
+#include <memory>
+
 static void vw_jpeg_error_exit(j_common_ptr cinfo) {
   char buffer[JMSG_LENGTH_MAX];
   (*cinfo->err->format_message)(cinfo, buffer);
@@ -64,37 +67,42 @@ void JpegIODecompress::read(uint8* buffer, size_t bufsize) {
   jpeg_finish_decompress(&m_ctx);
 }
 
-void JpegIODecompress::open() {
-  bind();
-  jpeg_read_header(&m_ctx, TRUE);
-  jpeg_calc_output_dimensions(&m_ctx);
-
-  m_fmt.cols = m_ctx.output_width;
-  m_fmt.rows = m_ctx.output_height;
-  m_fmt.channel_type = VW_CHANNEL_UINT8;
+// Fill in a format from the output parameters of a decompressor
+static void jpeg_output_format(const jpeg_decompress_struct& ctx, ImageFormat& fmt) {
+  fmt.cols = ctx.output_width;
+  fmt.rows = ctx.output_height;
+  fmt.channel_type = VW_CHANNEL_UINT8;
 
-  switch (m_ctx.output_components)
+  switch (ctx.output_components)
   {
     case 1:
-      m_fmt.pixel_format = VW_PIXEL_GRAY;
-      m_fmt.planes=1;
+      fmt.pixel_format = VW_PIXEL_GRAY;
+      fmt.planes=1;
       break;
     case 2:
-      m_fmt.pixel_format = VW_PIXEL_GRAYA;
-      m_fmt.planes=1;
+      fmt.pixel_format = VW_PIXEL_GRAYA;
+      fmt.planes=1;
       break;
     case 3:
-      m_fmt.pixel_format = VW_PIXEL_RGB;
-      m_fmt.planes=1;
+      fmt.pixel_format = VW_PIXEL_RGB;
+      fmt.planes=1;
       break;
     case 4:
-      m_fmt.pixel_format = VW_PIXEL_RGBA;
-      m_fmt.planes=1; break;
+      fmt.pixel_format = VW_PIXEL_RGBA;
+      fmt.planes=1; break;
     default:
-      m_fmt.planes = m_ctx.output_components;
-      m_fmt.pixel_format = VW_PIXEL_SCALAR;
+      fmt.planes = ctx.output_components;
+      fmt.pixel_format = VW_PIXEL_SCALAR;
       break;
   }
+}
+
+void JpegIODecompress::open() {
+  bind();
+  jpeg_read_header(&m_ctx, TRUE);
+  jpeg_calc_output_dimensions(&m_ctx);
+
+  jpeg_output_format(m_ctx, m_fmt);
 
   m_cstride = m_ctx.output_components;
   m_rstride = m_cstride * m_fmt.cols;
@@ -169,6 +177,422 @@ void JpegIOCompress::open() {
   jpeg_set_quality(&m_ctx, 95, TRUE); // XXX Make this settable
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// Random access sources
+////////////////////////////////////////////////////////////////////////////////
+JpegFileSource::JpegFileSource(const std::string& filename, size_t byte_offset)
+  : m_byte_offset(byte_offset)
+{
+  m_file = fopen(filename.c_str(), "rb");
+  if (!m_file)
+    vw_throw( ArgumentErr() << "Failed to open \"" << filename << "\" using libJPEG." );
+}
+
+JpegFileSource::~JpegFileSource() {
+  fclose(m_file);
+}
+
+size_t JpegFileSource::read(size_t offset, uint8* buffer, size_t len) const {
+  Mutex::Lock lock(m_mutex);
+  if (fseek(m_file, long(m_byte_offset + offset), SEEK_SET) != 0)
+    return 0;
+  return fread(buffer, 1, len, m_file);
+}
+
+size_t JpegMemorySource::read(size_t offset, uint8* buffer, size_t len) const {
+  if (offset >= m_size)
+    return 0;
+  len = std::min(len, m_size - offset);
+  std::memcpy(buffer, m_data + offset, len);
+  return len;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Restart marker index
+////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+  // Marker codes we need to recognize (see jdmarker.c)
+  enum {
+    M_SOF0 = 0xc0, M_SOF1 = 0xc1, M_DHT = 0xc4, M_SOF15 = 0xcf,
+    M_RST0 = 0xd0, M_RST7 = 0xd7, M_SOI = 0xd8, M_EOI = 0xd9,
+    M_SOS  = 0xda, M_DRI = 0xdd
+  };
+
+  // Buffered forward reader over a JpegSource
+  class SourceReader {
+      const JpegSource& m_src;
+      std::vector<uint8> m_buf;
+      size_t m_base, m_pos, m_len;
+
+      bool fill() {
+        m_base += m_len;
+        m_pos = 0;
+        m_len = m_src.read(m_base, &m_buf[0], m_buf.size());
+        return m_len > 0;
+      }
+    public:
+      SourceReader(const JpegSource& src) : m_src(src), m_buf(1 << 16), m_base(0), m_pos(0), m_len(0) {}
+
+      size_t offset() const { return m_base + m_pos; }
+
+      // The next byte, or -1 at the end
+      int get() {
+        if (m_pos == m_len && !fill())
+          return -1;
+        return m_buf[m_pos++];
+      }
+
+      bool get16(uint32& v) {
+        int a = get(), b = get();
+        v = uint32(a) << 8 | uint32(b);
+        return a >= 0 && b >= 0;
+      }
+
+      void skip_to(size_t offset) {
+        while (this->offset() < offset) {
+          if (m_pos == m_len && !fill())
+            return;
+          m_pos += std::min(offset - this->offset(), m_len - m_pos);
+        }
+      }
+
+      // Move to the next 0xFF byte. False at the end.
+      bool find_ff() {
+        while (true) {
+          if (m_pos == m_len && !fill())
+            return false;
+          const uint8* p = reinterpret_cast<const uint8*>(std::memchr(&m_buf[m_pos], 0xFF, m_len - m_pos));
+          if (p) {
+            m_pos = p - &m_buf[0];
+            return true;
+          }
+          m_pos = m_len;
+        }
+      }
+  };
+}
+
+boost::shared_ptr<const JpegRestartIndex> JpegRestartIndex::build(const JpegSource& src) {
+  typedef boost::shared_ptr<const JpegRestartIndex> Ptr;
+  boost::shared_ptr<JpegRestartIndex> idx(new JpegRestartIndex());
+  SourceReader in(src);
+
+  if (in.get() != 0xFF || in.get() != M_SOI)
+    return Ptr();
+
+  // Walk the header markers up to the start of the scan
+  uint32 restart_interval = 0, width = 0, hmax = 1, vmax = 1;
+  int components = 0;
+  bool have_frame = false;
+  while (true) {
+    int c = in.get();
+    if (c != 0xFF)
+      return Ptr();
+    while (c == 0xFF)
+      c = in.get();
+
+    uint32 len;
+    if (c < 0 || !in.get16(len) || len < 2)
+      return Ptr();
+    const size_t end = in.offset() + len - 2;
+
+    if (c == M_SOF0 || c == M_SOF1) {
+      in.get(); // precision
+      idx->height_offset = in.offset();
+      if (!in.get16(idx->rows) || !in.get16(width))
+        return Ptr();
+      components = in.get();
+      for (int i = 0; i < components; ++i) {
+        in.get();
+        int hv = in.get();
+        in.get();
+        if (hv < 0)
+          return Ptr();
+        hmax = std::max(hmax, uint32(hv >> 4));
+        vmax = std::max(vmax, uint32(hv & 15));
+      }
+      have_frame = true;
+    } else if (c > M_SOF1 && c <= M_SOF15 && c != M_DHT) {
+      // Progressive, lossless or arithmetic coded
+      return Ptr();
+    } else if (c == M_DRI) {
+      if (!in.get16(restart_interval))
+        return Ptr();
+    } else if (c == M_SOS) {
+      // Every component has to be in this one scan
+      if (!have_frame || in.get() != components)
+        return Ptr();
+      in.skip_to(end);
+      break;
+    } else if (c == M_EOI) {
+      return Ptr();
+    }
+    in.skip_to(end);
+  }
+
+  // A height of 0 means it is given by a DNL marker after the scan
+  if (restart_interval == 0 || idx->rows == 0 || width == 0 || components <= 0)
+    return Ptr();
+
+  const size_t header_size = in.offset();
+  idx->header.resize(header_size);
+  for (size_t done = 0, n; done < header_size; done += n)
+    if ((n = src.read(done, &idx->header[done], header_size - done)) == 0)
+      return Ptr();
+
+  // A scan with one component is not interleaved, and its MCU is one block
+  const uint32 mcu_cols = components > 1 ? 8 * hmax : 8;
+  idx->mcu_rows = components > 1 ? 8 * vmax : 8;
+  const uint32 mcus_across = (width + mcu_cols - 1) / mcu_cols;
+  idx->entries.resize((idx->rows + idx->mcu_rows - 1) / idx->mcu_rows);
+
+  // Find the restart markers. The nth comes after n * restart_interval MCUs.
+  uint32 markers = 0;
+  bool found = false;
+  while (in.find_ff()) {
+    int c = in.get();
+    while (c == 0xFF)
+      c = in.get();
+    if (c == 0)
+      continue;                  // a stuffed 0xFF data byte
+    if (c < M_RST0 || c > M_RST7)
+      break;
+
+    ++markers;
+    uint64 mcu = uint64(markers) * restart_interval;
+    if (mcu % mcus_across == 0 && mcu / mcus_across < idx->entries.size()) {
+      Entry& e = idx->entries[size_t(mcu / mcus_across)];
+      e.offset = in.offset();
+      e.markers = markers;
+      found = true;
+    }
+  }
+
+  return found ? Ptr(idx) : Ptr();
+}
+
+uint32 JpegRestartIndex::entry_before(uint32 mcu_row) const {
+  for (uint32 r = std::min<uint32>(mcu_row, uint32(entries.size()) - 1); r > 0; --r)
+    if (entries[r].offset)
+      return r;
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Streaming decompress
+////////////////////////////////////////////////////////////////////////////////
+
+// Feeds libjpeg from a JpegSource. When decoding is restarted partway down
+// the image, the header is handed over first, then the data from the restart
+// marker on, with the marker numbers shifted so they count up from RST0 the
+// way the decoder expects at the start of a scan.
+struct JpegIOStreamDecompress::SourceMgr {
+  jpeg_source_mgr pub;
+  const JpegSource* src;
+  const std::vector<uint8>* header;
+  size_t offset;
+  int shift;
+  bool last_ff;
+  std::vector<uint8> buf;
+
+  SourceMgr() : src(0), header(0), offset(0), shift(0), last_ff(false), buf(1 << 16) {
+    pub.init_source       = &SourceMgr::init_source;
+    pub.fill_input_buffer = &SourceMgr::fill_input_buffer;
+    pub.skip_input_data   = &SourceMgr::skip_input_data;
+    pub.resync_to_restart = ::jpeg_resync_to_restart;
+    pub.term_source       = &SourceMgr::term_source;
+  }
+
+  void reset(const JpegSource* s, const std::vector<uint8>* h, size_t start, int renumber) {
+    src = s;
+    header = h;
+    offset = start;
+    shift = renumber;
+    last_ff = false;
+    pub.bytes_in_buffer = 0;
+    pub.next_input_byte = 0;
+  }
+
+  static SourceMgr* self(j_decompress_ptr cinfo) { return reinterpret_cast<SourceMgr*>(cinfo->src); }
+
+  static void init_source(j_decompress_ptr /*cinfo*/) {/* no work */}
+  static void term_source(j_decompress_ptr /*cinfo*/) {/* no work */}
+
+  void fix_marker(uint8& b) const {
+    if (b >= M_RST0 && b <= M_RST7)
+      b = uint8(M_RST0 + (b - M_RST0 + 8 - shift) % 8);
+  }
+
+  void renumber(uint8* p, size_t n) {
+    uint8* end = p + n;
+    if (last_ff)
+      fix_marker(*p);
+    last_ff = false;
+    while ((p = reinterpret_cast<uint8*>(std::memchr(p, 0xFF, end - p))) != 0) {
+      while (p < end && *p == 0xFF)
+        ++p;
+      if (p == end) {
+        last_ff = true;
+        break;
+      }
+      fix_marker(*p);
+    }
+  }
+
+  static ::boolean fill_input_buffer(j_decompress_ptr cinfo) {
+    SourceMgr* m = self(cinfo);
+    if (m->header) {
+      m->pub.next_input_byte = &(*m->header)[0];
+      m->pub.bytes_in_buffer = m->header->size();
+      m->header = 0;
+      return TRUE;
+    }
+
+    size_t n = m->src->read(m->offset, &m->buf[0], m->buf.size());
+    if (n == 0)
+      vw_throw(IOErr() << "Damaged JPEG. No EOI? Cannot continue.");
+    m->offset += n;
+    if (m->shift)
+      m->renumber(&m->buf[0], n);
+
+    m->pub.next_input_byte = &m->buf[0];
+    m->pub.bytes_in_buffer = n;
+    return TRUE;
+  }
+
+  static void skip_input_data(j_decompress_ptr cinfo, long num_bytes_l) {
+    if (num_bytes_l <= 0)
+      return;
+    SourceMgr* m = self(cinfo);
+    size_t num_bytes = num_bytes_l;
+    while (num_bytes > m->pub.bytes_in_buffer) {
+      num_bytes -= m->pub.bytes_in_buffer;
+      m->pub.bytes_in_buffer = 0;
+      if (!m->header) {
+        // Skip straight over the source bytes
+        m->offset += num_bytes;
+        m->last_ff = false;
+        return;
+      }
+      fill_input_buffer(cinfo);
+    }
+    m->pub.next_input_byte += num_bytes;
+    m->pub.bytes_in_buffer -= num_bytes;
+  }
+};
+
+JpegIOStreamDecompress::JpegIOStreamDecompress(boost::shared_ptr<const JpegSource> src, int scale_denom)
+  : m_src(src), m_scale(scale_denom), m_srcmgr(new SourceMgr()), m_started(false), m_row(0)
+{
+  VW_ASSERT(src, ArgumentErr() << "JpegIOStreamDecompress: Expected a non-null source");
+  VW_ASSERT(scale_denom == 1 || scale_denom == 2 || scale_denom == 4 || scale_denom == 8,
+            ArgumentErr() << "JpegIOStreamDecompress: scale must be 1, 2, 4, or 8");
+  init_base(&m_ctx.err);
+  jpeg_create_decompress(&m_ctx);
+}
+
+JpegIOStreamDecompress::~JpegIOStreamDecompress() {
+  jpeg_destroy_decompress(&m_ctx);
+}
+
+void JpegIOStreamDecompress::bind() {
+  m_srcmgr->reset(m_src.get(), 0, 0, 0);
+  m_ctx.src = &m_srcmgr->pub;
+}
+
+void JpegIOStreamDecompress::open() {
+  bind();
+  jpeg_read_header(&m_ctx, TRUE);
+  m_ctx.scale_num = 1;
+  m_ctx.scale_denom = m_scale;
+  jpeg_calc_output_dimensions(&m_ctx);
+
+  jpeg_output_format(m_ctx, m_fmt);
+
+  m_cstride = m_ctx.output_components;
+  m_rstride = m_cstride * m_fmt.cols;
+  m_line.resize(m_rstride);
+}
+
+bool JpegIOStreamDecompress::ready() const {
+  return true;
+}
+
+size_t JpegIOStreamDecompress::mcu_rows() const {
+  return (m_ctx.num_components > 1 ? m_ctx.max_v_samp_factor : 1) * DCTSIZE / m_scale;
+}
+
+void JpegIOStreamDecompress::start_at(uint32 mcu_row) {
+  jpeg_abort_decompress(&m_ctx);
+
+  if (mcu_row == 0)
+    bind();
+  else {
+    // Tell the decoder the image starts at this MCU row, so it handles the
+    // bottom edge the same way as it would decoding the whole thing.
+    const JpegRestartIndex::Entry& e = m_index->entries[mcu_row];
+    const uint32 rows = m_index->rows - mcu_row * m_index->mcu_rows;
+    m_header = m_index->header;
+    m_header[m_index->height_offset]   = uint8(rows >> 8);
+    m_header[m_index->height_offset+1] = uint8(rows & 0xFF);
+    m_srcmgr->reset(m_src.get(), &m_header, e.offset, e.markers % 8);
+    m_ctx.src = &m_srcmgr->pub;
+  }
+
+  jpeg_read_header(&m_ctx, TRUE);
+  m_ctx.scale_num = 1;
+  m_ctx.scale_denom = m_scale;
+  jpeg_start_decompress(&m_ctx);
+  VW_ASSERT(m_ctx.output_width == m_fmt.cols, IOErr() << "JpegIOStreamDecompress: restarted at the wrong place");
+
+  m_started = true;
+  m_row = mcu_row ? mcu_row * m_index->mcu_rows / m_scale : 0;
+}
+
+void JpegIOStreamDecompress::read_rows(uint8* buffer, size_t bufsize, size_t row, size_t lines) {
+  VW_ASSERT(row + lines <= size_t(m_fmt.rows), ArgumentErr() << "JpegIOStreamDecompress: rows out of range");
+  VW_ASSERT(bufsize >= lines * line_bytes(), LogicErr() << "Buffer is too small");
+  if (lines == 0)
+    return;
+
+  // Start an MCU row early where we can, so the upsampler sees the same
+  // rows above the ones we want as it would decoding from the top.
+  uint32 entry = 0;
+  size_t entry_row = 0;
+  if (m_index) {
+    uint32 target = uint32(row * m_scale / m_index->mcu_rows);
+    if (target > 0)
+      entry = m_index->entry_before(target - 1);
+    entry_row = entry * m_index->mcu_rows / m_scale;
+  }
+
+  if (!m_started || m_row > row || entry_row > m_row)
+    start_at(entry);
+
+  JSAMPROW line = &m_line[0];
+  for (; m_row < row; ++m_row)
+    if (jpeg_read_scanlines(&m_ctx, &line, 1) != 1)
+      vw_throw(IOErr() << "JpegIOStreamDecompress: decoding stopped early");
+
+  for (size_t i = 0; i < lines; ++i, ++m_row) {
+    line = buffer + i * line_bytes();
+    if (jpeg_read_scanlines(&m_ctx, &line, 1) != 1)
+      vw_throw(IOErr() << "JpegIOStreamDecompress: decoding stopped early");
+  }
+}
+
+void JpegIOStreamDecompress::read(uint8* buffer, size_t bufsize) {
+  read_rows(buffer, bufsize, 0, m_fmt.rows);
+}
+
+JpegIOStreamDecompress* JpegIOStreamDecompress::rewind() const {
+  std::auto_ptr<JpegIOStreamDecompress> r(new JpegIOStreamDecompress(m_src, m_scale));
+  r->set_index(m_index);
+  r->open();
+  return r.release();
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Src/Dest Helpers
 ////////////////////////////////////////////////////////////////////////////////
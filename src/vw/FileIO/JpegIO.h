@@ -9,6 +9,13 @@
 #define __VW_FILEIO_JPEGIO_H__
 
 #include <vw/FileIO/ScanlineIO.h>
+#include <vw/Core/Features.h>
+#include <vw/Core/Thread.h>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <vector>
+#include <cstdio>
 
 extern "C" {
 #include <jpeglib.h>
@@ -59,6 +66,103 @@ class JpegIOCompress : public JpegIO, public ScanlineWriteBackend {
     void write(const uint8* buffer, size_t bufsize, size_t rows, size_t cols, size_t planes);
 };
 
+// Random access to the compressed bytes of a JPEG, wherever they live.
+class JpegSource {
+  public:
+    virtual ~JpegSource() {}
+    // Copy up to len bytes starting at offset (counted from the start of the
+    // JPEG). Returns how many were copied; 0 means the end was reached.
+    virtual size_t read(size_t offset, uint8* buffer, size_t len) const = 0;
+};
+
+class JpegFileSource : public JpegSource {
+    FILE* m_file;
+    size_t m_byte_offset;
+    mutable Mutex m_mutex;
+  public:
+    // The JPEG starts byte_offset bytes into the file
+    JpegFileSource(const std::string& filename, size_t byte_offset = 0);
+    ~JpegFileSource();
+    size_t read(size_t offset, uint8* buffer, size_t len) const;
+};
+
+class JpegMemorySource : public JpegSource {
+    const uint8* m_data;
+    size_t m_size;
+  public:
+    // The caller keeps the buffer alive
+    JpegMemorySource(const uint8* data, size_t size) : m_data(data), m_size(size) {}
+    size_t read(size_t offset, uint8* buffer, size_t len) const;
+};
+
+// Where the restart markers of a baseline JPEG line up with the start of an
+// MCU row, decoding can begin there rather than at the top of the image. This
+// records those places. Only single-scan sequential Huffman files with a
+// restart interval can be indexed.
+class JpegRestartIndex {
+  public:
+    struct Entry {
+      size_t offset;   // first byte of entropy-coded data after the marker
+      uint32 markers;  // restart markers that came before it
+      Entry() : offset(0), markers(0) {}
+    };
+
+    // Returns 0 if the JPEG can't be indexed (or has no useful entries)
+    static boost::shared_ptr<const JpegRestartIndex> build(const JpegSource& src);
+
+    // The header, up to the start of the entropy-coded data
+    std::vector<uint8> header;
+    // Position of the image height in the header
+    size_t height_offset;
+    uint32 rows, mcu_rows;  // full-resolution image rows, and rows in an MCU row
+    // One per MCU row; offset is 0 where no marker starts that row
+    std::vector<Entry> entries;
+
+    // The last indexed MCU row at or before mcu_row (0 if none)
+    uint32 entry_before(uint32 mcu_row) const;
+};
+
+// A JPEG reader that decodes a range of rows at a time, holding only a
+// line's worth of decoded data. It moves forward by decoding and discarding
+// lines; to go back (or to jump far ahead) it restarts from the top, or from
+// the nearest restart marker if it has been given an index.
+class JpegIOStreamDecompress : public JpegIO, public ScanlineReadBackend {
+    struct SourceMgr;
+
+    boost::shared_ptr<const JpegSource> m_src;
+    boost::shared_ptr<const JpegRestartIndex> m_index;
+    int m_scale;
+    jpeg_decompress_struct m_ctx;
+    boost::scoped_ptr<SourceMgr> m_srcmgr;
+    std::vector<uint8> m_header, m_line;
+    bool m_started;
+    size_t m_row;
+
+    // Begin decoding at an MCU row (from the index, or 0)
+    void start_at(uint32 mcu_row);
+  protected:
+    void bind();
+  public:
+    // scale_denom is the libjpeg output scale: 1, 2, 4 or 8
+    JpegIOStreamDecompress(boost::shared_ptr<const JpegSource> src, int scale_denom = 1);
+    virtual ~JpegIOStreamDecompress();
+
+    void open();
+    bool ready() const;
+    void read(uint8* buffer, size_t bufsize);
+    void read_rows(uint8* buffer, size_t bufsize, size_t row, size_t lines);
+    JpegIOStreamDecompress* rewind() const VW_WARN_UNUSED;
+
+    void set_index(boost::shared_ptr<const JpegRestartIndex> index) { m_index = index; }
+    int scale() const { return m_scale; }
+
+    // The row the next decoded line belongs to
+    size_t next_row() const { return m_started ? m_row : 0; }
+
+    // Output rows decoded together; reads aligned to this waste the least
+    size_t mcu_rows() const;
+};
+
 void jpeg_ptr_src(j_decompress_ptr cinfo, const uint8* buffer, size_t size);
 void jpeg_vector_dest(j_compress_ptr cinfo, std::vector<uint8>* v);
 
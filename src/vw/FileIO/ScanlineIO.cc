@@ -6,6 +6,7 @@
 
 
 #include <vw/FileIO/ScanlineIO.h>
+#include <vw/Core/Exception.h>
 
 namespace vw { namespace fileio { namespace detail {
 
@@ -16,4 +17,8 @@ const ImageFormat& ScanlineBackend::fmt() const {
 size_t ScanlineBackend::chan_bytes() const { return m_cstride; }
 size_t ScanlineReadBackend::line_bytes() const { return m_rstride; }
 
+void ScanlineReadBackend::read_rows(uint8* /*buffer*/, size_t /*bufsize*/, size_t /*row*/, size_t /*lines*/) {
+  vw_throw(NoImplErr() << "This reader cannot read a range of rows");
+}
+
 }}} // vw::fileio::detail
@@ -48,6 +48,10 @@ class ScanlineReadBackend : public ScanlineBackend {
     // lines * sizeof(uint8) bytes
     virtual void read(uint8* buffer, size_t bufsize) = 0;
 
+    // decode rows [row, row+lines) into buffer, which must hold
+    // line_bytes() * lines bytes. Not every backend can do this.
+    virtual void read_rows(uint8* buffer, size_t bufsize, size_t row, size_t lines);
+
     // Rewind to allow another read. Might be a noop if it's not necessary.
     virtual ScanlineReadBackend* rewind() const = 0;
 };
@@ -14,6 +14,13 @@
 #include <vw/config.h>
 #include <test/Helpers.h>
 
+#if defined(VW_HAVE_PKG_TIFF) && VW_HAVE_PKG_TIFF==1
+#include <tiffio.h>
+#endif
+#if defined(VW_HAVE_PKG_JPEG) && VW_HAVE_PKG_JPEG==1
+#include <vw/FileIO/JpegIO.h>
+#endif
+
 using namespace vw;
 using namespace vw::internal;
 using namespace vw::test;
@@ -188,6 +195,182 @@ typedef WriteReadImage<PixelRGB<float>, 1> WriteReadImageRGBF32TIF;
 TEST_F( WriteReadImageRGBF32TIF, RGB_F32_TIF ) {}
 #endif
 
+// Big enough to take the threaded paths, with some noise so the encoders
+// have something to chew on.
+template <class PixelT>
+static ImageView<PixelT> noisy_image(int32 cols, int32 rows) {
+  ImageView<PixelT> img(cols, rows);
+  typedef typename CompoundChannelType<PixelT>::type ChannelT;
+  uint32 seed = 42;
+  for (int32 y = 0; y < rows; ++y)
+    for (int32 x = 0; x < cols; ++x)
+      for (uint32 c = 0; c < PixelNumChannels<PixelT>::value; ++c) {
+        seed = seed * 1103515245 + 12345;
+        compound_select_channel<ChannelT&>(img(x,y), c) = ChannelT(x + 3*y + 50*c + ((seed >> 16) & 7));
+      }
+  return img;
+}
+
+#if defined(VW_HAVE_PKG_TIFF) && VW_HAVE_PKG_TIFF==1
+TEST( DiskImageResource, TIFFBlockWrite ) {
+  const uint32 old_threads = vw_settings().default_num_threads();
+  vw_settings().set_default_num_threads(4);
+
+  ImageView<PixelRGB<uint8> > img = noisy_image<PixelRGB<uint8> >(301, 257);
+
+  const DiskImageResourceTIFF::Compression modes[] = {DiskImageResourceTIFF::NO_COMPRESSION,
+                                                      DiskImageResourceTIFF::LZW_COMPRESSION,
+                                                      DiskImageResourceTIFF::DEFLATE_COMPRESSION};
+  for (int m = 0; m < 3; ++m) {
+    for (int tiled = 0; tiled < 2; ++tiled) {
+      UnlinkName fn("blockwrite.tif");
+      {
+        DiskImageResourceTIFF r(fn, img.format());
+        r.set_compression(modes[m]);
+        if (tiled) {
+          r.set_block_write_size(Vector2i(50, 50));
+          EXPECT_VECTOR_EQ(Vector2i(64, 64), r.block_write_size());
+        }
+        block_write_image(r, img);
+      }
+
+      DiskImageResourceTIFF r(fn);
+      if (tiled)
+        EXPECT_VECTOR_EQ(Vector2i(64, 64), r.block_read_size());
+      else
+        EXPECT_EQ(img.cols(), r.block_read_size().x());
+
+      ImageView<PixelRGB<uint8> > img2;
+      read_image(img2, r);
+      ASSERT_EQ(img.cols(), img2.cols());
+      ASSERT_EQ(img.rows(), img2.rows());
+      EXPECT_SEQ_EQ(img, img2) << "compression " << m << " tiled " << tiled;
+    }
+  }
+
+  // Writes that don't line up with the tiles, in no particular order
+  {
+    UnlinkName fn("unaligned.tif");
+    {
+      DiskImageResourceTIFF r(fn, img.format());
+      r.set_compression(DiskImageResourceTIFF::LZW_COMPRESSION);
+      r.set_block_write_size(Vector2i(32, 32));
+      const BBox2i boxes[] = {BBox2i(100, 0, 201, 257), BBox2i(0, 100, 100, 157), BBox2i(0, 0, 100, 100)};
+      for (int i = 0; i < 3; ++i) {
+        ImageView<PixelRGB<uint8> > part = crop(img, boxes[i]);
+        r.write(part.buffer(), boxes[i]);
+      }
+    }
+    ImageView<PixelRGB<uint8> > img2;
+    read_image(img2, fn);
+    EXPECT_SEQ_EQ(img, img2);
+
+    // The tiles still go into the file in order
+    TIFF* tif = TIFFOpen(fn.c_str(), "r");
+    ASSERT_TRUE(tif != NULL);
+    toff_t* offsets = 0;
+    ASSERT_EQ(1, TIFFGetField(tif, TIFFTAG_TILEOFFSETS, &offsets));
+    for (ttile_t t = 1; t < TIFFNumberOfTiles(tif); ++t)
+      EXPECT_LT(offsets[t-1], offsets[t]) << "tile " << t;
+    TIFFClose(tif);
+  }
+
+  vw_settings().set_default_num_threads(old_threads);
+}
+
+TEST( DiskImageResource, TIFFOverlappingWrite ) {
+  ImageView<PixelGray<uint8> > img = noisy_image<PixelGray<uint8> >(64, 32);
+  UnlinkName fn("overlapping.tif");
+  {
+    DiskImageResourceTIFF r(fn, img.format());
+    r.set_compression(DiskImageResourceTIFF::DEFLATE_COMPRESSION);
+    r.set_block_write_size(Vector2i(32, 32));
+
+    // Together these cover more than a tile's worth of pixels, but not
+    // the whole first tile, which has to wait for the last one.
+    const BBox2i boxes[] = {BBox2i(0, 0, 20, 32), BBox2i(10, 0, 20, 32), BBox2i(30, 0, 34, 32)};
+    for (int i = 0; i < 3; ++i) {
+      ImageView<PixelGray<uint8> > part = crop(img, boxes[i]);
+      r.write(part.buffer(), boxes[i]);
+    }
+
+    // Both tiles are complete now
+    ImageView<PixelGray<uint8> > part = crop(img, BBox2i(30, 0, 4, 4));
+    EXPECT_THROW(r.write(part.buffer(), BBox2i(30, 0, 4, 4)), ArgumentErr);
+  }
+
+  ImageView<PixelGray<uint8> > img2;
+  read_image(img2, fn);
+  EXPECT_SEQ_EQ(img, img2);
+}
+
+TEST( DiskImageResource, TIFFFlushPartial ) {
+  ImageView<PixelGray<uint8> > img = noisy_image<PixelGray<uint8> >(100, 100);
+
+  for (int tiled = 0; tiled < 2; ++tiled) {
+    UnlinkName fn("flushpartial.tif");
+    {
+      DiskImageResourceTIFF r(fn, img.format());
+      r.set_compression(DiskImageResourceTIFF::LZW_COMPRESSION);
+      r.set_block_write_size(tiled ? Vector2i(32, 32) : Vector2i(100, 32));
+
+      // Both halves land in the first block, with a flush in between
+      ImageView<PixelGray<uint8> > top = crop(img, BBox2i(0, 0, 100, 10));
+      r.write(top.buffer(), BBox2i(0, 0, 100, 10));
+      r.flush();
+      ImageView<PixelGray<uint8> > bottom = crop(img, BBox2i(0, 10, 100, 22));
+      r.write(bottom.buffer(), BBox2i(0, 10, 100, 22));
+    }
+
+    ImageView<PixelGray<uint8> > img2;
+    read_image(img2, fn);
+    ASSERT_EQ(100, img2.rows());
+    EXPECT_SEQ_EQ(crop(img, 0, 0, 100, 32), crop(img2, 0, 0, 100, 32)) << "tiled " << tiled;
+
+    // The rest was never written, and reads back as zeros
+    ImageView<PixelGray<uint8> > rest = crop(img2, 0, 32, 100, 68);
+    for (int32 y = 0; y < rest.rows(); ++y)
+      for (int32 x = 0; x < rest.cols(); ++x)
+        EXPECT_EQ(0, rest(x,y).v());
+  }
+}
+#endif
+
+#if defined(VW_HAVE_PKG_PNG) && VW_HAVE_PKG_PNG==1
+TEST( DiskImageResource, PNGParallelDeflate ) {
+  const uint32 old_threads = vw_settings().default_num_threads();
+  vw_settings().set_default_num_threads(4);
+
+  // 8 and 16 bit, both well over the size where the write goes parallel
+  {
+    UnlinkName fn("parallel8.png");
+    ImageView<PixelRGB<uint8> > img = noisy_image<PixelRGB<uint8> >(700, 500), img2;
+    {
+      DiskImageResourcePNG r(fn, img.format());
+      write_image(r, img);
+    }
+    read_image(img2, fn);
+    ASSERT_EQ(img.cols(), img2.cols());
+    ASSERT_EQ(img.rows(), img2.rows());
+    EXPECT_SEQ_EQ(img, img2);
+  }
+  {
+    UnlinkName fn("parallel16.png");
+    ImageView<PixelGray<uint16> > img = noisy_image<PixelGray<uint16> >(800, 600), img2;
+    {
+      DiskImageResourcePNG r(fn, img.format());
+      write_image(r, img);
+    }
+    read_image(img2, fn);
+    ASSERT_EQ(img.cols(), img2.cols());
+    ASSERT_EQ(img.rows(), img2.rows());
+    EXPECT_SEQ_EQ(img, img2);
+  }
+
+  vw_settings().set_default_num_threads(old_threads);
+}
+#endif
+
 #if defined(VW_HAVE_PKG_JPEG) && VW_HAVE_PKG_JPEG==1
 typedef ReadImage<PixelRGB<uint8>, 2> ReadImageRGBU8JPG;
 TEST_F( ReadImageRGBU8JPG, RGB_U8_JPG ) {}
@@ -204,6 +387,178 @@ typedef WriteReadImage<PixelRGB<float>, 2> WriteReadImageRGBF32JPG;
 TEST_F( WriteReadImageRGBF32JPG, DISABLED_RGB_F32_JPG ) {}
 #endif
 
+#if defined(VW_HAVE_PKG_JPEG) && VW_HAVE_PKG_JPEG==1
+TEST( DiskImageResource, JPEGLevels ) {
+  const std::string fn = TEST_SRCDIR"/mural.jpg";
+  DiskImageResourceJPEG r(fn);
+  ASSERT_EQ(4, r.num_levels());
+  EXPECT_VECTOR_EQ(Vector2i(r.cols(), r.rows()), r.level_size(0));
+  EXPECT_VECTOR_EQ(Vector2i((r.cols()+3)/4, (r.rows()+3)/4), r.level_size(2));
+
+  EXPECT_EQ(0, r.level_for_subsample(1));
+  EXPECT_EQ(1, r.level_for_subsample(3));
+  EXPECT_EQ(2, r.level_for_subsample(4));
+  EXPECT_EQ(3, r.level_for_subsample(100));
+
+  // A level should decode just like opening the file at that scale
+  for (int32 level = 1; level < r.num_levels(); ++level) {
+    DiskImageResourceJPEG scaled(fn, 1 << level);
+    ImageView<PixelRGB<uint8> > expected;
+    read_image(expected, scaled);
+    ASSERT_VECTOR_EQ(r.level_size(level), Vector2i(expected.cols(), expected.rows()));
+
+    BBox2i bbox(3, 5, expected.cols() - 7, expected.rows() - 9);
+    ImageView<PixelRGB<uint8> > actual(bbox.width(), bbox.height());
+    r.read_level(actual.buffer(), bbox, level);
+    EXPECT_SEQ_EQ(crop(expected, bbox), actual) << "level " << level;
+  }
+
+  // Reading a level leaves the sequential reader alone
+  ImageView<PixelRGB<uint8> > full, full2;
+  read_image(full, r);
+  read_image(full2, fn);
+  EXPECT_SEQ_EQ(full2, full);
+}
+
+// Writes an RGB jpeg (with the default 2x2 chroma subsampling) that has a
+// restart marker every restart_rows MCU rows, or none if that is 0.
+static void write_jpeg_with_restarts(std::string const& fn, ImageView<PixelRGB<uint8> > const& img, int restart_rows) {
+  FILE* f = fopen(fn.c_str(), "wb");
+  ASSERT_TRUE(f);
+  jpeg_compress_struct cinfo;
+  jpeg_error_mgr jerr;
+  cinfo.err = jpeg_std_error(&jerr);
+  jpeg_create_compress(&cinfo);
+  jpeg_stdio_dest(&cinfo, f);
+  cinfo.image_width = img.cols();
+  cinfo.image_height = img.rows();
+  cinfo.input_components = 3;
+  cinfo.in_color_space = JCS_RGB;
+  jpeg_set_defaults(&cinfo);
+  cinfo.restart_in_rows = restart_rows;
+  jpeg_start_compress(&cinfo, TRUE);
+
+  std::vector<uint8> line(img.cols() * 3);
+  for (int32 j = 0; j < img.rows(); ++j) {
+    for (int32 i = 0; i < img.cols(); ++i)
+      for (int32 c = 0; c < 3; ++c)
+        line[3*i+c] = img(i,j)[c];
+    JSAMPROW row = &line[0];
+    jpeg_write_scanlines(&cinfo, &row, 1);
+  }
+  jpeg_finish_compress(&cinfo);
+  jpeg_destroy_compress(&cinfo);
+  fclose(f);
+}
+
+TEST( DiskImageResource, JPEGStreaming ) {
+  using namespace vw::fileio::detail;
+
+  // Odd sizes, so the last MCU row and column are partial
+  ImageView<PixelRGB<uint8> > img(301, 203);
+  for (int32 j = 0; j < img.rows(); ++j)
+    for (int32 i = 0; i < img.cols(); ++i)
+      img(i,j) = PixelRGB<uint8>((i*7 + j*3) & 255, (i*j) & 255, (i ^ j) & 255);
+
+  UnlinkName fn("streaming.jpg");
+  for (int restart_rows = 0; restart_rows <= 2; ++restart_rows) {
+    write_jpeg_with_restarts(fn, img, restart_rows);
+
+    boost::shared_ptr<const JpegRestartIndex> idx = JpegRestartIndex::build(JpegFileSource(fn));
+    ASSERT_EQ(restart_rows != 0, bool(idx));
+    if (idx) {
+      EXPECT_EQ(16u, idx->mcu_rows);
+      EXPECT_EQ(13u, idx->entries.size());
+      for (size_t r = 1; r < idx->entries.size(); ++r)
+        EXPECT_EQ(r % restart_rows == 0, idx->entries[r].offset != 0) << "MCU row " << r;
+    }
+
+    for (int factor = 1; factor <= 2; factor *= 2) {
+      // Reading the whole image in one go decodes it top to bottom
+      ImageView<PixelRGB<uint8> > full;
+      read_image(full, DiskImageResourceJPEG(fn, factor));
+
+      DiskImageResourceJPEG r(fn, factor);
+      ASSERT_TRUE(r.has_block_read());
+      EXPECT_EQ(r.cols(), r.block_read_size().x());
+
+      // Bottom to top, so every read has to restart
+      for (int32 y = r.rows(); y > 0; y -= 37) {
+        BBox2i bbox(5, std::max(0, y-37), r.cols()-9, std::min(37, y));
+        ImageView<PixelRGB<uint8> > part(bbox.width(), bbox.height());
+        r.read(part.buffer(), bbox);
+        EXPECT_SEQ_EQ(crop(full, bbox), part) << "restart_rows " << restart_rows << " factor " << factor << " at " << bbox;
+      }
+
+      // Jumping ahead, and carrying on from there
+      BBox2i jump(0, r.rows()/2 + 3, r.cols(), 11), next(0, jump.max().y(), r.cols(), 20);
+      ImageView<PixelRGB<uint8> > a(jump.width(), jump.height()), b(next.width(), next.height());
+      DiskImageResourceJPEG r2(fn, factor);
+      r2.read(a.buffer(), jump);
+      r2.read(b.buffer(), next);
+      EXPECT_SEQ_EQ(crop(full, jump), a);
+      EXPECT_SEQ_EQ(crop(full, next), b);
+    }
+  }
+}
+#endif
+
+#if defined(VW_HAVE_PKG_TIFF) && VW_HAVE_PKG_TIFF==1
+// Writes a gray image followed by reduced resolution copies of it, the way
+// gdaladdo lays out internal overviews.
+static void write_tiff_with_overviews(std::string const& fn, std::vector<ImageView<PixelGray<uint8> > > const& levels) {
+  TIFF* tif = TIFFOpen(fn.c_str(), "w");
+  ASSERT_TRUE(tif);
+  for (size_t i = 0; i < levels.size(); ++i) {
+    ImageView<PixelGray<uint8> > const& img = levels[i];
+    TIFFSetField(tif, TIFFTAG_SUBFILETYPE, i == 0 ? 0 : FILETYPE_REDUCEDIMAGE);
+    TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, uint32(img.cols()));
+    TIFFSetField(tif, TIFFTAG_IMAGELENGTH, uint32(img.rows()));
+    TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, uint16(8));
+    TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, uint16(1));
+    TIFFSetField(tif, TIFFTAG_SAMPLEFORMAT, SAMPLEFORMAT_UINT);
+    TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
+    TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+    TIFFSetField(tif, TIFFTAG_TILEWIDTH, uint32(16));
+    TIFFSetField(tif, TIFFTAG_TILELENGTH, uint32(16));
+    for (int32 y = 0; y < img.rows(); y += 16)
+      for (int32 x = 0; x < img.cols(); x += 16) {
+        ImageView<PixelGray<uint8> > tile(16, 16);
+        crop(tile, 0, 0, std::min(16, img.cols()-x), std::min(16, img.rows()-y)) = crop(img, x, y, std::min(16, img.cols()-x), std::min(16, img.rows()-y));
+        TIFFWriteTile(tif, &tile(0,0), x, y, 0, 0);
+      }
+    TIFFWriteDirectory(tif);
+  }
+  TIFFClose(tif);
+}
+
+TEST( DiskImageResource, TIFFLevels ) {
+  std::vector<ImageView<PixelGray<uint8> > > levels;
+  levels.push_back(noisy_image<PixelGray<uint8> >(100, 70));
+  levels.push_back(noisy_image<PixelGray<uint8> >(50, 35));
+  levels.push_back(noisy_image<PixelGray<uint8> >(25, 18));
+
+  UnlinkName fn("levels.tif");
+  write_tiff_with_overviews(fn, levels);
+
+  DiskImageResourceTIFF r(fn);
+  ASSERT_EQ(3, r.num_levels());
+  EXPECT_VECTOR_EQ(Vector2i(16, 16), r.level_block_read_size(1));
+  for (int32 level = 0; level < 3; ++level) {
+    ImageView<PixelGray<uint8> > const& img = levels[level];
+    ASSERT_VECTOR_EQ(Vector2i(img.cols(), img.rows()), r.level_size(level));
+
+    BBox2i bbox(5, 3, img.cols() - 9, img.rows() - 4);
+    ImageView<PixelGray<uint8> > actual(bbox.width(), bbox.height());
+    r.read_level(actual.buffer(), bbox, level);
+    EXPECT_SEQ_EQ(crop(img, bbox), actual) << "level " << level;
+  }
+  EXPECT_EQ(1, r.level_for_subsample(2));
+  EXPECT_EQ(1, r.level_for_subsample(3));
+  EXPECT_THROW(r.level_size(3), ArgumentErr);
+}
+#endif
+
 TEST( DiskImageResource, TestPBM ) {
   const char
     //pr1[] = "P1 1 2 1 0",
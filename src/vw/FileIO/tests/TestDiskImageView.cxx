@@ -13,6 +13,10 @@
 #include <vw/Image/ImageView.h>
 #include <vw/Image/ImageMath.h>
 
+#if defined(VW_HAVE_PKG_JPEG) && VW_HAVE_PKG_JPEG==1
+#include <vw/FileIO/DiskImageResourceJPEG.h>
+#endif
+
 using namespace vw;
 
 #if defined(VW_HAVE_PKG_PNG) && VW_HAVE_PKG_PNG==1
@@ -94,3 +98,28 @@ TEST( DiskCacheImageView, Construction ) {
 
 }
 #endif
+
+#if defined(VW_HAVE_PKG_JPEG) && VW_HAVE_PKG_JPEG==1
+TEST( DiskImageView, Level ) {
+  const std::string fn = TEST_SRCDIR"/mural.jpg";
+  DiskImageView<PixelRGB<uint8> > full( fn );
+  EXPECT_EQ( 0, full.level() );
+
+  DiskImageView<PixelRGB<uint8> > quarter( fn, 2, &vw_system_cache() );
+  EXPECT_EQ( 2, quarter.level() );
+  EXPECT_EQ( (full.cols()+3)/4, quarter.cols() );
+  EXPECT_EQ( (full.rows()+3)/4, quarter.rows() );
+
+  // The same pixels as decoding the whole file at quarter scale
+  ImageView<PixelRGB<uint8> > expected, actual = quarter;
+  DiskImageResourceJPEG scaled( fn, 4 );
+  read_image( expected, scaled );
+  ASSERT_EQ( expected.cols(), actual.cols() );
+  ASSERT_EQ( expected.rows(), actual.rows() );
+  for ( int32 y = 0; y < actual.rows(); ++y )
+    for ( int32 x = 0; x < actual.cols(); ++x )
+      EXPECT_EQ( expected(x,y), actual(x,y) );
+
+  EXPECT_THROW( DiskImageView<PixelRGB<uint8> >( fn, 4, &vw_system_cache() ), ArgumentErr );
+}
+#endif
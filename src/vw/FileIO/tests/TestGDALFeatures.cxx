@@ -9,6 +9,8 @@
 #include <vw/FileIO.h>
 #include <vw/Image/ImageView.h>
 #include <vw/Image/ImageIO.h>
+#include <vw/Image/Algorithms.h>
+#include <vw/Core/Thread.h>
 #include <test/Helpers.h>
 
 using namespace vw;
@@ -42,4 +44,68 @@ TEST( GDALFeatures, NoDataValue ) {
   EXPECT_EQ( -1, r_rsrc.nodata_read() );
 }
 
+namespace {
+  // Reads a set of blocks from a shared resource
+  struct BlockReader {
+    const DiskImageResourceGDAL& rsrc;
+    const std::vector<BBox2i>& blocks;
+    std::vector<ImageView<PixelRGB<uint8> > >& out;
+    size_t start, stride;
+
+    BlockReader(const DiskImageResourceGDAL& rsrc, const std::vector<BBox2i>& blocks,
+                std::vector<ImageView<PixelRGB<uint8> > >& out, size_t start, size_t stride)
+      : rsrc(rsrc), blocks(blocks), out(out), start(start), stride(stride) {}
+
+    void operator()() {
+      for (size_t i = start; i < blocks.size(); i += stride) {
+        out[i].set_size(blocks[i].width(), blocks[i].height());
+        rsrc.read(out[i].buffer(), blocks[i]);
+      }
+    }
+  };
+}
+
+TEST( GDALFeatures, ConcurrentRead ) {
+  UnlinkName tiled("concurrent.tif");
+
+  ImageView<PixelRGB<uint8> > image(256,256);
+  for (int32 r = 0; r < image.rows(); ++r)
+    for (int32 c = 0; c < image.cols(); ++c)
+      image(c,r) = PixelRGB<uint8>(c, r, c^r);
+
+  {
+    DiskImageResourceGDAL w_rsrc( tiled, image.format(), Vector2i(64,64) );
+    write_image( w_rsrc, image );
+  }
+
+  DiskImageResourceGDAL rsrc( tiled );
+  EXPECT_FALSE( rsrc.concurrent_read() );
+  rsrc.set_concurrent_read(true);
+  ASSERT_TRUE( rsrc.concurrent_read() );
+
+  std::vector<BBox2i> blocks = image_blocks(image, 64, 64);
+  std::vector<ImageView<PixelRGB<uint8> > > out(blocks.size());
+
+  static const size_t THREADS = 4;
+  std::vector<boost::shared_ptr<BlockReader> > readers;
+  std::vector<boost::shared_ptr<Thread> > threads;
+  for (size_t i = 0; i < THREADS; ++i) {
+    readers.push_back(boost::shared_ptr<BlockReader>(new BlockReader(rsrc, blocks, out, i, THREADS)));
+    threads.push_back(boost::shared_ptr<Thread>(new Thread(readers.back())));
+  }
+  for (size_t i = 0; i < THREADS; ++i)
+    threads[i]->join();
+
+  for (size_t i = 0; i < blocks.size(); ++i) {
+    SCOPED_TRACE(::testing::Message() << "block " << blocks[i]);
+    EXPECT_SEQ_EQ(crop(image, blocks[i]), out[i]);
+  }
+
+  // And the global lock path still works after turning it off
+  rsrc.set_concurrent_read(false);
+  ImageView<PixelRGB<uint8> > all;
+  read_image(all, rsrc);
+  EXPECT_SEQ_EQ(image, all);
+}
+
 #endif
@@ -0,0 +1,60 @@
+// __BEGIN_LICENSE__
+// Copyright (C) 2006-2011 United States Government as represented by
+// the Administrator of the National Aeronautics and Space Administration.
+// All Rights Reserved.
+// __END_LICENSE__
+
+
+#include <gtest/gtest.h>
+#include <vw/Geometry/PointListIO.h>
+#include <vw/Math/FlatKDTree.h>
+
+#include <cstdlib>
+#include <sstream>
+
+using namespace vw;
+using namespace vw::math;
+
+static std::vector<Vector<float> > random_points( size_t count, size_t dim ) {
+  std::vector<Vector<float> > points( count, Vector<float>(dim) );
+  for( size_t i=0; i<count; ++i )
+    for( size_t j=0; j<dim; ++j )
+      points[i][j] = float( rand() % 1000 ) / 10;
+  return points;
+}
+
+TEST( PointListIO, RoundTrip ) {
+  srand( 5 );
+  std::vector<Vector<float> > points = random_points( 100, 3 ), read;
+  std::stringstream stream;
+  write_point_list( stream, points, true );
+  read_point_list( stream, read, true );
+  ASSERT_EQ( points.size(), read.size() );
+  for( size_t i=0; i<points.size(); ++i )
+    EXPECT_EQ( points[i], read[i] );
+}
+
+TEST( PointListIO, SpatialQuery ) {
+  srand( 11 );
+  std::vector<Vector<float> > points = random_points( 500, 3 ), read;
+  std::stringstream stream;
+  write_point_list( stream, points );
+  read_point_list( stream, read );
+  ASSERT_EQ( points.size(), read.size() );
+
+  // A point list indexes directly into a kd-tree
+  FlatKDTree<float> tree( read.begin(), read.end() );
+  std::vector<int> result;
+  for( int q=0; q<50; ++q ) {
+    Vector<float> query = random_points( 1, 3 )[0];
+    float max_dist = float( rand() % 1000 );
+    tree.radius_search( query, max_dist, result );
+    std::vector<int> expected;
+    for( size_t i=0; i<read.size(); ++i )
+      if( norm_2_sqr( read[i] - query ) <= max_dist )
+        expected.push_back( i );
+    ASSERT_EQ( expected.size(), result.size() );
+    for( size_t i=0; i<expected.size(); ++i )
+      EXPECT_EQ( expected[i], result[i] );
+  }
+}
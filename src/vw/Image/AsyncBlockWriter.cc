@@ -0,0 +1,126 @@
+// __BEGIN_LICENSE__
+// Copyright (C) 2006-2011 United States Government as represented by
+// the Administrator of the National Aeronautics and Space Administration.
+// All Rights Reserved.
+// __END_LICENSE__
+
+
+#include <vw/Image/AsyncBlockWriter.h>
+#include <vw/Core/Exception.h>
+#include <vw/Core/Log.h>
+
+namespace vw {
+
+  class AsyncBlockWriter::WriterThread {
+    AsyncBlockWriter& m_parent;
+  public:
+    WriterThread( AsyncBlockWriter& parent ) : m_parent(parent) {}
+    void operator()() { m_parent.run(); }
+  };
+
+  AsyncBlockWriter::AsyncBlockWriter( DstImageResource& resource, size_t memory_budget )
+    : m_resource(resource), m_budget(memory_budget),
+      m_ordered(!resource.has_unordered_block_write()),
+      m_buffered(0), m_peak(0), m_next(0), m_closed(false)
+  {
+    m_thread.reset( new Thread( WriterThread(*this) ) );
+  }
+
+  AsyncBlockWriter::~AsyncBlockWriter() {
+    {
+      Mutex::Lock lock(m_mutex);
+      m_pending.clear();
+    }
+    stop();
+  }
+
+  // Called with the lock held
+  bool AsyncBlockWriter::can_write() const {
+    if (m_pending.empty())
+      return false;
+    // Once no more blocks are coming, any gaps in the numbering are
+    // never going to be filled, so the rest go out in order.
+    return !m_ordered || m_closed || m_pending.begin()->first == m_next;
+  }
+
+  void AsyncBlockWriter::enqueue( boost::shared_ptr<BlockBase> block, int index ) {
+    Mutex::Lock lock(m_mutex);
+    VW_ASSERT( !m_closed, LogicErr() << "AsyncBlockWriter: write() called after finish()" );
+    VW_ASSERT( index >= 0 && m_pending.find(index) == m_pending.end(),
+               ArgumentErr() << "AsyncBlockWriter: block index " << index << " is invalid or already queued" );
+
+    while (!m_error.failed() && m_buffered > 0 && m_buffered + block->bytes > m_budget &&
+           !(m_ordered && index == m_next))
+      m_cond.wait(lock);
+
+    // The writer has given up; the error is reported by finish()
+    if (m_error.failed())
+      return;
+
+    m_pending[index] = block;
+    m_buffered += block->bytes;
+    m_peak = std::max(m_peak, m_buffered);
+    m_cond.notify_all();
+  }
+
+  void AsyncBlockWriter::run() {
+    Mutex::Lock lock(m_mutex);
+    while (true) {
+      while (!m_closed && !can_write())
+        m_cond.wait(lock);
+      if (!can_write())
+        break;
+
+      std::map<int, boost::shared_ptr<BlockBase> >::iterator next = m_pending.begin();
+      int index = next->first;
+      boost::shared_ptr<BlockBase> block = next->second;
+      m_pending.erase(next);
+      lock.unlock();
+
+      bool failed = false;
+      try {
+        vw_out(DebugMessage, "image") << "Writing block " << index << " at " << block->bbox << "\n";
+        m_resource.write( block->buffer(), block->bbox );
+      } catch (...) {
+        m_error.capture();
+        failed = true;
+      }
+
+      lock.lock();
+      m_buffered -= block->bytes;
+      m_next = index + 1;
+      if (failed) {
+        // Nothing more will be written, so free the memory and wake
+        // any producers waiting for room.
+        std::map<int, boost::shared_ptr<BlockBase> >::const_iterator i;
+        for (i = m_pending.begin(); i != m_pending.end(); ++i)
+          m_buffered -= i->second->bytes;
+        m_pending.clear();
+      }
+      m_cond.notify_all();
+    }
+  }
+
+  void AsyncBlockWriter::stop() {
+    {
+      Mutex::Lock lock(m_mutex);
+      m_closed = true;
+      m_cond.notify_all();
+    }
+    if (m_thread) {
+      m_thread->join();
+      m_thread.reset();
+    }
+  }
+
+  void AsyncBlockWriter::finish() {
+    stop();
+    m_error.rethrow();
+  }
+
+  size_t AsyncBlockWriter::peak_buffered() const {
+    Mutex::Lock lock(m_mutex);
+    return m_peak;
+  }
+
+} // namespace vw
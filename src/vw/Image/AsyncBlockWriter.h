@@ -0,0 +1,111 @@
+// __BEGIN_LICENSE__
+// Copyright (C) 2006-2011 United States Government as represented by
+// the Administrator of the National Aeronautics and Space Administration.
+// All Rights Reserved.
+// __END_LICENSE__
+
+
+/// \file AsyncBlockWriter.h
+///
+/// A write-behind queue that lets many threads hand rasterized blocks
+/// to one image resource.
+///
+#ifndef __VW_IMAGE_ASYNCBLOCKWRITER_H__
+#define __VW_IMAGE_ASYNCBLOCKWRITER_H__
+
+#include <vw/Core/Thread.h>
+#include <vw/Core/ThreadPool.h>
+#include <vw/Image/ImageResource.h>
+#include <vw/Image/ImageView.h>
+
+#include <boost/scoped_ptr.hpp>
+#include <map>
+
+namespace vw {
+
+  /// Accepts finished blocks from any number of threads, in any order,
+  /// and writes them to a resource from its own I/O thread.
+  ///
+  /// Blocks are numbered from 0 in file order (left to right, then top
+  /// to bottom). If the resource can take blocks in any order (see
+  /// DstImageResource::has_unordered_block_write()) they are written as
+  /// soon as they arrive; otherwise each one waits until every block
+  /// before it has been written. At most memory_budget bytes of blocks
+  /// are held at once: write() blocks until there is room, except that
+  /// the next block the file needs is always let in, so a budget that
+  /// is too small slows things down but doesn't deadlock, as long as
+  /// the thread making that block isn't itself stuck behind ones that
+  /// are waiting (rasterizing from a FifoWorkQueue in file order is
+  /// fine).
+  ///
+  /// If the resource fails a write, later blocks are dropped and
+  /// finish() throws the error.
+  class AsyncBlockWriter : private boost::noncopyable {
+
+    struct BlockBase {
+      BBox2i bbox;
+      size_t bytes;
+      virtual ~BlockBase() {}
+      virtual ImageBuffer buffer() const = 0;
+    };
+
+    template <class PixelT>
+    struct Block : public BlockBase {
+      ImageView<PixelT> image;
+      virtual ImageBuffer buffer() const { return image.buffer(); }
+    };
+
+    class WriterThread;
+    friend class WriterThread;
+
+    DstImageResource& m_resource;
+    size_t m_budget;
+    bool m_ordered;
+
+    std::map<int, boost::shared_ptr<BlockBase> > m_pending;
+    size_t m_buffered, m_peak;
+    int m_next;
+    bool m_closed;
+    TaskErrors m_error;
+
+    mutable Mutex m_mutex;
+    Condition m_cond;
+    boost::scoped_ptr<Thread> m_thread;
+
+    void enqueue( boost::shared_ptr<BlockBase> block, int index );
+    bool can_write() const;
+    void run();
+    void stop();
+
+  public:
+    AsyncBlockWriter( DstImageResource& resource, size_t memory_budget );
+
+    /// Drops any blocks that have not been written yet. Call finish()
+    /// first to keep them.
+    ~AsyncBlockWriter();
+
+    /// Hands a block over to be written at bbox. The image is shared,
+    /// not copied, so don't write into it afterwards.
+    template <class PixelT>
+    void write( ImageView<PixelT> const& image, BBox2i const& bbox, int index ) {
+      boost::shared_ptr<Block<PixelT> > block( new Block<PixelT>() );
+      block->image = image;
+      block->bbox = bbox;
+      block->bytes = image.cols() * image.rows() * image.planes() * sizeof(PixelT);
+      enqueue( block, index );
+    }
+
+    /// Waits for every block to be written, then stops the I/O thread.
+    /// Throws IOErr if any write failed.
+    void finish();
+
+    /// Whether blocks are being held back until their turn
+    bool ordered() const { return m_ordered; }
+
+    /// The most block memory that was held at once, in bytes
+    size_t peak_buffered() const;
+  };
+
+} // namespace vw
+
+#endif // __VW_IMAGE_ASYNCBLOCKWRITER_H__
@@ -15,6 +15,7 @@
 
 #include <vw/Core/ProgressCallback.h>
 #include <vw/Core/ThreadPool.h>
+#include <vw/Image/AsyncBlockWriter.h>
 #include <vw/Image/ImageResource.h>
 #include <vw/Image/ImageView.h>
 
@@ -85,23 +86,20 @@ namespace vw {
   // -----------------------------------------------------------------------
   //
   // Doing multi-threaded block rasterization and writing to disk
-  // correctly is a little tricky, because blocks almost always must
-  // be written _in order_ into the file.  If one of the rasterizing
-  // threads for an early block falls behind (which is not all that
-  // unlikely), it can cause a backup on the write queue.  Depending
-  // on the size of the blocks being rasterized, this can lead to
-  // large allocations of memory as rasterized tiles accumulate and
-  // sit waiting to be written to disk.
+  // correctly is a little tricky, because many formats need their
+  // blocks written _in order_ into the file.  If one of the
+  // rasterizing threads for an early block falls behind (which is not
+  // all that unlikely), the finished blocks after it pile up waiting
+  // for their turn, and they can take up a lot of memory.
   //
-  // To fix this, we need this semaphore to help us meet the following
-  // condition:
+  // CountingSemaphore meets the following condition:
   //
   // We rasterize _at most_ N blocks at a time, and it will never
   // get more than N blocks ahead of the last block that was written.
   //
-  // Of course, one slow rasterization thread can hold up the entire
-  // process, but this is the price we pay for guranteed ordering when
-  // writing tiles.
+  // ThreadedBlockWriter no longer uses it: it hands finished blocks to
+  // an AsyncBlockWriter, which bounds the memory instead and lets
+  // formats that don't care about order write blocks as they finish.
   class CountingSemaphore {
     Condition m_block_condition;
     Mutex m_mutex;
@@ -133,65 +131,34 @@ namespace vw {
 
   // This task generator manages the rasterizing and writing of images to disk.
   //
-  // Only one thread can be writing to the ImageResource at any given
-  // time, however several threads can be rasterizing simultaneously.
+  // Several threads rasterize blocks at once and hand them to an
+  // AsyncBlockWriter, which writes them from its own thread in
+  // whatever order the resource needs.  Rasterizing threads only wait
+  // when the finished blocks exceed the memory budget.
   //
   class ThreadedBlockWriter : private boost::noncopyable {
 
-    boost::shared_ptr<FifoWorkQueue> m_rasterize_work_queue;
-    boost::shared_ptr<OrderedWorkQueue> m_write_work_queue;
-    CountingSemaphore m_write_queue_limit;
-
-    // ----------------------------- TASK TYPES (2) --------------------------
-
-    template <class PixelT>
-    class WriteBlockTask : public Task {
-      DstImageResource& m_resource;
-      ImageView<PixelT> m_image_block;
-      BBox2i m_bbox;
-      int m_idx;
-      CountingSemaphore& m_write_finish_event;
-
-    public:
-      WriteBlockTask(DstImageResource& resource, ImageView<PixelT> const& image_block,
-                     BBox2i bbox, int idx, CountingSemaphore& write_finish_event) :
-      m_resource(resource), m_image_block(image_block), m_bbox(bbox), m_idx(idx), m_write_finish_event(write_finish_event) {}
-
-      virtual ~WriteBlockTask() {}
-      virtual void operator() () {
-        vw_out(DebugMessage, "image") << "Writing block " << m_idx << " at " << m_bbox << "\n";
-        m_resource.write( m_image_block.buffer(), m_bbox );
-        m_write_finish_event.notify();
-      }
-    };
-
-    // -----------------------------
+    // The writer goes first so that it outlives the rasterizing threads
+    AsyncBlockWriter m_writer;
+    FifoWorkQueue m_rasterize_work_queue;
 
     template <class ViewT>
     class RasterizeBlockTask : public Task {
-      ThreadedBlockWriter &m_parent;
-      DstImageResource& m_resource;
+      AsyncBlockWriter& m_writer;
       ViewT const& m_image;
       BBox2i m_bbox;
       int m_index;
-      int m_total_num_blocks;
       SubProgressCallback m_progress_callback;
-      CountingSemaphore& m_write_finish_event;
 
     public:
-      RasterizeBlockTask(ThreadedBlockWriter &parent, DstImageResource& resource,
-                         ImageViewBase<ViewT> const& image, BBox2i const& bbox,
-                         int index, int total_num_blocks,
-                         CountingSemaphore& write_finish_event,
+      RasterizeBlockTask(AsyncBlockWriter& writer, ImageViewBase<ViewT> const& image,
+                         BBox2i const& bbox, int index, int total_num_blocks,
                          const ProgressCallback &progress_callback = ProgressCallback::dummy_instance()) :
-      m_parent(parent), m_resource(resource), m_image(image.impl()), m_bbox(bbox), m_index(index),
-        m_progress_callback(progress_callback,0.0,1.0/float(total_num_blocks)), m_write_finish_event(write_finish_event) {}
+      m_writer(writer), m_image(image.impl()), m_bbox(bbox), m_index(index),
+        m_progress_callback(progress_callback,0.0,1.0/float(total_num_blocks)) {}
 
       virtual ~RasterizeBlockTask() {}
       virtual void operator()() {
-
-        m_write_finish_event.wait(m_index);
-
         vw_out(DebugMessage, "image") << "Rasterizing block " << m_index << " at " << m_bbox << "\n";
         // Rasterize the block
         ImageView<typename ViewT::pixel_type> image_block( crop(m_image, m_bbox) );
@@ -199,37 +166,29 @@ namespace vw {
         // Report progress
         m_progress_callback.report_incremental_progress(1.0);
 
-        // With rasterization complete, we queue up a request to write this block to disk.
-        boost::shared_ptr<Task> write_task ( new WriteBlockTask<typename ViewT::pixel_type>( m_resource, image_block, m_bbox, m_index, m_write_finish_event ) );
-
-        m_parent.add_write_task(write_task, m_index);
+        // Queue it up to be written; this waits if too much is already queued.
+        m_writer.write(image_block, m_bbox, m_index);
       }
     };
 
-    // -----------------------------
-
-    void add_write_task(boost::shared_ptr<Task> task, int index) { m_write_work_queue->add_task(task, index); }
-    void add_rasterize_task(boost::shared_ptr<Task> task) { m_rasterize_work_queue->add_task(task); }
-
   public:
-    ThreadedBlockWriter() : m_write_queue_limit(vw_settings().write_pool_size()) {
-      m_rasterize_work_queue = boost::shared_ptr<FifoWorkQueue>( new FifoWorkQueue() );
-      m_write_work_queue = boost::shared_ptr<OrderedWorkQueue>( new OrderedWorkQueue(1) );
-    }
-
-    // Add a block to be rasterized.  You can optionally supply an
-    // index, which will indicate the order in which this block should
-    // be written to disk.
+    // The memory budget covers rasterized blocks that are waiting to be
+    // written.
+    ThreadedBlockWriter(DstImageResource& resource, size_t memory_budget) :
+      m_writer(resource, memory_budget), m_rasterize_work_queue() {}
+
+    // Add a block to be rasterized.  The index gives the position of
+    // this block in the file, counting from 0 left to right and then
+    // top to bottom.
     template <class ViewT>
-    void add_block(DstImageResource& resource, ImageViewBase<ViewT> const& image, BBox2i const& bbox, int index, int total_num_blocks,
+    void add_block(ImageViewBase<ViewT> const& image, BBox2i const& bbox, int index, int total_num_blocks,
                    const ProgressCallback &progress_callback = ProgressCallback::dummy_instance() ) {
-      boost::shared_ptr<Task> task( new RasterizeBlockTask<ViewT>(*this, resource, image, bbox, index, total_num_blocks, m_write_queue_limit, progress_callback) );
-      this->add_rasterize_task(task);
+      m_rasterize_work_queue.add_task( boost::shared_ptr<Task>(new RasterizeBlockTask<ViewT>(m_writer, image, bbox, index, total_num_blocks, progress_callback)) );
     }
 
     void process_blocks() {
-      m_rasterize_work_queue->join_all();
-      m_write_work_queue->join_all();
+      m_rasterize_work_queue.join_all();
+      m_writer.finish();
     }
   };
 
@@ -264,9 +223,13 @@ namespace vw {
       ImageView<typename ImageT::pixel_type> image_block = image.impl();
       resource.write( image_block.buffer(), BBox2i(0,0,image_block.cols(),image_block.rows()) );
     } else {
-      // Set up the threaded block writer object, which will manage rasterizing
-      // and writing images to disk one block (and one thread) at a time.
-      ThreadedBlockWriter block_writer;
+      // Set up the threaded block writer object, which will manage
+      // rasterizing blocks on several threads and writing them to disk
+      // on another.  Finished blocks may use up to write_pool_size
+      // blocks' worth of memory while they wait to be written.
+      const size_t block_bytes = size_t(block_size.x()) * block_size.y() * image.impl().planes() *
+                                 sizeof(typename ImageT::pixel_type);
+      ThreadedBlockWriter block_writer(resource, vw_settings().write_pool_size() * block_bytes);
 
       for (int32 j = 0; j < rows; j+= block_size.y()) {
         for (int32 i = 0; i < cols; i+= block_size.x()) {
@@ -283,7 +246,7 @@ namespace vw {
           int j_block_index = int(j/block_size.y());
           int index = j_block_index*col_blocks+i_block_index;
 
-          block_writer.add_block(resource, image, current_bbox, index, total_num_blocks, progress_callback );
+          block_writer.add_block(image, current_bbox, index, total_num_blocks, progress_callback );
         }
       }
 
@@ -19,6 +19,7 @@
 #include <map>
 
 #include <boost/integer_traits.hpp>
+#include <boost/type_traits/is_floating_point.hpp>
 
 #include <vw/Core/Debugging.h>
 #include <vw/Image/PixelTypes.h>
@@ -341,6 +342,141 @@ ChannelUnpremultiplyMapEntry _unpremultiply_u64( &channel_unpremultiply_int<uint
 ChannelUnpremultiplyMapEntry _unpremultiply_f32( &channel_unpremultiply_float<float> );
 ChannelUnpremultiplyMapEntry _unpremultiply_f64( &channel_unpremultiply_float<double> );
 
+// Fused Conversion Kernels:
+//   The generic loop in convert() calls through a function pointer for each
+//   channel of each pixel.  For packed buffers of the common channel types we
+//   instead look up a kernel that converts a whole row, with the channel
+//   counts, the channel conversion and the premultiplication step all fixed
+//   at compile time so that the compiler can inline and vectorize the loop.
+//   The kernels are built from the same per-channel functions as the generic
+//   path, so they produce identical results.
+typedef void (*convert_row_func)(void* src, void* dst, size_t len);
+
+enum FusedPremultiplyMode {
+  FUSED_NO_PREMULTIPLY = 0,
+  FUSED_UNPREMULTIPLY_SRC,
+  FUSED_PREMULTIPLY_SRC,
+  FUSED_PREMULTIPLY_DST
+};
+
+template <class T, bool IsFloatV = boost::is_floating_point<T>::value>
+struct FusedChannelOps {
+  static void set_max( T* dest ) { channel_set_max_int( dest ); }
+  static void premultiply( T* src, T* dst, int32 len ) { channel_premultiply_int( src, dst, len ); }
+  static void unpremultiply( T* src, T* dst, int32 len ) { channel_unpremultiply_int( src, dst, len ); }
+};
+
+template <class T>
+struct FusedChannelOps<T,true> {
+  static void set_max( T* dest ) { channel_set_max_float( dest ); }
+  static void premultiply( T* src, T* dst, int32 len ) { channel_premultiply_float( src, dst, len ); }
+  static void unpremultiply( T* src, T* dst, int32 len ) { channel_unpremultiply_float( src, dst, len ); }
+};
+
+// Mirrors the body of the generic pixel loop in convert(), one row at a time.
+template <class SrcT, class DstT, void (*ConvF)(SrcT*,DstT*), int32 SrcN, int32 DstN, int32 ModeV>
+void convert_row_fused( void* src_row, void* dst_row, size_t len ) {
+  static const int32 copy_length = (SrcN==DstN) ? SrcN : (SrcN<3) ? 1 : (DstN>=3) ? 3 : 0;
+  SrcT* src = static_cast<SrcT*>(src_row);
+  DstT* dst = static_cast<DstT*>(dst_row);
+  SrcT src_buf[SrcN];
+  DstT dst_buf[3];
+  for( size_t i=0; i<len; ++i, src+=SrcN, dst+=DstN ) {
+    SrcT* src_ptr = src;
+    if( ModeV==FUSED_UNPREMULTIPLY_SRC ) {
+      FusedChannelOps<SrcT>::unpremultiply( src, src_buf, SrcN );
+      src_ptr = src_buf;
+    }
+    else if( ModeV==FUSED_PREMULTIPLY_SRC ) {
+      FusedChannelOps<SrcT>::premultiply( src, src_buf, SrcN );
+      src_ptr = src_buf;
+    }
+
+    for( int32 ch=0; ch<copy_length; ++ch )
+      ConvF( src_ptr+ch, dst+ch );
+
+    if( SrcN<3 && DstN>=3 ) {
+      ConvF( src_ptr, dst+1 );
+      ConvF( src_ptr, dst+2 );
+    }
+    else if( SrcN>=3 && DstN<3 ) {
+      for( int32 ch=0; ch<3; ++ch )
+        ConvF( src_ptr+ch, dst_buf+ch );
+      channel_average( dst_buf, dst, 3 );
+    }
+    if( SrcN!=DstN && SrcN%2==0 && DstN%2==0 )
+      ConvF( src_ptr+(SrcN-1), dst+(DstN-1) );
+    else if( SrcN%2==1 && DstN%2==0 )
+      FusedChannelOps<DstT>::set_max( dst+(DstN-1) );
+
+    if( ModeV==FUSED_PREMULTIPLY_DST )
+      FusedChannelOps<DstT>::premultiply( dst, dst, DstN );
+  }
+}
+
+inline int32 fused_convert_key( ChannelTypeEnum src, ChannelTypeEnum dst, int32 src_channels, int32 dst_channels, int32 mode ) {
+  return (((int32(src)*128 + int32(dst))*8 + src_channels)*8 + dst_channels)*4 + mode;
+}
+
+std::map<int32,convert_row_func> *fused_convert_map = 0, *fused_convert_rescale_map = 0;
+
+// Registers the kernels for one channel type pair: every combination of one
+// to four channels, plus the premultiplication variants that show up when
+// reading and writing images with alpha.  Other cases use the generic loop.
+template <class SrcT, class DstT, void (*ConvF)(SrcT*,DstT*), void (*RescaleF)(SrcT*,DstT*) = ConvF>
+class FusedConvertMapEntry {
+  typedef std::map<int32,convert_row_func> map_type;
+
+  template <void (*F)(SrcT*,DstT*), int32 SrcN, int32 DstN, int32 ModeV>
+  static void add( map_type* map ) {
+    map->operator[]( fused_convert_key( ChannelTypeID<SrcT>::value, ChannelTypeID<DstT>::value, SrcN, DstN, ModeV ) )
+      = &convert_row_fused<SrcT,DstT,F,SrcN,DstN,ModeV>;
+  }
+
+  template <void (*F)(SrcT*,DstT*), int32 SrcN>
+  static void add_src( map_type* map ) {
+    add<F,SrcN,1,FUSED_NO_PREMULTIPLY>( map );
+    add<F,SrcN,2,FUSED_NO_PREMULTIPLY>( map );
+    add<F,SrcN,3,FUSED_NO_PREMULTIPLY>( map );
+    add<F,SrcN,4,FUSED_NO_PREMULTIPLY>( map );
+  }
+
+  template <void (*F)(SrcT*,DstT*)>
+  static void add_all( map_type* map ) {
+    add_src<F,1>( map );
+    add_src<F,2>( map );
+    add_src<F,3>( map );
+    add_src<F,4>( map );
+    add<F,2,2,FUSED_UNPREMULTIPLY_SRC>( map );
+    add<F,4,4,FUSED_UNPREMULTIPLY_SRC>( map );
+    add<F,2,2,FUSED_PREMULTIPLY_DST>( map );
+    add<F,4,4,FUSED_PREMULTIPLY_DST>( map );
+    add<F,2,1,FUSED_PREMULTIPLY_SRC>( map );
+    add<F,2,3,FUSED_PREMULTIPLY_SRC>( map );
+    add<F,4,1,FUSED_PREMULTIPLY_SRC>( map );
+    add<F,4,3,FUSED_PREMULTIPLY_SRC>( map );
+  }
+public:
+  FusedConvertMapEntry() {
+    if( !fused_convert_map )
+      fused_convert_map = new map_type();
+    if( !fused_convert_rescale_map )
+      fused_convert_rescale_map = new map_type();
+    add_all<ConvF>( fused_convert_map );
+    add_all<RescaleF>( fused_convert_rescale_map );
+  }
+};
+
+FusedConvertMapEntry<uint8,uint8,&channel_convert_cast<uint8,uint8> > _fused_u8u8;
+FusedConvertMapEntry<uint8,uint16,&channel_convert_cast<uint8,uint16>,&channel_convert_uint8_to_uint16> _fused_u8u16;
+FusedConvertMapEntry<uint8,float,&channel_convert_cast<uint8,float>,&channel_convert_int_to_float<uint8,float> > _fused_u8f32;
+FusedConvertMapEntry<uint16,uint8,&channel_convert_cast<uint16,uint8>,&channel_convert_uint16_to_uint8> _fused_u16u8;
+FusedConvertMapEntry<uint16,uint16,&channel_convert_cast<uint16,uint16> > _fused_u16u16;
+FusedConvertMapEntry<uint16,float,&channel_convert_cast<uint16,float>,&channel_convert_int_to_float<uint16,float> > _fused_u16f32;
+FusedConvertMapEntry<float,uint8,&channel_convert_cast<float,uint8>,&channel_convert_float_to_int<float,uint8> > _fused_f32u8;
+FusedConvertMapEntry<float,uint16,&channel_convert_cast<float,uint16>,&channel_convert_float_to_int<float,uint16> > _fused_f32u16;
+FusedConvertMapEntry<float,float,&channel_convert_cast<float,float> > _fused_f32f32;
+
 void vw::convert( ImageBuffer const& dst, ImageBuffer const& src, bool rescale ) {
   VW_ASSERT( dst.format.cols==src.format.cols && dst.format.rows==src.format.rows,
              ArgumentErr() << "Destination buffer has wrong size." );
@@ -416,6 +552,34 @@ void vw::convert( ImageBuffer const& dst, ImageBuffer const& src, bool rescale )
     premultiply_dst   = (src_alpha && dst_alpha && !srcf.premultiplied && dstf.premultiplied);
   }
 
+  // Use a fused kernel when there is one for this combination and both
+  // buffers are packed pixel-by-pixel.
+  if( src.cstride == ssize_t(src_channels*src_chstride) && dst.cstride == ssize_t(dst_channels*dst_chstride) ) {
+    int32 mode = unpremultiply_src ? FUSED_UNPREMULTIPLY_SRC
+               : premultiply_src   ? FUSED_PREMULTIPLY_SRC
+               : premultiply_dst   ? FUSED_PREMULTIPLY_DST
+               : FUSED_NO_PREMULTIPLY;
+    std::map<int32,convert_row_func> const& kernels = rescale ? *fused_convert_rescale_map : *fused_convert_map;
+    std::map<int32,convert_row_func>::const_iterator kernel =
+      kernels.find( fused_convert_key( src.format.channel_type, dst.format.channel_type, src_channels, dst_channels, mode ) );
+    if( kernel != kernels.end() ) {
+      uint8 *src_ptr_p = (uint8*)src.data;
+      uint8 *dst_ptr_p = (uint8*)dst.data;
+      for( uint32 p=0; p<src.format.planes; ++p ) {
+        uint8 *src_ptr_r = src_ptr_p;
+        uint8 *dst_ptr_r = dst_ptr_p;
+        for( uint32 r=0; r<src.format.rows; ++r ) {
+          kernel->second( src_ptr_r, dst_ptr_r, src.format.cols );
+          src_ptr_r += src.rstride;
+          dst_ptr_r += dst.rstride;
+        }
+        src_ptr_p += src.pstride;
+        dst_ptr_p += dst.pstride;
+      }
+      return;
+    }
+  }
+
   bool triplicate = src_channels<3 && dst_channels>=3;
   bool average = src_channels >=3 && dst_channels<3;
   bool add_alpha = src_channels%2==1 && dst_channels%2==0;
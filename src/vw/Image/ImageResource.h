@@ -143,6 +143,10 @@ namespace vw {
         vw_throw(NoImplErr() << "This ImageResource does not support block writes");
       }
 
+      /// Can blocks be written in any order? If not, they have to arrive
+      /// left to right, top to bottom.
+      virtual bool has_unordered_block_write() const { return false; }
+
       // Does this resource have an output nodata value?
       // If you override this to true, you must implement the other nodata_write functions
       virtual bool has_nodata_write() const = 0;
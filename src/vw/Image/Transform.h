@@ -513,22 +513,38 @@ namespace vw {
   class ApproximateTransform : public TransformT {
     BBox2i m_bbox;
     ImageView<Vector2> m_table;
+
+    // Fills the n-by-n lookup table, whose node (x,y) lies at
+    // bbox.min() + elem_prod(Vector2(x,y)/(n-1), bbox.size()).  The
+    // nodes shared with prev, the (n+1)/2-square table from the last
+    // pass, are copied from it.  Transforms that can produce a whole
+    // lattice at once more cheaply than point by point may specialize
+    // this.
+    void reverse_lattice( int32 n, ImageView<Vector2> const& prev, ImageView<Vector2>& table ) const {
+      table.set_size(n,n);
+      Vector2 origin = m_bbox.min(), diag = m_bbox.size();
+      for( int y=0; y<n; ++y ) {
+        for( int x=0; x<n; ++x ) {
+          if( prev && (y%2)==0 && (x%2==0) )
+            table(x,y) = prev(x/2,y/2);
+          else
+            table(x,y) = TransformT::reverse(origin+elem_prod(Vector2(x,y)/(n-1),diag));
+        }
+      }
+    }
+
   public:
     ApproximateTransform( TransformT const& transform, BBox2i const& bbox )
-      : TransformT( transform ), m_bbox( bbox ), m_table(2,2)
+      : TransformT( transform ), m_bbox( bbox )
     {
       // Initialize with a simple 2x2 lookup table
       int32 n=2;
-      m_table(0,0) = TransformT::reverse(bbox.min());
-      m_table(1,0) = TransformT::reverse(Vector2(bbox.max().x(),bbox.min().y()));
-      m_table(0,1) = TransformT::reverse(Vector2(bbox.min().x(),bbox.max().y()));
-      m_table(1,1) = TransformT::reverse(bbox.max());
+      reverse_lattice( n, ImageView<Vector2>(), m_table );
 
       // Double the grid density until the worst (squared) approximation error
       // is less than the allowed (squared) tolerance.
       double max_sqr_err = 0;
       double tol_sqr = TransformT::tolerance() * TransformT::tolerance();
-      Vector2 origin = bbox.min(), diag = bbox.size();
       do {
         n = 2*n-1;
         // Fall back for unapproximatably crazy transform functions.
@@ -537,23 +553,17 @@ namespace vw {
           return;
         }
         ImageView<Vector2> prev = m_table;
-        m_table.set_size(n,n);
+        reverse_lattice( n, prev, m_table );
         max_sqr_err = 0;
         for( int y=0; y<n; ++y ) {
           for( int x=0; x<n; ++x ) {
-            if( (y%2)==0 && (x%2==0) ) {
-              m_table(x,y) = prev(x/2,y/2);
-            }
-            else {
-              Vector2 pos = Vector2(x,y)/(n-1);
-              m_table(x,y) = TransformT::reverse(origin+elem_prod(pos,diag));
-              Vector2 interp;
-              if( (y%2)==0 ) interp = (prev(x/2,y/2) + prev(x/2+1,y/2)) / 2.0;
-              else if( (x%2)==0 ) interp = (prev(x/2,y/2) + prev(x/2,y/2+1)) / 2.0;
-              else interp = (prev(x/2,y/2) + prev(x/2,y/2+1) + prev(x/2+1,y/2) + prev(x/2+1,y/2+1)) / 4.0;
-              double sqr_err = norm_2_sqr( m_table(x,y) - interp );
-              if( sqr_err > max_sqr_err ) max_sqr_err = sqr_err;
-            }
+            if( (y%2)==0 && (x%2==0) ) continue;
+            Vector2 interp;
+            if( (y%2)==0 ) interp = (prev(x/2,y/2) + prev(x/2+1,y/2)) / 2.0;
+            else if( (x%2)==0 ) interp = (prev(x/2,y/2) + prev(x/2,y/2+1)) / 2.0;
+            else interp = (prev(x/2,y/2) + prev(x/2,y/2+1) + prev(x/2+1,y/2) + prev(x/2+1,y/2+1)) / 4.0;
+            double sqr_err = norm_2_sqr( m_table(x,y) - interp );
+            if( sqr_err > max_sqr_err ) max_sqr_err = sqr_err;
           }
         }
       } while( max_sqr_err > tol_sqr );
@@ -0,0 +1,188 @@
+// __BEGIN_LICENSE__
+// Copyright (C) 2006-2011 United States Government as represented by
+// the Administrator of the National Aeronautics and Space Administration.
+// All Rights Reserved.
+// __END_LICENSE__
+
+
+#include <gtest/gtest.h>
+#include <test/Helpers.h>
+#include <vw/Image/AsyncBlockWriter.h>
+#include <vw/Image/ImageIO.h>
+#include <vw/Image/ImageMath.h>
+#include <vw/Image/Manipulation.h>
+
+using namespace vw;
+
+namespace {
+
+  // Keeps the pixels in memory and remembers the order the blocks came in
+  class RecordingResource : public DstImageResource {
+    bool m_unordered;
+    Vector2i m_block_size;
+    ImageView<uint32> m_image;
+    Mutex m_mutex;
+    bool m_busy;
+  public:
+    std::vector<BBox2i> writes;
+    int fail_after;
+    bool overlapped;
+
+    RecordingResource(int32 cols, int32 rows, Vector2i const& block_size, bool unordered)
+      : m_unordered(unordered), m_block_size(block_size), m_image(cols, rows), m_busy(false),
+        fail_after(-1), overlapped(false) {}
+
+    virtual void write( ImageBuffer const& buf, BBox2i const& bbox ) {
+      {
+        Mutex::Lock lock(m_mutex);
+        if (m_busy) overlapped = true;
+        m_busy = true;
+        if (fail_after >= 0 && int(writes.size()) >= fail_after) {
+          m_busy = false;
+          vw_throw( IOErr() << "RecordingResource: disk full" );
+        }
+      }
+      Thread::sleep_ms(1);
+      ImageView<uint32> block(bbox.width(), bbox.height());
+      convert( block.buffer(), buf );
+      Mutex::Lock lock(m_mutex);
+      crop(m_image, bbox) = block;
+      writes.push_back(bbox);
+      m_busy = false;
+    }
+    virtual bool has_block_write() const { return true; }
+    virtual bool has_unordered_block_write() const { return m_unordered; }
+    virtual Vector2i block_write_size() const { return m_block_size; }
+    virtual bool has_nodata_write() const { return false; }
+    virtual void flush() {}
+
+    ImageView<uint32> const& image() const { return m_image; }
+  };
+
+  std::vector<BBox2i> grid(int32 cols, int32 rows, Vector2i const& b) {
+    std::vector<BBox2i> boxes;
+    for (int32 j = 0; j < rows; j += b.y())
+      for (int32 i = 0; i < cols; i += b.x())
+        boxes.push_back(BBox2i(i, j, std::min(b.x(), cols-i), std::min(b.y(), rows-j)));
+    return boxes;
+  }
+
+  // Hands a block to the writer after a little jitter, so they show up
+  // out of order
+  class SubmitTask : public Task {
+    AsyncBlockWriter& m_writer;
+    ImageView<uint32> m_block;
+    BBox2i m_bbox;
+    int m_index;
+  public:
+    SubmitTask(AsyncBlockWriter& writer, ImageView<uint32> const& src, BBox2i const& bbox, int index)
+      : m_writer(writer), m_block(crop(src, bbox)), m_bbox(bbox), m_index(index) {}
+    virtual void operator()() {
+      Thread::sleep_ms(m_index % 3);
+      m_writer.write(m_block, m_bbox, m_index);
+    }
+  };
+
+  // Reversed, the file's first block is the last one to show up. That's
+  // only safe with a budget big enough to hold the whole image.
+  void submit_all(AsyncBlockWriter& writer, ImageView<uint32> const& src, std::vector<BBox2i> const& boxes,
+                  int threads, bool reverse = false) {
+    FifoWorkQueue queue(threads);
+    for (size_t n = 0; n < boxes.size(); ++n) {
+      int i = reverse ? int(boxes.size() - 1 - n) : int(n);
+      queue.add_task(boost::shared_ptr<Task>(new SubmitTask(writer, src, boxes[i], i)));
+    }
+    queue.join_all();
+  }
+
+  ImageView<uint32> test_image(int32 cols, int32 rows) {
+    ImageView<uint32> img(cols, rows);
+    for (int32 j = 0; j < rows; ++j)
+      for (int32 i = 0; i < cols; ++i)
+        img(i,j) = j * cols + i;
+    return img;
+  }
+}
+
+TEST(AsyncBlockWriter, Ordered) {
+  ImageView<uint32> src = test_image(50, 37);
+  Vector2i b(16, 8);
+  std::vector<BBox2i> boxes = grid(src.cols(), src.rows(), b);
+
+  RecordingResource r(src.cols(), src.rows(), b, false);
+  AsyncBlockWriter writer(r, 1 << 20);
+  EXPECT_TRUE(writer.ordered());
+  submit_all(writer, src, boxes, 4, true);
+  writer.finish();
+
+  ASSERT_EQ(boxes.size(), r.writes.size());
+  for (size_t i = 0; i < boxes.size(); ++i)
+    EXPECT_EQ(boxes[i], r.writes[i]);
+  EXPECT_FALSE(r.overlapped);
+  EXPECT_SEQ_EQ(src, r.image());
+}
+
+TEST(AsyncBlockWriter, Unordered) {
+  ImageView<uint32> src = test_image(64, 64);
+  Vector2i b(16, 16);
+  std::vector<BBox2i> boxes = grid(src.cols(), src.rows(), b);
+
+  RecordingResource r(src.cols(), src.rows(), b, true);
+  AsyncBlockWriter writer(r, 1 << 20);
+  EXPECT_FALSE(writer.ordered());
+  submit_all(writer, src, boxes, 4, true);
+  writer.finish();
+
+  EXPECT_EQ(boxes.size(), r.writes.size());
+  EXPECT_FALSE(r.overlapped);
+  EXPECT_SEQ_EQ(src, r.image());
+}
+
+TEST(AsyncBlockWriter, MemoryBudget) {
+  ImageView<uint32> src = test_image(64, 64);
+  Vector2i b(8, 8);
+  std::vector<BBox2i> boxes = grid(src.cols(), src.rows(), b);
+  const size_t block_bytes = b.x() * b.y() * sizeof(uint32);
+
+  for (int unordered = 0; unordered < 2; ++unordered) {
+    RecordingResource r(src.cols(), src.rows(), b, unordered);
+    AsyncBlockWriter writer(r, 3 * block_bytes);
+    submit_all(writer, src, boxes, 8);
+    writer.finish();
+
+    EXPECT_SEQ_EQ(src, r.image());
+    // The block the file needs next is let in regardless, so an ordered
+    // writer can go one block over.
+    EXPECT_LE(writer.peak_buffered(), (unordered ? 3 : 4) * block_bytes);
+  }
+
+  // A block larger than the budget still gets through
+  RecordingResource r(src.cols(), src.rows(), Vector2i(64, 64), true);
+  AsyncBlockWriter writer(r, 16);
+  writer.write(src, BBox2i(0, 0, 64, 64), 0);
+  writer.finish();
+  EXPECT_SEQ_EQ(src, r.image());
+}
+
+TEST(AsyncBlockWriter, WriteError) {
+  ImageView<uint32> src = test_image(64, 64);
+  Vector2i b(16, 16);
+  std::vector<BBox2i> boxes = grid(src.cols(), src.rows(), b);
+
+  RecordingResource r(src.cols(), src.rows(), b, true);
+  r.fail_after = 3;
+  AsyncBlockWriter writer(r, 2 * b.x() * b.y() * sizeof(uint32));
+  submit_all(writer, src, boxes, 4);
+  EXPECT_THROW(writer.finish(), IOErr);
+  EXPECT_EQ(3u, r.writes.size());
+}
+
+TEST(AsyncBlockWriter, BlockWriteImage) {
+  ImageView<uint32> src = test_image(100, 70);
+  for (int unordered = 0; unordered < 2; ++unordered) {
+    RecordingResource r(src.cols(), src.rows(), Vector2i(32, 16), unordered);
+    block_write_image(r, src + 1);
+    EXPECT_EQ(4u * 5u, r.writes.size());
+    EXPECT_SEQ_EQ(src + 1, r.image());
+  }
+}
@@ -63,6 +63,93 @@ TEST( ImageResource, PreMultiply ) {
   EXPECT_RANGE_EQ(buf3_data+0, buf3_data+4, buf1_data+0, buf1_data+4);
 }
 
+// Fills a buffer with arbitrary pixels whose color channels never exceed
+// their alpha, so that (un)premultiplying them stays in range.
+template <class T>
+void fill_test_pixels( ImageBuffer const& buf, bool has_alpha, double max ) {
+  const size_t channels = num_channels(buf.format.pixel_format);
+  const size_t n = buf.format.cols * buf.format.rows * buf.format.planes;
+  T* data = static_cast<T*>(buf.data);
+  for (size_t i = 0; i < n; ++i) {
+    double alpha = has_alpha ? 0.5 + 0.5 * double((i * 37) % 17) / 16. : 1.;
+    for (size_t ch = 0; ch < channels; ++ch)
+      data[i*channels+ch] = T(max * alpha * double((i * 7 + ch * 13) % 23) / 22.);
+    if (has_alpha)
+      data[i*channels+channels-1] = T(max * alpha);
+  }
+}
+
+// Runs convert() from a copy of src whose pixels are spaced apart, which
+// sends it down the generic per-channel path rather than a fused kernel.
+void convert_generic( ImageBuffer const& dst, ImageBuffer const& src, bool rescale, std::vector<uint8>& storage ) {
+  const ssize_t px = src.cstride;
+  ImageBuffer padded = src;
+  padded.cstride = px + 8;
+  padded.rstride = padded.cstride * src.format.cols;
+  padded.pstride = padded.rstride * src.format.rows;
+  storage.resize(padded.pstride * src.format.planes);
+  padded.data = &storage[0];
+  for (size_t i = 0; i < size_t(src.format.cols * src.format.rows * src.format.planes); ++i)
+    std::copy(static_cast<uint8*>(src.data) + i*px, static_cast<uint8*>(src.data) + (i+1)*px, &storage[i*padded.cstride]);
+  convert(dst, padded, rescale);
+}
+
+TEST( ImageResource, ConvertFused ) {
+  const PixelFormatEnum pfmts[] = {VW_PIXEL_GRAY, VW_PIXEL_GRAYA, VW_PIXEL_RGB, VW_PIXEL_RGBA};
+  const ChannelTypeEnum ctypes[] = {VW_CHANNEL_UINT8, VW_CHANNEL_UINT16, VW_CHANNEL_FLOAT32};
+
+  std::vector<uint8> src_data, fused_data, generic_data, storage;
+  for (int sp = 0; sp < 4; ++sp) for (int sc = 0; sc < 3; ++sc)
+  for (int dp = 0; dp < 4; ++dp) for (int dc = 0; dc < 3; ++dc)
+  for (int flags = 0; flags < 8; ++flags) {
+    ImageFormat sfmt, dfmt;
+    sfmt.cols = dfmt.cols = 5;
+    sfmt.rows = dfmt.rows = 3;
+    sfmt.planes = dfmt.planes = 2;
+    sfmt.pixel_format = pfmts[sp];
+    sfmt.channel_type = ctypes[sc];
+    sfmt.premultiplied = flags & 1;
+    dfmt.pixel_format = pfmts[dp];
+    dfmt.channel_type = ctypes[dc];
+    dfmt.premultiplied = flags & 2;
+    bool rescale = flags & 4;
+
+    src_data.assign(sfmt.byte_size(), 0);
+    fused_data.assign(dfmt.byte_size(), 0);
+    generic_data.assign(dfmt.byte_size(), 0);
+    ImageBuffer src(sfmt, &src_data[0]), fused(dfmt, &fused_data[0]), generic(dfmt, &generic_data[0]);
+
+    bool alpha = sfmt.pixel_format == VW_PIXEL_GRAYA || sfmt.pixel_format == VW_PIXEL_RGBA;
+    switch (sfmt.channel_type) {
+      case VW_CHANNEL_UINT8:  fill_test_pixels<uint8>(src, alpha, 255); break;
+      case VW_CHANNEL_UINT16: fill_test_pixels<uint16>(src, alpha, 65535); break;
+      default:                fill_test_pixels<float>(src, alpha, 1); break;
+    }
+
+    convert(fused, src, rescale);
+    convert_generic(generic, src, rescale, storage);
+    EXPECT_RANGE_EQ(generic_data.begin(), generic_data.end(), fused_data.begin(), fused_data.end())
+      << pixel_format_name(sfmt.pixel_format) << "/" << channel_type_name(sfmt.channel_type) << " -> "
+      << pixel_format_name(dfmt.pixel_format) << "/" << channel_type_name(dfmt.channel_type)
+      << " flags " << flags;
+  }
+
+  // And spot-check the most common read conversion
+  PixelRGB<uint8> rgb[2] = {PixelRGB<uint8>(0, 51, 255), PixelRGB<uint8>(102, 204, 1)};
+  PixelRGBA<float> rgba[2];
+  ImageFormat rgb_fmt, rgba_fmt;
+  rgb_fmt.cols = rgba_fmt.cols = 2;
+  rgb_fmt.rows = rgba_fmt.rows = 1;
+  rgb_fmt.planes = rgba_fmt.planes = 1;
+  rgb_fmt.pixel_format = VW_PIXEL_RGB;
+  rgb_fmt.channel_type = VW_CHANNEL_UINT8;
+  rgba_fmt.pixel_format = VW_PIXEL_RGBA;
+  rgba_fmt.channel_type = VW_CHANNEL_FLOAT32;
+  convert(ImageBuffer(rgba_fmt, rgba), ImageBuffer(rgb_fmt, rgb), true);
+  EXPECT_PIXEL_NEAR(PixelRGBA<float>(0, .2f, 1, 1),    rgba[0], 1e-6);
+  EXPECT_PIXEL_NEAR(PixelRGBA<float>(.4f, .8f, 1.f/255, 1), rgba[1], 1e-6);
+}
+
 class SrcNoopResource : public SrcImageResource {
   private:
     const ImageFormat& m_fmt;
@@ -22,7 +22,7 @@
 #if VW_HAVE_PKG_FLANN
 #include <vw/Math/FLANNTree.h>
 #else
-#include <vw/Math/KDTree.h>
+#include <vw/Math/FlatKDTree.h>
 #endif
 
 namespace vw {
@@ -161,12 +161,13 @@ namespace ip {
       math::FLANNTree<flann::L2<float> > kd( ip2_matrix );
       vw_out(InfoMessage,"interest_point") << "FLANN-Tree created. Searching...\n";
 
-      Vector<int> indices(2);
-      Vector<float> distances(2);
 #else
-      math::KDTree<ListT> kd(ip2.begin()->size(), ip2);
-      vw_out(InfoMessage,"interest_point") << "KD-Tree created with " << kd.size() << " nodes and depth ranging from " << kd.min_depth() << " to " << kd.max_depth() << ".  Searching...\n";
+      math::FlatKDTree<float> kd( ip2.begin(), ip2.end() );
+      vw_out(InfoMessage,"interest_point") << "KD-Tree created with " << kd.size() << " points in " << kd.num_nodes() << " nodes.  Searching...\n";
 #endif
+
+      Vector<int> indices(2);
+      Vector<float> distances(2);
       progress_callback.report_progress(0);
 
       BOOST_FOREACH( InterestPoint ip, ip1 ) {
@@ -174,16 +175,15 @@ namespace ip {
           vw_throw( Aborted() << "Aborted by ProgressCallback" );
         progress_callback.report_incremental_progress(inc_amt);
 
-        std::vector<InterestPoint> nearest_records(2);
 #if VW_HAVE_PKG_FLANN
         kd.knn_search( ip.descriptor, indices, distances, 2 );
-        nearest_records[0] = ip2[indices[0]];
-        nearest_records[1] = ip2[indices[1]];
 #else
-        int num_records = kd.m_nearest_neighbors(ip, nearest_records, 2);
-        if (num_records != 2)
+        if ( kd.knn_search( ip.descriptor, indices, distances, 2 ) != 2 )
           continue; // Ignore if there are no matches
 #endif
+        std::vector<InterestPoint> nearest_records(2);
+        nearest_records[0] = ip2[indices[0]];
+        nearest_records[1] = ip2[indices[1]];
 
         bool constraint_satisfied = false;
         if (bidirectional) {
@@ -252,12 +252,13 @@ namespace ip {
       math::FLANNTree<flann::L2<float> > kd( ip2_matrix );
       vw_out(InfoMessage,"interest_point") << "FLANN-Tree created. Searching...\n";
 
-      Vector<int> indices(2);
-      Vector<float> distances(2);
 #else
-      math::KDTree<ListT> kd(ip2.begin()->size(), ip2);
-      vw_out(InfoMessage,"interest_point") << "KD-Tree created with " << kd.size() << " nodes and depth ranging from " << kd.min_depth() << " to " << kd.max_depth() << ".  Searching...\n";
+      math::FlatKDTree<float> kd( ip2.begin(), ip2.end() );
+      vw_out(InfoMessage,"interest_point") << "KD-Tree created with " << kd.size() << " points in " << kd.num_nodes() << " nodes.  Searching...\n";
 #endif
+
+      Vector<int> indices(2);
+      Vector<float> distances(2);
       progress_callback.report_progress(0);
 
       BOOST_FOREACH( InterestPoint ip, ip1 ) {
@@ -265,26 +266,16 @@ namespace ip {
           vw_throw( Aborted() << "Aborted by ProgressCallback" );
         progress_callback.report_incremental_progress(inc_amt);
 
-
 #if VW_HAVE_PKG_FLANN
         kd.knn_search( ip.descriptor, indices, distances, 2 );
-        if ( distances[0] < m_threshold * distances[1] ) {
-          matched_ip1.push_back(ip);
-          matched_ip2.push_back(ip2[indices[0]]);
-        }
 #else
-        std::vector<InterestPoint> nearest_records(2);
-        int num_records = kd.m_nearest_neighbors(ip, nearest_records, 2);
-        if (num_records != 2)
+        if ( kd.knn_search( ip.descriptor, indices, distances, 2 ) != 2 )
           continue; // Ignore if there are no matches
-        double dist0 = m_metric(nearest_records[0], ip);
-        double dist1 = m_metric(nearest_records[1], ip);
-
-        if (dist0 < m_threshold * dist1) {
+#endif
+        if ( distances[0] < m_threshold * distances[1] ) {
           matched_ip1.push_back(ip);
-          matched_ip2.push_back(nearest_records[0]);
+          matched_ip2.push_back(ip2[indices[0]]);
         }
-#endif
       }
 
       progress_callback.report_finished();
@@ -229,6 +229,41 @@ namespace math{
     return pos;
   }
 
+
+  /// Solves the symmetric positive definite linear system A*x = b by
+  /// preconditioned conjugate gradients, starting from the given x.
+  /// op(v) must return A*v, and precond(r) an approximation of
+  /// inverse(A)*r (see BlockJacobiPreconditioner in
+  /// MatrixSparseBlock.h).  Stops once the residual has shrunk to tol
+  /// times the norm of b, or after max_iters iterations, and returns
+  /// the number of iterations used.
+  template <class OperatorT, class PreconditionerT, class VectorT>
+  int preconditioned_conjugate_gradient( OperatorT const& op,
+                                         PreconditionerT const& precond,
+                                         VectorT const& b, VectorT& x,
+                                         double tol, int max_iters ) {
+    VectorT r = b - op(x);
+    VectorT z = precond(r);
+    VectorT p = z;
+    double rz = dot_prod(r,z);
+    double threshold = tol * norm_2(b);
+    int i = 0;
+    for( ; i<max_iters && norm_2(r) > threshold; ++i ) {
+      VectorT q = op(p);
+      double pq = dot_prod(p,q);
+      if( pq <= 0 ) break; // Not positive definite along p
+      double alpha = rz / pq;
+      x += alpha * p;
+      r -= alpha * q;
+      z = precond(r);
+      double rz_new = dot_prod(r,z);
+      p = z + (rz_new/rz) * p;
+      rz = rz_new;
+    }
+    vw_out(DebugMessage, "math") << "PCG: " << i << " iterations, residual " << norm_2(r) << std::endl;
+    return i;
+  }
+
 } } // namespace vw::math
 
 #endif // #ifndef __VW_MATH_CONJUGATEGRADIENT_H__
@@ -0,0 +1,405 @@
+// __BEGIN_LICENSE__
+// Copyright (C) 2006-2011 United States Government as represented by
+// the Administrator of the National Aeronautics and Space Administration.
+// All Rights Reserved.
+// __END_LICENSE__
+
+
+/// \file FlatKDTree.h
+///
+/// A static kd-tree stored in flat arrays, for nearest neighbor
+/// searches over a fixed set of points.
+///
+/// Unlike math::KDTree, which keeps one record per graph vertex and
+/// reaches everything through property maps, this tree copies the
+/// points into one contiguous block, reordered so that each leaf's
+/// points sit next to each other, and keeps its nodes in a single
+/// vector in depth-first order.  A search walks the nodes and scans
+/// whole leaves linearly, which is far kinder to the cache.
+///
+/// Distances are squared Euclidean distances, the same as
+/// flann::L2, so FlatKDTree can stand in for FLANNTree.
+///
+#ifndef __VW_MATH_FLATKDTREE_H__
+#define __VW_MATH_FLATKDTREE_H__
+
+#include <vector>
+#include <queue>
+#include <limits>
+#include <iterator>
+#include <algorithm>
+#include <functional>
+
+#include <vw/Core/Exception.h>
+#include <vw/Core/FundamentalTypes.h>
+#include <vw/Math/Vector.h>
+#include <vw/Math/Matrix.h>
+
+namespace vw {
+namespace math {
+
+  /// A kd-tree over a fixed list of points of one dimension.  Each
+  /// node splits its points at the median of the dimension in which
+  /// they are most spread out, until no more than leaf_size are left.
+  ///
+  /// Searches are exact unless given a positive max_checks, in which
+  /// case they run best-bin-first (Beis & Lowe 1997): leaves are
+  /// visited in order of their estimated distance to the query, and
+  /// the search stops once max_checks points have been compared.
+  /// This finds the true nearest neighbors most of the time at a
+  /// fraction of the cost, which matters for high dimensional
+  /// descriptors where an exact search ends up visiting most leaves.
+  ///
+  /// The records can be anything with size(), begin() and end(), such
+  /// as a Vector, an InterestPoint or a point read by read_point_list.
+  /// The tree does not track changes to the records; build it again
+  /// after modifying them.
+  template <class ElemT = float>
+  class FlatKDTree {
+  public:
+    typedef ElemT element_type;
+    typedef ElemT distance_type;
+
+  private:
+    static const uint32 LEAF = 0xFFFFFFFF;
+
+    // Internal nodes are followed by their LO child; hi is the index
+    // of their HI child.  Leaves hold the points [begin,end).
+    struct Node {
+      uint32 dim;
+      uint32 begin, end, hi;
+      ElemT split;
+    };
+
+    // A branch not yet searched, with a lower estimate of its distance
+    struct Branch {
+      distance_type dist;
+      uint32 node;
+      Branch( distance_type d, uint32 n ) : dist(d), node(n) {}
+      bool operator>( Branch const& b ) const { return dist > b.dist; }
+    };
+    typedef std::priority_queue<Branch, std::vector<Branch>, std::greater<Branch> > branch_queue;
+
+    // The knn best points found so far, in increasing distance
+    class Neighbors {
+      size_t m_knn;
+      std::vector<std::pair<distance_type, uint32> > m_best;
+    public:
+      Neighbors( size_t knn ) : m_knn(knn) { m_best.reserve( knn + 1 ); }
+      distance_type worst() const {
+        return m_best.size() < m_knn ? std::numeric_limits<distance_type>::max() : m_best.back().first;
+      }
+      void add( distance_type dist, uint32 index ) {
+        if ( dist >= worst() )
+          return;
+        if ( m_best.size() == m_knn )
+          m_best.pop_back();
+        std::pair<distance_type, uint32> p( dist, index );
+        m_best.insert( std::upper_bound( m_best.begin(), m_best.end(), p ), p );
+      }
+      size_t size() const { return m_best.size(); }
+      std::pair<distance_type, uint32> const& operator[]( size_t i ) const { return m_best[i]; }
+    };
+
+    size_t m_dim;
+    std::vector<ElemT> m_points;  // Row per point, in leaf order
+    std::vector<uint32> m_index;  // Original index of each row
+    std::vector<Node> m_nodes;
+
+    // Sorts points by one coordinate of the original, unsorted points
+    struct CoordinateLess {
+      ElemT const* points;
+      size_t dim, d;
+      CoordinateLess( ElemT const* p, size_t dim, size_t d ) : points(p), dim(dim), d(d) {}
+      bool operator()( uint32 a, uint32 b ) const { return points[a*dim+d] < points[b*dim+d]; }
+    };
+
+    uint32 build_node( std::vector<ElemT> const& points, uint32 begin, uint32 end, size_t leaf_size ) {
+      uint32 n = m_nodes.size();
+      m_nodes.push_back( Node() );
+      m_nodes[n].begin = begin;
+      m_nodes[n].end = end;
+      m_nodes[n].dim = LEAF;
+      if ( end - begin <= leaf_size )
+        return n;
+
+      // Split along the dimension of largest spread
+      size_t best_dim = 0;
+      ElemT best_spread = 0;
+      for ( size_t d = 0; d < m_dim; ++d ) {
+        ElemT lo = points[m_index[begin]*m_dim+d], hi = lo;
+        for ( uint32 i = begin+1; i < end; ++i ) {
+          ElemT x = points[m_index[i]*m_dim+d];
+          if ( x < lo ) lo = x;
+          else if ( x > hi ) hi = x;
+        }
+        if ( hi - lo > best_spread ) {
+          best_spread = hi - lo;
+          best_dim = d;
+        }
+      }
+      if ( best_spread == 0 )
+        return n; // All the points are the same
+
+      uint32 mid = begin + ( end - begin ) / 2;
+      std::nth_element( m_index.begin()+begin, m_index.begin()+mid, m_index.begin()+end,
+                        CoordinateLess( &points[0], m_dim, best_dim ) );
+      m_nodes[n].dim = best_dim;
+      m_nodes[n].split = points[m_index[mid]*m_dim+best_dim];
+      build_node( points, begin, mid, leaf_size );
+      uint32 hi = build_node( points, mid, end, leaf_size );
+      m_nodes[n].hi = hi;
+      return n;
+    }
+
+    template <class IterT>
+    void build( IterT begin, IterT end, size_t leaf_size ) {
+      VW_ASSERT( leaf_size > 0, ArgumentErr() << "FlatKDTree: leaf size must be positive." );
+      std::vector<ElemT> points;
+      size_t num_points = 0;
+      for ( ; begin != end; ++begin, ++num_points ) {
+        if ( num_points == 0 )
+          m_dim = begin->size();
+        VW_ASSERT( size_t(begin->size()) == m_dim,
+                   ArgumentErr() << "FlatKDTree: all points must have the same dimension." );
+        std::copy( begin->begin(), begin->end(), std::back_inserter( points ) );
+      }
+      VW_ASSERT( num_points < LEAF, ArgumentErr() << "FlatKDTree: too many points." );
+
+      m_index.resize( num_points );
+      for ( uint32 i = 0; i < num_points; ++i )
+        m_index[i] = i;
+      if ( num_points == 0 )
+        return;
+      build_node( points, 0, num_points, leaf_size );
+
+      // Lay the points out in the order the leaves reach them
+      m_points.resize( points.size() );
+      for ( uint32 i = 0; i < num_points; ++i )
+        std::copy( &points[0] + m_index[i]*m_dim, &points[0] + (m_index[i]+1)*m_dim, &m_points[0] + i*m_dim );
+    }
+
+    // Squared distance to row i, or something over max once it is
+    // clear the distance will be.
+    distance_type distance( ElemT const* query, uint32 i, distance_type max ) const {
+      ElemT const* p = &m_points[i*m_dim];
+      distance_type dist = 0;
+      for ( size_t d = 0; d < m_dim; ++d ) {
+        distance_type diff = query[d] - p[d];
+        dist += diff * diff;
+        if ( dist > max )
+          break;
+      }
+      return dist;
+    }
+
+    void search_leaf( Node const& node, ElemT const* query, Neighbors& result ) const {
+      for ( uint32 i = node.begin; i < node.end; ++i )
+        result.add( distance( query, i, result.worst() ), i );
+    }
+
+    // Exact search.  offsets holds the distance from the query to the
+    // node's cell along each dimension, and dist the squared length
+    // of offsets, after Arya & Mount 1993.
+    void search_exact( uint32 n, ElemT const* query, distance_type dist,
+                       std::vector<distance_type>& offsets, Neighbors& result ) const {
+      Node const& node = m_nodes[n];
+      if ( node.dim == LEAF ) {
+        search_leaf( node, query, result );
+        return;
+      }
+      distance_type diff = query[node.dim] - node.split;
+      uint32 near = n+1, far = node.hi;
+      if ( diff >= 0 )
+        std::swap( near, far );
+      search_exact( near, query, dist, offsets, result );
+
+      distance_type old = offsets[node.dim];
+      distance_type far_dist = dist - old*old + diff*diff;
+      if ( far_dist < result.worst() ) {
+        offsets[node.dim] = diff;
+        search_exact( far, query, far_dist, offsets, result );
+        offsets[node.dim] = old;
+      }
+    }
+
+    // Finds every point within squared distance max_dist, pruning
+    // cells the same way as search_exact.
+    void search_radius( uint32 n, ElemT const* query, distance_type dist,
+                        std::vector<distance_type>& offsets, distance_type max_dist,
+                        std::vector<int>& indices ) const {
+      Node const& node = m_nodes[n];
+      if ( node.dim == LEAF ) {
+        for ( uint32 i = node.begin; i < node.end; ++i )
+          if ( distance( query, i, max_dist ) <= max_dist )
+            indices.push_back( m_index[i] );
+        return;
+      }
+      distance_type diff = query[node.dim] - node.split;
+      uint32 near = n+1, far = node.hi;
+      if ( diff >= 0 )
+        std::swap( near, far );
+      search_radius( near, query, dist, offsets, max_dist, indices );
+
+      distance_type old = offsets[node.dim];
+      distance_type far_dist = dist - old*old + diff*diff;
+      if ( far_dist <= max_dist ) {
+        offsets[node.dim] = diff;
+        search_radius( far, query, far_dist, offsets, max_dist, indices );
+        offsets[node.dim] = old;
+      }
+    }
+
+    // Best-bin-first search.  The distance of each branch left behind
+    // is estimated by adding the squared distance to its splitting
+    // plane, which can overestimate, so this search is approximate.
+    void search_bbf( ElemT const* query, size_t max_checks, branch_queue& queue, Neighbors& result ) const {
+      size_t checks = 0;
+      queue.push( Branch( 0, 0 ) );
+      while ( !queue.empty() && checks < max_checks ) {
+        Branch branch = queue.top();
+        queue.pop();
+        if ( branch.dist >= result.worst() )
+          break;
+        uint32 n = branch.node;
+        while ( m_nodes[n].dim != LEAF ) {
+          Node const& node = m_nodes[n];
+          distance_type diff = query[node.dim] - node.split;
+          uint32 near = n+1, far = node.hi;
+          if ( diff >= 0 )
+            std::swap( near, far );
+          distance_type far_dist = branch.dist + diff*diff;
+          if ( far_dist < result.worst() )
+            queue.push( Branch( far_dist, far ) );
+          n = near;
+        }
+        search_leaf( m_nodes[n], query, result );
+        checks += m_nodes[n].end - m_nodes[n].begin;
+      }
+      while ( !queue.empty() )
+        queue.pop();
+    }
+
+    void search( ElemT const* query, size_t max_checks, std::vector<distance_type>& offsets,
+                 branch_queue& queue, Neighbors& result ) const {
+      if ( m_nodes.empty() )
+        return;
+      if ( max_checks == 0 ) {
+        offsets.assign( m_dim, 0 );
+        search_exact( 0, query, 0, offsets, result );
+      } else {
+        search_bbf( query, max_checks, queue, result );
+      }
+    }
+
+  public:
+    FlatKDTree() : m_dim(0) {}
+
+    /// Builds the tree over the records in [begin,end).
+    template <class IterT>
+    FlatKDTree( IterT begin, IterT end, size_t leaf_size = 8 ) : m_dim(0) {
+      build( begin, end, leaf_size );
+    }
+
+    /// Builds the tree over the rows of a matrix.
+    template <class MatrixT>
+    FlatKDTree( MatrixBase<MatrixT> const& points, size_t leaf_size = 8 ) : m_dim(0) {
+      std::vector<Vector<ElemT> > rows( points.impl().rows() );
+      for ( size_t i = 0; i < rows.size(); ++i )
+        rows[i] = select_row( points.impl(), i );
+      build( rows.begin(), rows.end(), leaf_size );
+    }
+
+    /// The number of points in the tree.
+    size_t size() const { return m_index.size(); }
+
+    /// The dimension of the points.
+    size_t dimension() const { return m_dim; }
+
+    /// The number of nodes, leaves included.
+    size_t num_nodes() const { return m_nodes.size(); }
+
+    /// Finds the knn points nearest the query, in increasing distance.
+    /// indices receives their positions in the list the tree was
+    /// built from, and dists their squared distances.  Both are sized
+    /// to the number found, which is less than knn only if the tree
+    /// holds fewer points.  A positive max_checks makes the search
+    /// best-bin-first, giving up after comparing that many points.
+    template <class VectorT>
+    size_t knn_search( VectorBase<VectorT> const& query,
+                       Vector<int>& indices,
+                       Vector<distance_type>& dists,
+                       size_t knn, size_t max_checks = 0 ) const {
+      VW_ASSERT( size_t(query.impl().size()) == m_dim,
+                 ArgumentErr() << "FlatKDTree: query has the wrong dimension." );
+      Vector<ElemT> q = query.impl();
+      std::vector<distance_type> offsets;
+      branch_queue queue;
+      Neighbors result( knn );
+      if ( knn > 0 )
+        search( &q[0], max_checks, offsets, queue, result );
+
+      indices.set_size( result.size() );
+      dists.set_size( result.size() );
+      for ( size_t i = 0; i < result.size(); ++i ) {
+        dists[i] = result[i].first;
+        indices[i] = m_index[result[i].second];
+      }
+      return result.size();
+    }
+
+    /// Finds the knn nearest points to each row of queries.  Row i of
+    /// indices and dists holds the result for row i of queries; when
+    /// the tree has fewer than knn points the missing entries are -1
+    /// and the largest distance_type.
+    template <class MatrixT>
+    void knn_search( MatrixBase<MatrixT> const& queries,
+                     Matrix<int>& indices,
+                     Matrix<distance_type>& dists,
+                     size_t knn, size_t max_checks = 0 ) const {
+      MatrixT const& Q = queries.impl();
+      VW_ASSERT( size_t(Q.cols()) == m_dim,
+                 ArgumentErr() << "FlatKDTree: queries have the wrong dimension." );
+      indices.set_size( Q.rows(), knn );
+      dists.set_size( Q.rows(), knn );
+      std::fill( indices.begin(), indices.end(), -1 );
+      std::fill( dists.begin(), dists.end(), std::numeric_limits<distance_type>::max() );
+      if ( knn == 0 )
+        return;
+
+      // The scratch space is shared by all of the queries
+      std::vector<ElemT> q( m_dim );
+      std::vector<distance_type> offsets;
+      branch_queue queue;
+      for ( size_t r = 0; r < Q.rows(); ++r ) {
+        for ( size_t d = 0; d < m_dim; ++d )
+          q[d] = Q(r,d);
+        Neighbors result( knn );
+        search( &q[0], max_checks, offsets, queue, result );
+        for ( size_t i = 0; i < result.size(); ++i ) {
+          dists(r,i) = result[i].first;
+          indices(r,i) = m_index[result[i].second];
+        }
+      }
+    }
+
+    /// Replaces indices with the positions, in increasing order, of
+    /// the points within squared distance max_dist of the query.
+    template <class VectorT>
+    void radius_search( VectorBase<VectorT> const& query, distance_type max_dist,
+                        std::vector<int>& indices ) const {
+      VW_ASSERT( size_t(query.impl().size()) == m_dim,
+                 ArgumentErr() << "FlatKDTree: query has the wrong dimension." );
+      indices.clear();
+      if ( m_nodes.empty() )
+        return;
+      Vector<ElemT> q = query.impl();
+      std::vector<distance_type> offsets( m_dim, 0 );
+      search_radius( 0, &q[0], 0, offsets, max_dist, indices );
+      std::sort( indices.begin(), indices.end() );
+    }
+  };
+
+}} // namespace vw::math
+
+#endif // __VW_MATH_FLATKDTREE_H__
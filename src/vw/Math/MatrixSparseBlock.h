@@ -0,0 +1,614 @@
+// __BEGIN_LICENSE__
+// Copyright (C) 2006-2011 United States Government as represented by
+// the Administrator of the National Aeronautics and Space Administration.
+// All Rights Reserved.
+// __END_LICENSE__
+
+
+/// \file MatrixSparseBlock.h
+///
+/// A symmetric sparse matrix made of dense square blocks, such as the
+/// reduced camera system of a bundle adjustment, together with a
+/// fill-reducing ordering, a supernodal L*D*L^T factorization and a
+/// block-Jacobi preconditioner for use with conjugate gradients.
+///
+/// Unlike the skyline solver, which fills in every entry between a
+/// row's first non-zero and the diagonal, the factorization here only
+/// stores the structure of L, and does its arithmetic on dense panels
+/// of columns that share that structure (supernodes).
+
+#ifndef __VW_MATH_SPARSE_BLOCK_MATRIX_H__
+#define __VW_MATH_SPARSE_BLOCK_MATRIX_H__
+
+#include <map>
+#include <vector>
+#include <algorithm>
+
+// Vision Workbench
+#include <vw/Core/Log.h>
+#include <vw/Math/Vector.h>
+#include <vw/Math/Matrix.h>
+#include <vw/Math/MatrixSparseSkyline.h>
+
+// Boost
+#include <boost/graph/adjacency_list.hpp>
+#include <boost/graph/minimum_degree_ordering.hpp>
+
+namespace vw {
+namespace math {
+
+  //------------------------------------------------------------------
+  //                 Sparse Block Matrix
+  //
+  // Symmetric, so only the blocks on and below the diagonal are kept:
+  // column j maps each row block i >= j to its dense block.
+  //------------------------------------------------------------------
+  template <class ElemT>
+  class MatrixSparseBlock {
+  public:
+    typedef ElemT value_type;
+    typedef std::map<size_t, Matrix<ElemT> > column_type;
+
+  private:
+    size_t m_block_size;
+    std::vector<column_type> m_columns;
+
+  public:
+    MatrixSparseBlock( size_t num_blocks = 0, size_t block_size = 1 ) :
+      m_block_size(block_size), m_columns(num_blocks) {}
+
+    size_t num_blocks() const { return m_columns.size(); }
+    size_t block_size() const { return m_block_size; }
+    size_t rows() const { return num_blocks() * m_block_size; }
+    size_t cols() const { return rows(); }
+
+    column_type const& column( size_t j ) const { return m_columns[j]; }
+
+    /// The block at (i,j), i >= j, created as zeros on first use.
+    Matrix<ElemT>& block( size_t i, size_t j ) {
+      VW_ASSERT( i >= j && i < num_blocks(),
+                 ArgumentErr() << "MatrixSparseBlock: only blocks on or below the diagonal are stored." );
+      typename column_type::iterator it = m_columns[j].find( i );
+      if ( it == m_columns[j].end() )
+        it = m_columns[j].insert( std::make_pair( i, Matrix<ElemT>( m_block_size, m_block_size ) ) ).first;
+      return it->second;
+    }
+
+    bool has_block( size_t i, size_t j ) const {
+      return m_columns[j].find( i ) != m_columns[j].end();
+    }
+
+    /// Number of stored blocks
+    size_t nonzero_blocks() const {
+      size_t count = 0;
+      for ( size_t j = 0; j < m_columns.size(); j++ )
+        count += m_columns[j].size();
+      return count;
+    }
+  };
+
+  /// Copies a skyline matrix into blocks of the given size.
+  template <class ElemT>
+  MatrixSparseBlock<ElemT> sparse_block_matrix( MatrixSparseSkyline<ElemT> const& A,
+                                                size_t block_size ) {
+    VW_ASSERT( A.rows() % block_size == 0,
+               ArgumentErr() << "sparse_block_matrix: size is not a multiple of the block size." );
+    MatrixSparseBlock<ElemT> result( A.rows() / block_size, block_size );
+    // Only the lower triangle is stored in the skyline matrix
+    for ( typename MatrixSparseSkyline<ElemT>::const_sparse_iterator1 it1 = A.sparse_begin();
+          it1 != A.sparse_end(); it1++ ) {
+      for ( typename MatrixSparseSkyline<ElemT>::const_sparse_iterator2 it2 = it1.begin();
+            it2 != it1.end(); it2++ ) {
+        size_t i = it2.index1(), j = it2.index2();
+        Matrix<ElemT>& M = result.block( i / block_size, j / block_size );
+        M( i % block_size, j % block_size ) = *it2;
+        if ( i / block_size == j / block_size )
+          M( j % block_size, i % block_size ) = *it2;
+      }
+    }
+    return result;
+  }
+
+  /// y = A*x, using both triangles of the symmetric matrix.
+  template <class ElemT, class VectorT>
+  Vector<ElemT> sparse_multiply( MatrixSparseBlock<ElemT> const& A,
+                                 VectorBase<VectorT> const& x_ ) {
+    VectorT const& x = x_.impl();
+    VW_ASSERT( x.size() == A.cols(), ArgumentErr() << "sparse_multiply: size mismatch." );
+    size_t bs = A.block_size();
+    Vector<ElemT> y( A.rows() );
+    typedef typename MatrixSparseBlock<ElemT>::column_type::const_iterator block_iter;
+    for ( size_t j = 0; j < A.num_blocks(); j++ ) {
+      for ( block_iter it = A.column(j).begin(); it != A.column(j).end(); it++ ) {
+        size_t i = it->first;
+        Matrix<ElemT> const& M = it->second;
+        for ( size_t r = 0; r < bs; r++ )
+          for ( size_t c = 0; c < bs; c++ ) {
+            y[i*bs+r] += M(r,c) * x[j*bs+c];
+            if ( i != j )
+              y[j*bs+c] += M(r,c) * x[i*bs+r];
+          }
+      }
+    }
+    return y;
+  }
+
+  //------------------------------------------------------------------
+  // Minimum Degree Ordering
+  //
+  // Orders the blocks to reduce the fill-in of the factorization, as
+  // opposed to cuthill_mckee_ordering which reduces the bandwidth.
+  // Returns a lookup chart in the same sense as cuthill_mckee_ordering:
+  // the new block i is the old block lookup[i].
+  //------------------------------------------------------------------
+  template <class ElemT>
+  std::vector<size_t> minimum_degree_ordering( MatrixSparseBlock<ElemT> const& A ) {
+    size_t n = A.num_blocks();
+    std::vector<size_t> lookup_chart( n );
+    for ( size_t i = 0; i < n; i++ )
+      lookup_chart[i] = i;
+    // Nothing to gain below three blocks (and boost's implementation
+    // overruns its degree lists on a connected pair).
+    if ( n < 3 ) return lookup_chart;
+
+    // boost's minimum degree wants a directed graph holding both
+    // directions of each edge.
+    typedef boost::adjacency_list<boost::vecS, boost::vecS, boost::directedS> Graph;
+    Graph G( n );
+    typedef typename MatrixSparseBlock<ElemT>::column_type::const_iterator block_iter;
+    for ( size_t j = 0; j < n; j++ )
+      for ( block_iter it = A.column(j).begin(); it != A.column(j).end(); it++ )
+        if ( it->first != j ) {
+          boost::add_edge( it->first, j, G );
+          boost::add_edge( j, it->first, G );
+        }
+
+    std::vector<int> inverse_perm( n, 0 ), perm( n, 0 ), degree( n, 0 ), supernode_sizes( n, 1 );
+    boost::property_map<Graph, boost::vertex_index_t>::type id = get( boost::vertex_index, G );
+    boost::minimum_degree_ordering( G,
+                                    make_iterator_property_map( &degree[0], id, degree[0] ),
+                                    &inverse_perm[0], &perm[0],
+                                    make_iterator_property_map( &supernode_sizes[0], id, supernode_sizes[0] ),
+                                    0, id );
+
+    for ( size_t i = 0; i < n; i++ )
+      lookup_chart[i] = perm[i];
+    return lookup_chart;
+  }
+
+  //------------------------------------------------------------------
+  //        Supernodal L*D*L^T for Symmetric Sparse Block Matrices
+  //
+  // analyze() picks the ordering and works out the structure of L;
+  // factor() can then be repeated for any matrix with the same
+  // pattern, which is the common case inside an iterative solver.
+  //------------------------------------------------------------------
+  template <class ElemT>
+  class SparseBlockLDL {
+    size_t m_block_size;
+    std::vector<size_t> m_order;   // new block -> old block
+    std::vector<size_t> m_inverse; // old block -> new block
+
+    // Supernode s covers the blocks [m_first[s], m_first[s+1]), and
+    // m_rows[s] lists the blocks of L below them.  Its panel is the
+    // dense (W+R) x W slice of L (with D on the diagonal), where W and
+    // R are those two counts in scalars.
+    std::vector<size_t> m_first;
+    std::vector<size_t> m_supernode;
+    std::vector< std::vector<size_t> > m_rows;
+    std::vector< Matrix<ElemT> > m_panels;
+    bool m_analyzed, m_factored;
+
+    size_t width( size_t s ) const { return m_first[s+1] - m_first[s]; }
+
+    // Row offsets, in blocks, of every block of supernode s's panel
+    void set_positions( size_t s, std::vector<size_t>& position ) const {
+      size_t w = width( s );
+      for ( size_t k = 0; k < w; k++ )
+        position[m_first[s]+k] = k;
+      for ( size_t k = 0; k < m_rows[s].size(); k++ )
+        position[m_rows[s][k]] = w + k;
+    }
+
+  public:
+    SparseBlockLDL() : m_block_size(1), m_analyzed(false), m_factored(false) {}
+
+    /// Analyze and factor in one step
+    explicit SparseBlockLDL( MatrixSparseBlock<ElemT> const& A ) :
+      m_block_size(1), m_analyzed(false), m_factored(false) {
+      analyze( A );
+      factor( A );
+    }
+
+    bool analyzed() const { return m_analyzed; }
+    size_t num_supernodes() const { return m_panels.size(); }
+    std::vector<size_t> const& ordering() const { return m_order; }
+
+    /// Number of scalars stored for L and D
+    size_t nonzeros() const {
+      size_t count = 0;
+      for ( size_t s = 0; s < m_panels.size(); s++ )
+        count += m_panels[s].rows() * m_panels[s].cols();
+      return count;
+    }
+
+    /// Finds the ordering and the structure of L for A's pattern.
+    void analyze( MatrixSparseBlock<ElemT> const& A ) {
+      size_t n = A.num_blocks();
+      m_block_size = A.block_size();
+      m_order = minimum_degree_ordering( A );
+      m_inverse.resize( n );
+      for ( size_t i = 0; i < n; i++ )
+        m_inverse[m_order[i]] = i;
+
+      // Pattern of the reordered lower triangle
+      typedef typename MatrixSparseBlock<ElemT>::column_type::const_iterator block_iter;
+      std::vector< std::vector<size_t> > pattern( n );
+      for ( size_t jo = 0; jo < n; jo++ )
+        for ( block_iter it = A.column(jo).begin(); it != A.column(jo).end(); it++ ) {
+          size_t i = m_inverse[it->first], j = m_inverse[jo];
+          if ( i == j ) continue;
+          if ( i < j ) std::swap( i, j );
+          pattern[j].push_back( i );
+        }
+
+      // Structure of each column of L: its own pattern, plus that of
+      // its children in the elimination tree.
+      std::vector< std::vector<size_t> > structure( n );
+      std::vector< std::vector<size_t> > children( n );
+      std::vector<size_t> merged;
+      for ( size_t j = 0; j < n; j++ ) {
+        std::vector<size_t>& s = structure[j];
+        s.swap( pattern[j] );
+        for ( size_t c = 0; c < children[j].size(); c++ ) {
+          std::vector<size_t> const& child = structure[children[j][c]];
+          s.insert( s.end(), child.begin() + 1, child.end() ); // drop j itself
+        }
+        std::sort( s.begin(), s.end() );
+        s.erase( std::unique( s.begin(), s.end() ), s.end() );
+        if ( !s.empty() )
+          children[s.front()].push_back( j );
+      }
+
+      // Group columns into supernodes: j joins j-1's supernode when
+      // j-1's structure is exactly j plus j's structure.
+      m_first.clear();
+      m_supernode.resize( n );
+      for ( size_t j = 0; j < n; j++ ) {
+        bool join = j > 0 &&
+          structure[j-1].size() == structure[j].size() + 1 &&
+          structure[j-1].front() == j &&
+          std::equal( structure[j].begin(), structure[j].end(), structure[j-1].begin() + 1 );
+        if ( !join ) m_first.push_back( j );
+        m_supernode[j] = m_first.size() - 1;
+      }
+      m_first.push_back( n );
+
+      size_t num_supernodes = m_first.size() - 1;
+      m_rows.resize( num_supernodes );
+      m_panels.resize( num_supernodes );
+      for ( size_t s = 0; s < num_supernodes; s++ ) {
+        m_rows[s] = structure[m_first[s+1]-1];
+        size_t w = width( s ) * m_block_size;
+        m_panels[s].set_size( w + m_rows[s].size() * m_block_size, w );
+      }
+      m_analyzed = true;
+      m_factored = false;
+
+      vw_out(DebugMessage,"math") << "-> Sparse LDL: " << n << " blocks in "
+                                  << num_supernodes << " supernodes, "
+                                  << nonzeros() << " entries.\n";
+    }
+
+    /// Computes the L*D*L^T factorization of A, which must have the
+    /// pattern given to analyze() (or a subset of it).
+    void factor( MatrixSparseBlock<ElemT> const& A ) {
+      if ( !m_analyzed ) analyze( A );
+      VW_ASSERT( A.num_blocks() == m_order.size() && A.block_size() == m_block_size,
+                 ArgumentErr() << "SparseBlockLDL: matrix does not match the analysis." );
+      size_t n = A.num_blocks(), bs = m_block_size;
+      size_t num_supernodes = m_panels.size();
+
+      // Load A into the panels
+      typedef typename MatrixSparseBlock<ElemT>::column_type::const_iterator block_iter;
+      std::vector< std::vector< std::pair<size_t, block_iter> > > entries( n );
+      for ( size_t jo = 0; jo < n; jo++ )
+        for ( block_iter it = A.column(jo).begin(); it != A.column(jo).end(); it++ ) {
+          size_t i = m_inverse[it->first], j = m_inverse[jo];
+          entries[std::min(i,j)].push_back( std::make_pair( std::max(i,j), it ) );
+        }
+      std::vector<size_t> position( n, 0 );
+      for ( size_t s = 0; s < num_supernodes; s++ ) {
+        Matrix<ElemT>& P = m_panels[s];
+        std::fill( P.begin(), P.end(), ElemT() );
+        set_positions( s, position );
+        for ( size_t j = m_first[s]; j < m_first[s+1]; j++ ) {
+          size_t col = ( j - m_first[s] ) * bs;
+          for ( size_t e = 0; e < entries[j].size(); e++ ) {
+            size_t i = entries[j][e].first;
+            Matrix<ElemT> const& M = entries[j][e].second->second;
+            // Stored blocks are (row >= col) in the old order
+            bool transposed = m_inverse[entries[j][e].second->first] != i;
+            VW_ASSERT( i == j || std::binary_search( m_rows[s].begin(), m_rows[s].end(), i ) ||
+                       m_supernode[i] == s,
+                       LogicErr() << "SparseBlockLDL: matrix pattern differs from its analysis." );
+            size_t row = position[i] * bs;
+            for ( size_t r = 0; r < bs; r++ )
+              for ( size_t c = 0; c < bs; c++ )
+                P( row + r, col + c ) = transposed ? M(c,r) : M(r,c);
+          }
+        }
+      }
+
+      // Right-looking supernodal factorization
+      std::vector<ElemT> ld;
+      for ( size_t s = 0; s < num_supernodes; s++ ) {
+        Matrix<ElemT>& P = m_panels[s];
+        size_t W = P.cols(), H = P.rows();
+        ld.resize( W );
+
+        // Dense L*D*L^T of the panel's columns
+        for ( size_t k = 0; k < W; k++ ) {
+          ElemT* row_k = &P(k,0);
+          ElemT d = row_k[k];
+          for ( size_t m = 0; m < k; m++ )
+            d -= row_k[m] * row_k[m] * P(m,m);
+          row_k[k] = d;
+          for ( size_t m = 0; m < k; m++ )
+            ld[m] = row_k[m] * P(m,m);
+          for ( size_t i = k + 1; i < H; i++ ) {
+            ElemT* row_i = &P(i,0);
+            ElemT sum = row_i[k];
+            for ( size_t m = 0; m < k; m++ )
+              sum -= row_i[m] * ld[m];
+            row_i[k] = sum / d;
+          }
+        }
+
+        // Subtract L_below*D*L_below^T from the supernodes below,
+        // one target block column at a time.
+        std::vector<size_t> const& rows = m_rows[s];
+        size_t t = size_t(-1);
+        for ( size_t a = 0; a < rows.size(); a++ ) {
+          size_t target = rows[a];
+          if ( m_supernode[target] != t ) {
+            t = m_supernode[target];
+            set_positions( t, position );
+          }
+          Matrix<ElemT>& T = m_panels[t];
+          size_t col = ( target - m_first[t] ) * bs;
+          for ( size_t c = 0; c < bs; c++ ) {
+            ElemT const* row_c = &P( W + a*bs + c, 0 );
+            for ( size_t m = 0; m < W; m++ )
+              ld[m] = row_c[m] * P(m,m);
+            for ( size_t b = a; b < rows.size(); b++ ) {
+              size_t row = position[rows[b]] * bs;
+              for ( size_t r = ( b == a ? c : 0 ); r < bs; r++ ) {
+                ElemT const* row_r = &P( W + b*bs + r, 0 );
+                ElemT sum = 0;
+                for ( size_t m = 0; m < W; m++ )
+                  sum += row_r[m] * ld[m];
+                T( row + r, col + c ) -= sum;
+              }
+            }
+          }
+        }
+      }
+      m_factored = true;
+    }
+
+    /// Solves A*x = b with the factorization.
+    template <class VectorT>
+    Vector<ElemT> solve( VectorBase<VectorT> const& b_ ) const {
+      VectorT const& b = b_.impl();
+      VW_ASSERT( m_factored, LogicErr() << "SparseBlockLDL: solve before factor." );
+      size_t n = m_order.size(), bs = m_block_size;
+      VW_ASSERT( b.size() == n * bs, ArgumentErr() << "SparseBlockLDL: size mismatch." );
+
+      Vector<ElemT> y( n * bs );
+      for ( size_t i = 0; i < n; i++ )
+        for ( size_t r = 0; r < bs; r++ )
+          y[i*bs+r] = b[m_order[i]*bs+r];
+
+      // Forward substitution with L
+      for ( size_t s = 0; s < m_panels.size(); s++ ) {
+        Matrix<ElemT> const& P = m_panels[s];
+        size_t W = P.cols(), base = m_first[s] * bs;
+        for ( size_t k = 0; k < W; k++ )
+          for ( size_t m = 0; m < k; m++ )
+            y[base+k] -= P(k,m) * y[base+m];
+        for ( size_t a = 0; a < m_rows[s].size(); a++ )
+          for ( size_t r = 0; r < bs; r++ ) {
+            ElemT sum = 0;
+            for ( size_t m = 0; m < W; m++ )
+              sum += P( W + a*bs + r, m ) * y[base+m];
+            y[m_rows[s][a]*bs+r] -= sum;
+          }
+      }
+
+      // Diagonal
+      for ( size_t s = 0; s < m_panels.size(); s++ ) {
+        Matrix<ElemT> const& P = m_panels[s];
+        size_t base = m_first[s] * bs;
+        for ( size_t k = 0; k < P.cols(); k++ )
+          y[base+k] /= P(k,k);
+      }
+
+      // Backward substitution with L^T
+      for ( size_t s = m_panels.size(); s-- > 0; ) {
+        Matrix<ElemT> const& P = m_panels[s];
+        size_t W = P.cols(), base = m_first[s] * bs;
+        for ( size_t a = 0; a < m_rows[s].size(); a++ )
+          for ( size_t r = 0; r < bs; r++ ) {
+            ElemT value = y[m_rows[s][a]*bs+r];
+            for ( size_t m = 0; m < W; m++ )
+              y[base+m] -= P( W + a*bs + r, m ) * value;
+          }
+        for ( size_t k = W; k-- > 0; )
+          for ( size_t m = k + 1; m < W; m++ )
+            y[base+k] -= P(m,k) * y[base+m];
+      }
+
+      Vector<ElemT> x( n * bs );
+      for ( size_t i = 0; i < n; i++ )
+        for ( size_t r = 0; r < bs; r++ )
+          x[m_order[i]*bs+r] = y[i*bs+r];
+      return x;
+    }
+
+    /// The diagonal blocks of inverse(A), in A's original block order,
+    /// without forming the rest of the inverse.  The Takahashi
+    /// equations give inverse(A) on the pattern of L from the factor
+    /// alone, a supernode at a time from the last one back.
+    std::vector< Matrix<ElemT> > inverse_diagonal_blocks() const {
+      VW_ASSERT( m_factored, LogicErr() << "SparseBlockLDL: inverse before factor." );
+      size_t n = m_order.size(), bs = m_block_size;
+
+      // Z holds inverse(A) on the same pattern as the panels
+      std::vector< Matrix<ElemT> > Z( m_panels.size() );
+      std::vector<size_t> position( n, 0 );
+      for ( size_t s = m_panels.size(); s-- > 0; ) {
+        Matrix<ElemT> const& P = m_panels[s];
+        std::vector<size_t> const& rows = m_rows[s];
+        size_t W = P.cols(), R = P.rows() - W;
+        Z[s].set_size( P.rows(), W );
+
+        // T = inverse of the unit lower triangle on the diagonal
+        Matrix<ElemT> T( W, W );
+        for ( size_t k = 0; k < W; k++ ) {
+          T(k,k) = 1;
+          for ( size_t i = k + 1; i < W; i++ ) {
+            ElemT sum = 0;
+            for ( size_t m = k; m < i; m++ )
+              sum += P(i,m) * T(m,k);
+            T(i,k) = -sum;
+          }
+        }
+
+        // Y = Z22 * L21, where Z22 is inverse(A) on the rows below,
+        // already known from the later supernodes.
+        Matrix<ElemT> Y( R, W );
+        size_t t = size_t(-1);
+        for ( size_t b = 0; b < rows.size(); b++ ) {
+          if ( m_supernode[rows[b]] != t ) {
+            t = m_supernode[rows[b]];
+            set_positions( t, position );
+          }
+          size_t col = ( rows[b] - m_first[t] ) * bs;
+          for ( size_t a = b; a < rows.size(); a++ ) {
+            size_t row = position[rows[a]] * bs;
+            for ( size_t r = 0; r < bs; r++ )
+              for ( size_t c = 0; c < bs; c++ ) {
+                ElemT z = Z[t]( row + r, col + c );
+                if ( z == 0 ) continue;
+                ElemT* y_a = &Y( a*bs + r, 0 );
+                ElemT const* l_b = &P( W + b*bs + c, 0 );
+                for ( size_t m = 0; m < W; m++ )
+                  y_a[m] += z * l_b[m];
+                if ( a == b ) continue;
+                ElemT* y_b = &Y( b*bs + c, 0 );
+                ElemT const* l_a = &P( W + a*bs + r, 0 );
+                for ( size_t m = 0; m < W; m++ )
+                  y_b[m] += z * l_a[m];
+              }
+          }
+        }
+
+        // Z21 = -Y * T
+        for ( size_t i = 0; i < R; i++ )
+          for ( size_t k = 0; k < W; k++ ) {
+            ElemT sum = 0;
+            for ( size_t m = k; m < W; m++ )
+              sum += Y(i,m) * T(m,k);
+            Z[s]( W + i, k ) = -sum;
+          }
+
+        // Z11 = T^T * ( inverse(D)*T - L21^T*Z21 )
+        Matrix<ElemT> M( W, W );
+        for ( size_t m = 0; m < W; m++ )
+          for ( size_t k = 0; k < W; k++ ) {
+            ElemT sum = T(m,k) / P(m,m);
+            for ( size_t i = 0; i < R; i++ )
+              sum -= P( W + i, m ) * Z[s]( W + i, k );
+            M(m,k) = sum;
+          }
+        for ( size_t i = 0; i < W; i++ )
+          for ( size_t k = 0; k < W; k++ ) {
+            ElemT sum = 0;
+            for ( size_t m = i; m < W; m++ )
+              sum += T(m,i) * M(m,k);
+            Z[s](i,k) = sum;
+          }
+      }
+
+      std::vector< Matrix<ElemT> > result( n );
+      for ( size_t jo = 0; jo < n; jo++ ) {
+        size_t j = m_inverse[jo], s = m_supernode[j];
+        size_t offset = ( j - m_first[s] ) * bs;
+        result[jo] = submatrix( Z[s], offset, offset, bs, bs );
+      }
+      return result;
+    }
+  };
+
+  /// Factor and solve A*x = b in one go.
+  template <class ElemT, class VectorT>
+  Vector<ElemT> sparse_solve( MatrixSparseBlock<ElemT> const& A,
+                              VectorBase<VectorT> const& b ) {
+    SparseBlockLDL<ElemT> ldl( A );
+    return ldl.solve( b );
+  }
+
+  //------------------------------------------------------------------
+  // Block-Jacobi Preconditioner
+  //
+  // Applies the inverse of A's diagonal blocks, for use with
+  // preconditioned_conjugate_gradient() on problems too large to
+  // factor.
+  //------------------------------------------------------------------
+  template <class ElemT>
+  class BlockJacobiPreconditioner {
+    size_t m_block_size;
+    std::vector< Matrix<ElemT> > m_inverses;
+  public:
+    BlockJacobiPreconditioner( MatrixSparseBlock<ElemT> const& A ) :
+      m_block_size(A.block_size()), m_inverses(A.num_blocks()) {
+      for ( size_t j = 0; j < A.num_blocks(); j++ ) {
+        typename MatrixSparseBlock<ElemT>::column_type::const_iterator it = A.column(j).find( j );
+        m_inverses[j].set_size( m_block_size, m_block_size );
+        m_inverses[j].set_identity();
+        if ( it == A.column(j).end() ) continue;
+        // Blocks that can't be inverted are left as the identity
+        try {
+          m_inverses[j] = inverse( it->second );
+        } catch ( const MathErr& ) {}
+      }
+    }
+
+    template <class VectorT>
+    Vector<ElemT> operator()( VectorBase<VectorT> const& r_ ) const {
+      VectorT const& r = r_.impl();
+      Vector<ElemT> z( r.size() );
+      for ( size_t j = 0; j < m_inverses.size(); j++ )
+        subvector( z, j*m_block_size, m_block_size ) =
+          m_inverses[j] * subvector( r, j*m_block_size, m_block_size );
+      return z;
+    }
+  };
+
+  /// The product with a MatrixSparseBlock, as a functor for
+  /// preconditioned_conjugate_gradient().
+  template <class ElemT>
+  class SparseBlockOperator {
+    MatrixSparseBlock<ElemT> const& m_matrix;
+  public:
+    SparseBlockOperator( MatrixSparseBlock<ElemT> const& A ) : m_matrix(A) {}
+    template <class VectorT>
+    Vector<ElemT> operator()( VectorBase<VectorT> const& x ) const {
+      return sparse_multiply( m_matrix, x );
+    }
+  };
+
+}} // namespace vw::math
+
+#endif//__VW_MATH_SPARSE_BLOCK_MATRIX_H__
@@ -0,0 +1,167 @@
+// __BEGIN_LICENSE__
+// Copyright (C) 2006-2011 United States Government as represented by
+// the Administrator of the National Aeronautics and Space Administration.
+// All Rights Reserved.
+// __END_LICENSE__
+
+
+#include <gtest/gtest.h>
+#include <vw/Math/FlatKDTree.h>
+
+#include <cstdlib>
+#include <algorithm>
+
+using namespace std;
+using namespace vw;
+using namespace vw::math;
+
+static vector<Vector<float> > random_points( size_t count, size_t dim, int values = 1000 ) {
+  vector<Vector<float> > points( count, Vector<float>(dim) );
+  for( size_t i=0; i<count; ++i )
+    for( size_t j=0; j<dim; ++j )
+      points[i][j] = float( rand() % values ) / 10;
+  return points;
+}
+
+static float squared_distance( Vector<float> const& a, Vector<float> const& b ) {
+  float dist = 0;
+  for( size_t j=0; j<a.size(); ++j )
+    dist += (a[j]-b[j])*(a[j]-b[j]);
+  return dist;
+}
+
+// Squared distances to the knn nearest points, by checking them all
+static vector<float> brute_force( vector<Vector<float> > const& points, Vector<float> const& query, size_t knn ) {
+  vector<float> dists;
+  for( size_t i=0; i<points.size(); ++i )
+    dists.push_back( squared_distance( points[i], query ) );
+  sort( dists.begin(), dists.end() );
+  dists.resize( min( knn, dists.size() ) );
+  return dists;
+}
+
+TEST( FlatKDTree, Empty ) {
+  vector<Vector<float> > points;
+  FlatKDTree<float> tree( points.begin(), points.end() );
+  EXPECT_EQ( 0u, tree.size() );
+
+  Vector<int> indices;
+  Vector<float> dists;
+  EXPECT_EQ( 0u, tree.knn_search( Vector<float>(), indices, dists, 2 ) );
+  EXPECT_EQ( 0u, indices.size() );
+}
+
+TEST( FlatKDTree, FewerThanKnn ) {
+  vector<Vector<float> > points;
+  points.push_back( Vector2f(0,0) );
+  points.push_back( Vector2f(3,4) );
+  FlatKDTree<float> tree( points.begin(), points.end() );
+
+  Vector<int> indices;
+  Vector<float> dists;
+  ASSERT_EQ( 2u, tree.knn_search( Vector2f(3,3), indices, dists, 3 ) );
+  EXPECT_EQ( 1, indices[0] );
+  EXPECT_EQ( 0, indices[1] );
+  EXPECT_FLOAT_EQ( 1, dists[0] );
+  EXPECT_FLOAT_EQ( 18, dists[1] );
+}
+
+TEST( FlatKDTree, ExactMatchesBruteForce ) {
+  srand( 42 );
+  static const size_t dims[] = { 1, 2, 3, 64 };
+  static const size_t leaf_sizes[] = { 1, 8, 50 };
+  for( unsigned d=0; d<sizeof(dims)/sizeof(dims[0]); ++d ) {
+    // Few distinct values, so there are plenty of duplicate coordinates
+    vector<Vector<float> > points = random_points( 1000, dims[d], 50 );
+    for( unsigned l=0; l<sizeof(leaf_sizes)/sizeof(leaf_sizes[0]); ++l ) {
+      FlatKDTree<float> tree( points.begin(), points.end(), leaf_sizes[l] );
+      ASSERT_EQ( points.size(), tree.size() );
+      ASSERT_EQ( dims[d], tree.dimension() );
+      Vector<int> indices;
+      Vector<float> dists;
+      for( int q=0; q<50; ++q ) {
+        Vector<float> query = random_points( 1, dims[d], 60 )[0];
+        vector<float> expected = brute_force( points, query, 5 );
+        ASSERT_EQ( 5u, tree.knn_search( query, indices, dists, 5 ) );
+        for( size_t k=0; k<5; ++k ) {
+          EXPECT_FLOAT_EQ( expected[k], dists[k] ) << "dim " << dims[d] << " leaf " << leaf_sizes[l];
+          EXPECT_FLOAT_EQ( dists[k], squared_distance( points[indices[k]], query ) );
+        }
+      }
+    }
+  }
+}
+
+TEST( FlatKDTree, BestBinFirst ) {
+  srand( 7 );
+  vector<Vector<float> > points = random_points( 2000, 16 );
+  FlatKDTree<float> tree( points.begin(), points.end() );
+
+  Vector<int> exact_indices, indices;
+  Vector<float> exact_dists, dists;
+  int found = 0, queries = 200;
+  for( int q=0; q<queries; ++q ) {
+    Vector<float> query = random_points( 1, 16 )[0];
+    tree.knn_search( query, exact_indices, exact_dists, 1 );
+    ASSERT_EQ( 1u, tree.knn_search( query, indices, dists, 1, 200 ) );
+    EXPECT_GE( dists[0], exact_dists[0] );
+    EXPECT_FLOAT_EQ( dists[0], squared_distance( points[indices[0]], query ) );
+    if( indices[0] == exact_indices[0] )
+      found++;
+  }
+  // Checking a tenth of the points should find most true neighbors
+  EXPECT_GT( found, queries / 2 );
+}
+
+TEST( FlatKDTree, Batch ) {
+  srand( 3 );
+  vector<Vector<float> > points = random_points( 300, 4 );
+  Matrix<float> data( points.size(), 4 );
+  for( size_t i=0; i<points.size(); ++i )
+    select_row( data, i ) = points[i];
+  FlatKDTree<float> tree( data );
+  ASSERT_EQ( points.size(), tree.size() );
+
+  Matrix<float> queries( 20, 4 );
+  for( size_t i=0; i<queries.rows(); ++i )
+    select_row( queries, i ) = random_points( 1, 4 )[0];
+  Matrix<int> indices;
+  Matrix<float> dists;
+  tree.knn_search( queries, indices, dists, 3 );
+  ASSERT_EQ( 20u, indices.rows() );
+  ASSERT_EQ( 3u, indices.cols() );
+
+  Vector<int> single_indices;
+  Vector<float> single_dists;
+  for( size_t i=0; i<queries.rows(); ++i ) {
+    tree.knn_search( select_row( queries, i ), single_indices, single_dists, 3 );
+    for( size_t k=0; k<3; ++k ) {
+      EXPECT_EQ( single_indices[k], indices(i,k) );
+      EXPECT_EQ( single_dists[k], dists(i,k) );
+    }
+  }
+
+  // Missing neighbors are marked
+  FlatKDTree<float> small( submatrix( data, 0, 0, 2, 4 ) );
+  small.knn_search( queries, indices, dists, 3 );
+  EXPECT_EQ( -1, indices(0,2) );
+}
+
+TEST( FlatKDTree, Radius ) {
+  srand( 11 );
+  vector<Vector<float> > points = random_points( 500, 3 );
+  FlatKDTree<float> tree( points.begin(), points.end(), 4 );
+  vector<int> result;
+  for( int q=0; q<50; ++q ) {
+    Vector<float> query = random_points( 1, 3 )[0];
+    float max_dist = float( rand() % 1000 );
+    tree.radius_search( query, max_dist, result );
+    vector<int> expected;
+    for( size_t i=0; i<points.size(); ++i )
+      if( squared_distance( points[i], query ) <= max_dist )
+        expected.push_back( i );
+    ASSERT_EQ( expected.size(), result.size() );
+    for( size_t i=0; i<expected.size(); ++i )
+      EXPECT_EQ( expected[i], result[i] );
+  }
+}
@@ -0,0 +1,177 @@
+// __BEGIN_LICENSE__
+// Copyright (C) 2006-2011 United States Government as represented by
+// the Administrator of the National Aeronautics and Space Administration.
+// All Rights Reserved.
+// __END_LICENSE__
+
+
+#include <gtest/gtest.h>
+#include <vw/Math/MatrixSparseBlock.h>
+#include <vw/Math/ConjugateGradient.h>
+
+#include <cstdlib>
+
+using namespace vw;
+using namespace vw::math;
+
+// A random, diagonally dominant block matrix where each block row
+// couples to a few others, plus one dense "hub" block row.
+static MatrixSparseBlock<double> random_block_matrix( size_t n, size_t bs, size_t links ) {
+  MatrixSparseBlock<double> A( n, bs );
+  for ( size_t j = 0; j < n; j++ ) {
+    for ( size_t l = 0; l < links; l++ ) {
+      size_t i = rand() % n;
+      if ( i == j ) continue;
+      Matrix<double>& M = A.block( std::max(i,j), std::min(i,j) );
+      for ( size_t r = 0; r < bs; r++ )
+        for ( size_t c = 0; c < bs; c++ )
+          M(r,c) = double(rand() % 200) / 100 - 1;
+    }
+    if ( j > 0 ) {
+      Matrix<double>& H = A.block( j, 0 );
+      for ( size_t r = 0; r < bs; r++ )
+        H(r,r) = 0.5;
+    }
+  }
+  // Make the diagonal dominant
+  for ( size_t j = 0; j < n; j++ ) {
+    Matrix<double>& D = A.block( j, j );
+    for ( size_t r = 0; r < bs; r++ ) {
+      for ( size_t c = 0; c < r; c++ )
+        D(r,c) = D(c,r) = double(rand() % 200) / 1000;
+      D(r,r) = 10.0 * bs * ( links + 1 ) + ( j == 0 ? n : 0 );
+    }
+  }
+  return A;
+}
+
+static Matrix<double> dense( MatrixSparseBlock<double> const& A ) {
+  size_t bs = A.block_size();
+  Matrix<double> D( A.rows(), A.cols() );
+  for ( size_t j = 0; j < A.num_blocks(); j++ )
+    for ( MatrixSparseBlock<double>::column_type::const_iterator it = A.column(j).begin();
+          it != A.column(j).end(); it++ ) {
+      submatrix( D, it->first*bs, j*bs, bs, bs ) = it->second;
+      if ( it->first != j )
+        submatrix( D, j*bs, it->first*bs, bs, bs ) = transpose( it->second );
+    }
+  return D;
+}
+
+TEST( MatrixSparseBlock, Multiply ) {
+  srand( 1 );
+  MatrixSparseBlock<double> A = random_block_matrix( 20, 3, 2 );
+  Vector<double> x( A.cols() );
+  for ( size_t i = 0; i < x.size(); i++ )
+    x[i] = i % 7;
+  Vector<double> y = sparse_multiply( A, x );
+  Vector<double> expected = dense( A ) * x;
+  for ( size_t i = 0; i < y.size(); i++ )
+    EXPECT_NEAR( expected[i], y[i], 1e-10 );
+}
+
+TEST( MatrixSparseBlock, Ordering ) {
+  // An arrow: block 0 is coupled to every other block.  Eliminating it
+  // first would fill in everything, so it should come last.
+  size_t n = 10;
+  MatrixSparseBlock<double> A( n, 1 );
+  for ( size_t i = 0; i < n; i++ ) {
+    A.block( i, i )(0,0) = 10;
+    if ( i > 0 ) A.block( i, 0 )(0,0) = 1;
+  }
+  std::vector<size_t> order = minimum_degree_ordering( A );
+  ASSERT_EQ( n, order.size() );
+  std::vector<size_t> sorted( order );
+  std::sort( sorted.begin(), sorted.end() );
+  for ( size_t i = 0; i < n; i++ )
+    EXPECT_EQ( i, sorted[i] );
+  EXPECT_EQ( 0u, order.back() );
+
+  // L then has just the diagonal and the last row (the last two
+  // columns share a panel, which adds one unused entry).
+  SparseBlockLDL<double> ldl( A );
+  EXPECT_LE( ldl.nonzeros(), 2*n );
+}
+
+TEST( MatrixSparseBlock, Solve ) {
+  srand( 2 );
+  static const size_t sizes[] = { 1, 2, 7, 40, 150 };
+  static const size_t block_sizes[] = { 1, 3, 6 };
+  for ( size_t s = 0; s < sizeof(sizes)/sizeof(sizes[0]); s++ )
+    for ( size_t b = 0; b < sizeof(block_sizes)/sizeof(block_sizes[0]); b++ ) {
+      MatrixSparseBlock<double> A = random_block_matrix( sizes[s], block_sizes[b], 3 );
+      Vector<double> x( A.cols() );
+      for ( size_t i = 0; i < x.size(); i++ )
+        x[i] = double(rand() % 1000) / 100;
+      Vector<double> rhs = dense( A ) * x;
+
+      SparseBlockLDL<double> ldl( A );
+      Vector<double> result = ldl.solve( rhs );
+      ASSERT_EQ( x.size(), result.size() );
+      for ( size_t i = 0; i < x.size(); i++ )
+        EXPECT_NEAR( x[i], result[i], 1e-8 ) << sizes[s] << " blocks of " << block_sizes[b];
+
+      // Refactoring with the same analysis
+      A.block( 0, 0 )(0,0) += 1;
+      rhs = dense( A ) * x;
+      ldl.factor( A );
+      result = ldl.solve( rhs );
+      for ( size_t i = 0; i < x.size(); i++ )
+        EXPECT_NEAR( x[i], result[i], 1e-8 );
+    }
+}
+
+TEST( MatrixSparseBlock, ConjugateGradient ) {
+  srand( 3 );
+  MatrixSparseBlock<double> A = random_block_matrix( 60, 6, 3 );
+  Vector<double> x( A.cols() );
+  for ( size_t i = 0; i < x.size(); i++ )
+    x[i] = double(rand() % 1000) / 100;
+  Vector<double> rhs = sparse_multiply( A, x );
+
+  Vector<double> result( A.cols() );
+  int iterations = preconditioned_conjugate_gradient( SparseBlockOperator<double>( A ),
+                                                      BlockJacobiPreconditioner<double>( A ),
+                                                      rhs, result, 1e-12, 1000 );
+  EXPECT_LT( iterations, 1000 );
+  for ( size_t i = 0; i < x.size(); i++ )
+    EXPECT_NEAR( x[i], result[i], 1e-8 );
+}
+
+TEST( MatrixSparseBlock, InverseDiagonalBlocks ) {
+  srand( 4 );
+  static const size_t sizes[] = { 1, 2, 9, 50 };
+  static const size_t block_sizes[] = { 1, 3, 6 };
+  for ( size_t s = 0; s < sizeof(sizes)/sizeof(sizes[0]); s++ )
+    for ( size_t b = 0; b < sizeof(block_sizes)/sizeof(block_sizes[0]); b++ ) {
+      size_t bs = block_sizes[b];
+      MatrixSparseBlock<double> A = random_block_matrix( sizes[s], bs, 2 );
+      Matrix<double> expected = inverse( dense( A ) );
+
+      SparseBlockLDL<double> ldl( A );
+      std::vector<Matrix<double> > blocks = ldl.inverse_diagonal_blocks();
+      ASSERT_EQ( sizes[s], blocks.size() );
+      for ( size_t j = 0; j < blocks.size(); j++ )
+        for ( size_t r = 0; r < bs; r++ )
+          for ( size_t c = 0; c < bs; c++ )
+            EXPECT_NEAR( expected( j*bs + r, j*bs + c ), blocks[j](r,c), 1e-12 )
+              << sizes[s] << " blocks of " << bs;
+    }
+}
+
+TEST( MatrixSparseBlock, FromSkyline ) {
+  srand( 5 );
+  MatrixSparseBlock<double> A = random_block_matrix( 12, 3, 2 );
+  Matrix<double> D = dense( A );
+  MatrixSparseSkyline<double> S( D.rows(), D.cols() );
+  for ( size_t i = 0; i < D.rows(); i++ )
+    for ( size_t j = 0; j <= i; j++ )
+      if ( D(i,j) != 0 ) S(i,j) = D(i,j);
+
+  MatrixSparseBlock<double> B = sparse_block_matrix( S, 3 );
+  EXPECT_EQ( A.nonzero_blocks(), B.nonzero_blocks() );
+  Matrix<double> D2 = dense( B );
+  for ( size_t i = 0; i < D.rows(); i++ )
+    for ( size_t j = 0; j < D.cols(); j++ )
+      EXPECT_EQ( D(i,j), D2(i,j) );
+}
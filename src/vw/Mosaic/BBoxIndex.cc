@@ -0,0 +1,107 @@
+// __BEGIN_LICENSE__
+// Copyright (C) 2006-2011 United States Government as represented by
+// the Administrator of the National Aeronautics and Space Administration.
+// All Rights Reserved.
+// __END_LICENSE__
+
+
+#include <vw/Mosaic/BBoxIndex.h>
+#include <vw/Core/Exception.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace vw {
+namespace mosaic {
+
+  namespace {
+    // Orders entries by the center of their boxes along one axis
+    struct CenterLess {
+      std::vector<BBox2i> const& bboxes;
+      int axis;
+      CenterLess( std::vector<BBox2i> const& bboxes, int axis ) : bboxes(bboxes), axis(axis) {}
+      bool operator()( uint32 a, uint32 b ) const {
+        return bboxes[a].min()[axis] + bboxes[a].max()[axis] < bboxes[b].min()[axis] + bboxes[b].max()[axis];
+      }
+    };
+
+    // Sorts entries into sort-tile-recursive order: vertical slices of
+    // about sqrt(n/fanout) nodes each, sorted by y within a slice.
+    void str_sort( std::vector<uint32> &entries, std::vector<BBox2i> const& bboxes, uint32 fanout ) {
+      std::sort( entries.begin(), entries.end(), CenterLess( bboxes, 0 ) );
+      size_t nodes = (entries.size() + fanout - 1) / fanout;
+      size_t slices = (size_t) ceil( sqrt( (double) nodes ) );
+      size_t slice_size = ((nodes + slices - 1) / slices) * fanout;
+      for( size_t i=0; i<entries.size(); i+=slice_size )
+        std::sort( entries.begin()+i, entries.begin()+std::min(i+slice_size, entries.size()), CenterLess( bboxes, 1 ) );
+    }
+  }
+
+  void BBoxIndex::build( std::vector<BBox2i> const& bboxes, uint32 fanout ) {
+    VW_ASSERT( fanout > 1, ArgumentErr() << "BBoxIndex: fanout must be at least two." );
+    m_bboxes = bboxes;
+    m_levels.clear();
+    m_items.resize( bboxes.size() );
+    for( uint32 i=0; i<m_items.size(); ++i ) m_items[i] = i;
+    if( m_items.empty() ) return;
+
+    // Pack the items into leaves, then each level into the next
+    // until only the root is left.
+    std::vector<uint32> *entries = &m_items;
+    std::vector<BBox2i> const *entry_bboxes = &m_bboxes;
+    std::vector<uint32> order;
+    std::vector<BBox2i> node_bboxes;
+    do {
+      str_sort( *entries, *entry_bboxes, fanout );
+      std::vector<Node> level;
+      for( uint32 i=0; i<entries->size(); i+=fanout ) {
+        Node node;
+        node.begin = i;
+        node.end = std::min<uint32>( i+fanout, entries->size() );
+        for( uint32 j=node.begin; j<node.end; ++j )
+          node.bbox.grow( (*entry_bboxes)[(*entries)[j]] );
+        level.push_back( node );
+      }
+
+      // Nodes above the leaves point at the level below, which must
+      // be put in the order just chosen for it.
+      if( ! m_levels.empty() ) {
+        std::vector<Node> sorted( m_levels.back().size() );
+        for( uint32 i=0; i<order.size(); ++i ) sorted[i] = m_levels.back()[order[i]];
+        m_levels.back().swap( sorted );
+      }
+      m_levels.push_back( level );
+
+      order.resize( level.size() );
+      node_bboxes.resize( level.size() );
+      for( uint32 i=0; i<level.size(); ++i ) {
+        order[i] = i;
+        node_bboxes[i] = level[i].bbox;
+      }
+      entries = &order;
+      entry_bboxes = &node_bboxes;
+    } while( m_levels.back().size() > 1 );
+  }
+
+  void BBoxIndex::intersects( BBox2i const& bbox, std::vector<uint32> &result ) const {
+    result.clear();
+    if( m_levels.empty() || bbox.empty() ) return;
+
+    // Walk down from the root, one (level, node) pair at a time
+    std::vector<std::pair<size_t, uint32> > stack;
+    stack.push_back( std::make_pair( m_levels.size()-1, uint32(0) ) );
+    while( ! stack.empty() ) {
+      size_t level = stack.back().first;
+      Node const& node = m_levels[level][stack.back().second];
+      stack.pop_back();
+      if( ! node.bbox.intersects( bbox ) ) continue;
+      for( uint32 i=node.begin; i<node.end; ++i ) {
+        if( level > 0 ) stack.push_back( std::make_pair( level-1, i ) );
+        else if( m_bboxes[m_items[i]].intersects( bbox ) ) result.push_back( m_items[i] );
+      }
+    }
+    std::sort( result.begin(), result.end() );
+  }
+
+} // namespace mosaic
+} // namespace vw
@@ -0,0 +1,56 @@
+// __BEGIN_LICENSE__
+// Copyright (C) 2006-2011 United States Government as represented by
+// the Administrator of the National Aeronautics and Space Administration.
+// All Rights Reserved.
+// __END_LICENSE__
+
+
+/// \file BBoxIndex.h
+///
+/// A static spatial index over a set of integer bounding boxes.
+///
+#ifndef __VW_MOSAIC_BBOXINDEX_H__
+#define __VW_MOSAIC_BBOXINDEX_H__
+
+#include <vector>
+
+#include <vw/Core/FundamentalTypes.h>
+#include <vw/Math/BBox.h>
+
+namespace vw {
+namespace mosaic {
+
+  /// A packed R-tree over a fixed list of boxes, built bottom up by
+  /// sort-tile-recursive packing.  Finding the boxes that intersect a
+  /// query box costs O(log n) plus the number found, rather than the
+  /// O(n) of checking every box.  The index does not track changes to
+  /// the list; build it again after modifying it.
+  class BBoxIndex {
+    struct Node {
+      BBox2i bbox;
+      uint32 begin, end; // Children in the level below, or items
+    };
+
+    // m_levels[0] holds the leaves; the last level holds the root
+    std::vector<std::vector<Node> > m_levels;
+    std::vector<uint32> m_items;
+    std::vector<BBox2i> m_bboxes;
+
+  public:
+    BBoxIndex() {}
+    BBoxIndex( std::vector<BBox2i> const& bboxes, uint32 fanout = 16 ) { build( bboxes, fanout ); }
+
+    void build( std::vector<BBox2i> const& bboxes, uint32 fanout = 16 );
+
+    /// The number of boxes indexed.
+    size_t size() const { return m_bboxes.size(); }
+
+    /// Replaces result with the indices, in increasing order, of the
+    /// boxes that intersect bbox.
+    void intersects( BBox2i const& bbox, std::vector<uint32> &result ) const;
+  };
+
+} // namespace mosaic
+} // namespace vw
+
+#endif // __VW_MOSAIC_BBOXINDEX_H__
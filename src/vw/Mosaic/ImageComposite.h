@@ -13,11 +13,18 @@
 #define __VW_MOSAIC_IMAGECOMPOSITE_H__
 
 #include <iostream>
+#include <fstream>
+#include <sstream>
 #include <vector>
 #include <list>
+#include <map>
+
+#include <boost/filesystem/operations.hpp>
 
 #include <vw/Core/Cache.h>
 #include <vw/Core/ProgressCallback.h>
+#include <vw/Core/Thread.h>
+#include <vw/Core/ThreadPool.h>
 #include <vw/Image/ImageView.h>
 #include <vw/Image/ImageViewRef.h>
 #include <vw/Image/ImageMath.h>
@@ -27,6 +34,7 @@
 #include <vw/Image/Filter.h>
 #include <vw/Image/SparseImageCheck.h>
 #include <vw/FileIO/DiskImageResource.h>
+#include <vw/Mosaic/BBoxIndex.h>
 
 namespace vw {
 namespace mosaic {
@@ -136,88 +144,196 @@ namespace mosaic {
       std::vector<PositionedImage<channel_type> > masks;
     };
 
-    class SourceGenerator {
+    class GrassfireGenerator {
       ImageViewRef<pixel_type> m_source;
     public:
-      typedef ImageView<pixel_type> value_type;
-      SourceGenerator( ImageViewRef<pixel_type> const& source ) : m_source(source) {}
+      typedef ImageView<float32> value_type;
+      GrassfireGenerator( ImageViewRef<pixel_type> const& source ) : m_source(source) {}
       size_t size() const {
-        return m_source.cols() * m_source.rows() * sizeof(pixel_type);
+        return m_source.cols() * m_source.rows() * sizeof(float32);
       }
+      // The same transform as grassfire(), but the forward pass reads
+      // the source a strip of rows at a time, so only its alpha
+      // channel is ever held in memory, and not all of that at once.
       boost::shared_ptr<value_type> generate() const {
-        return boost::shared_ptr<value_type>( new value_type(m_source) );
+        int32 cols = m_source.cols(), rows = m_source.rows();
+        boost::shared_ptr<value_type> result( new value_type( cols, rows ) );
+        value_type& dist = *result;
+        int32 strip = std::max( 1, (1 << 22) / std::max( cols, 1 ) );
+        ImageView<channel_type> alpha;
+        for( int32 y0=0; y0<rows; y0+=strip ) {
+          alpha = select_alpha_channel( crop( m_source, 0, y0, cols, std::min( strip, rows-y0 ) ) );
+          for( int32 j=0; j<alpha.rows(); ++j ) {
+            int32 y = y0 + j;
+            for( int32 x=0; x<cols; ++x ) {
+              if( alpha(x,j) == channel_type() ) dist(x,y) = 0;
+              else if( x == 0 || y == 0 || x == cols-1 || y == rows-1 ) dist(x,y) = 1;
+              else dist(x,y) = 1 + std::min( dist(x-1,y), dist(x,y-1) );
+            }
+          }
+        }
+        for( int32 y=rows-2; y>0; --y ) {
+          for( int32 x=cols-2; x>0; --x ) {
+            if( dist(x,y) != 0 ) {
+              float32 m = std::min( dist(x+1,y), dist(x,y+1) );
+              if( m < dist(x,y) ) dist(x,y) = m + 1;
+            }
+          }
+        }
+        return result;
       }
     };
 
-    class GrassfireGenerator {
-      ImageViewRef<pixel_type> m_source;
+    // A source's mask, read back from the file make_mask() wrote.
+    // Blocks each need only part of it, but the file can't be read in
+    // pieces, so it is decoded whole once and kept in the cache.
+    class MaskGenerator {
+      std::string m_filename;
+      int32 m_cols, m_rows;
     public:
-      typedef ImageView<float32> value_type;
-      GrassfireGenerator( ImageViewRef<pixel_type> const& source ) : m_source(source) {}
+      typedef ImageView<channel_type> value_type;
+      MaskGenerator( std::string const& filename, int32 cols, int32 rows ) : m_filename(filename), m_cols(cols), m_rows(rows) {}
       size_t size() const {
-        return m_source.cols() * m_source.rows() * sizeof(float32);
+        return m_cols * m_rows * sizeof(channel_type);
       }
       boost::shared_ptr<value_type> generate() const {
-        ImageView<float32> alpha = channel_cast<float32>( select_alpha_channel( copy( m_source ) ) );
-        return boost::shared_ptr<value_type>( new value_type( grassfire( alpha ) ) );
+        boost::shared_ptr<value_type> result( new value_type );
+        read_image( *result, m_filename );
+        return result;
+      }
+    };
+
+    // Progress and the first error of the mask tasks
+    struct MaskStatus {
+      Mutex mutex;
+      ProgressCallback const& progress;
+      size_t done, total;
+      TaskErrors errors;
+      MaskStatus( ProgressCallback const& progress, size_t total ) : progress(progress), done(0), total(total) {}
+      void finished() {
+        Mutex::Lock lock( mutex );
+        progress.report_fractional_progress( double(++done), double(total) );
       }
     };
 
-    class AlphaGenerator {
+    // Builds one source's mask
+    class MaskTask : public Task {
+      ImageComposite const& m_composite;
+      std::vector<Cache::Handle<GrassfireGenerator> > const& m_grassfires;
+      unsigned m_index;
+      std::vector<uint32> m_overlaps;
+      std::string m_key;
+      MaskStatus& m_status;
     public:
-      ImageComposite& m_composite;
-      size_t m_index;
+      MaskTask( ImageComposite const& composite, std::vector<Cache::Handle<GrassfireGenerator> > const& grassfires,
+                unsigned index, std::vector<uint32> const& overlaps, std::string const& key, MaskStatus& status )
+        : m_composite(composite), m_grassfires(grassfires), m_index(index), m_overlaps(overlaps), m_key(key), m_status(status) {}
+      virtual void operator()() {
+        try {
+          m_composite.make_mask( m_index, m_overlaps, m_grassfires, m_key );
+        } catch( ... ) {
+          m_status.errors.capture();
+        }
+        m_status.finished();
+      }
+    };
+
+    // One block of blended output.  Holds on to the composite it
+    // blends from, since the block may be regenerated after the copy
+    // that asked for it is gone.
+    class BlockGenerator {
+      boost::shared_ptr<const ImageComposite> m_composite;
+      BBox2i m_bbox;
     public:
-      typedef ImageView<channel_type> value_type;
-      AlphaGenerator( ImageComposite& composite, size_t index ) : m_composite(composite), m_index(index) {}
+      typedef ImageView<pixel_type> value_type;
+      BlockGenerator( boost::shared_ptr<const ImageComposite> const& composite, BBox2i const& bbox ) : m_composite(composite), m_bbox(bbox) {}
       size_t size() const {
-        return m_composite.sources[m_index].size() / PixelNumChannels<pixel_type>::value;
+        return m_bbox.width() * m_bbox.height() * sizeof(pixel_type);
       }
       boost::shared_ptr<value_type> generate() const {
-        ImageView<pixel_type> source = *m_composite.sources[m_index];
-        m_composite.sources[m_index].deprioritize();
-        return boost::shared_ptr<value_type>( new value_type( select_alpha_channel( source ) ) );
+        return boost::shared_ptr<value_type>( new value_type( m_composite->blend_patch( m_bbox ) ) );
       }
     };
 
-    class PyramidGenerator {
-    public:
-      ImageComposite& m_composite;
-      size_t m_index;
+    // Fills in a block ahead of time.  Errors are left for whoever
+    // reads the block to run into.
+    class BlockTask : public Task {
+      Cache::Handle<BlockGenerator> m_handle;
     public:
-      typedef Pyramid value_type;
-      PyramidGenerator( ImageComposite& composite, size_t index ) : m_composite(composite), m_index(index) {}
-      size_t size() const {
-        return size_t( double(m_composite.sources[m_index].size()) * 1.66 ); // 1.66 = (5/4)*(4/3)
+      BlockTask( Cache::Handle<BlockGenerator> const& handle ) : m_handle(handle) {}
+      virtual void operator()() {
+        try {
+          boost::shared_ptr<ImageView<pixel_type> > block = m_handle;
+        } catch( const std::exception& ) {}
       }
-      boost::shared_ptr<value_type> generate() const;
     };
 
-    friend class PyramidGenerator;
+    // Shared between copies of a prepared composite, along with a copy
+    // of the composite as prepare() left it for the blocks to blend
+    // from.
+    struct BlockCache {
+      Mutex mutex;
+      std::map<std::pair<int32,int32>, Cache::Handle<BlockGenerator> > handles;
+      boost::shared_ptr<const ImageComposite> composite;
+    };
 
     std::vector<BBox2i > bboxes;
+    BBoxIndex m_index;
     BBox2i view_bbox, data_bbox;
     int mindim, levels;
     bool m_draft_mode;
     bool m_fill_holes;
     bool m_reuse_masks;
+    int32 m_num_threads;
+    std::string m_mask_key;
+    int32 m_block_size;
     Cache& m_cache;
     std::vector<ImageViewRef<pixel_type> > sourcerefs;
-    std::vector<Cache::Handle<SourceGenerator> > sources;
-    std::vector<Cache::Handle<AlphaGenerator> > alphas;
-    std::vector<Cache::Handle<PyramidGenerator> > pyramids;
+    std::vector<std::string> m_source_files;
+    std::vector<Cache::Handle<MaskGenerator> > m_masks;
+    boost::shared_ptr<BlockCache> m_blocks;
+
+    static std::string mask_filename( unsigned index, const char* suffix = ".png" ) {
+      std::ostringstream filename;
+      filename << "mask." << index << suffix;
+      return filename.str();
+    }
 
+    std::string mask_key( unsigned index, std::vector<uint32> const& overlaps ) const;
+    bool mask_reusable( unsigned index, std::string const& key ) const;
+    void make_mask( unsigned index, std::vector<uint32> const& overlaps,
+                    std::vector<Cache::Handle<GrassfireGenerator> > const& grassfires,
+                    std::string const& key ) const;
     void generate_masks( ProgressCallback const& progress_callback ) const;
 
+    // Finds the sources whose bboxes intersect bbox, in the order
+    // they were inserted.  Uses the index once prepare() has built it.
+    void overlapping( BBox2i const& bbox, std::vector<uint32> &result ) const {
+      if( m_index.size() == bboxes.size() ) {
+        m_index.intersects( bbox, result );
+        return;
+      }
+      result.clear();
+      for( uint32 i=0; i<bboxes.size(); ++i )
+        if( bbox.intersects( bboxes[i] ) ) result.push_back( i );
+    }
+
+    Pyramid make_pyramid( unsigned index, BBox2i const& region ) const;
+    Cache::Handle<BlockGenerator> block_handle( int32 bx, int32 by ) const;
+
     ImageView<pixel_type> blend_patch( BBox2i const& patch_bbox ) const;
+    ImageView<pixel_type> cached_patch( BBox2i const& patch_bbox ) const;
     ImageView<pixel_type> draft_patch( BBox2i const& patch_bbox ) const;
 
   public:
     typedef pixel_type result_type;
 
-    ImageComposite() : m_draft_mode(false), m_fill_holes(false), m_reuse_masks(false), m_cache(vw_system_cache()) {}
+    ImageComposite() : m_draft_mode(false), m_fill_holes(false), m_reuse_masks(false), m_num_threads(0), m_block_size(256), m_cache(vw_system_cache()) {}
 
-    void insert( ImageViewRef<pixel_type> const& image, int x, int y );
+    /// Adds a source at the given offset.  If the source was read
+    /// from a file, naming it lets set_reuse_masks() tell whether a
+    /// mask left behind by an earlier run is still up to date.
+    void insert( ImageViewRef<pixel_type> const& image, int x, int y, std::string const& source_file = std::string() );
 
     void prepare( const ProgressCallback &progress_callback = ProgressCallback::dummy_instance() );
     void prepare( BBox2i const& total_bbox, const ProgressCallback &progress_callback = ProgressCallback::dummy_instance() );
@@ -231,8 +347,33 @@ namespace mosaic {
 
     void set_fill_holes( bool fill_holes ) { m_fill_holes = fill_holes; }
 
+    /// Keep masks written by an earlier prepare() rather than building
+    /// them all again.  Each mask is stamped with the file names,
+    /// modification times and positions of the sources it was built
+    /// from, and with the key given to set_mask_key(); a mask whose
+    /// stamp no longer matches is rebuilt.  Masks that overlap a
+    /// source inserted without a file name are always rebuilt.
     void set_reuse_masks( bool reuse_masks ) { m_reuse_masks = reuse_masks; }
 
+    /// Describes whatever else the masks depend on that the composite
+    /// can't see for itself, such as how the sources were masked and
+    /// resampled, so that set_reuse_masks() rebuilds them when it
+    /// changes.
+    void set_mask_key( std::string const& key ) { m_mask_key = key; }
+
+    /// Multi-band output is blended, cached, and handed out in square
+    /// blocks of this size.  Each block is blended from pyramids built
+    /// over just the part of each source that can affect it, so
+    /// memory use depends on the block size and not on the sizes of
+    /// the sources.  Takes effect at the next prepare().
+    void set_block_size( int32 block_size ) { m_block_size = block_size; }
+
+    /// The blocks of a patch that aren't cached yet are blended on this
+    /// many threads.  Zero means the system default.  Set this to one
+    /// when the composite is already rasterized from several threads at
+    /// once, as by a QuadTreeGenerator with more than one thread.
+    void set_num_threads( int32 threads ) { m_num_threads = threads; }
+
     int32 cols() const {
       return view_bbox.width();
     }
@@ -254,10 +395,11 @@ namespace mosaic {
     }
 
     pixel_type operator()( int x, int y, int p=0 ) const {
-      // FIXME: This is horribly slow, and totally untested for
-      // multi-band blending.  We should do something faster for draft
-      // mode, and possibly cache output blocks in multi-band mode?
-      return generate_patch(BBox2i(x,y,1,1))(0,0,p);
+      if( m_draft_mode || ! m_blocks ) return generate_patch(BBox2i(x,y,1,1))(0,0,p);
+      int32 bx = x / m_block_size - (x % m_block_size < 0);
+      int32 by = y / m_block_size - (y % m_block_size < 0);
+      boost::shared_ptr<ImageView<pixel_type> > block = block_handle( bx, by );
+      return (*block)( x - bx*m_block_size, y - by*m_block_size, p );
     }
 
     typedef ProceduralPixelAccessor<ImageComposite> pixel_accessor;
@@ -266,7 +408,7 @@ namespace mosaic {
     typedef CropView<ImageView<PixelT> > prerasterize_type;
 
     inline prerasterize_type prerasterize( BBox2i bbox ) const {
-      ImageView<PixelT> buf = generate_patch(bbox);
+      ImageView<PixelT> buf = ( m_draft_mode || ! m_blocks ) ? generate_patch(bbox) : cached_patch(bbox);
       return CropView<ImageView<PixelT> >( buf, BBox2i(-bbox.min().x(),-bbox.min().y(),cols(),rows()) );
     }
 
@@ -275,7 +417,10 @@ namespace mosaic {
     }
 
     bool sparse_check( BBox2i const& bbox ) const {
-      for (unsigned int i = 0; i < bboxes.size(); ++i) {
+      std::vector<uint32> overlaps;
+      overlapping( bbox, overlaps );
+      for (unsigned int k = 0; k < overlaps.size(); ++k) {
+        uint32 i = overlaps[k];
         BBox2i src_bbox = bboxes[i];
         src_bbox.crop(bbox);
         if( ! src_bbox.empty() ) {
@@ -309,72 +454,123 @@ namespace mosaic {
 } // namespace vw
 
 
+// Describes everything a source's mask depends on: the caller's key,
+// where it and each source overlapping it lie, relative to it, and
+// which files they came from and when those were last changed.  Empty
+// when any of them has no file to check.
+template <class PixelT>
+std::string vw::mosaic::ImageComposite<PixelT>::mask_key( unsigned index, std::vector<uint32> const& overlaps ) const {
+  std::ostringstream key;
+  key << "mask " << index << "\n" << m_mask_key << "\n";
+  for( unsigned k=0; k<overlaps.size(); ++k ) {
+    unsigned p = overlaps[k];
+    if( m_source_files[p].empty() || ! boost::filesystem::exists( m_source_files[p] ) ) return std::string();
+    key << p << " " << ( bboxes[p] - bboxes[index].min() ) << " "
+        << boost::filesystem::last_write_time( m_source_files[p] ) << " " << m_source_files[p] << "\n";
+  }
+  return key.str();
+}
+
+template <class PixelT>
+bool vw::mosaic::ImageComposite<PixelT>::mask_reusable( unsigned index, std::string const& key ) const {
+  // An empty key means there is nothing to check the mask against
+  if( key.empty() || ! boost::filesystem::exists( mask_filename( index ) ) ) return false;
+  std::ifstream file( mask_filename( index, ".key" ).c_str() );
+  if( ! file ) return false;
+  std::ostringstream stamp;
+  stamp << file.rdbuf();
+  return stamp.str() == key;
+}
+
+// Zeroes each pixel of a source's grassfire that is further inside
+// some other source, and writes the result out as that source's mask.
+template <class PixelT>
+void vw::mosaic::ImageComposite<PixelT>::make_mask( unsigned p1, std::vector<uint32> const& overlaps,
+                                                    std::vector<Cache::Handle<GrassfireGenerator> > const& grassfires,
+                                                    std::string const& key ) const {
+  ImageView<float> mask = copy( *(grassfires[p1]) );
+  for( unsigned k=0; k<overlaps.size(); ++k ) {
+    unsigned p2 = overlaps[k];
+    if( p1 == p2 ) continue;
+    int ox = bboxes[p2].min().x() - bboxes[p1].min().x();
+    int oy = bboxes[p2].min().y() - bboxes[p1].min().y();
+    ImageView<float> other = *grassfires[p2];
+    int left = std::max( ox, 0 );
+    int top = std::max( oy, 0 );
+    int right = std::min( bboxes[p2].width()+ox, bboxes[p1].width() );
+    int bottom = std::min( bboxes[p2].height()+oy, bboxes[p1].height() );
+    for( int j=top; j<bottom; ++j ) {
+      for( int i=left; i<right; ++i ) {
+        if( ( other(i-ox,j-oy) > mask(i,j) ) ||
+            ( other(i-ox,j-oy) == mask(i,j) && p2 > p1 ) )
+          mask(i,j) = 0;
+      }
+    }
+  }
+  mask = threshold( mask );
+
+  // Drop the old stamp first, so that a mask left half-written can
+  // never look up to date.
+  std::string key_filename = mask_filename( p1, ".key" );
+  boost::filesystem::remove( key_filename );
+  write_image( mask_filename( p1 ), mask );
+  if( ! key.empty() ) {
+    std::ofstream file( key_filename.c_str() );
+    file << key;
+  }
+}
+
 template <class PixelT>
 void vw::mosaic::ImageComposite<PixelT>::generate_masks( vw::ProgressCallback const& progress_callback ) const {
   vw_out(DebugMessage, "mosaic") << "Generating masks..." << std::endl;
   std::vector<Cache::Handle<GrassfireGenerator> > grassfires;
-  for( unsigned i=0; i<sources.size(); ++i )
+  for( unsigned i=0; i<sourcerefs.size(); ++i )
     grassfires.push_back( m_cache.insert( GrassfireGenerator( sourcerefs[i] ) ) );
-  for( unsigned p1=0; p1<sources.size(); ++p1 ) {
-    ImageView<float> mask = copy( *(grassfires[p1]) );
-    for( unsigned p2=0; p2<sources.size(); ++p2 ) {
-      if( p1 == p2 ) continue;
-      int ox = bboxes[p2].min().x() - bboxes[p1].min().x();
-      int oy = bboxes[p2].min().y() - bboxes[p1].min().y();
-      if( ! ( ox >= bboxes[p1].width() ||
-              oy >= bboxes[p1].height() ||
-              -ox >= bboxes[p2].width() ||
-              -oy >= bboxes[p2].height() ) )
-      {
-        ImageView<float> other = *grassfires[p2];
-        int left = std::max( ox, 0 );
-        int top = std::max( oy, 0 );
-        int right = std::min( bboxes[p2].width()+ox, bboxes[p1].width() );
-        int bottom = std::min( bboxes[p2].height()+oy, bboxes[p1].height() );
-        for( int j=top; j<bottom; ++j ) {
-          for( int i=left; i<right; ++i ) {
-            if( ( other(i-ox,j-oy) > mask(i,j) ) ||
-                ( other(i-ox,j-oy) == mask(i,j) && p2 > p1 ) )
-              mask(i,j) = 0;
-          }
-        }
+
+  // Each mask only reads the grassfires, so they can all be built at
+  // once.
+  MaskStatus status( progress_callback, sourcerefs.size() );
+  {
+    FifoWorkQueue queue;
+    std::vector<uint32> overlaps;
+    for( unsigned p1=0; p1<sourcerefs.size(); ++p1 ) {
+      overlapping( bboxes[p1], overlaps );
+      std::string key = mask_key( p1, overlaps );
+      if( m_reuse_masks && mask_reusable( p1, key ) ) {
+        status.finished();
+        continue;
       }
-      progress_callback.report_fractional_progress( double(p1*(sources.size()+1)+p2+1), double((sources.size()+1)*sources.size()) );
+      queue.add_task( boost::shared_ptr<Task>( new MaskTask( *this, grassfires, p1, overlaps, key, status ) ) );
     }
-    mask = threshold( mask );
-    std::ostringstream filename;
-    filename << "mask." << p1 << ".png";
-    write_image( filename.str(), mask );
-    progress_callback.report_fractional_progress( double((p1+1)*(sources.size()+1)), double((sources.size()+1)*sources.size()) );
+    queue.join_all();
   }
+  status.errors.rethrow();
   // report_finished() called by prepare(), so don't call it here
 }
 
 
+// Builds the Laplacian pyramid of one source, over just the given
+// region of it.  Pixels near the edges of the region that are not
+// also edges of the source come out wrong, so the region must
+// include a halo around whatever part of the pyramid is needed.
 template <class PixelT>
-boost::shared_ptr<typename vw::mosaic::ImageComposite<PixelT>::Pyramid> vw::mosaic::ImageComposite<PixelT>::PyramidGenerator::generate() const {
-  vw_out(DebugMessage, "mosaic") << "ImageComposite generating pyramid " << m_index << std::endl;
-  boost::shared_ptr<Pyramid> ptr( new Pyramid );
-  ImageView<pixel_type> source = copy(*m_composite.sources[m_index]);
-  m_composite.sources[m_index].deprioritize();
+typename vw::mosaic::ImageComposite<PixelT>::Pyramid vw::mosaic::ImageComposite<PixelT>::make_pyramid( unsigned index, BBox2i const& region ) const {
+  Pyramid pyramid;
+  ImageView<pixel_type> source = crop( sourcerefs[index], region - bboxes[index].min() );
 
   // This is sort of a kluge: the hole-filling algorithm currently
   // doesn't cope well with partially-transparent source pixels.
-  if( m_composite.m_fill_holes ) source /= select_alpha_channel(source);
+  if( m_fill_holes ) source /= select_alpha_channel(source);
 
-  PositionedImage<pixel_type> image_high( m_composite.view_bbox.width(), m_composite.view_bbox.height(), source, m_composite.bboxes[m_index] );
+  PositionedImage<pixel_type> image_high( view_bbox.width(), view_bbox.height(), source, region );
   PositionedImage<pixel_type> image_low = image_high.reduce();
-  ImageView<channel_type> mask_image;
+  boost::shared_ptr<ImageView<channel_type> > mask_image = m_masks[index];
+  PositionedImage<channel_type> mask( view_bbox.width(), view_bbox.height(), crop( *mask_image, region - bboxes[index].min() ), region );
 
-  std::ostringstream mask_filename;
-  mask_filename << "mask." << m_index << ".png";
-  read_image( mask_image, mask_filename.str() );
-  PositionedImage<channel_type> mask( m_composite.view_bbox.width(), m_composite.view_bbox.height(), mask_image, m_composite.bboxes[m_index] );
-
-  for( int l=0; l<m_composite.levels; ++l ) {
+  for( int l=0; l<levels; ++l ) {
     PositionedImage<pixel_type> diff = image_high;
     if( l > 0 ) mask = mask.reduce();
-    if( l < m_composite.levels-1 ) {
+    if( l < levels-1 ) {
       PositionedImage<pixel_type> next_image_low = image_low.reduce();
       image_low.unpremultiply();
       diff.subtract_expanded( image_low );
@@ -382,19 +578,17 @@ boost::shared_ptr<typename vw::mosaic::ImageComposite<PixelT>::Pyramid> vw::mosa
       image_low = next_image_low;
     }
     diff *= mask;
-    ptr->images.push_back( diff );
-    ptr->masks.push_back( mask );
+    pyramid.images.push_back( diff );
+    pyramid.masks.push_back( mask );
   }
-  return ptr;
+  return pyramid;
 }
 
 
 template <class PixelT>
-void vw::mosaic::ImageComposite<PixelT>::insert( ImageViewRef<pixel_type> const& image, int x, int y ) {
+void vw::mosaic::ImageComposite<PixelT>::insert( ImageViewRef<pixel_type> const& image, int x, int y, std::string const& source_file ) {
   sourcerefs.push_back( image );
-  sources.push_back( m_cache.insert( SourceGenerator( image ) ) );
-  alphas.push_back( m_cache.insert( AlphaGenerator( *this, pyramids.size() ) ) );
-  pyramids.push_back( m_cache.insert( PyramidGenerator( *this, pyramids.size() ) ) );
+  m_source_files.push_back( source_file );
 
   int cols = image.cols(), rows = image.rows();
   BBox2i image_bbox( Vector2i(x, y), Vector2i(x+cols, y+rows) );
@@ -415,15 +609,26 @@ void vw::mosaic::ImageComposite<PixelT>::insert( ImageViewRef<pixel_type> const&
 template <class PixelT>
 void vw::mosaic::ImageComposite<PixelT>::prepare( vw::ProgressCallback const& progress_callback ) {
   // Translate bboxes to origin
-  for( unsigned i=0; i<sources.size(); ++i )
+  for( unsigned i=0; i<sourcerefs.size(); ++i )
     bboxes[i] -= view_bbox.min();
   data_bbox -= view_bbox.min();
+  m_index.build( bboxes );
 
   levels = (int) floorf( logf( float(mindim)/2.0f ) / logf(2.0f) ) - 1;
   if( levels < 1 ) levels = 1;
 
-  if( !m_draft_mode && !m_reuse_masks ) {
+  m_masks.clear();
+  m_blocks.reset();
+  if( !m_draft_mode ) {
     generate_masks( progress_callback );
+    for( unsigned i=0; i<sourcerefs.size(); ++i )
+      m_masks.push_back( m_cache.insert( MaskGenerator( mask_filename( i ), bboxes[i].width(), bboxes[i].height() ) ) );
+
+    // The blocks blend from a copy of their own, taken before there is
+    // a block cache for it to share and keep alive.
+    ImageComposite *composite = new ImageComposite( *this );
+    m_blocks.reset( new BlockCache );
+    m_blocks->composite.reset( composite );
   }
   progress_callback.report_finished();
 }
@@ -480,23 +685,23 @@ vw::ImageView<PixelT> vw::mosaic::ImageComposite<PixelT>::blend_patch( BBox2i co
     padded_bbox.max().y() = 2*padded_bbox.max().y();
   }
 
-  // Make a list of the images whose bounding boxes permit them to
-  // impact the patch, prioritizing ones that are already in memory.
-  std::list<unsigned> image_list;
-  for( unsigned p=0; p<sources.size(); ++p ) {
-    if( ! padded_bbox.intersects( bboxes[p] ) ) continue;
-    if( ! pyramids[p].valid() ) image_list.push_back( p );
-    else image_list.push_front( p );
-  }
-
-  // Add each source image pyramid to the blend pyramid.
-  std::list<unsigned>::iterator ili=image_list.begin(), ilend=image_list.end();
-  for( ; ili!=ilend; ++ili ) {
-    unsigned p = *ili;
-    boost::shared_ptr<Pyramid> pyr = pyramids[p];
+  // The pyramids below are built from just this part of each source,
+  // which corrupts a band along the cut edges.  Two pixels at the
+  // coarsest level keeps that band clear of the patch.
+  padded_bbox.expand( 1 << levels );
+
+  // Add the pyramid of each source that could impact the patch to
+  // the blend pyramid, building it over just the padded patch.
+  std::vector<uint32> overlaps;
+  overlapping( padded_bbox, overlaps );
+  for( unsigned k=0; k<overlaps.size(); ++k ) {
+    unsigned p = overlaps[k];
+    BBox2i region = padded_bbox;
+    region.crop( bboxes[p] );
+    Pyramid pyr = make_pyramid( p, region );
     for( int l=0; l<levels; ++l ) {
-      pyr->images[l].addto( sum_pyr[l], bbox_pyr[l].min().x(), bbox_pyr[l].min().y() );
-      pyr->masks[l].addto( msum_pyr[l], bbox_pyr[l].min().x(), bbox_pyr[l].min().y() );
+      pyr.images[l].addto( sum_pyr[l], bbox_pyr[l].min().x(), bbox_pyr[l].min().y() );
+      pyr.masks[l].addto( msum_pyr[l], bbox_pyr[l].min().x(), bbox_pyr[l].min().y() );
     }
   }
 
@@ -519,22 +724,19 @@ vw::ImageView<PixelT> vw::mosaic::ImageComposite<PixelT>::blend_patch( BBox2i co
   }
   else {
 
-    // Trim to the maximal source alpha, reloading images if needed
+    // Trim to the maximal source alpha
     ImageView<channel_type> alpha( patch_bbox.width(), patch_bbox.height() );
-    for( unsigned p=0; p<sources.size(); ++p ) {
-      if( ! patch_bbox.intersects( bboxes[p] ) ) continue;
-
-      ImageView<channel_type> source_alpha = *alphas[p];
-
+    overlapping( patch_bbox, overlaps );
+    for( unsigned k=0; k<overlaps.size(); ++k ) {
+      unsigned p = overlaps[k];
       BBox2i overlap = patch_bbox;
       overlap.crop( bboxes[p] );
+      ImageView<channel_type> source_alpha = select_alpha_channel( crop( sourcerefs[p], overlap - bboxes[p].min() ) );
+
       for( int j=0; j<overlap.height(); ++j ) {
         for( int i=0; i<overlap.width(); ++i ) {
-          if( source_alpha( overlap.min().x()+i-bboxes[p].min().x(), overlap.min().y()+j-bboxes[p].min().y() ) >
-              alpha( overlap.min().x()+i-patch_bbox.min().x(), overlap.min().y()+j-patch_bbox.min().y() ) ) {
-            alpha( overlap.min().x()+i-patch_bbox.min().x(), overlap.min().y()+j-patch_bbox.min().y() ) =
-              source_alpha( overlap.min().x()+i-bboxes[p].min().x(), overlap.min().y()+j-bboxes[p].min().y() );
-          }
+          if( source_alpha( i, j ) > alpha( overlap.min().x()+i-patch_bbox.min().x(), overlap.min().y()+j-patch_bbox.min().y() ) )
+            alpha( overlap.min().x()+i-patch_bbox.min().x(), overlap.min().y()+j-patch_bbox.min().y() ) = source_alpha( i, j );
         }
       }
     }
@@ -546,6 +748,55 @@ vw::ImageView<PixelT> vw::mosaic::ImageComposite<PixelT>::blend_patch( BBox2i co
 }
 
 
+template <class PixelT>
+vw::Cache::Handle<typename vw::mosaic::ImageComposite<PixelT>::BlockGenerator> vw::mosaic::ImageComposite<PixelT>::block_handle( int32 bx, int32 by ) const {
+  Mutex::Lock lock( m_blocks->mutex );
+  Cache::Handle<BlockGenerator>& handle = m_blocks->handles[std::make_pair(bx,by)];
+  if( ! handle.attached() )
+    handle = m_cache.insert( BlockGenerator( m_blocks->composite, BBox2i( bx*m_block_size, by*m_block_size, m_block_size, m_block_size ) ) );
+  return handle;
+}
+
+// Assembles a patch of the multi-band mosaic from cached blocks,
+// blending any that are missing in parallel unless this is already
+// one of several threads rasterizing the mosaic.
+template <class PixelT>
+vw::ImageView<PixelT> vw::mosaic::ImageComposite<PixelT>::cached_patch( BBox2i const& patch_bbox ) const {
+  ImageView<pixel_type> composite( patch_bbox.width(), patch_bbox.height() );
+  if( patch_bbox.empty() ) return composite;
+
+  int32 bx0 = patch_bbox.min().x() / m_block_size - (patch_bbox.min().x() % m_block_size < 0);
+  int32 by0 = patch_bbox.min().y() / m_block_size - (patch_bbox.min().y() % m_block_size < 0);
+  int32 bx1 = (patch_bbox.max().x()-1) / m_block_size - ((patch_bbox.max().x()-1) % m_block_size < 0);
+  int32 by1 = (patch_bbox.max().y()-1) / m_block_size - ((patch_bbox.max().y()-1) % m_block_size < 0);
+
+  std::vector<Cache::Handle<BlockGenerator> > handles;
+  std::vector<BBox2i> block_bboxes;
+  for( int32 by=by0; by<=by1; ++by ) {
+    for( int32 bx=bx0; bx<=bx1; ++bx ) {
+      handles.push_back( block_handle( bx, by ) );
+      block_bboxes.push_back( BBox2i( bx*m_block_size, by*m_block_size, m_block_size, m_block_size ) );
+    }
+  }
+
+  int32 threads = m_num_threads ? m_num_threads : int32(vw_settings().default_num_threads());
+  if( handles.size() > 1 && threads > 1 ) {
+    FifoWorkQueue queue( threads );
+    for( unsigned i=0; i<handles.size(); ++i )
+      if( ! handles[i].valid() ) queue.add_task( boost::shared_ptr<Task>( new BlockTask( handles[i] ) ) );
+    queue.join_all();
+  }
+
+  for( unsigned i=0; i<handles.size(); ++i ) {
+    BBox2i overlap = patch_bbox;
+    overlap.crop( block_bboxes[i] );
+    boost::shared_ptr<ImageView<pixel_type> > block = handles[i];
+    crop( composite, overlap - patch_bbox.min() ) = crop( *block, overlap - block_bboxes[i].min() );
+  }
+  return composite;
+}
+
+
 // Generates a full-resolution patch of the mosaic corresponding
 // to the given bounding box WITHOUT blending.
 template <class PixelT>
@@ -556,8 +807,10 @@ vw::ImageView<PixelT> vw::mosaic::ImageComposite<PixelT>::draft_patch( BBox2i co
   ImageView<pixel_type> composite(patch_bbox.width(),patch_bbox.height());
 
   // Add each image to the composite.
-  for( unsigned p=0; p<sources.size(); ++p ) {
-    if( ! patch_bbox.intersects( bboxes[p] ) ) continue;
+  std::vector<uint32> overlaps;
+  overlapping( patch_bbox, overlaps );
+  for( unsigned k=0; k<overlaps.size(); ++k ) {
+    unsigned p = overlaps[k];
     BBox2i bbox = patch_bbox;
     bbox.crop( bboxes[p] );
     PositionedImage<pixel_type> image( view_bbox.width(), view_bbox.height(), crop(sourcerefs[p],bbox-bboxes[p].min()), bbox );
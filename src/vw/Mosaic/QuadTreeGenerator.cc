@@ -13,6 +13,9 @@ namespace fs = boost::filesystem;
 
 #include <vw/FileIO/DiskImageResource.h>
 
+#include <cstdio>
+#include <sstream>
+
 namespace vw {
 namespace mosaic {
 
@@ -67,6 +70,200 @@ namespace mosaic {
     return boost::shared_ptr<DstImageResource>( DiskImageResource::create( info.filepath+info.filetype, format ) );
   }
 
+  boost::shared_ptr<SrcImageResource> QuadTreeGenerator::default_tile_read_func::operator()( QuadTreeGenerator const&, TileInfo const& info ) {
+    return boost::shared_ptr<SrcImageResource>( DiskImageResource::open( info.filepath+info.filetype ) );
+  }
+
+  // 64-bit FNV-1a, seeded with the tile dimensions
+  uint64 QuadTreeGenerator::tile_hash( const void* data, size_t size, Vector2i const& dims ) {
+    uint64 hash = 14695981039346656037ULL;
+    const uint8 *bytes = (const uint8*) data;
+    int32 seed[2] = { dims.x(), dims.y() };
+    for( size_t i=0; i<sizeof(seed); ++i ) {
+      hash ^= ((const uint8*) seed)[i];
+      hash *= 1099511628211ULL;
+    }
+    for( size_t i=0; i<size; ++i ) {
+      hash ^= bytes[i];
+      hash *= 1099511628211ULL;
+    }
+    // Zero is reserved for empty tiles
+    return hash ? hash : 1;
+  }
+
+  // Each entry is one line: the hash, file type, region and image
+  // bboxes, and then the tile name, which runs to the end of the line
+  // and may be empty.  Only complete lines count, so a run that dies
+  // mid-write loses at most the tile it was recording.
+  QuadTreeGenerator::Manifest::Manifest( std::string const& filename, std::string const& header )
+    : m_filename( filename ), m_header( header ) {
+    std::ifstream in( filename.c_str(), std::ios::binary );
+    if( ! in.is_open() ) return;
+    std::ostringstream contents;
+    contents << in.rdbuf();
+    std::string const data = contents.str();
+
+    size_t pos = data.find( '\n' );
+    if( pos == std::string::npos || data.substr( 0, pos ) != header ) {
+      vw_out(WarningMessage, "mosaic") << "Ignoring quadtree manifest \"" << filename
+                                       << "\" written with different settings." << std::endl;
+      return;
+    }
+    for( size_t end; (end = data.find( '\n', ++pos )) != std::string::npos; pos = end ) {
+      std::istringstream line( data.substr( pos, end-pos ) );
+      Entry entry;
+      Vector2i rmin, rsize, imin, isize;
+      line >> std::hex >> entry.hash >> std::dec >> entry.filetype
+           >> rmin[0] >> rmin[1] >> rsize[0] >> rsize[1]
+           >> imin[0] >> imin[1] >> isize[0] >> isize[1];
+      if( ! line || line.get() != ' ' ) continue;
+      std::string name;
+      std::getline( line, name );
+      entry.region_bbox = BBox2i( rmin, rmin + rsize );
+      entry.image_bbox = BBox2i( imin, imin + isize );
+      m_entries[name] = entry;
+    }
+  }
+
+  void QuadTreeGenerator::Manifest::write_entry( std::ostream &out, std::string const& name, Entry const& entry ) {
+    out << std::hex << entry.hash << std::dec << ' ' << entry.filetype << ' '
+        << entry.region_bbox.min().x() << ' ' << entry.region_bbox.min().y() << ' '
+        << entry.region_bbox.width() << ' ' << entry.region_bbox.height() << ' '
+        << entry.image_bbox.min().x() << ' ' << entry.image_bbox.min().y() << ' '
+        << entry.image_bbox.width() << ' ' << entry.image_bbox.height() << ' '
+        << name << '\n';
+  }
+
+  void QuadTreeGenerator::Manifest::invalidate( std::vector<BBox2i> const& regions ) {
+    Mutex::Lock lock( m_mutex );
+    for( std::map<std::string, Entry>::iterator it = m_entries.begin(); it != m_entries.end(); ) {
+      bool dirty = false;
+      for( unsigned i=0; i<regions.size() && !dirty; ++i )
+        dirty = it->second.region_bbox.intersects( regions[i] );
+      if( dirty ) {
+        m_previous.insert( *it );
+        m_entries.erase( it++ );
+      }
+      else ++it;
+    }
+
+    // Write the survivors out to a new file and swap it in, so that the
+    // old manifest stays intact until the new one is complete.
+    std::string temp = m_filename + ".tmp";
+    {
+      std::ofstream out( temp.c_str(), std::ios::binary );
+      out << m_header << '\n';
+      for( std::map<std::string, Entry>::const_iterator it = m_entries.begin(); it != m_entries.end(); ++it )
+        write_entry( out, it->first, it->second );
+      out.close();
+      if( ! out ) vw_throw( IOErr() << "Unable to write quadtree manifest \"" << temp << "\"." );
+    }
+    if( std::rename( temp.c_str(), m_filename.c_str() ) != 0 )
+      vw_throw( IOErr() << "Unable to replace quadtree manifest \"" << m_filename << "\"." );
+
+    m_out.open( m_filename.c_str(), std::ios::binary | std::ios::app );
+    if( ! m_out.is_open() ) vw_throw( IOErr() << "Unable to open quadtree manifest \"" << m_filename << "\"." );
+  }
+
+  bool QuadTreeGenerator::Manifest::find( std::string const& name, Entry &entry ) {
+    Mutex::Lock lock( m_mutex );
+    std::map<std::string, Entry>::const_iterator it = m_entries.find( name );
+    if( it == m_entries.end() ) return false;
+    entry = it->second;
+    return true;
+  }
+
+  bool QuadTreeGenerator::Manifest::unchanged( std::string const& name, std::string const& filetype, uint64 hash ) {
+    Mutex::Lock lock( m_mutex );
+    std::map<std::string, Entry>::const_iterator it = m_previous.find( name );
+    return it != m_previous.end() && it->second.hash == hash && it->second.filetype == filetype;
+  }
+
+  void QuadTreeGenerator::Manifest::record( TileInfo const& info, uint64 hash ) {
+    Entry entry;
+    entry.region_bbox = info.region_bbox;
+    entry.image_bbox = info.image_bbox;
+    entry.filetype = info.filetype;
+    entry.hash = hash;
+
+    Mutex::Lock lock( m_mutex );
+    std::map<std::string, Entry>::iterator it = m_previous.find( info.name );
+    if( it != m_previous.end() ) {
+      if( it->second.hash && ( ! hash || it->second.filetype != info.filetype ) ) {
+        fs::path stale( info.filepath + it->second.filetype, fs::native );
+        if( fs::exists( stale ) ) fs::remove( stale );
+      }
+      m_previous.erase( it );
+    }
+    m_entries[info.name] = entry;
+    write_entry( m_out, info.name, entry );
+    m_out.flush();
+    if( ! m_out ) vw_throw( IOErr() << "Unable to write quadtree manifest \"" << m_filename << "\"." );
+  }
+
+  void QuadTreeGenerator::Manifest::remove_stale( QuadTreeGenerator const& qtree ) {
+    Mutex::Lock lock( m_mutex );
+    for( std::map<std::string, Entry>::const_iterator it = m_previous.begin(); it != m_previous.end(); ++it ) {
+      if( ! it->second.hash ) continue;
+      fs::path stale( qtree.image_path( it->first ) + it->second.filetype, fs::native );
+      if( fs::exists( stale ) ) fs::remove( stale );
+    }
+    m_previous.clear();
+  }
+
+  // Runs one task for a TaskGroup, catching anything it throws
+  class QuadTreeGenerator::TaskGroup::Wrapper : public Task {
+    TaskGroup &m_group;
+    boost::shared_ptr<Task> m_task;
+  public:
+    Wrapper( TaskGroup &group, boost::shared_ptr<Task> const& task ) : m_group( group ), m_task( task ) {}
+    virtual void operator()() {
+      try {
+        (*m_task)();
+      } catch( ... ) {
+        m_group.m_errors.capture();
+      }
+      m_group.finished();
+    }
+  };
+
+  QuadTreeGenerator::TaskGroup::TaskGroup( int num_threads, size_t max_pending )
+    : m_max_pending( max_pending ), m_pending( 0 ), m_queue( num_threads ) {}
+
+  QuadTreeGenerator::TaskGroup::~TaskGroup() {
+    m_queue.join_all();
+  }
+
+  void QuadTreeGenerator::TaskGroup::add( boost::shared_ptr<Task> const& task ) {
+    {
+      Mutex::Lock lock( m_mutex );
+      while( m_max_pending && m_pending >= m_max_pending )
+        m_cond.wait( lock );
+      ++m_pending;
+    }
+    m_queue.add_task( boost::shared_ptr<Task>( new Wrapper( *this, task ) ) );
+  }
+
+  void QuadTreeGenerator::TaskGroup::finished() {
+    Mutex::Lock lock( m_mutex );
+    --m_pending;
+    m_cond.notify_all();
+  }
+
+  bool QuadTreeGenerator::TaskGroup::failed() {
+    return m_errors.failed();
+  }
+
+  void QuadTreeGenerator::TaskGroup::join() {
+    {
+      Mutex::Lock lock( m_mutex );
+      while( m_pending > 0 )
+        m_cond.wait( lock );
+    }
+    m_queue.join_all();
+    m_errors.rethrow();
+  }
+
   void QuadTreeGenerator::generate( const ProgressCallback &progress_callback ) {
     ScopedWatch sw("QuadTreeGenerator::generate");
     int32 tree_levels = get_tree_levels();
@@ -75,8 +272,20 @@ namespace mosaic {
     vw_out(DebugMessage, "mosaic") << "Generating tile files of type: " << m_file_type << std::endl;
     vw_out(DebugMessage, "mosaic") << "Generating quadtree with " << tree_levels << " levels." << std::endl;
 
+    m_manifest.reset();
+    if( ! m_manifest_file.empty() ) {
+      std::ostringstream header;
+      header << "vw-quadtree-manifest 1 " << m_tile_size << " " << m_file_type << " "
+             << m_dimensions.x() << " " << m_dimensions.y();
+      m_manifest.reset( new Manifest( m_manifest_file, header.str() ) );
+      m_manifest->invalidate( m_changed_regions );
+      m_changed_regions.clear();
+    }
+
     BBox2i region_bbox = BBox2i(0,0,m_tile_size,m_tile_size) * (1<<(tree_levels-1));
     m_processor->generate( region_bbox, progress_callback );
+    if( m_manifest ) m_manifest->remove_stale( *this );
+    m_manifest.reset();
 
     progress_callback.report_finished();
   }
@@ -13,6 +13,7 @@
 #define __VW_MOSAIC_QUADTREEGENERATOR_H__
 
 #include <vector>
+#include <list>
 #include <map>
 #include <string>
 #include <fstream>
@@ -21,10 +22,13 @@
 
 #include <vw/Core/ProgressCallback.h>
 #include <vw/Core/Stopwatch.h>
+#include <vw/Core/Thread.h>
+#include <vw/Core/ThreadPool.h>
 #include <vw/Image/EdgeExtension.h>
 #include <vw/Image/SparseImageCheck.h>
 #include <vw/Image/ImageView.h>
 #include <vw/Image/ImageViewRef.h>
+#include <vw/Image/ImageIO.h>
 #include <vw/Image/Algorithms.h>
 #include <vw/Image/Filter.h>
 
@@ -54,6 +58,7 @@ namespace mosaic {
     typedef boost::function<std::string(QuadTreeGenerator const&, std::string const&)> image_path_func_type;
     typedef boost::function<std::vector<std::pair<std::string,BBox2i> >(QuadTreeGenerator const&, std::string const&, BBox2i const&)> branch_func_type;
     typedef boost::function<boost::shared_ptr<DstImageResource>(QuadTreeGenerator const&, TileInfo const&, ImageFormat const&)> tile_resource_func_type;
+    typedef boost::function<boost::shared_ptr<SrcImageResource>(QuadTreeGenerator const&, TileInfo const&)> tile_read_func_type;
     typedef boost::function<void(QuadTreeGenerator const&, TileInfo const&)> metadata_func_type;
     typedef boost::function<bool(BBox2i const&)> sparse_image_check_type;
 
@@ -74,11 +79,13 @@ namespace mosaic {
         m_crop_bbox(),
         m_crop_images( false ),
         m_cull_images( false ),
+        m_num_threads( 1 ),
         m_dimensions( image.impl().cols(), image.impl().rows() ),
         m_processor( new Processor<typename ImageT::pixel_type>( this, image.impl() ) ),
         m_image_path_func( simple_image_path() ),
         m_branch_func( default_branch_func() ),
         m_tile_resource_func( default_tile_resource_func() ),
+        m_tile_read_func( default_tile_read_func() ),
         m_metadata_func(),
         m_sparse_image_check( SparseImageCheck<ImageT>(image.impl()) )
     {}
@@ -125,6 +132,21 @@ namespace mosaic {
       m_tile_size = size;
     }
 
+    int32 get_num_threads() const {
+      return m_num_threads;
+    }
+
+    /// With more than one thread, subtrees are generated concurrently
+    /// and tiles are encoded and written by a separate pool of I/O
+    /// threads.  The source image, the image path, branch, tile
+    /// resource and metadata functions must then be safe to call from
+    /// several threads at once.  Metadata for a tile is still only
+    /// generated once all of its children's metadata has been.  Zero
+    /// means the system default.
+    void set_num_threads( int32 threads ) {
+      m_num_threads = threads;
+    }
+
     int32 get_tree_levels() const {
       int32 maxdim = (std::max)( m_dimensions.x(), m_dimensions.y() );
       int32 tree_levels = 1 + int32( ceil( log( maxdim/(double)(m_tile_size) ) / log(2.0) ) );
@@ -176,6 +198,37 @@ namespace mosaic {
       return m_tile_resource_func( *this, info, format );
     }
 
+    /// Sets the function used to read back tiles written by an
+    /// earlier run in incremental mode.  It should undo whatever the
+    /// tile resource function does.
+    void set_tile_read_func( tile_read_func_type const& tile_read_func ) {
+      m_tile_read_func = tile_read_func;
+    }
+
+    std::string const& get_manifest_file() const {
+      return m_manifest_file;
+    }
+
+    /// Turns on incremental generation.  Every tile is recorded in
+    /// the manifest file once it and its metadata have been written,
+    /// and tiles already recorded there are read back rather than
+    /// regenerated.  An interrupted run therefore resumes where it
+    /// left off, and a run over a finished tree only redoes the tiles
+    /// touched by add_changed_region().  The manifest is discarded if
+    /// the tile size, file type, or image dimensions change.  Parents
+    /// of regenerated tiles are rebuilt from their children's tiles
+    /// as stored, so lossy file types lose a little more each time.
+    void set_manifest_file( std::string const& filename ) {
+      m_manifest_file = filename;
+    }
+
+    /// Marks a region of the source image as changed since the last
+    /// run, so that the tiles covering it are regenerated by the next
+    /// call to generate().
+    void add_changed_region( BBox2i const& bbox ) {
+      m_changed_regions.push_back( bbox );
+    }
+
     void set_metadata_func( metadata_func_type metadata_func ) {
       m_metadata_func = metadata_func;
     }
@@ -219,27 +272,194 @@ namespace mosaic {
       boost::shared_ptr<DstImageResource> operator()( QuadTreeGenerator const& qtree, TileInfo const& info, ImageFormat const& format );
     };
 
+    // The default read function, opens standard disk image resources
+    struct default_tile_read_func {
+      boost::shared_ptr<SrcImageResource> operator()( QuadTreeGenerator const& qtree, TileInfo const& info );
+    };
+
   protected:
-    template <class PixelT>
-    class Processor : public ProcessorBase {
-      ImageViewRef<PixelT> m_source;
+    // The tiles known to be finished, as recorded on disk.  A hash of
+    // zero means the tile was empty and no file was written.
+    class Manifest {
+    public:
+      struct Entry {
+        BBox2i region_bbox, image_bbox;
+        std::string filetype;
+        uint64 hash;
+      };
+
+      Manifest( std::string const& filename, std::string const& header );
 
+      // Forgets every tile that overlaps one of the regions, then
+      // rewrites the file with those that remain.
+      void invalidate( std::vector<BBox2i> const& regions );
+
+      bool find( std::string const& name, Entry &entry );
+
+      // Whether a tile being regenerated came out the same as before
+      bool unchanged( std::string const& name, std::string const& filetype, uint64 hash );
+
+      // Records a finished tile, removing any file of another type
+      // that an earlier version of it left behind.
+      void record( TileInfo const& info, uint64 hash );
+
+      // Removes the files of the forgotten tiles that were not
+      // recorded again, such as those that have since come out sparse
+      // or fallen outside the crop.  Call once the tree is complete.
+      void remove_stale( QuadTreeGenerator const& qtree );
+
+    private:
+      std::string m_filename, m_header;
+      std::map<std::string, Entry> m_entries, m_previous;
+      std::ofstream m_out;
+      Mutex m_mutex;
+
+      void write_entry( std::ostream &out, std::string const& name, Entry const& entry );
+    };
+
+    static uint64 tile_hash( const void* data, size_t size, Vector2i const& dims );
+
+    // Runs tasks on a thread pool, remembering the first failure so it
+    // can be rethrown from join() on the calling thread.  If
+    // max_pending is nonzero, add() blocks while that many tasks are
+    // queued or running.
+    class TaskGroup {
+      class Wrapper;
+      friend class Wrapper;
+
+      size_t m_max_pending, m_pending;
+      TaskErrors m_errors;
+      Mutex m_mutex;
+      Condition m_cond;
+      // Last, so the running tasks are done before the state they
+      // report to goes away.
+      FifoWorkQueue m_queue;
+
+      void finished();
     public:
-      template <class ImageT>
-      Processor( QuadTreeGenerator *qtree, ImageT const& source )
-        : ProcessorBase( qtree ), m_source( source )
-      {}
+      TaskGroup( int num_threads, size_t max_pending );
+      ~TaskGroup();
+      void add( boost::shared_ptr<Task> const& task );
+      bool failed();
+      void join();
+    };
 
-      void generate( BBox2i const& region_bbox, const ProgressCallback &progress_callback ) {
-        generate_branch( "", region_bbox, progress_callback );
+    // A tile whose metadata waits on its own write and on the metadata
+    // of its children.  The count starts with one for the tile itself.
+    struct MetadataNode {
+      TileInfo info;
+      boost::shared_ptr<MetadataNode> parent;
+      int32 pending;
+      uint64 hash;
+      Mutex mutex;
+      MetadataNode( boost::shared_ptr<MetadataNode> const& parent ) : parent( parent ), pending( 1 ), hash( 0 ) {
+        if( parent ) {
+          Mutex::Lock lock( parent->mutex );
+          ++parent->pending;
+        }
       }
+    };
 
-      ImageView<PixelT> generate_branch( std::string const& name, BBox2i const& region_bbox, const ProgressCallback &progress_callback ) {
-        progress_callback.report_progress(0);
-        progress_callback.abort_if_requested();
+    // Drops one count on node, generating its metadata and moving on
+    // to its parent once the count is gone.
+    void release( boost::shared_ptr<MetadataNode> node ) const {
+      while( node ) {
+        {
+          Mutex::Lock lock( node->mutex );
+          if( --node->pending > 0 ) return;
+        }
+        if( m_metadata_func ) m_metadata_func( *this, node->info );
+        if( m_manifest ) m_manifest->record( node->info, node->hash );
+        node = node->parent;
+      }
+    }
 
-        ImageView<PixelT> image;
+    template <class PixelT>
+    class Processor : public ProcessorBase {
+      ImageViewRef<PixelT> m_source;
+      TaskGroup *m_writer;
+
+      // Writes one tile, then releases it for metadata
+      class WriteTileTask : public Task {
+        QuadTreeGenerator const& m_qtree;
+        ImageView<PixelT> m_image;
+        boost::shared_ptr<MetadataNode> m_node;
+      public:
+        WriteTileTask( QuadTreeGenerator const& qtree, ImageView<PixelT> const& image, boost::shared_ptr<MetadataNode> const& node )
+          : m_qtree( qtree ), m_image( image ), m_node( node ) {}
+        virtual void operator()() {
+          if( m_image ) {
+            ScopedWatch sw("QuadTreeGenerator::write_tile");
+            boost::shared_ptr<DstImageResource> r = m_qtree.m_tile_resource_func( m_qtree, m_node->info, m_image.format() );
+            write_image( *r, m_image );
+          }
+          m_qtree.release( m_node );
+        }
+      };
+
+      // A tile above the subtrees, assembled as they finish
+      struct Node {
         TileInfo info;
+        Vector2i scale;
+        ImageView<PixelT> image;
+        Node *parent;
+        BBox2i dst_bbox;
+        int32 pending;
+        boost::shared_ptr<MetadataNode> metadata;
+        Mutex mutex;
+      };
+
+      // Reports progress as subtrees finish
+      struct ProgressState {
+        ProgressCallback const& callback;
+        double done, total;
+        Mutex mutex;
+        ProgressState( ProgressCallback const& callback ) : callback( callback ), done( 0 ), total( 0 ) {}
+        void report( double area ) {
+          Mutex::Lock lock( mutex );
+          done += area;
+          if( total > 0 ) callback.report_progress( done / total );
+        }
+      };
+
+      // A subtree waiting to be handed out
+      struct PendingSubtree {
+        std::string name;
+        BBox2i region_bbox;
+        Node *parent;
+        BBox2i dst_bbox;
+      };
+
+      // Generates one subtree on its own and hands the result up
+      class SubtreeTask : public Task {
+        Processor &m_processor;
+        std::string m_name;
+        BBox2i m_region_bbox;
+        Node *m_parent;
+        BBox2i m_dst_bbox;
+        double m_area;
+        TaskGroup &m_group;
+        ProgressState &m_progress;
+      public:
+        SubtreeTask( Processor &processor, PendingSubtree const& subtree, double area,
+                     TaskGroup &group, ProgressState &progress )
+          : m_processor( processor ), m_name( subtree.name ), m_region_bbox( subtree.region_bbox ),
+            m_parent( subtree.parent ), m_dst_bbox( subtree.dst_bbox ), m_area( area ),
+            m_group( group ), m_progress( progress ) {}
+        virtual void operator()() {
+          if( m_group.failed() ) return;
+          m_progress.callback.abort_if_requested();
+          ImageView<PixelT> image = m_processor.generate_branch( m_name, m_region_bbox, ProgressCallback::dummy_instance(),
+                                                                 m_parent ? m_parent->metadata : boost::shared_ptr<MetadataNode>() );
+          m_processor.deliver( m_parent, m_dst_bbox, image );
+          m_progress.report( m_area );
+        }
+      };
+
+      // Sets up info for a tile.  Returns false if there is nothing
+      // more to do, in which case image holds the result.
+      bool begin_tile( std::string const& name, BBox2i const& region_bbox, TileInfo &info, Vector2i &scale,
+                       std::vector<std::pair<std::string, BBox2i> > &children, ImageView<PixelT> &image ) const {
         info.name = name;
         info.region_bbox = region_bbox;
 
@@ -251,40 +471,45 @@ namespace mosaic {
         if( info.image_bbox.empty() ) {
           if( ! (qtree->get_crop_images() || qtree->get_cull_images()) )
             image.set_size( qtree->get_tile_size(), qtree->get_tile_size() );
-          return image;
+          return false;
         }
 
-        if( qtree->m_sparse_image_check && ! qtree->m_sparse_image_check(info.region_bbox) ) return image;
+        if( qtree->m_sparse_image_check && ! qtree->m_sparse_image_check(info.region_bbox) ) return false;
 
-        Vector2i scale = info.region_bbox.size() / qtree->m_tile_size;
+        scale = info.region_bbox.size() / qtree->m_tile_size;
 
-        std::vector<std::pair<std::string, BBox2i> > children = qtree->m_branch_func(*qtree,info.name,info.region_bbox);
-        if( children.empty() ) {
-          image = crop( m_source, info.image_bbox );
-          if( info.image_bbox != info.region_bbox ) {
-            image = edge_extend( image, info.region_bbox - info.image_bbox.min(), ZeroEdgeExtension() );
-          }
-          if( info.region_bbox.width() != qtree->m_tile_size || info.region_bbox.height() != qtree->m_tile_size ) {
-            image = subsample( image, scale.x(), scale.y() );
-          }
-        }
-        else {
-          image.set_size(qtree->m_tile_size,qtree->m_tile_size);
-          double total_area = (double) info.image_bbox.width() * info.image_bbox.height();
-          for( unsigned i=0; i<children.size(); ++i ) {
-            BBox2i image_bbox = children[i].second;
-            image_bbox.crop( info.image_bbox );
-            if( image_bbox.empty() ) continue;
-            double child_area = (double) image_bbox.width() * image_bbox.height();
-            double progress = progress_callback.progress();
-            SubProgressCallback spc( progress_callback, progress, progress + child_area/total_area );
-            ImageView<PixelT> child = generate_branch(children[i].first, children[i].second, spc);
-            if( ! child ) continue;
-            BBox2i dst_bbox = elem_quot( children[i].second - info.region_bbox.min(), scale );
-            crop(image,dst_bbox) = box_subsample( child, elem_quot(qtree->m_tile_size,dst_bbox.size()) );
+        Manifest::Entry entry;
+        if( qtree->m_manifest && qtree->m_manifest->find( info.name, entry ) ) {
+          if( entry.hash ) {
+            info.image_bbox = entry.image_bbox;
+            info.filetype = entry.filetype;
+            info.filepath = qtree->m_image_path_func( *qtree, info.name );
+            image = read_tile( info, scale );
           }
+          return false;
         }
 
+        children = qtree->m_branch_func(*qtree,info.name,info.region_bbox);
+        return true;
+      }
+
+      // Reads back a tile from an earlier run, padded out to full size
+      // if it was cropped.
+      ImageView<PixelT> read_tile( TileInfo const& info, Vector2i const& scale ) const {
+        ScopedWatch sw("QuadTreeGenerator::read_tile");
+        ImageView<PixelT> tile;
+        boost::shared_ptr<SrcImageResource> r = qtree->m_tile_read_func( *qtree, info );
+        read_image( tile, *r );
+        if( tile.cols() == qtree->m_tile_size && tile.rows() == qtree->m_tile_size ) return tile;
+        ImageView<PixelT> image( qtree->m_tile_size, qtree->m_tile_size );
+        crop( image, elem_quot( info.image_bbox - info.region_bbox.min(), scale ) ) = tile;
+        return image;
+      }
+
+      // Crops, names, and writes a finished tile, then generates its
+      // metadata (or hands both to the I/O threads).
+      void finish_tile( TileInfo &info, Vector2i const& scale, ImageView<PixelT> const& image,
+                        boost::shared_ptr<MetadataNode> const& metadata ) const {
         ImageView<PixelT> cropped_image = image;
         if( qtree->m_crop_images || qtree->m_cull_images ) {
           BBox2i data_bbox = elem_quot( info.image_bbox-info.region_bbox.min(), scale );
@@ -308,12 +533,217 @@ namespace mosaic {
         }
 
         info.filepath = qtree->m_image_path_func( *qtree, info.name );
-        if( cropped_image ) {
+
+        // Leave tiles that came out the same as last time alone
+        uint64 hash = 0;
+        ImageView<PixelT> to_write = cropped_image;
+        if( qtree->m_manifest && cropped_image ) {
+          hash = tile_hash( &cropped_image(0,0), cropped_image.cols()*cropped_image.rows()*sizeof(PixelT),
+                            Vector2i( cropped_image.cols(), cropped_image.rows() ) );
+          if( qtree->m_manifest->unchanged( info.name, info.filetype, hash ) ) to_write.reset();
+        }
+
+        if( m_writer ) {
+          metadata->info = info;
+          metadata->hash = hash;
+          m_writer->add( boost::shared_ptr<Task>( new WriteTileTask( *qtree, to_write, metadata ) ) );
+          return;
+        }
+        if( to_write ) {
           ScopedWatch sw("QuadTreeGenerator::write_tile");
-          boost::shared_ptr<DstImageResource> r = qtree->m_tile_resource_func( *qtree, info, cropped_image.format() );
-          write_image( *r, cropped_image );
+          boost::shared_ptr<DstImageResource> r = qtree->m_tile_resource_func( *qtree, info, to_write.format() );
+          write_image( *r, to_write );
         }
         if( qtree->m_metadata_func ) qtree->m_metadata_func( *qtree, info );
+        if( qtree->m_manifest ) qtree->m_manifest->record( info, hash );
+      }
+
+      // Subsamples a finished child into its parent, finishing the
+      // parent (and so on up) once its last child is in.
+      void deliver( Node *node, BBox2i dst_bbox, ImageView<PixelT> child ) {
+        while( node ) {
+          {
+            Mutex::Lock lock( node->mutex );
+            if( child ) crop(node->image,dst_bbox) = box_subsample( child, elem_quot(qtree->m_tile_size,dst_bbox.size()) );
+            if( --node->pending > 0 ) return;
+          }
+          finish_tile( node->info, node->scale, node->image, node->metadata );
+          child = node->image;
+          dst_bbox = node->dst_bbox;
+          node = node->parent;
+        }
+      }
+
+      // Clears m_writer once the threads using it are done
+      struct WriterGuard {
+        TaskGroup *&writer;
+        WriterGuard( TaskGroup *&writer ) : writer( writer ) {}
+        ~WriterGuard() { writer = 0; }
+      };
+
+      void generate_parallel( BBox2i const& region_bbox, const ProgressCallback &progress_callback, int32 num_threads ) {
+        // Declared so that both pools are drained before anything
+        // their tasks refer to goes away.
+        WriterGuard guard( m_writer );
+        std::list<boost::shared_ptr<Node> > nodes;
+        ProgressState progress( progress_callback );
+        TaskGroup writer( num_threads, 2*num_threads );
+        TaskGroup workers( num_threads, 0 );
+        m_writer = &writer;
+
+        // Walk down the top of the tree, breadth first, until there
+        // are enough subtrees to keep every thread busy.  Each thread
+        // then holds at most one tile per level of its subtree.
+        std::vector<PendingSubtree> frontier(1), next;
+        frontier[0].region_bbox = region_bbox;
+        frontier[0].parent = 0;
+        size_t target = 4*num_threads;
+        while( frontier.size() < target ) {
+          next.clear();
+          bool expanded = false;
+          for( unsigned f=0; f<frontier.size(); ++f ) {
+            PendingSubtree const& p = frontier[f];
+            TileInfo info;
+            Vector2i scale;
+            std::vector<std::pair<std::string, BBox2i> > children;
+            ImageView<PixelT> image;
+            if( ! begin_tile( p.name, p.region_bbox, info, scale, children, image ) ) {
+              // Nothing to generate here; hand what there is straight up
+              if( p.parent && image ) {
+                {
+                  Mutex::Lock lock( p.parent->mutex );
+                  ++p.parent->pending;
+                }
+                deliver( p.parent, p.dst_bbox, image );
+              }
+              continue;
+            }
+            if( children.empty() ) {
+              next.push_back( p );
+              continue;
+            }
+            boost::shared_ptr<Node> node( new Node );
+            node->info = info;
+            node->scale = scale;
+            node->image.set_size( qtree->m_tile_size, qtree->m_tile_size );
+            node->parent = p.parent;
+            node->dst_bbox = p.dst_bbox;
+            node->pending = 1; // Released once everything below is queued
+            node->metadata.reset( new MetadataNode( p.parent ? p.parent->metadata : boost::shared_ptr<MetadataNode>() ) );
+            if( p.parent ) {
+              Mutex::Lock lock( p.parent->mutex );
+              ++p.parent->pending;
+            }
+            nodes.push_back( node );
+            for( unsigned i=0; i<children.size(); ++i ) {
+              BBox2i image_bbox = children[i].second;
+              image_bbox.crop( info.image_bbox );
+              if( image_bbox.empty() ) continue;
+              PendingSubtree c;
+              c.name = children[i].first;
+              c.region_bbox = children[i].second;
+              c.parent = node.get();
+              c.dst_bbox = elem_quot( children[i].second - info.region_bbox.min(), scale );
+              next.push_back( c );
+            }
+            expanded = true;
+          }
+          frontier.swap( next );
+          if( ! expanded ) break;
+        }
+
+        // Hand the subtrees out
+        BBox2i crop_bbox(Vector2i(), qtree->get_dimensions());
+        if( ! qtree->get_crop_bbox().empty() ) crop_bbox.crop( qtree->get_crop_bbox() );
+        std::vector<double> areas( frontier.size() );
+        for( unsigned f=0; f<frontier.size(); ++f ) {
+          BBox2i image_bbox = frontier[f].region_bbox;
+          image_bbox.crop( crop_bbox );
+          areas[f] = (double) image_bbox.width() * image_bbox.height();
+          progress.total += areas[f];
+          if( frontier[f].parent ) {
+            Mutex::Lock lock( frontier[f].parent->mutex );
+            ++frontier[f].parent->pending;
+          }
+        }
+        progress_callback.report_progress(0);
+        for( unsigned f=0; f<frontier.size(); ++f )
+          workers.add( boost::shared_ptr<Task>( new SubtreeTask( *this, frontier[f], areas[f], workers, progress ) ) );
+
+        // Let go of the nodes' own counts, deepest first, so that
+        // those whose subtrees have all finished already complete.
+        for( typename std::list<boost::shared_ptr<Node> >::reverse_iterator it = nodes.rbegin(); it != nodes.rend(); ++it )
+          deliver( it->get(), BBox2i(), ImageView<PixelT>() );
+
+        // The workers' tiles may still be queued for writing, so the
+        // writer is drained even when the workers failed.
+        try {
+          workers.join();
+        } catch( ... ) {
+          try { writer.join(); } catch( ... ) {}
+          throw;
+        }
+        writer.join();
+        progress_callback.report_progress(1);
+      }
+
+    public:
+      template <class ImageT>
+      Processor( QuadTreeGenerator *qtree, ImageT const& source )
+        : ProcessorBase( qtree ), m_source( source ), m_writer( 0 )
+      {}
+
+      void generate( BBox2i const& region_bbox, const ProgressCallback &progress_callback ) {
+        int32 num_threads = qtree->get_num_threads();
+        if( num_threads == 0 ) num_threads = vw_settings().default_num_threads();
+        if( num_threads > 1 )
+          generate_parallel( region_bbox, progress_callback, num_threads );
+        else
+          generate_branch( "", region_bbox, progress_callback );
+      }
+
+      ImageView<PixelT> generate_branch( std::string const& name, BBox2i const& region_bbox, const ProgressCallback &progress_callback,
+                                         boost::shared_ptr<MetadataNode> const& parent_metadata = boost::shared_ptr<MetadataNode>() ) {
+        progress_callback.report_progress(0);
+        progress_callback.abort_if_requested();
+
+        ImageView<PixelT> image;
+        TileInfo info;
+        Vector2i scale;
+        std::vector<std::pair<std::string, BBox2i> > children;
+        if( ! begin_tile( name, region_bbox, info, scale, children, image ) )
+          return image;
+
+        boost::shared_ptr<MetadataNode> metadata;
+        if( m_writer ) metadata.reset( new MetadataNode( parent_metadata ) );
+
+        if( children.empty() ) {
+          image = crop( m_source, info.image_bbox );
+          if( info.image_bbox != info.region_bbox ) {
+            image = edge_extend( image, info.region_bbox - info.image_bbox.min(), ZeroEdgeExtension() );
+          }
+          if( info.region_bbox.width() != qtree->m_tile_size || info.region_bbox.height() != qtree->m_tile_size ) {
+            image = subsample( image, scale.x(), scale.y() );
+          }
+        }
+        else {
+          image.set_size(qtree->m_tile_size,qtree->m_tile_size);
+          double total_area = (double) info.image_bbox.width() * info.image_bbox.height();
+          for( unsigned i=0; i<children.size(); ++i ) {
+            BBox2i image_bbox = children[i].second;
+            image_bbox.crop( info.image_bbox );
+            if( image_bbox.empty() ) continue;
+            double child_area = (double) image_bbox.width() * image_bbox.height();
+            double progress = progress_callback.progress();
+            SubProgressCallback spc( progress_callback, progress, progress + child_area/total_area );
+            ImageView<PixelT> child = generate_branch(children[i].first, children[i].second, spc, metadata);
+            if( ! child ) continue;
+            BBox2i dst_bbox = elem_quot( children[i].second - info.region_bbox.min(), scale );
+            crop(image,dst_bbox) = box_subsample( child, elem_quot(qtree->m_tile_size,dst_bbox.size()) );
+          }
+        }
+
+        finish_tile( info, scale, image, metadata );
 
         progress_callback.report_progress(1);
         return image;
@@ -328,12 +758,17 @@ namespace mosaic {
     BBox2i m_crop_bbox;
     bool m_crop_images;
     bool m_cull_images;
+    int32 m_num_threads;
+    std::string m_manifest_file;
+    std::vector<BBox2i> m_changed_regions;
+    boost::shared_ptr<Manifest> m_manifest;
     Vector2i m_dimensions;
     boost::shared_ptr<ProcessorBase> m_processor;
 
     image_path_func_type m_image_path_func;
     branch_func_type m_branch_func;
     tile_resource_func_type m_tile_resource_func;
+    tile_read_func_type m_tile_read_func;
     metadata_func_type m_metadata_func;
     sparse_image_check_type m_sparse_image_check;
   };
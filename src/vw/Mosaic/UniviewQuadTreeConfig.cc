@@ -35,11 +35,25 @@ namespace mosaic {
     }
 
   public:
-    // We only provide a constructor for image *creation*, at least for now.
     UniviewTerrainResource( std::string const& filename, ImageFormat const& format )
       : DiskImageResourcePNG( filename, make_uint16(format) )
     {}
 
+    // Opens an existing terrain tile, for incremental regeneration.
+    UniviewTerrainResource( std::string const& filename )
+      : DiskImageResourcePNG( filename )
+    {}
+
+    // The reverse of write(): read the uint16 data and reinterpret it
+    // as int16 before converting.
+    void read( ImageBuffer const& dst, BBox2i const& bbox ) const {
+      ImageView<PixelGray<uint16> > im_buf( bbox.width(), bbox.height() );
+      ImageBuffer buffer = im_buf.buffer();
+      DiskImageResourcePNG::read( buffer, bbox );
+      buffer.format.channel_type = VW_CHANNEL_INT16;
+      convert( dst, buffer );
+    }
+
     // First we convert to single-channel signed int16, then we spoof that as
     // uint16 data and pass it along to DiskImageResourcePNG to write.
     void write( ImageBuffer const& src, BBox2i const& bbox ) {
@@ -84,10 +98,17 @@ namespace mosaic {
     return boost::shared_ptr<DstImageResource>( new UniviewTerrainResource( info.filepath+info.filetype, format ) );
   }
 
+  boost::shared_ptr<SrcImageResource> UniviewQuadTreeConfig::terrain_tile_read( QuadTreeGenerator const& /*qtree*/,QuadTreeGenerator::TileInfo const& info ) {
+    return boost::shared_ptr<SrcImageResource>( new UniviewTerrainResource( info.filepath+info.filetype ) );
+  }
+
 
   void UniviewQuadTreeConfig::configure( QuadTreeGenerator &qtree ) const {
     qtree.set_image_path_func( &image_path );
-    if( m_terrain ) qtree.set_tile_resource_func( &terrain_tile_resource );
+    if( m_terrain ) {
+      qtree.set_tile_resource_func( &terrain_tile_resource );
+      qtree.set_tile_read_func( &terrain_tile_read );
+    }
     qtree.set_metadata_func( boost::bind(&UniviewQuadTreeConfig::metadata_func,this,_1,_2) );
   }
 
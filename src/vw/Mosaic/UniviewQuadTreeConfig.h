@@ -31,6 +31,7 @@ namespace mosaic {
 
     static std::string image_path( QuadTreeGenerator const& qtree, std::string const& name );
     static boost::shared_ptr<DstImageResource> terrain_tile_resource( QuadTreeGenerator const& qtree, QuadTreeGenerator::TileInfo const& info, ImageFormat const& format );
+    static boost::shared_ptr<SrcImageResource> terrain_tile_read( QuadTreeGenerator const& qtree, QuadTreeGenerator::TileInfo const& info );
 
     void metadata_func( QuadTreeGenerator const& qtree, QuadTreeGenerator::TileInfo const& info ) const;
     void set_module(const std::string& module);
@@ -0,0 +1,80 @@
+// __BEGIN_LICENSE__
+// Copyright (C) 2006-2011 United States Government as represented by
+// the Administrator of the National Aeronautics and Space Administration.
+// All Rights Reserved.
+// __END_LICENSE__
+
+
+#include <gtest/gtest.h>
+#include <vw/Mosaic/BBoxIndex.h>
+
+#include <cstdlib>
+
+using namespace std;
+using namespace vw;
+using namespace vw::mosaic;
+
+static BBox2i random_bbox( int32 extent, int32 max_size ) {
+  int32 x = rand() % extent, y = rand() % extent;
+  return BBox2i( x, y, 1 + rand() % max_size, 1 + rand() % max_size );
+}
+
+static void brute_force( vector<BBox2i> const& bboxes, BBox2i const& bbox, vector<uint32> &result ) {
+  result.clear();
+  for( uint32 i=0; i<bboxes.size(); ++i )
+    if( bboxes[i].intersects( bbox ) ) result.push_back( i );
+}
+
+TEST( BBoxIndex, Empty ) {
+  vector<BBox2i> bboxes;
+  BBoxIndex index( bboxes );
+  EXPECT_EQ( 0u, index.size() );
+  vector<uint32> result( 3 );
+  index.intersects( BBox2i(0,0,10,10), result );
+  EXPECT_TRUE( result.empty() );
+}
+
+TEST( BBoxIndex, Edges ) {
+  vector<BBox2i> bboxes;
+  bboxes.push_back( BBox2i(0,0,10,10) );
+  bboxes.push_back( BBox2i(10,0,10,10) );
+  BBoxIndex index( bboxes );
+  vector<uint32> result;
+
+  // Boxes that only share an edge do not intersect
+  index.intersects( BBox2i(10,0,5,5), result );
+  ASSERT_EQ( 1u, result.size() );
+  EXPECT_EQ( 1u, result[0] );
+
+  index.intersects( BBox2i(9,5,2,2), result );
+  ASSERT_EQ( 2u, result.size() );
+  EXPECT_EQ( 0u, result[0] );
+  EXPECT_EQ( 1u, result[1] );
+
+  index.intersects( BBox2i(20,0,5,5), result );
+  EXPECT_TRUE( result.empty() );
+}
+
+TEST( BBoxIndex, MatchesBruteForce ) {
+  srand( 42 );
+  static const uint32 counts[] = { 1, 2, 15, 16, 17, 300, 5000 };
+  static const uint32 fanouts[] = { 2, 4, 16 };
+  for( unsigned c=0; c<sizeof(counts)/sizeof(counts[0]); ++c ) {
+    vector<BBox2i> bboxes;
+    for( uint32 i=0; i<counts[c]; ++i )
+      bboxes.push_back( random_bbox( 2000, 200 ) );
+    for( unsigned f=0; f<sizeof(fanouts)/sizeof(fanouts[0]); ++f ) {
+      BBoxIndex index( bboxes, fanouts[f] );
+      ASSERT_EQ( bboxes.size(), index.size() );
+      vector<uint32> result, expected;
+      for( int q=0; q<200; ++q ) {
+        BBox2i query = random_bbox( 2200, 400 ) - Vector2i(100,100);
+        index.intersects( query, result );
+        brute_force( bboxes, query, expected );
+        ASSERT_EQ( expected.size(), result.size() ) << "count " << counts[c] << " fanout " << fanouts[f];
+        for( size_t i=0; i<expected.size(); ++i )
+          EXPECT_EQ( expected[i], result[i] );
+      }
+    }
+  }
+}
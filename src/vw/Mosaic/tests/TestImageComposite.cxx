@@ -7,10 +7,16 @@
 
 #include <gtest/gtest.h>
 #include <vw/Mosaic/ImageComposite.h>
+#include <vw/FileIO/DiskImageView.h>
+#include <test/Helpers.h>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/scoped_ptr.hpp>
 
 using namespace std;
 using namespace vw;
 using namespace vw::mosaic;
+using namespace vw::test;
 
 ImageView<uint32> make(uint32 x) {
   ImageView<uint32> img(8,8);
@@ -39,3 +45,122 @@ TEST(TestImageComposite, Basic) {
       EXPECT_EQ(2, c(col, row)) << "at (" << col << "," << row << ")";
   }
 }
+
+// prepare() writes the masks into the working directory; this removes
+// them before and after a test.
+class UnlinkMasks {
+  int m_count;
+  void unlink() {
+    for (int i = 0; i < m_count; ++i) {
+      std::ostringstream base;
+      base << "mask." << i;
+      boost::filesystem::remove(base.str() + ".png");
+      boost::filesystem::remove(base.str() + ".key");
+    }
+  }
+public:
+  UnlinkMasks(int count) : m_count(count) { unlink(); }
+  ~UnlinkMasks() { unlink(); }
+};
+
+static ImageView<PixelRGBA<float> > make_blend_source(int cols, int rows, int seed) {
+  ImageView<PixelRGBA<float> > img(cols, rows);
+  for (int32 row = 0; row < rows; ++row)
+    for (int32 col = 0; col < cols; ++col)
+      img(col, row) = PixelRGBA<float>( float((col*7 + row*3 + seed*11) % 17) / 17,
+                                        float((col + row*5 + seed) % 13) / 13,
+                                        float(seed) / 3, 1 );
+  return img;
+}
+
+TEST(TestImageComposite, BlendBlocks) {
+  UnlinkMasks masks(3);
+  ImageComposite<PixelRGBA<float> > c;
+  c.set_block_size(16);
+  c.insert(make_blend_source(70, 50, 0), 0, 0);
+  c.insert(make_blend_source(60, 64, 1), 40, 10);
+  c.insert(make_blend_source(64, 40, 2), 20, 45);
+  c.prepare();
+
+  // Blending the whole thing at once sees every source in full, so
+  // the blocks should come out the same as it.
+  ImageView<PixelRGBA<float> > whole = c.generate_patch(BBox2i(0, 0, c.cols(), c.rows()));
+  ImageView<PixelRGBA<float> > blocked = c;
+  ASSERT_EQ(whole.cols(), blocked.cols());
+  ASSERT_EQ(whole.rows(), blocked.rows());
+  for (int32 row = 0; row < c.rows(); ++row)
+    for (int32 col = 0; col < c.cols(); ++col)
+      for (int32 ch = 0; ch < 4; ++ch)
+        ASSERT_NEAR(whole(col, row)[ch], blocked(col, row)[ch], 1e-5) << "at (" << col << "," << row << ")";
+
+  EXPECT_NEAR(whole(77, 30)[0], c(77, 30)[0], 1e-5);
+  EXPECT_NEAR(whole(90, 5)[2], c(90, 5)[2], 1e-5);
+}
+
+TEST(TestImageComposite, BlocksOutliveCopy) {
+  UnlinkMasks masks(2);
+  boost::scoped_ptr<ImageComposite<PixelRGBA<float> > > c(new ImageComposite<PixelRGBA<float> >);
+  c->set_block_size(16);
+  c->insert(make_blend_source(70, 50, 0), 0, 0);
+  c->insert(make_blend_source(60, 64, 1), 40, 10);
+  c->prepare();
+
+  // The copy shares the block cache; its blocks must still blend once
+  // the composite that created the cache is gone.
+  ImageComposite<PixelRGBA<float> > copy = *c;
+  ImageView<PixelRGBA<float> > whole = c->generate_patch(BBox2i(0, 0, c->cols(), c->rows()));
+  c.reset();
+  ImageView<PixelRGBA<float> > blocked = copy;
+  for (int32 row = 0; row < whole.rows(); ++row)
+    for (int32 col = 0; col < whole.cols(); ++col)
+      for (int32 ch = 0; ch < 4; ++ch)
+        ASSERT_NEAR(whole(col, row)[ch], blocked(col, row)[ch], 1e-5) << "at (" << col << "," << row << ")";
+}
+
+static void prepare_from_files(string const& file0, string const& file1, bool reuse,
+                               string const& key = string(), bool named = true) {
+  ImageComposite<PixelRGBA<float> > c;
+  c.set_reuse_masks(reuse);
+  c.set_mask_key(key);
+  c.insert(DiskImageView<PixelRGBA<float> >(file0), 0, 0, named ? file0 : string());
+  c.insert(DiskImageView<PixelRGBA<float> >(file1), 20, 5, named ? file1 : string());
+  c.prepare();
+}
+
+static float blank_and_prepare(string const& file0, string const& file1,
+                               string const& key = string(), bool named = true) {
+  write_image("mask.0.png", ImageView<float>(40, 30));
+  prepare_from_files(file0, file1, true, key, named);
+  ImageView<float> mask;
+  read_image(mask, "mask.0.png");
+  return sum_of_pixel_values(mask);
+}
+
+TEST(TestImageComposite, ReuseMasks) {
+  UnlinkMasks masks(2);
+  UnlinkName file0("ReuseMasks0.tif"), file1("ReuseMasks1.tif");
+  write_image(file0, make_blend_source(40, 30, 0));
+  write_image(file1, make_blend_source(40, 30, 1));
+  prepare_from_files(file0, file1, false, "nodata 0");
+
+  // Blank a mask.  While its sources and the key are unchanged it is
+  // kept...
+  EXPECT_EQ(0, blank_and_prepare(file0, file1, "nodata 0"));
+
+  // ...but not once the caller's key changes,
+  EXPECT_LT(0, blank_and_prepare(file0, file1, "nodata 1"));
+
+  // nor when a source has no file to check,
+  EXPECT_LT(0, blank_and_prepare(file0, file1, "nodata 1", false));
+
+  // nor once a source it overlaps changes.
+  prepare_from_files(file0, file1, false, "nodata 1");
+  EXPECT_EQ(0, blank_and_prepare(file0, file1, "nodata 1"));
+  boost::filesystem::last_write_time(file1, boost::filesystem::last_write_time(file1) + 10);
+  prepare_from_files(file0, file1, true, "nodata 1");
+  ImageView<float> mask;
+  read_image(mask, "mask.0.png");
+  EXPECT_LT(0, sum_of_pixel_values(mask));
+  EXPECT_EQ(0, mask(39, 29));
+  EXPECT_LT(0, mask(0, 0));
+}
@@ -0,0 +1,237 @@
+// __BEGIN_LICENSE__
+// Copyright (C) 2006-2011 United States Government as represented by
+// the Administrator of the National Aeronautics and Space Administration.
+// All Rights Reserved.
+// __END_LICENSE__
+
+
+#include <gtest/gtest.h>
+#include <vw/Mosaic/QuadTreeGenerator.h>
+#include <vw/Image/PixelTypes.h>
+#include <vw/Image/ViewImageResource.h>
+#include <test/Helpers.h>
+
+#include <boost/bind.hpp>
+#include <boost/filesystem/operations.hpp>
+
+#include <fstream>
+#include <set>
+
+using namespace std;
+using namespace vw;
+using namespace vw::mosaic;
+using namespace vw::test;
+
+typedef PixelRGBA<uint8> PixelT;
+
+// Collects tiles in memory, and the order their metadata was made in
+struct TileStore {
+  Mutex mutex;
+  map<string, ImageView<PixelT> > tiles;
+  vector<string> metadata;
+  int writes, fail_after;
+
+  TileStore() : writes(0), fail_after(-1) {}
+
+  class Resource : public DstImageResource {
+    TileStore &m_store;
+    string m_name;
+    ImageFormat m_format;
+  public:
+    Resource( TileStore &store, string const& name, ImageFormat const& format )
+      : m_store(store), m_name(name), m_format(format) {}
+    virtual void write( ImageBuffer const& buf, BBox2i const& bbox ) {
+      ImageView<PixelT> image( bbox.width(), bbox.height() );
+      convert( image.buffer(), buf );
+      Mutex::Lock lock( m_store.mutex );
+      if( m_store.writes == m_store.fail_after ) vw_throw( IOErr() << "Out of disk" );
+      m_store.tiles[m_name] = image;
+      m_store.writes++;
+    }
+    virtual bool has_block_write() const { return false; }
+    virtual bool has_nodata_write() const { return false; }
+    virtual void flush() {}
+  };
+
+  boost::shared_ptr<DstImageResource> resource( QuadTreeGenerator const&, QuadTreeGenerator::TileInfo const& info, ImageFormat const& format ) {
+    return boost::shared_ptr<DstImageResource>( new Resource( *this, info.name, format ) );
+  }
+
+  boost::shared_ptr<SrcImageResource> read( QuadTreeGenerator const&, QuadTreeGenerator::TileInfo const& info ) {
+    Mutex::Lock lock( mutex );
+    EXPECT_TRUE( tiles.count(info.name) ) << info.name;
+    return boost::shared_ptr<SrcImageResource>( new ViewImageResource( tiles[info.name] ) );
+  }
+
+  void record( QuadTreeGenerator const&, QuadTreeGenerator::TileInfo const& info ) {
+    Mutex::Lock lock( mutex );
+    metadata.push_back( info.name );
+  }
+};
+
+// A pattern, with its own pattern in one region to stand for an
+// updated input
+class SlowView : public ImageViewBase<SlowView> {
+  BBox2i m_changed;
+public:
+  SlowView( BBox2i const& changed = BBox2i() ) : m_changed(changed) {}
+  typedef PixelT pixel_type;
+  typedef PixelT result_type;
+  typedef ProceduralPixelAccessor<SlowView> pixel_accessor;
+  int32 cols() const { return 1000; }
+  int32 rows() const { return 700; }
+  int32 planes() const { return 1; }
+  pixel_accessor origin() const { return pixel_accessor(*this); }
+  result_type operator()( int32 i, int32 j, int32 /*p*/=0 ) const {
+    if( m_changed.contains( Vector2i(i,j) ) )
+      return PixelT( uint8(j), uint8(i), uint8(i*j), 255 );
+    return PixelT( uint8(i), uint8(j), uint8(i+j), 255 );
+  }
+  typedef SlowView prerasterize_type;
+  prerasterize_type prerasterize( BBox2i const& ) const { return *this; }
+  template <class DestT> void rasterize( DestT const& dest, BBox2i const& bbox ) const {
+    vw::rasterize( prerasterize(bbox), dest, bbox );
+  }
+};
+
+// Reports the tiles inside the hole as having no data
+struct HoleCheck {
+  BBox2i hole;
+  HoleCheck( BBox2i const& hole ) : hole(hole) {}
+  bool operator()( BBox2i const& bbox ) const { return ! hole.contains( bbox ); }
+};
+
+// Where the manifest thinks the tiles are, for removing stale ones
+static std::string tile_path( QuadTreeGenerator const&, std::string const& name ) {
+  return "qtree_tiles/" + name;
+}
+
+static void generate( TileStore &store, int32 threads, bool crop,
+                      SlowView const& source = SlowView(), std::string const& manifest = "",
+                      BBox2i const& changed = BBox2i(), BBox2i const& hole = BBox2i() ) {
+  QuadTreeGenerator qtree( source, "test" );
+  qtree.set_tile_size( 64 );
+  qtree.set_num_threads( threads );
+  qtree.set_crop_images( crop );
+  qtree.set_crop_bbox( BBox2i(30, 20, 900, 650) );
+  qtree.set_tile_resource_func( boost::bind( &TileStore::resource, &store, _1, _2, _3 ) );
+  qtree.set_metadata_func( boost::bind( &TileStore::record, &store, _1, _2 ) );
+  qtree.set_tile_read_func( boost::bind( &TileStore::read, &store, _1, _2 ) );
+  qtree.set_image_path_func( &tile_path );
+  if( ! hole.empty() ) qtree.set_sparse_image_check( HoleCheck( hole ) );
+  qtree.set_manifest_file( manifest );
+  if( ! changed.empty() ) qtree.add_changed_region( changed );
+  qtree.generate();
+}
+
+static void expect_same_tiles( TileStore &expected, TileStore &actual ) {
+  ASSERT_EQ( expected.tiles.size(), actual.tiles.size() );
+  for ( map<string, ImageView<PixelT> >::iterator it = expected.tiles.begin(); it != expected.tiles.end(); ++it ) {
+    ASSERT_TRUE( actual.tiles.count(it->first) ) << it->first;
+    ImageView<PixelT> const& other = actual.tiles[it->first];
+    ASSERT_EQ( it->second.cols(), other.cols() ) << it->first;
+    ASSERT_EQ( it->second.rows(), other.rows() ) << it->first;
+    for ( int32 j = 0; j < other.rows(); ++j )
+      for ( int32 i = 0; i < other.cols(); ++i )
+        ASSERT_EQ( it->second(i,j), other(i,j) ) << it->first << " at " << i << "," << j;
+  }
+}
+
+TEST(QuadTreeGenerator, Parallel) {
+  for ( int crop = 0; crop < 2; ++crop ) {
+    TileStore serial, parallel;
+    generate( serial, 1, crop );
+    generate( parallel, 4, crop );
+
+    ASSERT_EQ( serial.metadata.size(), parallel.metadata.size() );
+    EXPECT_GT( serial.tiles.size(), 64u );
+    expect_same_tiles( serial, parallel );
+
+    // Every tile's metadata comes after its children's
+    map<string, size_t> position;
+    for ( size_t i = 0; i < parallel.metadata.size(); ++i )
+      position[parallel.metadata[i]] = i;
+    for ( map<string, size_t>::iterator it = position.begin(); it != position.end(); ++it ) {
+      if ( it->first.empty() ) continue;
+      string parent = it->first.substr( 0, it->first.size()-1 );
+      ASSERT_TRUE( position.count(parent) ) << it->first;
+      EXPECT_LT( it->second, position[parent] ) << it->first;
+    }
+  }
+}
+
+TEST(QuadTreeGenerator, Incremental) {
+  BBox2i changed(300, 200, 50, 40);
+  for ( int threads = 1; threads <= 4; threads += 3 ) {
+    UnlinkName manifest("qtree_manifest.txt");
+    TileStore full, store;
+    generate( full, threads, true, SlowView(changed) );
+    generate( store, threads, true, SlowView(), manifest );
+    EXPECT_EQ( full.writes, store.writes );
+
+    // Nothing to do the second time around
+    store.writes = 0;
+    store.metadata.clear();
+    generate( store, threads, true, SlowView(), manifest );
+    EXPECT_EQ( 0, store.writes );
+    EXPECT_TRUE( store.metadata.empty() );
+
+    // Only the tiles over the change, one per level
+    generate( store, threads, true, SlowView(changed), manifest, changed );
+    EXPECT_GT( store.writes, 0 );
+    EXPECT_LT( store.writes, full.writes / 8 );
+    expect_same_tiles( full, store );
+  }
+}
+
+TEST(QuadTreeGenerator, Resume) {
+  for ( int threads = 1; threads <= 4; threads += 3 ) {
+    UnlinkName manifest("qtree_manifest.txt");
+    TileStore full, store;
+    generate( full, threads, false );
+
+    store.fail_after = full.writes / 2;
+    EXPECT_THROW( generate( store, threads, false, SlowView(), manifest ), IOErr );
+    int written = store.writes;
+    EXPECT_GE( written, full.writes / 2 - 2*threads );
+
+    store.fail_after = -1;
+    store.writes = 0;
+    generate( store, threads, false, SlowView(), manifest );
+    EXPECT_LE( store.writes, full.writes - written + 2*threads );
+    expect_same_tiles( full, store );
+  }
+}
+
+static set<string> manifest_lines( std::string const& filename ) {
+  std::ifstream in( filename.c_str() );
+  set<string> lines;
+  string line;
+  while ( getline( in, line ) ) lines.insert( line );
+  return lines;
+}
+
+TEST(QuadTreeGenerator, IncrementalSparse) {
+  // One 128-pixel tile and its four children
+  BBox2i hole(256, 128, 128, 128);
+  for ( int threads = 1; threads <= 4; threads += 3 ) {
+    UnlinkName manifest("qtree_manifest.txt"), full_manifest("qtree_full_manifest.txt");
+    TileStore full, store;
+    generate( full, threads, true, SlowView(), full_manifest, BBox2i(), hole );
+    generate( store, threads, true, SlowView(), manifest );
+
+    // Stand-ins for the tile files the store keeps in memory
+    boost::filesystem::create_directory( "qtree_tiles" );
+    for ( map<string, ImageView<PixelT> >::iterator it = store.tiles.begin(); it != store.tiles.end(); ++it )
+      std::ofstream( ("qtree_tiles/" + it->first + ".png").c_str() );
+
+    // The tiles that are now sparse are removed, as if rebuilt from scratch
+    generate( store, threads, true, SlowView(), manifest, hole, hole );
+    EXPECT_EQ( 5u, store.tiles.size() - full.tiles.size() );
+    for ( map<string, ImageView<PixelT> >::iterator it = store.tiles.begin(); it != store.tiles.end(); ++it )
+      EXPECT_EQ( full.tiles.count( it->first ) != 0, boost::filesystem::exists( "qtree_tiles/" + it->first + ".png" ) ) << it->first;
+    EXPECT_TRUE( manifest_lines( full_manifest ) == manifest_lines( manifest ) );
+
+    boost::filesystem::remove_all( "qtree_tiles" );
+  }
+}
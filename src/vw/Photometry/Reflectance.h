@@ -38,12 +38,11 @@ namespace photometry {
   };
   
   template <class ImageT>
-    UnaryPerPixelView<BinaryPerPixelView<PerPixelIndexView<VectorIndexFunctor>, ImageT, cartography::DemToPointImageFunctor<typename ImageT::pixel_type> >, LLAtoXYZFunctor>
+    UnaryPerPixelView<cartography::DemToPointImageView<ImageT>, LLAtoXYZFunctor>
     dem_to_point_cloud( ImageViewBase<ImageT> const& image,
                         cartography::GeoReference const& georef ) {
-    typedef cartography::DemToPointImageFunctor<typename ImageT::pixel_type> func1_type;
     typedef LLAtoXYZFunctor func2_type;
-    typedef BinaryPerPixelView<PerPixelIndexView<VectorIndexFunctor>, ImageT, func1_type> inner_view;
+    typedef cartography::DemToPointImageView<ImageT> inner_view;
     return UnaryPerPixelView<inner_view,func2_type>(dem_to_point_image( image.impl(), georef ), func2_type(georef.datum()) );
   }
 
@@ -19,6 +19,8 @@
 #include <boost/foreach.hpp>
 #include <boost/regex.hpp>
 #include <boost/lexical_cast.hpp>
+#include <fstream>
+#include <cstdio>
 
 namespace fs = boost::filesystem;
 
@@ -62,9 +64,37 @@ uint64 BlobManager::blob_size(uint32 blob_id) const {
   return i->size;
 }
 
-uint32 BlobManager::request_lock() {
-  WHEREAMI << std::endl;
+uint64 BlobManager::blob_locality(uint32 blob_id) const {
   Mutex::Lock lock(m_mutex);
+  BOOST_FOREACH(const affinity_t::value_type& a, m_affinity)
+    if (a.second == blob_id)
+      return a.first;
+  return NO_LOCALITY;
+}
+
+uint32 BlobManager::request_lock(uint64 locality) {
+  WHEREAMI << "locality " << locality << std::endl;
+  Mutex::Lock lock(m_mutex);
+
+  if (locality != NO_LOCALITY) {
+    blob_by_id_t& ids = m_blobs.get<0>();
+    std::pair<affinity_t::const_iterator, affinity_t::const_iterator> bound = m_affinity.equal_range(locality);
+    for (affinity_t::const_iterator a = bound.first; a != bound.second; ++a) {
+      blob_by_id_t::iterator i = ids.find(a->second);
+      if (i == ids.end() || !i->can_write())
+        continue;
+      ids.modify(i, BlobKey::SetLock(true));
+      return i->id;
+    }
+
+    // Every blob bound to this key is locked or full, so start a new one
+    // rather than mixing this key into a blob that belongs to another.
+    uint32 blob_id = locked_add_blob();
+    m_affinity.insert(std::make_pair(locality, blob_id));
+    save_affinity();
+    return blob_id;
+  }
+
   blob_by_score_t& lookup = m_blobs.get<1>();
 
   blob_by_score_t::iterator i = lookup.begin();
@@ -109,6 +139,42 @@ void BlobManager::release_lock(uint32 blob_id) {
   lookup.modify(i, BlobKey::SetUnlockSize(size));
 }
 
+std::string BlobManager::affinity_filename() const {
+  return m_directory + "/plate_affinity.txt";
+}
+
+// The affinity file is a list of "<blob_id> <locality>" lines
+void BlobManager::load_affinity() {
+  std::ifstream f(affinity_filename().c_str());
+  if (!f.is_open())
+    return;
+
+  uint32 blob_id;
+  uint64 locality;
+  const blob_by_id_t& lookup = m_blobs.get<0>();
+  while (f >> blob_id >> locality) {
+    if (lookup.count(blob_id) == 0) {
+      vw_out(WarningMessage, "platefile.blob") << "Ignoring affinity for missing blob " << blob_id << std::endl;
+      continue;
+    }
+    m_affinity.insert(std::make_pair(locality, blob_id));
+  }
+}
+
+void BlobManager::save_affinity() const {
+  const std::string fn = affinity_filename();
+  const std::string tmp = fn + ".tmp";
+  {
+    std::ofstream f(tmp.c_str(), std::ios::trunc);
+    VW_ASSERT(f.is_open(), IOErr() << "Could not open " << tmp << " for writing");
+    BOOST_FOREACH(const affinity_t::value_type& a, m_affinity)
+      f << a.second << " " << a.first << "\n";
+    VW_ASSERT(!f.fail(), IOErr() << "Could not write " << tmp);
+  }
+  if (std::rename(tmp.c_str(), fn.c_str()) != 0)
+    vw_throw(IOErr() << "Could not replace " << fn);
+}
+
 BlobManager::BlobManager(const std::string& directory)
   : m_directory(directory)
 {
@@ -128,6 +194,8 @@ BlobManager::BlobManager(const std::string& directory)
     std::pair<blob_tracker_t::iterator, bool> ret = m_blobs.insert(BlobKey(fs::file_size(p), blob_id, false));
     VW_ASSERT(ret.second, LogicErr() << "Failed to add blob " << blob_id);
   }
+
+  load_affinity();
 }
 
 }} // namespace vw::platefile
@@ -10,11 +10,13 @@
 
 #include <vw/Core/FundamentalTypes.h>
 #include <vw/Core/Log.h>
+#include <vw/Plate/TileOrder.h>
 
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/ordered_index.hpp>
 #include <boost/multi_index/mem_fun.hpp>
 #include <boost/multi_index/member.hpp>
+#include <map>
 
 namespace vw {
 namespace platefile {
@@ -25,6 +27,12 @@ namespace platefile {
   // locking/unlocking of blobs, and can load balance blobs writes by
   // alternating which blob is offered up for writing data.
   //
+  // Callers may also pass a locality key (see TileOrder.h) when they request
+  // a lock. Blobs become bound to the first key they are handed out for, and
+  // later requests with the same key reuse those blobs, so tiles that are
+  // close together on the plate end up close together on disk. Bindings are
+  // saved next to the blobs, in plate_affinity.txt.
+  //
   // The BlobManager is thread safe.
   class BlobManager {
 
@@ -63,11 +71,18 @@ namespace platefile {
     typedef blob_tracker_t::nth_index<0>::type blob_by_id_t;
     typedef blob_tracker_t::nth_index<1>::type blob_by_score_t;
 
+    // locality key -> blobs bound to that key
+    typedef std::multimap<uint64, uint32> affinity_t;
+
     mutable vw::Mutex m_mutex;
     std::string m_directory;
     blob_tracker_t m_blobs;
+    affinity_t m_affinity;
 
     uint32 locked_add_blob();
+    std::string affinity_filename() const;
+    void load_affinity();
+    void save_affinity() const;
 
   public:
 
@@ -81,8 +96,12 @@ namespace platefile {
     BlobManager(const std::string& directory);
 
     // Request a blob to write to that has sufficient space. Returns the blob
-    // index of a locked blob that you have sole access to write to.
-    uint32 request_lock();
+    // index of a locked blob that you have sole access to write to. If a
+    // locality key is given, prefer (or create) a blob bound to that key.
+    uint32 request_lock(uint64 locality = NO_LOCALITY);
+
+    // Returns the locality key a blob is bound to, or NO_LOCALITY
+    uint64 blob_locality(uint32 blob_id) const;
 
     // Given a blob id, return the filename of the corresponding blob
     std::string name_from_id(uint32 blob_id) const;
@@ -234,7 +234,7 @@ METHOD_IMPL(WriteRequest, IndexWriteRequest, IndexWriteReply) {
   METHOD_BOILERPLATE(read_lock_t);
   IndexServiceRecord rec = find_id_throw(request->platefile_id());
 
-  uint32 blob_id = rec.index->write_request();
+  uint32 blob_id = rec.index->write_request(request->has_locality() ? request->locality() : NO_LOCALITY);
   response->set_blob_id(blob_id);
 }
 
@@ -44,9 +44,18 @@ ReadOnlyPlateFile::ReadOnlyPlateFile(const Url& url, std::string type, std::stri
   vw_out(DebugMessage, "platefile") << "Constructed new platefile: " << url.string() << "\n";
 }
 
+ReadOnlyPlateFile::ReadOnlyPlateFile(const Url& url, const IndexHeader& new_index_info)
+  : m_data(Datastore::open(url, new_index_info))
+{
+  vw_out(DebugMessage, "platefile") << "Constructed new platefile: " << url.string() << "\n";
+}
+
 PlateFile::PlateFile(const Url& url)
   : ReadOnlyPlateFile(url) {}
 
+PlateFile::PlateFile(const Url& url, const IndexHeader& new_index_info)
+  : ReadOnlyPlateFile(url, new_index_info) {}
+
 PlateFile::PlateFile(const Url& url, std::string type, std::string description, uint32 tile_size, std::string tile_filetype,
                      PixelFormatEnum pixel_format, ChannelTypeEnum channel_type)
   : ReadOnlyPlateFile(url, type, description, tile_size, tile_filetype, pixel_format, channel_type) {}
@@ -114,6 +114,7 @@ namespace platefile {
     protected:
       boost::shared_ptr<Datastore> m_data;
       ReadOnlyPlateFile(const Url& url, std::string type, std::string description, uint32 tile_size, std::string tile_filetype, PixelFormatEnum pixel_format, ChannelTypeEnum channel_type);
+      ReadOnlyPlateFile(const Url& url, const IndexHeader& new_index_info);
 
     public:
       ReadOnlyPlateFile(const Url& url);
@@ -187,6 +188,10 @@ namespace platefile {
                 uint32 tile_size, std::string tile_filetype,
                 PixelFormatEnum pixel_format, ChannelTypeEnum channel_type);
 
+      /// Open or create a platefile, using a complete IndexHeader as the
+      /// defaults for a new one (e.g. to pick a blob placement policy).
+      PlateFile(const Url& url, const IndexHeader& new_index_info);
+
       void sync() const;
 
       std::ostream& audit_log();
@@ -14,11 +14,14 @@
 #include <vw/Core/Debugging.h>
 #include <google/protobuf/descriptor.h>
 #include <boost/scoped_ptr.hpp>
+#include <boost/foreach.hpp>
 
 using namespace vw;
 using namespace vw::platefile;
 namespace pb = ::google::protobuf;
 
+const char* const vw::platefile::RPC_BATCH_METHOD = "__batch__";
+
 #define NOIMPL { vw_throw(vw::NoImplErr() << "Not implemented: " << VW_CURRENT_FUNCTION); }
 
 void RpcBase::Reset() NOIMPL
@@ -52,6 +55,8 @@ class RpcServerBase::Task {
   protected:
     // return = false means timeout
     bool handle_one_request();
+    // Run a single call, and fill in the answer (errors included)
+    void dispatch(const RpcWrapper& q_wrap, RpcWrapper& a_wrap, std::string& fatal);
 };
 
 ThreadMap::Locked::Locked(ThreadMap& m)
@@ -185,28 +190,70 @@ bool RpcServerBase::Task::handle_one_request() {
       break;
   }
 
+  // Set if we're in debug mode and a call hit a server error. We still answer
+  // the client before dying.
+  std::string fatal;
+
+  if (q_wrap.method() == RPC_BATCH_METHOD) {
+    RpcBatch q_batch, a_batch;
+    if (!q_batch.ParseFromString(q_wrap.payload())) {
+      // they're not speaking our protocol. just ignore it.
+      m_stats.add("client_error");
+      return false;
+    }
+
+    m_stats.add("batches");
+    a_wrap.set_method(q_wrap.method());
+    a_wrap.set_requestor(q_wrap.requestor());
+    a_wrap.set_seq(q_wrap.seq());
+
+    BOOST_FOREACH(const RpcWrapper& q, q_batch.calls()) {
+      RpcWrapper* a = a_batch.add_calls();
+      dispatch(q, *a, fatal);
+      a->set_checksum(IChannel::checksum(*a));
+    }
+
+    a_wrap.set_payload(a_batch.SerializeAsString());
+    a_wrap.mutable_error()->set_code(RpcErrorMsg::SUCCESS);
+  } else
+    dispatch(q_wrap, a_wrap, fatal);
+
+  m_chan->send_message(a_wrap);
+
+  if (!fatal.empty())
+    vw_throw(RpcErr() << "Server Error (debug mode): " << fatal);
+  return true;
+}
+
+void RpcServerBase::Task::dispatch(const RpcWrapper& q_wrap, RpcWrapper& a_wrap, std::string& fatal) {
+  a_wrap.set_method(q_wrap.method());
+
+  // copy the metadata over
+  a_wrap.set_requestor(q_wrap.requestor());
+  if (q_wrap.seq() != a_wrap.seq())
+    a_wrap.set_seq(q_wrap.seq());
+
   const pb::MethodDescriptor* method = m_rpc->service()->GetDescriptor()->FindMethodByName(q_wrap.method());
-  VW_ASSERT(method, RpcErr() << "Unrecognized RPC method: " << q_wrap.method());
+  if (!method) {
+    a_wrap.mutable_error()->set_code(RpcErrorMsg::UNKNOWN);
+    a_wrap.mutable_error()->set_msg("Unrecognized RPC method: " + q_wrap.method());
+    m_stats.add("client_error");
+    return;
+  }
 
   typedef boost::scoped_ptr<pb::Message> msg_t;
 
   msg_t q(m_rpc->service()->GetRequestPrototype(method).New());
   msg_t a(m_rpc->service()->GetResponsePrototype(method).New());
 
-  a_wrap.set_method(q_wrap.method());
-
   // Attempt to parse the actual request message from the request_wrapper.
   if (!q->ParseFromString(q_wrap.payload())) {
-    // they're not speaking our protocol. just ignore it.
+    a_wrap.mutable_error()->set_code(RpcErrorMsg::UNKNOWN);
+    a_wrap.mutable_error()->set_msg("Could not parse request for " + q_wrap.method());
     m_stats.add("client_error");
-    return false;
+    return;
   }
 
-  // copy the metadata over
-  a_wrap.set_requestor(q_wrap.requestor());
-  if (q_wrap.seq() != a_wrap.seq())
-    a_wrap.set_seq(q_wrap.seq());
-
   try {
     m_rpc->service()->CallMethod(method, m_rpc, q.get(), a.get(), null_callback());
     a_wrap.set_payload(a->SerializeAsString());
@@ -224,19 +271,15 @@ bool RpcServerBase::Task::handle_one_request() {
     m_stats.add("client_error");
   } catch (const std::exception &e) {
     // These exceptions should be reported back to the far side as a general
-    // server error- unless we're in debug mode, in which case... rethrow!
+    // server error- unless we're in debug mode, in which case... die (after
+    // answering).
     a_wrap.mutable_error()->set_code(RpcErrorMsg::REMOTE_ERROR);
     a_wrap.mutable_error()->set_msg(e.what());
     m_stats.add("server_error");
     vw_out(WarningMessage) << "Server Error: " << e.what() << std::endl;
-    if (m_rpc->debug()) {
-      m_chan->send_message(a_wrap);
-      throw;
-    }
+    if (m_rpc->debug() && fatal.empty())
+      fatal = e.what();
   }
-
-  m_chan->send_message(a_wrap);
-  return true;
 }
 
 // TODO: Make the clientname settable here.
@@ -23,6 +23,9 @@ namespace platefile {
     return google::protobuf::NewCallback(&google::protobuf::DoNothing);
   }
 
+  // The method name of an RpcWrapper whose payload is an RpcBatch
+  extern const char* const RPC_BATCH_METHOD;
+
   class ThreadMap : private boost::noncopyable {
     private:
       typedef std::map<std::string, int64> map_t;
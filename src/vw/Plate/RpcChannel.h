@@ -58,6 +58,11 @@ class IChannel : public ::google::protobuf::RpcChannel {
     //virtual uint64 queue_depth() const = 0;
     virtual std::string name() const = 0;
 
+    // True if a client may send several requests before reading the replies
+    // (they come back tagged with the request's seq). Otherwise, every send
+    // must be followed by its recv.
+    virtual bool pipelined() const { return false; }
+
     IChannel() {}
     virtual ~IChannel() {}
 
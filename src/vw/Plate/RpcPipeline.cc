@@ -0,0 +1,233 @@
+// __BEGIN_LICENSE__
+// Copyright (C) 2006-2011 United States Government as represented by
+// the Administrator of the National Aeronautics and Space Administration.
+// All Rights Reserved.
+// __END_LICENSE__
+
+
+#include <vw/Plate/RpcPipeline.h>
+#include <vw/Plate/RpcChannel.h>
+#include <vw/Plate/Rpc.h>
+#include <vw/Plate/Rpc.pb.h>
+#include <vw/Plate/FundamentalTypes.h>
+#include <vw/Plate/HTTPUtils.h>
+#include <vw/Plate/Exception.h>
+#include <vw/Core/Log.h>
+
+#include <google/protobuf/descriptor.h>
+#include <boost/foreach.hpp>
+
+namespace pb = ::google::protobuf;
+
+namespace vw {
+namespace platefile {
+
+RpcPipeline::RpcPipeline(const Url& url, uint32 max_in_flight, uint32 batch_size, const std::string& clientname)
+  : m_chan(IChannel::make_conn(url, clientname.empty() ? url.string() : clientname)), m_batch(new RpcBatch()),
+    m_seq(0), m_max_in_flight(max_in_flight), m_batch_size(batch_size)
+{
+  VW_ASSERT(m_max_in_flight > 0, ArgumentErr() << "RpcPipeline needs at least one frame in flight");
+  VW_ASSERT(m_batch_size > 0,    ArgumentErr() << "RpcPipeline batch size must be at least 1");
+}
+
+RpcPipeline::~RpcPipeline() {
+  if (!m_calls.empty())
+    vw_out(WarningMessage) << "RpcPipeline destroyed with " << m_calls.size() << " calls outstanding" << std::endl;
+}
+
+void RpcPipeline::CallMethod(const pb::MethodDescriptor* method,
+                             pb::RpcController* /*controller*/,
+                             const pb::Message* request,
+                             pb::Message* response,
+                             pb::Closure* done)
+{
+  RpcWrapper q_wrap;
+  q_wrap.set_method(method->name());
+  q_wrap.set_payload(request->SerializeAsString());
+  q_wrap.set_requestor(m_chan->name());
+  q_wrap.set_seq(++m_seq);
+
+  Call& call = m_calls[q_wrap.seq()];
+  call.method   = method;
+  call.response = response;
+  call.done     = done;
+
+  if (m_batch_size > 1 && q_wrap.payload().size() <= MAX_BATCHED_CALL) {
+    q_wrap.set_checksum(IChannel::checksum(q_wrap));
+    *m_batch->add_calls() = q_wrap;
+    if (uint32(m_batch->calls_size()) >= m_batch_size)
+      flush();
+  } else {
+    // Don't let a big call overtake the small ones queued before it
+    flush();
+    send_frame(q_wrap);
+  }
+}
+
+void RpcPipeline::flush() {
+  if (m_batch->calls_size() == 0)
+    return;
+
+  RpcWrapper frame;
+  frame.set_method(RPC_BATCH_METHOD);
+  frame.set_payload(m_batch->SerializeAsString());
+  frame.set_requestor(m_chan->name());
+  frame.set_seq(++m_seq);
+  m_batch->Clear();
+
+  send_frame(frame);
+}
+
+void RpcPipeline::send_frame(RpcWrapper& frame) {
+  const uint32 window = m_chan->pipelined() ? m_max_in_flight : 1;
+  while (m_frames.size() >= window)
+    wait_for_reply();
+
+  m_chan->send_message(frame);
+  m_frames[frame.seq()].reset(new RpcWrapper(frame));
+}
+
+size_t RpcPipeline::poll() {
+  while (!m_frames.empty() && receive(0)) {}
+  throw_pending_error();
+  return m_calls.size();
+}
+
+void RpcPipeline::wait() {
+  flush();
+  while (!m_frames.empty())
+    wait_for_reply();
+  throw_pending_error();
+}
+
+size_t RpcPipeline::outstanding() const {
+  return m_calls.size();
+}
+
+void RpcPipeline::wait_for_reply() {
+  for (uint32 trial = 0; trial <= m_chan->retries(); ++trial) {
+    if (trial > 0) {
+      // The server may answer a resent frame twice; receive() drops the
+      // duplicate.
+      vw_out(WarningMessage) << "RpcPipeline timeout: resending " << m_frames.size()
+                             << " frames (" << trial << "/" << m_chan->retries() << ")" << std::endl;
+      BOOST_FOREACH(FrameMap::value_type& f, m_frames)
+        m_chan->send_message(*f.second);
+    }
+    if (receive(m_chan->timeout())) {
+      throw_pending_error();
+      return;
+    }
+  }
+  vw_throw(RpcErr() << "RpcPipeline timed out completely with " << m_calls.size() << " calls outstanding");
+}
+
+bool RpcPipeline::receive(int32 timeout) {
+  RpcWrapper a_wrap;
+
+  const int32 old_timeout = m_chan->timeout();
+  m_chan->set_timeout(timeout);
+  int32 ret = m_chan->recv_message(a_wrap);
+  m_chan->set_timeout(old_timeout);
+
+  switch (ret) {
+    case 0:
+      return false;
+    case -1:
+      // The frame it belonged to will be resent if we time out waiting
+      vw_out(WarningMessage) << "RpcPipeline: corrupted message." << std::endl;
+      return true;
+    default:
+      break;
+  }
+
+  FrameMap::iterator f = m_frames.find(a_wrap.seq());
+  if (f == m_frames.end()) {
+    // Answer to a frame we resent (and already got an answer for)
+    vw_out(DebugMessage) << "RpcPipeline: dropping duplicate reply " << a_wrap.seq() << std::endl;
+    return true;
+  }
+  boost::shared_ptr<RpcWrapper> q_wrap = f->second;
+  m_frames.erase(f);
+
+  if (q_wrap->method() != RPC_BATCH_METHOD) {
+    complete(a_wrap);
+    return true;
+  }
+
+  RpcBatch q_batch, a_batch;
+  q_batch.ParseFromString(q_wrap->payload());
+
+  bool parsed = a_wrap.error().code() == RpcErrorMsg::SUCCESS && a_batch.ParseFromString(a_wrap.payload());
+  if (parsed) {
+    BOOST_FOREACH(const RpcWrapper& a, a_batch.calls())
+      complete(a);
+  }
+
+  // Anything the server didn't answer individually failed with the frame
+  BOOST_FOREACH(const RpcWrapper& q, q_batch.calls()) {
+    if (m_calls.count(q.seq()) == 0)
+      continue;
+    RpcWrapper a(q);
+    a.clear_payload();
+    if (parsed) {
+      a.mutable_error()->set_code(RpcErrorMsg::REMOTE_ERROR);
+      a.mutable_error()->set_msg("Server did not answer batched call " + q.method());
+    } else if (a_wrap.has_error() && a_wrap.error().code() != RpcErrorMsg::SUCCESS)
+      *a.mutable_error() = a_wrap.error();
+    else {
+      a.mutable_error()->set_code(RpcErrorMsg::UNKNOWN);
+      a.mutable_error()->set_msg("Could not parse batch reply");
+    }
+    complete(a);
+  }
+  return true;
+}
+
+void RpcPipeline::complete(const RpcWrapper& a_wrap) {
+  CallMap::iterator i = m_calls.find(a_wrap.seq());
+  if (i == m_calls.end())
+    return;
+
+  Call call = i->second;
+  m_calls.erase(i);
+
+  // Like a synchronous call, the closure runs even if the call failed. Only
+  // the first error is kept; it's thrown once the whole frame is handled.
+  detail::RequireCall run(call.done);
+  if (a_wrap.error().code() != RpcErrorMsg::SUCCESS) {
+    if (!m_error)
+      m_error.reset(new RpcErrorMsg(a_wrap.error()));
+    return;
+  }
+  call.response->ParseFromString(a_wrap.payload());
+}
+
+void RpcPipeline::throw_pending_error() {
+  if (!m_error)
+    return;
+  RpcErrorMsg e(*m_error);
+  m_error.reset();
+  throw_rpc_error(e);
+}
+
+void RpcPipeline::set_timeout(int32 t) {
+  m_chan->set_timeout(t);
+}
+
+void RpcPipeline::set_retries(uint32 r) {
+  m_chan->set_retries(r);
+}
+
+void RpcPipeline::set_max_in_flight(uint32 n) {
+  VW_ASSERT(n > 0, ArgumentErr() << "RpcPipeline needs at least one frame in flight");
+  m_max_in_flight = n;
+}
+
+void RpcPipeline::set_batch_size(uint32 n) {
+  VW_ASSERT(n > 0, ArgumentErr() << "RpcPipeline batch size must be at least 1");
+  flush();
+  m_batch_size = n;
+}
+
+}} // namespace vw::platefile
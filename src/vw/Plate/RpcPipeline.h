@@ -0,0 +1,117 @@
+// __BEGIN_LICENSE__
+// Copyright (C) 2006-2011 United States Government as represented by
+// the Administrator of the National Aeronautics and Space Administration.
+// All Rights Reserved.
+// __END_LICENSE__
+
+
+/// \file RpcPipeline.h
+///
+/// An asynchronous RPC channel. CallMethod() sends the request (or queues it
+/// into a batch) and returns right away; replies are matched back to their
+/// calls by seq, and each call's closure is run from inside poll() or wait().
+/// Many requests can be in flight at once, and small requests can be packed
+/// several to a frame.
+///
+/// The request and response messages handed to CallMethod() must stay alive
+/// until the call's closure runs. Errors are thrown from poll()/wait() (after
+/// the failed call's closure has run), just like a synchronous call would.
+///
+/// Like IChannel, an RpcPipeline has thread affinity.
+///
+
+#ifndef __VW_PLATE_RPCPIPELINE_H__
+#define __VW_PLATE_RPCPIPELINE_H__
+
+#include <vw/Core/FundamentalTypes.h>
+#include <google/protobuf/service.h>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <map>
+#include <string>
+
+namespace vw {
+namespace platefile {
+
+  class IChannel;
+  class Url;
+  class RpcWrapper;
+  class RpcBatch;
+  class RpcErrorMsg;
+
+  class RpcPipeline : public ::google::protobuf::RpcChannel, private boost::noncopyable {
+    public:
+      static const uint32 DEFAULT_IN_FLIGHT = 32;
+      // Requests bigger than this are never batched
+      static const size_t MAX_BATCHED_CALL = 1024;
+
+      // max_in_flight: number of frames sent but not yet answered. Channels
+      //                that aren't pipelined() always use 1.
+      // batch_size:    number of small calls to pack into a frame (1 disables
+      //                batching)
+      // clientname:    name the requests are sent under (empty uses the url)
+      RpcPipeline(const Url& url, uint32 max_in_flight = DEFAULT_IN_FLIGHT, uint32 batch_size = 1,
+                  const std::string& clientname = std::string());
+      // Calls still outstanding are dropped. Call wait() first.
+      virtual ~RpcPipeline();
+
+      virtual void CallMethod(const google::protobuf::MethodDescriptor*,
+                              google::protobuf::RpcController*,
+                              const google::protobuf::Message*,
+                              google::protobuf::Message*,
+                              google::protobuf::Closure*);
+
+      // Send any partial batch now
+      void flush();
+      // Handle whatever replies have already arrived without blocking.
+      // Returns the number of calls still outstanding.
+      size_t poll();
+      // Flush, then block until every call has been answered
+      void wait();
+
+      size_t outstanding() const;
+
+      // -1 means "never", other values in ms
+      void set_timeout(int32 t);
+      void set_retries(uint32 r);
+      void set_max_in_flight(uint32 n);
+      void set_batch_size(uint32 n);
+
+    private:
+      struct Call {
+        const google::protobuf::MethodDescriptor* method;
+        google::protobuf::Message* response;
+        google::protobuf::Closure* done;
+      };
+      typedef std::map<int32, Call> CallMap;
+      typedef std::map<int32, boost::shared_ptr<RpcWrapper> > FrameMap;
+
+      boost::shared_ptr<IChannel> m_chan;
+      CallMap  m_calls;   // by call seq
+      FrameMap m_frames;  // sent but unanswered frames, by frame seq
+      boost::scoped_ptr<RpcBatch> m_batch;
+      boost::scoped_ptr<RpcErrorMsg> m_error;
+      int32 m_seq;
+      uint32 m_max_in_flight, m_batch_size;
+
+      void send_frame(RpcWrapper& frame);
+      // Wait for one reply, resending everything in flight on timeout.
+      void wait_for_reply();
+      // Returns false if nothing arrived in time
+      bool receive(int32 timeout);
+      void complete(const RpcWrapper& answer);
+      void throw_pending_error();
+  };
+
+  template <typename ServiceT>
+  class RpcPipelineClient : public RpcPipeline, public ServiceT::Stub {
+    public:
+      RpcPipelineClient(const Url& url, uint32 max_in_flight = DEFAULT_IN_FLIGHT, uint32 batch_size = 1,
+                        const std::string& clientname = std::string())
+        : RpcPipeline(url, max_in_flight, batch_size, clientname), ServiceT::Stub(this) {}
+  };
+
+}} // namespace vw::platefile
+
+#endif
@@ -0,0 +1,108 @@
+// __BEGIN_LICENSE__
+// Copyright (C) 2006-2011 United States Government as represented by
+// the Administrator of the National Aeronautics and Space Administration.
+// All Rights Reserved.
+// __END_LICENSE__
+
+
+#include <vw/Plate/TileOrder.h>
+#include <vw/Plate/IndexData.pb.h>
+#include <vw/Core/Exception.h>
+#include <boost/algorithm/string/case_conv.hpp>
+#include <algorithm>
+
+namespace {
+  // Spread the low 32 bits of x out into the even bits of the result
+  vw::uint64 spread_bits(vw::uint64 x) {
+    x &= 0xffffffffULL;
+    x = (x | (x << 16)) & 0x0000ffff0000ffffULL;
+    x = (x | (x <<  8)) & 0x00ff00ff00ff00ffULL;
+    x = (x | (x <<  4)) & 0x0f0f0f0f0f0f0f0fULL;
+    x = (x | (x <<  2)) & 0x3333333333333333ULL;
+    x = (x | (x <<  1)) & 0x5555555555555555ULL;
+    return x;
+  }
+}
+
+namespace vw {
+namespace platefile {
+
+BlobPlacement blob_placement_from_string(const std::string& name_) {
+  std::string name = boost::to_lower_copy(name_);
+  if (name.empty() || name == "size")
+    return PLACE_BY_SIZE;
+  if (name == "morton")
+    return PLACE_BY_MORTON;
+  if (name == "hilbert")
+    return PLACE_BY_HILBERT;
+  vw_throw(ArgumentErr() << "Unknown blob placement \"" << name_ << "\" [expected size, morton, or hilbert]");
+}
+
+std::string blob_placement_name(BlobPlacement placement) {
+  switch (placement) {
+    case PLACE_BY_SIZE:    return "size";
+    case PLACE_BY_MORTON:  return "morton";
+    case PLACE_BY_HILBERT: return "hilbert";
+  }
+  vw_throw(ArgumentErr() << "Unknown blob placement " << int(placement));
+}
+
+uint64 morton_index(uint32 col, uint32 row) {
+  return spread_bits(col) | (spread_bits(row) << 1);
+}
+
+uint64 hilbert_index(uint32 order, uint32 col, uint32 row) {
+  VW_ASSERT(order <= 32, ArgumentErr() << "Hilbert order must be <= 32");
+  if (order == 0)
+    return 0;
+
+  uint64 x = col, y = row, d = 0;
+  for (uint64 s = uint64(1) << (order-1); s > 0; s >>= 1) {
+    uint64 rx = (x & s) ? 1 : 0;
+    uint64 ry = (y & s) ? 1 : 0;
+    d += s * s * ((3 * rx) ^ ry);
+
+    // Rotate the quadrant so the sub-curve is in standard orientation.
+    if (ry == 0) {
+      if (rx == 1) {
+        x = s - 1 - (x & (s-1));
+        y = s - 1 - (y & (s-1));
+      }
+      std::swap(x, y);
+    }
+  }
+  return d;
+}
+
+uint64 tile_curve_index(BlobPlacement placement, uint32 col, uint32 row, uint32 level) {
+  switch (placement) {
+    case PLACE_BY_MORTON:  return morton_index(col, row);
+    case PLACE_BY_HILBERT: return hilbert_index(level, col, row);
+    case PLACE_BY_SIZE:    break;
+  }
+  return (uint64(row) << 32) | col;
+}
+
+uint64 tile_locality(BlobPlacement placement, uint32 col, uint32 row, uint32 level, uint32 bucket_level) {
+  if (placement == PLACE_BY_SIZE)
+    return NO_LOCALITY;
+
+  // The top of the pyramid is tiny; keep it all together.
+  if (level < bucket_level)
+    return 0;
+
+  uint32 shift = level - bucket_level;
+  return 1 + tile_curve_index(placement, col >> shift, row >> shift, bucket_level);
+}
+
+bool OrderHeaderByCurve::operator()(const TileHeader& a, const TileHeader& b) const {
+  if (a.level() != b.level())
+    return a.level() < b.level();
+  uint64 ka = tile_curve_index(placement, a.col(), a.row(), a.level()),
+         kb = tile_curve_index(placement, b.col(), b.row(), b.level());
+  if (ka != kb)
+    return ka < kb;
+  return a.transaction_id() < b.transaction_id();
+}
+
+}} // namespace vw::platefile
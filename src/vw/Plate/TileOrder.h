@@ -0,0 +1,69 @@
+// __BEGIN_LICENSE__
+// Copyright (C) 2006-2011 United States Government as represented by
+// the Administrator of the National Aeronautics and Space Administration.
+// All Rights Reserved.
+// __END_LICENSE__
+
+
+/// \file TileOrder.h
+///
+/// Space-filling curve orderings for the tiles in a platefile.  Tiles that
+/// are close together on the curve are close together on the plate, so
+/// routing tiles to blobs (and ordering them within a blob) by their curve
+/// position keeps region reads down to a few contiguous byte ranges.
+///
+
+#ifndef __VW_PLATE_TILEORDER_H__
+#define __VW_PLATE_TILEORDER_H__
+
+#include <vw/Core/FundamentalTypes.h>
+#include <string>
+
+namespace vw {
+namespace platefile {
+
+  class TileHeader;
+
+  // How new tiles are assigned to blobs.
+  //   PLACE_BY_SIZE:    fill the largest unlocked blob (tiles land in arrival order)
+  //   PLACE_BY_MORTON:  route by the Z-order position of the tile's ancestor
+  //   PLACE_BY_HILBERT: route by the Hilbert position of the tile's ancestor
+  enum BlobPlacement {
+    PLACE_BY_SIZE = 0,
+    PLACE_BY_MORTON,
+    PLACE_BY_HILBERT
+  };
+
+  // Locality key meaning "no preference". Blobs are handed out by size.
+  static const uint64 NO_LOCALITY = static_cast<uint64>(-1);
+
+  // Parse/print the names used in IndexHeader::blob_placement ("size",
+  // "morton", "hilbert"). Throws ArgumentErr on an unknown name.
+  BlobPlacement blob_placement_from_string(const std::string& name);
+  std::string blob_placement_name(BlobPlacement placement);
+
+  // Interleave the bits of col and row (col in the even bits).
+  uint64 morton_index(uint32 col, uint32 row);
+
+  // Distance along the Hilbert curve that fills a 2^order x 2^order grid.
+  uint64 hilbert_index(uint32 order, uint32 col, uint32 row);
+
+  // Position of a tile along the curve that fills its own level.
+  // PLACE_BY_SIZE has no curve, and falls back to row-major order.
+  uint64 tile_curve_index(BlobPlacement placement, uint32 col, uint32 row, uint32 level);
+
+  // The locality key for a tile: the curve position of its ancestor at
+  // bucket_level. All tiles above bucket_level share a single key. Returns
+  // NO_LOCALITY for PLACE_BY_SIZE.
+  uint64 tile_locality(BlobPlacement placement, uint32 col, uint32 row, uint32 level, uint32 bucket_level);
+
+  // Orders tiles by level, then by curve position within the level.
+  struct OrderHeaderByCurve {
+    BlobPlacement placement;
+    OrderHeaderByCurve(BlobPlacement placement) : placement(placement) {}
+    bool operator()(const TileHeader& a, const TileHeader& b) const;
+  };
+
+}} // namespace vw::platefile
+
+#endif // __VW_PLATE_TILEORDER_H__
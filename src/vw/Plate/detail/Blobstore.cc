@@ -7,25 +7,48 @@
 #include <boost/format.hpp>
 #include <boost/iostreams/tee.hpp>
 #include <boost/iostreams/stream.hpp>
+#include <algorithm>
+#include <sstream>
 
 namespace fs = boost::filesystem;
 namespace io = boost::iostreams;
 
 namespace {
   static const size_t DEFAULT_BLOB_CACHE_SIZE = 8;
+  // With a curve placement, a single writer can hold one blob per locality
+  // key it touches. This bounds how many it keeps locked at once.
+  static const size_t MAX_OPEN_WRITE_BLOBS = 16;
   static const boost::format blob_tmpl("%s/plate_%u.blob");
 
   class BlobWriteState : public vw::platefile::WriteState {
     public:
-      BlobWriteState(const vw::platefile::Transaction& id) : transaction(id) {}
+      struct OpenBlob {
+        vw::uint32 blob_id;
+        boost::shared_ptr<vw::platefile::Blob> blob;
+        vw::uint64 last_use;
+        OpenBlob() : blob_id(0), last_use(0) {}
+      };
+      // locality key -> blob currently locked for that key
+      typedef std::map<vw::uint64, OpenBlob> blob_map_t;
+
+      BlobWriteState(const vw::platefile::Transaction& id) : transaction(id), clock(0) {}
       virtual std::string what() const {
-        return std::string("BlobWriteState[id = " + vw::stringify(blob_id) + "]");
+        std::ostringstream ostr;
+        ostr << "BlobWriteState[ids =";
+        BOOST_FOREACH(const blob_map_t::value_type& b, blobs)
+          ostr << " " << b.second.blob_id;
+        ostr << "]";
+        return ostr.str();
       }
       vw::platefile::Transaction transaction;
-      boost::shared_ptr<vw::platefile::Blob> blob;
-      vw::uint32 blob_id;
+      blob_map_t blobs;
+      vw::uint64 clock;
   };
 
+  bool OlderUse(const BlobWriteState::blob_map_t::value_type& a, const BlobWriteState::blob_map_t::value_type& b) {
+    return a.second.last_use < b.second.last_use;
+  }
+
 }
 
 namespace vw { namespace platefile { namespace detail {
@@ -49,6 +72,10 @@ void Blobstore::init() {
 
   VW_ASSERT(fs::exists(name),       ArgumentErr() << "Plate directory " << name << " must exist. (This datastore does not support remote data)");
   VW_ASSERT(fs::is_directory(name), LogicErr() << "Plate " << name << " is not a directory.");
+
+  const IndexHeader hdr = m_index->index_header();
+  m_placement       = blob_placement_from_string(hdr.blob_placement());
+  m_placement_level = hdr.blob_placement_level();
 }
 
 Blobstore::Blobstore(const Url& u)
@@ -240,13 +267,46 @@ Datastore::TileSearch& Blobstore::populate(TileSearch& hdrs) {
   return hdrs;
 }
 
+uint32 Blobstore::lock_write_blob(uint64 locality, boost::shared_ptr<Blob>& blob) {
+  uint32 blob_id = m_index->write_request(locality);
+  blob = open_write_blob(blob_id);
+
+  vw_out(DebugMessage, "blob") << "Opened blob " << blob_id << " ( size = " << blob->size() << " )\n";
+  return blob_id;
+}
+
+void Blobstore::unlock_write_blob(uint32 blob_id, boost::shared_ptr<Blob>& blob) {
+  // Fetch the size from the blob.
+  uint64 new_blob_size = blob->size();
+
+  {
+    Mutex::Lock lock(m_mutex);
+
+    // The blob might still technically be open for writing (in the read
+    // cache), so flush it and drop our reference to it. Once the lock is
+    // released, another writer may open it again.
+    blob->flush();
+    blob.reset();
+    m_write_cache.erase(blob_id);
+  }
+
+  // For debugging:
+  vw_out(DebugMessage, "blob") << "Closed blob " << blob_id << " ( size = " << new_blob_size << " )\n";
+
+  // Release the blob lock.
+  m_index->write_complete(blob_id);
+}
+
 WriteState* Blobstore::write_request(const Transaction& id) {
   std::auto_ptr<BlobWriteState> state(new BlobWriteState(id));
 
-  state->blob_id = m_index->write_request();
-  state->blob = open_write_blob(state->blob_id);
+  // With a curve placement, the blob depends on the tile, so blobs are
+  // locked as write_update() needs them.
+  if (m_placement == PLACE_BY_SIZE) {
+    BlobWriteState::OpenBlob& b = state->blobs[NO_LOCALITY];
+    b.blob_id = lock_write_blob(NO_LOCALITY, b.blob);
+  }
 
-  vw_out(DebugMessage, "blob") << "Opened blob " << state->blob_id << " ( size = " << state->blob->size() << " )\n";
   return state.release();
 }
 
@@ -264,12 +324,27 @@ void Blobstore::write_update(WriteState& state_, uint32 level, uint32 row, uint3
   header.set_transaction_id(state->transaction);
   header.set_filetype(filetype);
 
+  // 0. Find the blob this tile belongs in, locking a new one if needed
+  typedef BlobWriteState::blob_map_t::iterator iter_t;
+  const uint64 locality = tile_locality(m_placement, col, row, level, m_placement_level);
+  iter_t b = state->blobs.find(locality);
+  if (b == state->blobs.end()) {
+    if (state->blobs.size() >= MAX_OPEN_WRITE_BLOBS) {
+      iter_t lru = std::min_element(state->blobs.begin(), state->blobs.end(), OlderUse);
+      unlock_write_blob(lru->second.blob_id, lru->second.blob);
+      state->blobs.erase(lru);
+    }
+    b = state->blobs.insert(std::make_pair(locality, BlobWriteState::OpenBlob())).first;
+    b->second.blob_id = lock_write_blob(locality, b->second.blob);
+  }
+  b->second.last_use = ++state->clock;
+
   // 1. Write the data into the blob
-  uint64 blob_offset = state->blob->write(header, data, size);
+  uint64 blob_offset = b->second.blob->write(header, data, size);
 
   // 2. Update the index
   IndexRecord write_record;
-  write_record.set_blob_id(state->blob_id);
+  write_record.set_blob_id(b->second.blob_id);
   write_record.set_blob_offset(blob_offset);
   write_record.set_filetype(header.filetype());
 
@@ -280,25 +355,9 @@ void Blobstore::write_complete(WriteState& state_) {
   BlobWriteState* state = dynamic_cast<BlobWriteState*>(&state_);
   VW_ASSERT(state, LogicErr() << "Cannot pass write states between different implementations!");
 
-  // Fetch the size from the blob.
-  uint64 new_blob_size = state->blob->size();
-
-  {
-    Mutex::Lock lock(m_mutex);
-
-    // The blob might still technically be open for writing (in the read
-    // cache), so flush it and drop our reference to it.
-    state->blob->flush();
-    state->blob.reset();
-  }
-
-  // For debugging:
-  vw_out(DebugMessage, "blob") << "Closed blob " << state->blob_id << " ( size = " << new_blob_size << " )\n";
-
-  // Release the blob lock.
-  m_index->write_complete(state->blob_id);
-
-  state->blob_id = 0;
+  BOOST_FOREACH(BlobWriteState::blob_map_t::value_type& b, state->blobs)
+    unlock_write_blob(b.second.blob_id, b.second.blob);
+  state->blobs.clear();
 }
 
 void Blobstore::flush() {
@@ -10,6 +10,7 @@
 
 #include <vw/Plate/Blob.h>
 #include <vw/Plate/Datastore.h>
+#include <vw/Plate/TileOrder.h>
 #include <vw/Core/Log.h>
 #include <vw/Core/Cache.h>
 #include <boost/multi_index_container.hpp>
@@ -43,9 +44,17 @@ class Blobstore : public Datastore {
     write_cache_t m_write_cache;
     vw::Mutex m_mutex;
 
+    BlobPlacement m_placement;
+    uint32 m_placement_level;
+
     boost::shared_ptr<ReadBlob>  open_read_blob(uint32 blob_id);
     boost::shared_ptr<Blob>     open_write_blob(uint32 blob_id);
 
+    // Lock a blob (near the given locality) and open it for writing
+    uint32 lock_write_blob(uint64 locality, boost::shared_ptr<Blob>& blob);
+    // Flush and close a blob opened by lock_write_blob, and release the lock
+    void unlock_write_blob(uint32 blob_id, boost::shared_ptr<Blob>& blob);
+
     void init();
   public:
     Blobstore(const Url& u);
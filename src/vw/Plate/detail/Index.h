@@ -9,6 +9,7 @@
 #define __VW_PLATEFILE_INDEX_H__
 
 #include <vw/Plate/FundamentalTypes.h>
+#include <vw/Plate/TileOrder.h>
 #include <vw/Plate/IndexData.pb.h>
 #include <vw/Plate/IndexDataPrivate.pb.h>
 #include <vw/Image/PixelTypeInfo.h>
@@ -79,8 +80,9 @@ namespace detail {
     virtual IndexRecord read_request(uint32 col, uint32 row, uint32 depth, TransactionOrNeg transaction_id, bool exact_transaction_match = false) = 0;
 
     /// Writing, pt. 1: Locks a blob and returns the blob id that can
-    /// be used to write a tile.
-    virtual uint32 write_request() = 0;
+    /// be used to write a tile. The locality key (see TileOrder.h) asks
+    /// for a blob that already holds nearby tiles.
+    virtual uint32 write_request(uint64 locality = NO_LOCALITY) = 0;
 
     /// Writing, pt. 2: Supply information to update the index and
     /// unlock the blob id.
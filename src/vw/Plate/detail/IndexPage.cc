@@ -13,6 +13,7 @@
 
 #include <boost/shared_array.hpp>
 #include <boost/foreach.hpp>
+#include <algorithm>
 
 #define WHEREAMI (vw::vw_out(VerboseDebugMessage, "platefile.index") << VW_CURRENT_FUNCTION << ": ")
 using namespace vw;
@@ -181,6 +182,56 @@ void IndexPage::set(TileHeader const& header, IndexRecord const& record) {
   }
 }
 
+namespace {
+  // By location, then by decreasing transaction id (the order the lists are
+  // kept in). Used with stable_sort, so duplicates keep their order.
+  struct BulkOrder {
+    bool operator()(const IndexPage::bulk_value_type& a, const IndexPage::bulk_value_type& b) const {
+      if (a.first != b.first)
+        return a.first < b.first;
+      return a.second.first > b.second.first;
+    }
+  };
+}
+
+void IndexPage::bulk_set(std::vector<bulk_value_type>& entries) {
+  std::stable_sort(entries.begin(), entries.end(), BulkOrder());
+
+  typedef std::vector<bulk_value_type>::const_iterator iter_t;
+  for (iter_t i = entries.begin(), end = entries.end(); i != end; ) {
+    const uint32 elmnt = i->first;
+    VW_ASSERT(elmnt < m_sparse_table.size(),
+              ArgumentErr() << "IndexPage::bulk_set(): entry " << elmnt << " is outside the page");
+
+    multi_value_type l;
+    for (; i != end && i->first == elmnt; ++i) {
+      // Duplicates are adjacent; the later one replaces the earlier.
+      if (!l.empty() && l.back().first == i->second.first)
+        l.back().second = i->second.second;
+      else
+        l.push_back(i->second);
+    }
+
+    if (!m_sparse_table.test(elmnt)) {
+      m_sparse_table[elmnt] = l;
+      continue;
+    }
+
+    // Merge into the existing entry. Both lists are in decreasing order of
+    // transaction id, so this is a single pass.
+    multi_value_type *old = m_sparse_table[elmnt].operator&();
+    multi_value_type::iterator it = old->begin();
+    BOOST_FOREACH(const value_type& v, l) {
+      while (it != old->end() && (*it).first > v.first)
+        ++it;
+      if (it != old->end() && (*it).first == v.first)
+        (*it).second = v.second;
+      else
+        old->insert(it, v);
+    }
+  }
+}
+
 /// Return the IndexRecord for a the given transaction_id at
 /// this location.  By default this routine returns the record with
 /// the greatest transaction id that is less than or equal to the
@@ -17,6 +17,7 @@
 #include <boost/shared_ptr.hpp>
 #include <string>
 #include <list>
+#include <vector>
 
 namespace vw {
 namespace platefile {
@@ -32,6 +33,8 @@ namespace detail {
     typedef std::pair<uint32, IndexRecord> value_type;
     typedef std::list<value_type> multi_value_type;
     typedef google::sparsetable<multi_value_type>::nonempty_iterator nonempty_iterator;
+    // An entry for bulk_set(): (row*page_width + col within the page, value)
+    typedef std::pair<uint32, value_type> bulk_value_type;
 
   protected:
     uint32 m_level, m_base_col, m_base_row;
@@ -78,6 +81,13 @@ namespace detail {
     /// Set the value of an entry in the IndexPage.
     virtual void set(TileHeader const& header, IndexRecord const& record);
 
+    /// Set many entries at once. This sorts the entries (in place) and then
+    /// builds each location's list in one go, which is much faster than
+    /// calling set() once per entry. If a location and transaction id appear
+    /// more than once, the last one in the vector wins, just as it would
+    /// with repeated set()s.
+    virtual void bulk_set(std::vector<bulk_value_type>& entries);
+
     /// Return the IndexRecord for a the given transaction_id at
     /// this location.  By default this routine returns the record with
     /// the greatest transaction id that is less than or equal to the
@@ -7,6 +7,8 @@
 
 #include <vw/Core/ProgressCallback.h>
 #include <vw/Core/Log.h>
+#include <vw/Core/Settings.h>
+#include <vw/Core/ThreadPool.h>
 #include <vw/FileIO/TemporaryFile.h>
 #include <vw/Plate/detail/LocalIndex.h>
 #include <vw/Plate/detail/RemoteIndex.h>
@@ -23,6 +25,7 @@ using namespace vw::platefile::detail;
 #include <boost/filesystem.hpp>
 #include <boost/regex.hpp>
 #include <algorithm>
+#include <map>
 namespace fs = boost::filesystem;
 
 LocalIndexPage::LocalIndexPage(std::string filename, uint32 level, uint32 base_col,
@@ -51,6 +54,12 @@ void LocalIndexPage::set(TileHeader const& header, IndexRecord const& record) {
   m_needs_saving = true;
 }
 
+void LocalIndexPage::bulk_set(std::vector<bulk_value_type>& entries) {
+  IndexPage::bulk_set(entries);
+  if (!entries.empty())
+    m_needs_saving = true;
+}
+
 void LocalIndexPage::sync() {
   if (m_needs_saving) {
     this->serialize();
@@ -211,6 +220,7 @@ void LocalIndex::save_index_file() const {
       WARN_IF_DIFFERENT(channel_type);
       WARN_IF_DIFFERENT(type);
       WARN_IF_DIFFERENT(description);
+      WARN_IF_DIFFERENT(blob_placement);
 #undef WARN_IF_DIFFERENT
      return;
    }
@@ -230,6 +240,9 @@ void LocalIndex::save_index_file() const {
          << m_header.tile_filetype() << ").\n";
    }
 
+   // Fail early on a placement policy we don't understand.
+   blob_placement_from_string(m_header.blob_placement());
+
 #define WARN_IF_SET(field) do {if (new_index_info.has_ ## field()) vw_out(ErrorMessage, "plate") << #field << " is a private field. Ignoring your value " << m_header.field() << std::endl;} while(0)
    WARN_IF_SET(platefile_id);
    WARN_IF_SET(version);
@@ -369,44 +382,192 @@ Transaction LocalIndex::transaction_request(std::string transaction_description,
    return m_header.transaction_read_cursor();
  }
 
+ namespace {
+
+   // Which page a record belongs to: level, then page row, then page col.
+   typedef uint64 PageKey;
+   typedef std::pair<PageKey, IndexPage::bulk_value_type> KeyedRecord;
+   typedef std::map<PageKey, std::vector<IndexPage::bulk_value_type> > PageBuckets;
+
+   PageKey page_key(uint32 level, uint32 page_col, uint32 page_row) {
+     return (uint64(level) << 56) | (uint64(page_row) << 28) | uint64(page_col);
+   }
+   uint32 key_level(PageKey k)    { return uint32(k >> 56); }
+   uint32 key_page_row(PageKey k) { return uint32((k >> 28) & 0xfffffff); }
+   uint32 key_page_col(PageKey k) { return uint32(k & 0xfffffff); }
+
+   // Shared by the tasks of one phase: counts progress and keeps the first
+   // error, since exceptions can't leave a worker thread.
+   class RebuildStatus {
+       Mutex m_mutex;
+       TerminalProgressCallback m_tpc;
+       size_t m_done, m_total;
+     public:
+       TaskErrors errors;
+
+       RebuildStatus(const std::string& msg, size_t total)
+         : m_tpc("plate", msg), m_done(0), m_total(total) { m_tpc.report_progress(0); }
+
+       void finished_one() {
+         Mutex::Lock lock(m_mutex);
+         m_tpc.report_progress(float(++m_done) / float(m_total));
+       }
+       void check() {
+         m_tpc.report_finished();
+         errors.rethrow();
+       }
+   };
+
+   // Reads every record out of a single blob
+   class ReadBlobTask : public Task {
+       std::string m_filename;
+       uint32 m_blob_id, m_page_width, m_page_height;
+       std::vector<KeyedRecord>& m_records;
+       RebuildStatus& m_status;
+     public:
+       ReadBlobTask(const std::string& filename, uint32 blob_id, uint32 page_width, uint32 page_height,
+                    std::vector<KeyedRecord>& records, RebuildStatus& status)
+         : m_filename(filename), m_blob_id(blob_id), m_page_width(page_width), m_page_height(page_height),
+           m_records(records), m_status(status) {}
+
+       void operator()() {
+         try {
+           ReadBlob blob(m_filename);
+
+           IndexRecord rec;
+           rec.set_blob_id(m_blob_id);
+           typedef Blob::iterator iter_t;
+           for (iter_t tile = blob.begin(), end = blob.end(); tile != end; ++tile) {
+             const TileHeader& hdr = (*tile).hdr;
+             rec.set_blob_offset(tile.current_base_offset());
+             rec.set_filetype(hdr.filetype());
+
+             const uint32 elmnt = (hdr.row() % m_page_height) * m_page_width + hdr.col() % m_page_width;
+             m_records.push_back(KeyedRecord(
+                 page_key(hdr.level(), hdr.col() / m_page_width, hdr.row() / m_page_height),
+                 IndexPage::bulk_value_type(elmnt, IndexPage::value_type(hdr.transaction_id(), rec))));
+           }
+         } catch (...) {
+           vw_out(ErrorMessage, "plate") << "Rebuilding index: failed to read " << m_filename << std::endl;
+           m_status.errors.capture();
+         }
+         m_status.finished_one();
+       }
+   };
+
+   // Builds one page from its bucket and writes it out
+   class WritePageTask : public Task {
+       boost::shared_ptr<PageGeneratorBase> m_gen;
+       std::vector<IndexPage::bulk_value_type>& m_records;
+       RebuildStatus& m_status;
+     public:
+       WritePageTask(boost::shared_ptr<PageGeneratorBase> gen,
+                     std::vector<IndexPage::bulk_value_type>& records, RebuildStatus& status)
+         : m_gen(gen), m_records(records), m_status(status) {}
+
+       void operator()() {
+         try {
+           boost::shared_ptr<IndexPage> page = m_gen->generate();
+           page->bulk_set(m_records);
+           page->sync();
+         } catch (...) {
+           m_status.errors.capture();
+         }
+         // Give the memory back as we go
+         std::vector<IndexPage::bulk_value_type>().swap(m_records);
+         m_status.finished_one();
+       }
+   };
+ }
+
  // Load index entries by iterating through TileHeaders saved in the
  // blob file.  This function essentially rebuilds an index in memory
  // using entries that had been previously saved to disk.
- void LocalIndex::rebuild_index() {
+ void LocalIndex::rebuild_index(uint32 num_threads) {
+
+   if (num_threads == 0)
+     num_threads = vw_settings().default_num_threads();
+
+   vw_out(InfoMessage) << "Rebuilding index: " << m_plate_filename
+                       << " (" << num_threads << " threads)\n";
 
-   vw_out(InfoMessage) << "Rebuilding index: " << m_plate_filename <<"\n";
+   // Anything cached has to hit the disk first, or it would overwrite the
+   // pages written below.
+   this->sync();
 
    // index in blob_filenames is the blobfile id
    std::vector<std::string> blob_files = this->blob_filenames();
-   for (uint32 blob_id = 0; blob_id < blob_files.size(); ++blob_id) {
-     const std::string& name = blob_files[blob_id];
-     if (name.empty())
-       continue;
-
-     TerminalProgressCallback tpc("plate", "\t --> Rebuild from blob" + vw::stringify(blob_id) + " : ");
-     tpc.report_progress(0);
-
-     ReadBlob blob(name);
-
-     IndexRecord rec;
-     typedef Blob::iterator iter_t;
-     for (iter_t tile = blob.begin(), end = blob.end(); tile != end; ++tile) {
-       const BlobTileRecord& hdr = *tile;
-       rec.set_blob_id(blob_id);
-       rec.set_blob_offset(tile.current_base_offset());
-       rec.set_filetype(hdr.hdr.filetype());
-       this->write_update(hdr.hdr, rec);
-       tpc.report_progress(float(tile.current_base_offset()) / float(blob.size()));
-    }
-    tpc.report_finished();
-  }
-}
+   std::vector<std::vector<KeyedRecord> > records(blob_files.size());
+
+   {
+     size_t count = 0;
+     BOOST_FOREACH(const std::string& name, blob_files)
+       if (!name.empty())
+         count++;
+
+     RebuildStatus status("\t --> Reading blobs: ", count);
+     FifoWorkQueue queue(num_threads);
+     for (uint32 blob_id = 0; blob_id < blob_files.size(); ++blob_id) {
+       if (blob_files[blob_id].empty())
+         continue;
+       queue.add_task(boost::shared_ptr<Task>(
+             new ReadBlobTask(blob_files[blob_id], blob_id, m_page_width, m_page_height, records[blob_id], status)));
+     }
+     queue.join_all();
+     status.check();
+   }
+
+   // Bucket by page. Going through the blobs in id order means that
+   // duplicate records resolve the same way an incremental rebuild would.
+   PageBuckets buckets;
+   uint32 max_level = 0;
+   size_t total = 0;
+   BOOST_FOREACH(std::vector<KeyedRecord>& blob_records, records) {
+     BOOST_FOREACH(const KeyedRecord& r, blob_records) {
+       buckets[r.first].push_back(r.second);
+       max_level = std::max(max_level, key_level(r.first));
+     }
+     total += blob_records.size();
+     std::vector<KeyedRecord>().swap(blob_records);
+   }
+
+   if (buckets.empty()) {
+     vw_out(WarningMessage) << "Rebuilding index: no tiles found in " << m_plate_filename << "\n";
+     return;
+   }
+
+   {
+     RebuildStatus status("\t --> Writing pages: ", buckets.size());
+     FifoWorkQueue queue(num_threads);
+     BOOST_FOREACH(PageBuckets::value_type& b, buckets) {
+       boost::shared_ptr<PageGeneratorBase> gen = m_page_gen_factory->create(
+           key_level(b.first), key_page_col(b.first) * m_page_width, key_page_row(b.first) * m_page_height,
+           m_page_width, m_page_height);
+       queue.add_task(boost::shared_ptr<Task>(new WritePageTask(gen, b.second, status)));
+     }
+     queue.join_all();
+     status.check();
+   }
+
+   // The pages on disk are now newer than anything in the level caches, so
+   // start the levels over.
+   const uint32 num_levels = std::max(max_level + 1, boost::numeric_cast<uint32>(m_levels.size()));
+   m_levels.clear();
+   for (uint32 level = 0; level < num_levels; ++level)
+     m_levels.push_back(boost::shared_ptr<IndexLevel>(
+           new IndexLevel(m_page_gen_factory, level, m_page_width, m_page_height, m_default_cache_size)));
+
+   m_header.set_num_levels(num_levels);
+   this->save_index_file();
+
+   this->log() << "Rebuilt index from " << total << " records into " << buckets.size() << " pages\n";
+ }
 
 // -----------------------    I/O      ----------------------
 
 /// Writing, pt. 1: Reserve a blob lock
-uint32 LocalIndex::write_request() {
-  return m_blob_manager->request_lock();
+uint32 LocalIndex::write_request(uint64 locality) {
+  return m_blob_manager->request_lock(locality);
 }
 
 /// Writing, pt. 1: Reserve a blob lock
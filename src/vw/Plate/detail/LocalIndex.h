@@ -43,6 +43,9 @@ namespace detail {
     /// Set the value of an entry in the IndexPage.
     virtual void set(TileHeader const& header, IndexRecord const& record);
 
+    /// Set many entries at once.
+    virtual void bulk_set(std::vector<bulk_value_type>& entries);
+
     /// Save any unsaved changes to disk.
     virtual void sync();
 
@@ -115,7 +118,12 @@ namespace detail {
     // Rebuild an index from blob file entries.  You should only do
     // this if you lose or corrupt an index.  This may take a long
     // time.
-    void rebuild_index();
+    //
+    // The blobs are read in parallel, one reader per blob, and the records
+    // are sorted into per-page buckets so each page is built and written
+    // once. Every record is held in memory until the pages are written. A
+    // num_threads of 0 means vw_settings().default_num_threads().
+    void rebuild_index(uint32 num_threads = 0);
 
     /// Use this to send data to the index's logfile like this:
     ///
@@ -127,7 +135,7 @@ namespace detail {
 
     // Writing, pt. 1: Locks a blob and returns the blob id that can
     // be used to write a tile.
-    virtual uint32 write_request();
+    virtual uint32 write_request(uint64 locality = NO_LOCALITY);
 
     // Writing, pt. 2: Supply information to update the index and
     // unlock the blob id.
@@ -255,9 +255,11 @@ RemoteIndex::~RemoteIndex() {}
 
 // Writing, pt. 1: Locks a blob and returns the blob id that can
 // be used to write a tile.
-uint32 RemoteIndex::write_request() {
+uint32 RemoteIndex::write_request(uint64 locality) {
   IndexWriteRequest request;
   request.set_platefile_id(m_platefile_id);
+  if (locality != NO_LOCALITY)
+    request.set_locality(locality);
 
   IndexWriteReply response;
   m_client->WriteRequest(m_client.get(), &request, &response, null_callback());
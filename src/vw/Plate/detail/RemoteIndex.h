@@ -126,7 +126,7 @@ namespace detail {
 
     // Writing, pt. 1: Locks a blob and returns the blob id that can
     // be used to write a tile.
-    virtual uint32 write_request();
+    virtual uint32 write_request(uint64 locality = NO_LOCALITY);
 
     /// Writing, pt. 3: Signal the completion
     virtual void write_complete(uint32 blob_id);
@@ -0,0 +1,242 @@
+// __BEGIN_LICENSE__
+// Copyright (C) 2006-2011 United States Government as represented by
+// the Administrator of the National Aeronautics and Space Administration.
+// All Rights Reserved.
+// __END_LICENSE__
+
+
+#include <vw/Plate/detail/SharedTileCache.h>
+#include <vw/Plate/IndexDataPrivate.pb.h>
+#include <vw/Core/Exception.h>
+#include <boost/numeric/conversion/cast.hpp>
+
+#include <sys/mman.h>
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+
+namespace {
+  static const size_t FILETYPE_LEN = 16;
+
+  size_t align8(size_t n) {
+    return (n + 7) & ~size_t(7);
+  }
+}
+
+namespace vw {
+namespace platefile {
+namespace detail {
+
+// Everything below lives in the shared region, so it must be POD-ish and
+// contain no pointers.
+struct SharedTileCache::Header {
+  uint32 nsets;
+  uint32 ways;
+  uint32 slot_bytes;
+  uint64 max_tile;
+  volatile uint64 hits, misses, inserts, evictions;
+  // followed by nsets clock hands, then nsets*ways slots
+};
+
+struct SharedTileCache::Slot {
+  volatile uint32 seq;        // odd while a writer owns the slot
+  volatile uint32 referenced; // the CLOCK bit
+  uint32 used;
+  uint32 has_data;
+  Key    key;
+  uint32 blob_id;
+  uint32 data_size;
+  uint64 blob_offset;
+  char   filetype[FILETYPE_LEN];
+  // followed by max_tile bytes of tile data
+
+  uint8* data() { return reinterpret_cast<uint8*>(this + 1); }
+};
+
+bool SharedTileCache::Key::operator==(const Key& k) const {
+  return platefile_id == k.platefile_id && level == k.level
+      && col == k.col && row == k.row
+      && transaction_id == k.transaction_id && exact == k.exact;
+}
+
+SharedTileCache::SharedTileCache(size_t bytes, size_t max_tile, uint32 ways)
+  : m_base(0), m_bytes(bytes), m_header(0)
+{
+  VW_ASSERT(ways > 0, ArgumentErr() << "SharedTileCache needs at least one way per set");
+
+  const size_t slot_bytes = align8(sizeof(Slot) + max_tile);
+  const size_t per_set    = ways * slot_bytes + sizeof(uint32);
+  const size_t fixed      = align8(sizeof(Header));
+
+  VW_ASSERT(bytes > fixed + per_set + 8,
+      ArgumentErr() << "SharedTileCache of " << bytes << " bytes is too small to hold a single set of " << ways << " tiles of " << max_tile << " bytes");
+
+  const uint32 nsets = boost::numeric_cast<uint32>((bytes - fixed - 8) / per_set);
+
+  // MAP_SHARED|MAP_ANON survives fork(), and comes back zeroed.
+  m_base = ::mmap(0, m_bytes, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANON, -1, 0);
+  if (m_base == MAP_FAILED) {
+    m_base = 0;
+    vw_throw(IOErr() << "Could not map " << m_bytes << " bytes for the shared tile cache: " << ::strerror(errno));
+  }
+
+  m_header = reinterpret_cast<Header*>(m_base);
+  m_header->nsets      = nsets;
+  m_header->ways       = ways;
+  m_header->slot_bytes = boost::numeric_cast<uint32>(slot_bytes);
+  m_header->max_tile   = max_tile;
+}
+
+SharedTileCache::~SharedTileCache() {
+  if (m_base)
+    ::munmap(m_base, m_bytes);
+}
+
+SharedTileCache::Slot* SharedTileCache::slot(uint32 idx) const {
+  uint8* hands_end = reinterpret_cast<uint8*>(m_base) + align8(sizeof(Header)) + m_header->nsets * sizeof(uint32);
+  uint8* slots     = reinterpret_cast<uint8*>(align8(reinterpret_cast<size_t>(hands_end)));
+  return reinterpret_cast<Slot*>(slots + size_t(idx) * m_header->slot_bytes);
+}
+
+uint32 SharedTileCache::set_of(const Key& k) const {
+  uint64 h = 14695981039346656037ULL;
+  const int32 parts[] = {k.platefile_id, k.level, k.col, k.row, k.transaction_id, k.exact};
+  for (size_t i = 0; i < sizeof(parts)/sizeof(parts[0]); ++i) {
+    h ^= uint32(parts[i]);
+    h *= 1099511628211ULL;
+  }
+  h ^= h >> 29;
+  return uint32(h % m_header->nsets);
+}
+
+bool SharedTileCache::lookup(const Key& key, IndexRecord& record, bool& has_data, std::vector<uint8>& data) const {
+  const uint32 set = set_of(key);
+  for (uint32 way = 0; way < m_header->ways; ++way) {
+    Slot* s = slot(set * m_header->ways + way);
+
+    const uint32 seq = s->seq;
+    if (seq & 1)
+      continue;
+    __sync_synchronize();
+
+    if (!s->used || !(s->key == key))
+      continue;
+
+    // Copy everything out, then make sure nobody rewrote the slot while we
+    // were looking at it. A torn data_size must not run us off the end.
+    uint32 blob_id     = s->blob_id;
+    uint64 blob_offset = s->blob_offset;
+    uint32 size        = std::min<uint64>(s->data_size, m_header->max_tile);
+    bool   cached_data = s->has_data;
+    char   filetype[FILETYPE_LEN];
+    std::memcpy(filetype, s->filetype, FILETYPE_LEN);
+    filetype[FILETYPE_LEN-1] = '\0';
+
+    if (cached_data)
+      data.assign(s->data(), s->data() + size);
+
+    __sync_synchronize();
+    if (s->seq != seq)
+      continue;
+
+    s->referenced = 1;
+    __sync_fetch_and_add(&m_header->hits, 1);
+
+    record.set_blob_id(blob_id);
+    record.set_blob_offset(blob_offset);
+    record.set_filetype(filetype);
+    has_data = cached_data;
+    if (!cached_data)
+      data.clear();
+    return true;
+  }
+
+  __sync_fetch_and_add(&m_header->misses, 1);
+  return false;
+}
+
+bool SharedTileCache::insert(const Key& key, const IndexRecord& record, const uint8* data, size_t size) {
+  if (record.filetype().size() >= FILETYPE_LEN)
+    return false;
+
+  const bool with_data = data && size <= m_header->max_tile;
+  const uint32 set  = set_of(key);
+  const uint32 ways = m_header->ways;
+  volatile uint32* hands = reinterpret_cast<volatile uint32*>(reinterpret_cast<uint8*>(m_base) + align8(sizeof(Header)));
+
+  // If the key is already here, only bother replacing it to add the data.
+  Slot* target = 0;
+  for (uint32 way = 0; way < ways; ++way) {
+    Slot* s = slot(set * ways + way);
+    if (s->used && s->key == key) {
+      if (s->has_data || !with_data)
+        return false;
+      target = s;
+      break;
+    }
+  }
+
+  // Otherwise, sweep the clock hand around the set. Anything referenced since
+  // the last pass gets a second chance; two full turns is enough to find a
+  // victim unless every slot is busy being written.
+  for (uint32 step = 0; step < 2 * ways + 1; ++step) {
+    Slot* s = target;
+    if (!s) {
+      s = slot(set * ways + (__sync_fetch_and_add(&hands[set], 1) % ways));
+      if (s->used && s->referenced) {
+        s->referenced = 0;
+        continue;
+      }
+    }
+
+    const uint32 seq = s->seq;
+    if ((seq & 1) || !__sync_bool_compare_and_swap(&s->seq, seq, seq+1)) {
+      if (target)
+        return false;
+      continue;
+    }
+
+    const bool evicted = s->used && !(s->key == key);
+
+    s->key         = key;
+    s->blob_id     = record.blob_id();
+    s->blob_offset = record.blob_offset();
+    std::memset(s->filetype, 0, FILETYPE_LEN);
+    std::memcpy(s->filetype, record.filetype().data(), record.filetype().size());
+    s->has_data    = with_data;
+    s->data_size   = with_data ? boost::numeric_cast<uint32>(size) : 0;
+    if (with_data && size)
+      std::memcpy(s->data(), data, size);
+    s->used        = 1;
+    // New tiles only earn a second chance once somebody asks for them again,
+    // so a burst of one-off requests can't push out the hot tiles.
+    s->referenced  = 0;
+
+    __sync_synchronize();
+    __sync_fetch_and_add(&s->seq, 1);
+
+    __sync_fetch_and_add(&m_header->inserts, 1);
+    if (evicted)
+      __sync_fetch_and_add(&m_header->evictions, 1);
+    return true;
+  }
+
+  return false;
+}
+
+size_t SharedTileCache::max_tile() const {
+  return m_header->max_tile;
+}
+
+SharedTileCache::Stats SharedTileCache::stats() const {
+  Stats s;
+  s.hits      = m_header->hits;
+  s.misses    = m_header->misses;
+  s.inserts   = m_header->inserts;
+  s.evictions = m_header->evictions;
+  s.slots     = uint64(m_header->nsets) * m_header->ways;
+  s.max_tile  = m_header->max_tile;
+  return s;
+}
+
+}}} // namespace vw::platefile::detail
@@ -0,0 +1,88 @@
+// __BEGIN_LICENSE__
+// Copyright (C) 2006-2011 United States Government as represented by
+// the Administrator of the National Aeronautics and Space Administration.
+// All Rights Reserved.
+// __END_LICENSE__
+
+
+/// \file SharedTileCache.h
+///
+/// A fixed-size cache of index lookups (and optionally the tile bytes
+/// themselves) that lives in anonymous shared memory. Create it before
+/// forking, and every child process sees the same cache.
+///
+/// The table is set-associative. Each slot is guarded by a sequence counter
+/// (odd while a writer owns it), so lookups never block: a reader copies the
+/// slot out and retries (well, gives up) if the counter moved underneath it.
+/// Inserts are best-effort; a writer that loses a race just doesn't cache
+/// that tile. Slots are evicted with the CLOCK (second chance) algorithm.
+///
+
+#ifndef __VW_PLATE_SHAREDTILECACHE_H__
+#define __VW_PLATE_SHAREDTILECACHE_H__
+
+#include <vw/Core/FundamentalTypes.h>
+#include <boost/noncopyable.hpp>
+#include <vector>
+
+namespace vw {
+namespace platefile {
+namespace detail {
+
+  class IndexRecord;
+
+  class SharedTileCache : boost::noncopyable {
+    public:
+      struct Key {
+        int32 platefile_id;
+        int32 level;
+        int32 col;
+        int32 row;
+        int32 transaction_id;
+        int32 exact;
+
+        Key() : platefile_id(0), level(0), col(0), row(0), transaction_id(0), exact(0) {}
+        Key(int32 platefile_id, int32 level, int32 col, int32 row, int32 transaction_id, bool exact)
+          : platefile_id(platefile_id), level(level), col(col), row(row),
+            transaction_id(transaction_id), exact(exact ? 1 : 0) {}
+        bool operator==(const Key& k) const;
+      };
+
+      struct Stats {
+        uint64 hits, misses, inserts, evictions;
+        uint64 slots, max_tile;
+      };
+
+      // bytes:    total size of the shared region
+      // max_tile: tiles larger than this only have their index record cached
+      // ways:     slots per set
+      SharedTileCache(size_t bytes, size_t max_tile, uint32 ways = 8);
+      ~SharedTileCache();
+
+      // Look up a key. On a hit, fills in the index record and returns true.
+      // If the tile bytes were cached too, has_data is set and data holds
+      // them; otherwise data is left empty.
+      bool lookup(const Key& key, IndexRecord& record, bool& has_data, std::vector<uint8>& data) const;
+
+      // Cache a lookup. data may be null (or larger than max_tile), in which
+      // case only the record is kept. Returns false if nothing was cached.
+      bool insert(const Key& key, const IndexRecord& record, const uint8* data = 0, size_t size = 0);
+
+      size_t max_tile() const;
+      Stats stats() const;
+
+    private:
+      struct Header;
+      struct Slot;
+
+      Slot* slot(uint32 idx) const;
+      uint32 set_of(const Key& key) const;
+
+      void *m_base;
+      size_t m_bytes;
+      Header *m_header;
+  };
+
+}}} // namespace vw::platefile::detail
+
+#endif // __VW_PLATE_SHAREDTILECACHE_H__
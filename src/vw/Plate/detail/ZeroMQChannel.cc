@@ -13,6 +13,7 @@
 #include <vw/Core/Debugging.h>
 
 #include <boost/algorithm/string/trim.hpp>
+#include <boost/foreach.hpp>
 #include <google/protobuf/descriptor.h>
 #include <zmq.hpp>
 #include <cerrno>
@@ -44,7 +45,8 @@ namespace {
   VW_ASSERT(m_id == Thread::id(), LogicErr() << "ZeroMQChannel created on thread " <<  m_id << " and used on thread " << Thread::id() << ". function: " << VW_CURRENT_FUNCTION)
 
 ZeroMQChannel::ZeroMQChannel(const std::string& human_name)
-  : m_ctx(get_ctx()), m_human_name(human_name), m_timeout(DEFAULT_TIMEOUT), m_retries(DEFAULT_RETRIES) {}
+  : m_ctx(get_ctx()), m_human_name(human_name), m_timeout(DEFAULT_TIMEOUT), m_retries(DEFAULT_RETRIES),
+    m_seq(0), m_bound(false) {}
 
 ZeroMQChannel::~ZeroMQChannel() VW_NOTHROW {
   if (m_sock) {
@@ -53,18 +55,33 @@ ZeroMQChannel::~ZeroMQChannel() VW_NOTHROW {
   }
 }
 
-void ZeroMQChannel::send_bytes(const uint8* message, size_t len) {
-  THREAD_CHECK();
+void ZeroMQChannel::send_frame(const void* data, size_t len, bool more) {
   // send() just queues the message. need to copy it.
   zmq::message_t rmsg(len);
-  ::memcpy(rmsg.data(), message, len);
+  if (len)
+    ::memcpy(rmsg.data(), data, len);
 
   // false return means EAGAIN
-  while (!m_sock->send(rmsg)) {
+  while (!m_sock->send(rmsg, more ? ZMQ_SNDMORE : 0)) {
     Thread::sleep_ms(10);
   }
 }
 
+void ZeroMQChannel::send_bytes(const uint8* message, size_t len) {
+  THREAD_CHECK();
+
+  // We use XREQ/XREP rather than REQ/REP, so we have to do the envelope
+  // ourselves: the server sends back the return address it got with the
+  // request, and both sides add the empty delimiter frame.
+  if (m_bound) {
+    BOOST_FOREACH(const std::string& hop, m_envelope)
+      send_frame(hop.data(), hop.size(), true);
+    m_envelope.clear();
+  }
+  send_frame(0, 0, true);
+  send_frame(message, len, false);
+}
+
 bool ZeroMQChannel::recv_bytes(std::vector<uint8>* bytes) {
   THREAD_CHECK();
 
@@ -98,9 +115,27 @@ bool ZeroMQChannel::recv_bytes(std::vector<uint8>* bytes) {
     }
   }
 
-  // false return means EAGAIN
-  while (!m_sock->recv(&rmsg))
-    Thread::sleep_ms(10);
+  // Everything before the body is envelope (return address, then an empty
+  // delimiter). Multipart messages arrive atomically, so once the first part
+  // is here they all are.
+  std::vector<std::string> envelope;
+  while (true) {
+    // false return means EAGAIN
+    while (!m_sock->recv(&rmsg))
+      Thread::sleep_ms(10);
+
+    int64_t more = 0;
+    size_t more_size = sizeof(more);
+    m_sock->getsockopt(ZMQ_RCVMORE, &more, &more_size);
+    if (!more)
+      break;
+
+    if (rmsg.size() > 0)
+      envelope.push_back(std::string(reinterpret_cast<const char*>(rmsg.data()), rmsg.size()));
+  }
+
+  if (m_bound)
+    m_envelope.swap(envelope);
 
   bytes->clear();
   bytes->reserve(rmsg.size());
@@ -127,16 +162,30 @@ void ZeroMQChannel::CallMethod(const pb::MethodDescriptor* method,
   for (uint32 trial = 0; trial <= m_retries; ++trial) {
     if (trial > 0)
       vw_out(WarningMessage) << "Retry (" << trial << "/" << m_retries << ")" << std::endl;
+    q_wrap.set_seq(++m_seq);
 
     send_message(q_wrap);
-    switch (recv_message(a_wrap)) {
+
+    // Answers to the requests we gave up on may still turn up. Drop them and
+    // keep waiting for ours.
+    int32 ret;
+    while ((ret = recv_message(a_wrap)) > 0 && a_wrap.seq() < q_wrap.seq())
+      vw_out(WarningMessage) << "Dropping stale answer on \"" << this->name() << "\" (expected "
+                             << q_wrap.seq() << ", got " << a_wrap.seq() << ")" << std::endl;
+
+    switch (ret) {
       case 0:
-        // we can't recover from a timeout, since we can't send twice in a row
-        vw_throw(NetworkErr() << "CallMethod Timeout.");
+        // XREQ doesn't care if we send twice in a row, so we can just retry.
+        vw_out(WarningMessage) << "CallMethod Timeout. ";
+        continue;
       case -1:
         vw_out(WarningMessage) << "CallMethod(): corrupted message. ";
         continue;
       default:
+        if (a_wrap.seq() != q_wrap.seq()) {
+          vw_out(WarningMessage) << "Sequence mismatch on \"" << this->name() << "\" (expected " << m_seq << ", got " << a_wrap.seq() << ") ";
+          continue;
+        }
         throw_rpc_error(a_wrap.error());
         response->ParseFromString(a_wrap.payload());
         return;
@@ -186,7 +235,7 @@ void ZeroMQChannel::conn(const Url& endpoint_) {
   std::string url = endpoint.string();
   boost::algorithm::trim_right_if(url, boost::is_any_of("/"));
 
-  m_sock.reset(new zmq::socket_t(*m_ctx, ZMQ_REQ));
+  m_sock.reset(new zmq::socket_t(*m_ctx, ZMQ_XREQ));
 
   // We use the c interface rather than the c++ one here to avoid having to
   // catch an exception and rethrow
@@ -202,7 +251,8 @@ void ZeroMQChannel::bind(const Url& endpoint_) {
   std::string url = endpoint.string();
   boost::algorithm::trim_right_if(url, boost::is_any_of("/"));
 
-  m_sock.reset(new zmq::socket_t(*m_ctx, ZMQ_REP));
+  m_sock.reset(new zmq::socket_t(*m_ctx, ZMQ_XREP));
+  m_bound = true;
 
   // We use the c interface rather than the c++ one here to avoid having to
   // catch an exception and rethrow
@@ -229,3 +279,7 @@ void ZeroMQChannel::set_retries(uint32 x) {
 std::string ZeroMQChannel::name() const {
   return m_human_name;
 }
+
+bool ZeroMQChannel::pipelined() const {
+  return true;
+}
@@ -12,6 +12,8 @@
 #include <vw/Plate/Exception.h>
 #include <boost/noncopyable.hpp>
 #include <boost/shared_ptr.hpp>
+#include <string>
+#include <vector>
 
 namespace zmq {
   class context_t;
@@ -33,6 +35,12 @@ namespace platefile {
       uint64 m_id;
       int32 m_timeout;
       uint32 m_retries;
+      int32 m_seq;
+      bool m_bound;
+      // The return address of the last request (server side only)
+      std::vector<std::string> m_envelope;
+
+      void send_frame(const void* data, size_t len, bool more);
 
     protected:
       void send_bytes(const uint8* message, size_t len);
@@ -52,6 +60,10 @@ namespace platefile {
       //uint64 queue_depth() const;
       std::string name() const;
 
+      // Clients use XREQ sockets, so requests don't have to alternate with
+      // replies.
+      bool pipelined() const;
+
       virtual void CallMethod(const google::protobuf::MethodDescriptor*,
                               google::protobuf::RpcController*,
                               const google::protobuf::Message*,
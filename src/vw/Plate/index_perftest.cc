@@ -6,33 +6,149 @@
 
 
 #include <vw/Plate/Rpc.h>
+#include <vw/Plate/RpcPipeline.h>
 #include <vw/Plate/IndexService.h>
 #include <vw/Plate/HTTPUtils.h>
 #include <vw/Core/Stopwatch.h>
 #include  <iostream>
+#include <algorithm>
 
 #include <boost/scoped_ptr.hpp>
 #include <boost/program_options.hpp>
 namespace po = boost::program_options;
+namespace pb = ::google::protobuf;
 
 using namespace vw;
 using namespace vw::platefile;
 
-const static size_t BATCH_SIZE = 5000;
-
 typedef RpcClient<IndexService> IndexClient;
+typedef RpcPipelineClient<IndexService> IndexPipeline;
+
+// Stands in for a real index server when running with --local, so we measure
+// the rpc layer rather than the index.
+class StandInService : public IndexService {
+  public:
+    void TestRequest(pb::RpcController*, const IndexTestRequest* request, IndexTestReply* response, pb::Closure* done) {
+      response->set_value(request->value());
+      done->Run();
+    }
+    void WriteUpdate(pb::RpcController*, const IndexWriteUpdate*, RpcNullMsg*, pb::Closure* done) {
+      done->Run();
+    }
+};
+
+// Records when each call went out and when its answer came back
+struct LatencyLog {
+  std::vector<uint64> start, end;
+
+  LatencyLog(size_t n) : start(n), end(n) {}
+  void sent(size_t i) { start[i] = Stopwatch::microtime(); }
+  void done(size_t i) { end[i]   = Stopwatch::microtime(); }
+
+  void report(std::ostream& out, uint64 total_us) const {
+    std::vector<uint64> lat(start.size());
+    for (size_t i = 0; i < start.size(); ++i)
+      lat[i] = end[i] - start[i];
+    std::sort(lat.begin(), lat.end());
+
+    out << 1000000. * double(lat.size()) / double(total_us) << " msg/s  latency(us):"
+        << " p50 " << lat[lat.size() * 50 / 100]
+        << " p90 " << lat[lat.size() * 90 / 100]
+        << " p99 " << lat[lat.size() * 99 / 100]
+        << " max " << lat.back() << std::endl;
+  }
+};
+
+struct Options {
+  Url url;
+  std::string mode, message;
+  size_t count;
+  uint32 rounds, in_flight, batch;
+  bool local;
+};
+
+void run_sync(const Options& opt, IndexClient& client, LatencyLog& log) {
+  for (size_t i = 0; i < opt.count; i++) {
+    log.sent(i);
+    if (opt.message == "write") {
+      IndexWriteUpdate request;
+      request.set_platefile_id(1);
+      request.mutable_header()->set_col(i);
+      request.mutable_header()->set_row(0);
+      request.mutable_header()->set_level(0);
+      request.mutable_header()->set_transaction_id(1);
+      request.mutable_record()->set_blob_id(0);
+      request.mutable_record()->set_blob_offset(i);
+      RpcNullMsg response;
+      client.WriteUpdate(&client, &request, &response, null_callback());
+    } else {
+      IndexTestRequest request;
+      request.set_value(i);
+
+      IndexTestReply response;
+      client.TestRequest(&client, &request, &response, null_callback());
+
+      if (i != response.value())
+        std::cerr << "Error: IndexTestMessage failed!\n";
+    }
+    log.done(i);
+  }
+}
+
+void run_pipeline(const Options& opt, IndexPipeline& client, LatencyLog& log) {
+  // The pipeline needs the messages to live until the answers come back
+  std::vector<IndexWriteUpdate> wq;
+  std::vector<RpcNullMsg>       wa;
+  std::vector<IndexTestRequest> tq;
+  std::vector<IndexTestReply>   ta;
+
+  if (opt.message == "write") {
+    wq.resize(opt.count);
+    wa.resize(opt.count);
+  } else {
+    tq.resize(opt.count);
+    ta.resize(opt.count);
+  }
 
-IndexClient* conn(const Url& url) {
-  std::cerr << "Connecting to index server at " << url.string() << std::endl;
-  return new IndexClient(url);
+  for (size_t i = 0; i < opt.count; i++) {
+    log.sent(i);
+    pb::Closure* done = pb::NewCallback(&log, &LatencyLog::done, i);
+    if (opt.message == "write") {
+      IndexWriteUpdate& request = wq[i];
+      request.set_platefile_id(1);
+      request.mutable_header()->set_col(i);
+      request.mutable_header()->set_row(0);
+      request.mutable_header()->set_level(0);
+      request.mutable_header()->set_transaction_id(1);
+      request.mutable_record()->set_blob_id(0);
+      request.mutable_record()->set_blob_offset(i);
+      client.WriteUpdate(0, &request, &wa[i], done);
+    } else {
+      tq[i].set_value(i);
+      client.TestRequest(0, &tq[i], &ta[i], done);
+    }
+    client.poll();
+  }
+  client.wait();
+
+  for (size_t i = 0; i < ta.size(); ++i)
+    if (i != ta[i].value())
+      std::cerr << "Error: IndexTestMessage failed!\n";
 }
 
 int main(int argc, char** argv) {
-  Url url;
+  Options opt;
 
-  po::options_description general_options("AMQP Performance Test Program");
+  po::options_description general_options("Index RPC Performance Test Program");
   general_options.add_options()
-    ("url,u", po::value(&url), "Run requests against this index url.")
+    ("url,u",     po::value(&opt.url), "Run requests against this index url.")
+    ("local",     "Start an in-process stand-in server on the url (defaults to zmq+inproc://index_perftest)")
+    ("mode",      po::value(&opt.mode)->default_value("sync"), "sync: one request at a time, pipeline: many requests in flight")
+    ("message",   po::value(&opt.message)->default_value("test"), "Message to send [test, write]")
+    ("count",     po::value(&opt.count)->default_value(5000), "Requests per round")
+    ("rounds",    po::value(&opt.rounds)->default_value(0), "Number of rounds to run (0 means forever)")
+    ("in-flight", po::value(&opt.in_flight)->default_value(RpcPipeline::DEFAULT_IN_FLIGHT), "Frames in flight (pipeline mode)")
+    ("batch",     po::value(&opt.batch)->default_value(1), "Requests to pack into each frame (pipeline mode)")
     ("help,h", "Display this help message");
 
   po::variables_map vm;
@@ -48,26 +164,48 @@ int main(int argc, char** argv) {
     return 0;
   }
 
-  boost::scoped_ptr<IndexClient> client(conn(url));
+  opt.local = vm.count("local");
+  if (opt.local && !vm.count("url"))
+    opt.url = Url("zmq+inproc://index_perftest");
 
-  uint64 t0, t1;
-
-  while (1) {
-    t0 = Stopwatch::microtime();
-
-    for (size_t i = 0; i < BATCH_SIZE; i++) {
-      IndexTestRequest request;
-      request.set_value(i);
-
-      IndexTestReply response;
-      client->TestRequest(client.get(), &request, &response, null_callback());
+  if ((opt.mode != "sync" && opt.mode != "pipeline") || (opt.message != "test" && opt.message != "write") || opt.count == 0) {
+    std::cerr << usage.str();
+    return 1;
+  }
 
-      if (i != response.value())
-        std::cerr << "Error: IndexTestMessage failed!\n";
+  boost::scoped_ptr<RpcServer<IndexService> > server;
+  if (opt.local) {
+    std::cerr << "Starting stand-in index server at " << opt.url.string() << std::endl;
+    server.reset(new RpcServer<IndexService>(opt.url, new StandInService()));
+    if (server->error()) {
+      std::cerr << "Could not start stand-in server: " << server->error() << std::endl;
+      return 1;
     }
+  }
 
-    t1 = Stopwatch::microtime();
-    std::cout << 1000000. * float(BATCH_SIZE) / float(t1-t0) << " msg/s" << std::endl;
+  std::cerr << "Connecting to index server at " << opt.url.string() << std::endl;
+  boost::scoped_ptr<IndexClient>   client;
+  boost::scoped_ptr<IndexPipeline> pipeline;
+  if (opt.mode == "sync")
+    client.reset(new IndexClient(opt.url));
+  else
+    pipeline.reset(new IndexPipeline(opt.url, opt.in_flight, opt.batch));
+
+  for (uint32 round = 0; opt.rounds == 0 || round < opt.rounds; ++round) {
+    LatencyLog log(opt.count);
+
+    uint64 t0 = Stopwatch::microtime();
+    if (client)
+      run_sync(opt, *client, log);
+    else
+      run_pipeline(opt, *pipeline, log);
+    uint64 t1 = Stopwatch::microtime();
+
+    log.report(std::cout, t1-t0);
   }
-}
 
+  if (server)
+    std::cerr << "Server handled " << server->stats().get("msgs") << " messages in "
+              << server->stats().get("batches") << " batches" << std::endl;
+  return 0;
+}
@@ -143,6 +143,12 @@ const char* is_gt_zero(int arg) {
   return NULL;
 }
 
+const char* is_ge_zero(int arg) {
+  if (arg < 0)
+    return "Expected a number greater than or equal to zero";
+  return NULL;
+}
+
 const char* noop(const char* arg) {
   (void)arg;
   return NULL;
@@ -154,6 +160,10 @@ ADD_INT_CONFIG(index_timeout, is_gt_zero);
 ADD_INT_CONFIG(index_tries, is_gt_zero);
 ADD_FLAG_CONFIG(unknown_resync);
 ADD_FLAG_CONFIG(use_blob_cache);
+ADD_INT_CONFIG(tile_cache_mb, is_ge_zero);
+ADD_INT_CONFIG(tile_cache_max_tile, is_ge_zero);
+ADD_FLAG_CONFIG(use_zero_copy);
+ADD_FLAG_CONFIG(serve_blobs);
 ADD_STRING_CONFIG(index_url, noop);
 
 static const command_rec my_cmds[] = {
@@ -166,6 +176,10 @@ static const command_rec my_cmds[] = {
   AP_INIT_TAKE2("PlateAlias",         handle_alias,          NULL, RSRC_CONF, "Name-to-platefile_id mappings"),
   AP_INIT_FLAG("PlateUnknownResync",  handle_unknown_resync, NULL, RSRC_CONF, "Should we resync the platefile list when someone asks for an unknown one?"),
   AP_INIT_FLAG("PlateBlobCache",      handle_use_blob_cache, NULL, RSRC_CONF, "Should the blob cache be used?"),
+  AP_INIT_TAKE1("PlateTileCacheSize",    handle_tile_cache_mb,       NULL, RSRC_CONF, "Size (in MB) of the tile cache shared by all children (default 0, disabled)"),
+  AP_INIT_TAKE1("PlateTileCacheMaxTile", handle_tile_cache_max_tile, NULL, RSRC_CONF, "Tiles larger than this many bytes only have their index lookup cached"),
+  AP_INIT_FLAG("PlateZeroCopy",       handle_use_zero_copy,  NULL, RSRC_CONF, "Always send tile bodies straight from the blob with sendfile"),
+  AP_INIT_FLAG("PlateServeBlobs",     handle_serve_blobs,    NULL, RSRC_CONF, "Allow whole blobs to be downloaded (with Range support) for mirroring"),
   { NULL }
 };
 
@@ -183,6 +197,10 @@ static void* create_plate_config(apr_pool_t* p, server_rec* s) {
   conf->alias = apr_table_make(p, 4);
   conf->unknown_resync = 1;
   conf->use_blob_cache = 1;
+  conf->tile_cache_mb  = 0;
+  conf->tile_cache_max_tile = 64*1024;
+  conf->use_zero_copy  = 0;
+  conf->serve_blobs    = 0;
   return conf;
   // This is the default config file
 #if 0
@@ -192,6 +210,10 @@ static void* create_plate_config(apr_pool_t* p, server_rec* s) {
   PlateIndexTries 3
   PlateUnknownResync on
   PlateBlobCache on
+  PlateTileCacheSize 0
+  PlateTileCacheMaxTile 65536
+  PlateZeroCopy off
+  PlateServeBlobs off
 #endif
 
 // these keys not set by default, but here are examples of possible valid ones
@@ -200,6 +222,11 @@ static void* create_plate_config(apr_pool_t* p, server_rec* s) {
   PlateServerName http://198.10.124.50
   PlateAlias hirise 123456789
 #endif
+
+// The shared tile cache is off unless given a size; this enables a 64MB one
+#if 0
+  PlateTileCacheSize 64
+#endif
 }
 
 plate_config* get_plate_config_mutable(server_rec* s) {
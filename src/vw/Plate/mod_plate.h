@@ -37,6 +37,10 @@ typedef struct {
   int index_tries;
   int unknown_resync;
   int use_blob_cache;
+  int tile_cache_mb;         // size of the shared tile cache (0, the default, disables it)
+  int tile_cache_max_tile;   // largest tile (in bytes) whose data is cached
+  int use_zero_copy;         // always sendfile tile bodies (never copy them into the cache)
+  int serve_blobs;           // allow whole blobs to be fetched (for mirroring)
   apr_array_header_t *rules; // This holds rule_entries
   apr_table_t *alias;        // key is name, value is id, an int stored as a const char*
 } plate_config;
@@ -13,6 +13,7 @@
 #include <apr_tables.h>
 #include <vw/Core/Settings.h>
 #include <vw/Plate/detail/Index.h>
+#include <vw/Plate/detail/SharedTileCache.h>
 #include <vw/Plate/Blob.h>
 #include <vw/Plate/Rpc.h>
 #include <vw/Plate/IndexService.pb.h>
@@ -100,12 +101,25 @@ string PlateModule::get_servername() const {
   return m_conf->servername;
 }
 
+bool PlateModule::zero_copy() const {
+  return m_conf->use_zero_copy;
+}
+
+bool PlateModule::serve_blobs() const {
+  return m_conf->serve_blobs;
+}
+
 const Url& PlateModule::get_base_url() const {
   return m_base_url;
 }
 
 namespace {
   boost::shared_ptr<PlateModule> mod_plate_ptr;
+  boost::shared_ptr<detail::SharedTileCache> tile_cache_ptr;
+}
+
+detail::SharedTileCache* PlateModule::tile_cache() const {
+  return tile_cache_ptr.get();
 }
 
 const PlateModule& mod_plate() {
@@ -122,6 +136,13 @@ void mod_plate_init(const plate_config *conf) {
   mod_plate_ptr.reset(new PlateModule(conf));
 }
 
+void mod_plate_tile_cache_init(const plate_config *conf) {
+  // post_config runs again on every restart; drop the old mapping first.
+  tile_cache_ptr.reset();
+  if (conf->tile_cache_mb > 0)
+    tile_cache_ptr.reset(new detail::SharedTileCache(size_t(conf->tile_cache_mb) * 1024 * 1024, conf->tile_cache_max_tile));
+}
+
 PlateModule::PlateModule(const plate_config* conf)
   : m_connected(false), m_conf(conf), m_base_url(conf->index_url)
 {
@@ -167,7 +188,7 @@ int PlateModule::operator()(const ApacheRequest& r) const {
   if (r.url.empty())
     return DECLINED;
 
-  static const Handler Handlers[] = {handle_image, handle_wtml};
+  static const Handler Handlers[] = {handle_image, handle_wtml, handle_blob};
 
   BOOST_FOREACH(const Handler h, Handlers) {
     int ret = h(r);
@@ -186,6 +207,17 @@ int PlateModule::status(const ApacheRequest& r, int /*flags*/) const {
 
   out << "BlobCacheSize: " << get_blob_cache().size() << "<br>";
 
+  if (const detail::SharedTileCache* cache = tile_cache()) {
+    detail::SharedTileCache::Stats s = cache->stats();
+    out << "TileCache:<br>" << std::endl
+        << "Slots: "     << s.slots     << " (tile data up to " << s.max_tile << " bytes)<br>"
+        << "Hits: "      << s.hits      << "<br>"
+        << "Misses: "    << s.misses    << "<br>"
+        << "Inserts: "   << s.inserts   << "<br>"
+        << "Evictions: " << s.evictions << "<br>";
+  } else
+    out << "TileCache: disabled<br>";
+
   return OK;
 }
 
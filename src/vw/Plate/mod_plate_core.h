@@ -24,6 +24,7 @@ namespace platefile {
 
 namespace detail {
   class Index;
+  class SharedTileCache;
 }
 
 class ReadBlob;
@@ -75,8 +76,13 @@ class PlateModule {
     std::string get_dem() const;
     bool allow_resync() const;
     std::string get_servername() const;
+    bool zero_copy() const;
+    bool serve_blobs() const;
     const Url& get_base_url() const;
 
+    // The tile cache shared by every child, or null if it's disabled.
+    detail::SharedTileCache* tile_cache() const;
+
   private:
     boost::shared_ptr<IndexClient> m_client;
 
@@ -93,6 +99,10 @@ const PlateModule& mod_plate();
 PlateModule& mod_plate_mutable();
 void mod_plate_init(const plate_config *conf);
 
+// Creates the shared tile cache. Must be called in the parent (before the
+// children fork) for the children to share it.
+void mod_plate_tile_cache_init(const plate_config *conf);
+
 }} // namespace vw::platefile
 
 #endif
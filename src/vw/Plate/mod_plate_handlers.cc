@@ -12,6 +12,7 @@
 
 #include <vw/Plate/Blob.h>
 #include <vw/Plate/detail/Index.h>
+#include <vw/Plate/detail/SharedTileCache.h>
 #include <vw/Plate/Exception.h>
 
 #include <httpd.h>
@@ -23,6 +24,7 @@
 
 #include <boost/regex.hpp>
 #include <boost/foreach.hpp>
+#include <boost/numeric/conversion/cast.hpp>
 
 using namespace vw;
 using namespace vw::platefile;
@@ -30,6 +32,58 @@ using namespace vw::platefile::detail;
 
 using std::string;
 
+namespace {
+  int send_buffer(const ApacheRequest& r, const std::vector<uint8>& data) {
+    ap_set_content_length(r.writer(), data.size());
+    if (data.empty())
+      return OK;
+
+    int sent = ap_rwrite(&data[0], boost::numeric_cast<int>(data.size()), r.writer());
+    if (sent < 0)
+      vw_throw(ServerError() << "ap_rwrite failed");
+    else if (size_t(sent) != data.size())
+      vw_throw(ServerError() << "ap_rwrite: short write (expected to send " << data.size() << " bytes, but only sent " << sent);
+    return OK;
+  }
+
+  // Hand the file region to apache as a file bucket. That lets the core
+  // output filter use sendfile(2), and lets the byterange filter answer
+  // Range requests without us touching the data.
+  int send_file(const ApacheRequest& r, const string& filename, vw::uint64 offset, vw::uint64 size) {
+    apr_file_t *fd = 0;
+    // Open the blob as an apache file with raii (so it goes away when we return)
+    raii file_opener(
+        boost::bind(apr_file_open, &fd, filename.c_str(), APR_READ|APR_FOPEN_SENDFILE_ENABLED, 0, r.writer()->pool),
+        boost::bind(apr_file_close, boost::ref(fd)));
+
+    if (!fd)
+      vw_throw(ServerError() << "Could not open " << filename);
+
+    ap_set_content_length(r.writer(), size);
+
+    size_t sent;
+    apr_status_t ap_ret;
+
+    if ((ap_ret = ap_send_fd(fd, r.writer(), offset, size, &sent)) != APR_SUCCESS) {
+      char buf[256];
+      apr_strerror(ap_ret, buf, 256);
+      vw_throw(ServerError() << "ap_send_fd failed: " << buf);
+    }
+    else if (sent != size)
+      vw_throw(ServerError() << "ap_send_fd: short write (expected to send " << size << " bytes, but only sent " << sent);
+
+    return OK;
+  }
+
+  // Sets the ETag and checks the conditional request headers against it.
+  // Returns OK if the body should be sent, or the status (usually 304) to
+  // answer with instead.
+  int check_etag(const ApacheRequest& r, const string& etag) {
+    apr_table_setn(r.writer()->headers_out, "ETag", apr_pstrdup(r.writer()->pool, etag.c_str()));
+    return ap_meets_conditions(r.writer());
+  }
+}
+
 int vw::platefile::handle_image(const ApacheRequest& r) {
   static const boost::regex match_regex("/(\\w+)/(\\d+)/(\\d+)/(\\d+)\\.(\\w+)$");
 
@@ -59,6 +113,11 @@ int vw::platefile::handle_image(const ApacheRequest& r) {
 
   // --------------  Access Plate Index -----------------
 
+  SharedTileCache* cache = mod_plate().tile_cache();
+  SharedTileCache::Key cache_key;
+  bool cached = false, cached_data = false;
+  std::vector<uint8> tile_data;
+
   IndexRecord idx_record;
   try {
     int transaction_id = r.args.get("transaction_id", int(-1));
@@ -71,8 +130,16 @@ int vw::platefile::handle_image(const ApacheRequest& r) {
       exact = false;
     }
 
-    mod_plate().logger(VerboseDebugMessage) << "Sending tile read_request with transaction[" << transaction_id << "] and exact[" << exact << "]" << std::endl;;
-    idx_record = index.index->read_request(col,row,level,transaction_id,exact);
+    // The key uses the resolved transaction, so new transactions never see
+    // stale entries.
+    cache_key = SharedTileCache::Key(id, level, col, row, transaction_id, exact);
+    if (cache)
+      cached = cache->lookup(cache_key, idx_record, cached_data, tile_data);
+
+    if (!cached) {
+      mod_plate().logger(VerboseDebugMessage) << "Sending tile read_request with transaction[" << transaction_id << "] and exact[" << exact << "]" << std::endl;;
+      idx_record = index.index->read_request(col,row,level,transaction_id,exact);
+    }
   } catch(const TileNotFoundErr &) {
     throw;
   } catch (const BadRequest &) {
@@ -105,10 +172,35 @@ int vw::platefile::handle_image(const ApacheRequest& r) {
       apr_table_set(r.writer()->headers_out, "Cache-Control", "max-age=1200");
   }
 
+  // Blobs are append-only, so the blob location names the tile bytes exactly.
+  // (The resolved transaction isn't included: it moves every time the
+  // cursor does, even if this tile didn't change.)
+  {
+    std::ostringstream etag;
+    etag << "\"" << id << "-" << idx_record.blob_id() << "-" << idx_record.blob_offset() << "\"";
+    int ret = check_etag(r, etag.str());
+    if (ret != OK) {
+      if (cache && !cached)
+        cache->insert(cache_key, idx_record);
+      return ret;
+    }
+  }
+
   // This is as far as we can go without making the request heavyweight. Bail
   // out on a header request now.
-  if (r.header_only())
+  if (r.header_only()) {
+    if (cache && !cached)
+      cache->insert(cache_key, idx_record);
     return OK;
+  }
+
+  // Bodies go out through send_file() (sendfile(2) where apache can) unless
+  // the shared tile cache is on and PlateZeroCopy is off: then tiles small
+  // enough to cache are copied into it and sent from memory.
+  if (cached_data) {
+    mod_plate().logger(VerboseDebugMessage) << "Serving tile from the shared tile cache" << std::endl;
+    return send_buffer(r, tile_data);
+  }
 
   // These are the sendfile(2) parameters
   string filename;
@@ -123,31 +215,80 @@ int vw::platefile::handle_image(const ApacheRequest& r) {
     // And calculate the sendfile(2) parameters
     blob->read_sendfile(idx_record.blob_offset(), filename, offset, size);
 
+    // Small tiles go into the shared cache whole (unless we're in zero-copy
+    // mode); everything else just gets its index record remembered.
+    if (cache) {
+      if (!mod_plate().zero_copy() && size <= cache->max_tile()) {
+        TileData data = blob->read_data(idx_record.blob_offset());
+        cache->insert(cache_key, idx_record, data->empty() ? 0 : &data->operator[](0), data->size());
+        tile_data.swap(*data);
+        cached_data = true;
+      } else if (!cached)
+        cache->insert(cache_key, idx_record);
+    }
+
   } catch (const vw::Exception& e) {
     vw_throw(ServerError() << "Could not load blob data: " << e.what());
   }
 
-  apr_file_t *fd = 0;
-  // Open the blob as an apache file with raii (so it goes away when we return)
-  raii file_opener(
-      boost::bind(apr_file_open, &fd, filename.c_str(), APR_READ|APR_FOPEN_SENDFILE_ENABLED, 0, r.writer()->pool),
-      boost::bind(apr_file_close, boost::ref(fd)));
-
-  ap_set_content_length(r.writer(), size);
+  if (cached_data)
+    return send_buffer(r, tile_data);
 
   // Use sendfile (if available) to send the proper tile data
-  size_t sent;
-  apr_status_t ap_ret;
+  return send_file(r, filename, offset, size);
+}
+
+int vw::platefile::handle_blob(const ApacheRequest& r) {
+  static const boost::regex match_regex("/(\\w+)/plate_(\\d+)\\.blob$");
+
+  boost::smatch match;
+  if (!boost::regex_search(r.url, match, match_regex))
+    return DECLINED;
+
+  if (!mod_plate().serve_blobs())
+    return DECLINED;
+
+  mod_plate_mutable().connect_index();
 
-  if ((ap_ret = ap_send_fd(fd, r.writer(), offset, size, &sent) != APR_SUCCESS)) {
-    char buf[256];
-    apr_strerror(ap_ret, buf, 256);
-    vw_throw(ServerError() << "ap_send_fd failed: " << buf);
+  const string& sid = match[1];
+  uint32 blob_id = boost::lexical_cast<uint32>(match[2]);
+
+  mod_plate().logger(DebugMessage) << "Request Blob: id[" << sid << "] blob[" << blob_id << "]" << std::endl;
+
+  const PlateModule::IndexCacheEntry& index = mod_plate().get_index(sid);
+  int id = index.index->index_header().platefile_id();
+
+  std::ostringstream ostr;
+  ostr << index.filename << "/plate_" << blob_id << ".blob";
+  const string filename = ostr.str();
+
+  apr_finfo_t finfo;
+  if (apr_stat(&finfo, filename.c_str(), APR_FINFO_SIZE|APR_FINFO_MTIME|APR_FINFO_TYPE, r.writer()->pool) != APR_SUCCESS || finfo.filetype != APR_REG)
+    vw_throw(UnknownBlob() << "No blob " << blob_id << " in platefile " << sid);
+
+  ap_set_content_type(r.writer(), "application/octet-stream");
+  apr_table_set(r.writer()->headers_out, "Cache-Control", "no-cache");
+
+  // A blob only ever grows, so (size, mtime) identifies its contents. The
+  // mirror can resume with If-Range/Range against this.
+  ap_update_mtime(r.writer(), finfo.mtime);
+  ap_set_last_modified(r.writer());
+  {
+    std::ostringstream etag;
+    etag << "\"" << id << "-blob" << blob_id << "-" << finfo.size << "-" << finfo.mtime << "\"";
+    int ret = check_etag(r, etag.str());
+    if (ret != OK)
+      return ret;
   }
-  else if (sent != size)
-    vw_throw(ServerError() << "ap_send_fd: short write (expected to send " << size << " bytes, but only sent " << sent);
 
-  return OK;
+  if (r.header_only()) {
+    ap_set_content_length(r.writer(), finfo.size);
+    return OK;
+  }
+
+  // Send the size we stat'd, even if the blob grew since: every prefix of a
+  // blob is valid.
+  return send_file(r, filename, 0, finfo.size);
 }
 
 int vw::platefile::handle_wtml(const ApacheRequest& r) {
@@ -232,6 +373,10 @@ extern "C" int mod_plate_handler(request_rec *r) {
     // Valid format, but not there
     ap_log_rerror(APLOG_MARK, APLOG_NOTICE, 0, r,  "Platefile not found: %s", e.what());
     return HTTP_NOT_FOUND;
+  } catch (const UnknownBlob& e) {
+    // Valid format, but not there
+    ap_log_rerror(APLOG_MARK, APLOG_NOTICE, 0, r,  "Blob not found: %s", e.what());
+    return HTTP_NOT_FOUND;
   } catch (const ServerError& e) {
     // Something screwed up, but we controlled it
     ap_log_rerror(APLOG_MARK, APLOG_ERR, 0, r,  "Server Error [recovered]: %s", e.what());
@@ -291,5 +436,13 @@ extern "C" int mod_plate_post_config(apr_pool_t* /*pconf*/, apr_pool_t* /*plog*/
     return HTTP_INTERNAL_SERVER_ERROR;
   }
 
+  // The tile cache has to exist before the children fork so they all share it.
+  try {
+    mod_plate_tile_cache_init(conf);
+  } catch (const std::exception& e) {
+    fprintf(stderr, "mod_plate could not create the shared tile cache: %s\n", e.what());
+    return HTTP_INTERNAL_SERVER_ERROR;
+  }
+
   return OK;
 }
@@ -18,6 +18,7 @@ class ApacheRequest;
 
 int handle_image(const ApacheRequest& r);
 int  handle_wtml(const ApacheRequest& r);
+int  handle_blob(const ApacheRequest& r);
 
 }} // namespace vw::platefile
 
@@ -31,6 +31,7 @@ VW_DEFINE_EXCEPTION(PlateException,   Exception);
 VW_DEFINE_EXCEPTION(BadRequest,       PlateException);
 VW_DEFINE_EXCEPTION(ServerError,      PlateException);
 VW_DEFINE_EXCEPTION(UnknownPlatefile, PlateException);
+VW_DEFINE_EXCEPTION(UnknownBlob,      PlateException);
 
 // Returns the const char* as a string, or an empty() string if it's scary in
 // some way.
@@ -8,6 +8,7 @@
 #include <vw/Plate/ToastDem.h>
 #include <vw/Plate/PlateFile.h>
 #include <vw/Plate/TileManipulation.h>
+#include <vw/Plate/TileOrder.h>
 #include <vw/Core/Debugging.h>
 #include <boost/foreach.hpp>
 
@@ -74,6 +75,27 @@ struct Identity : public FilterBase<Identity> {
   }
 };
 
+// Copies the encoded tiles unchanged. Combined with --blob-placement, this
+// rewrites a plate so that nearby tiles share blobs and sit next to each
+// other inside them.
+struct Relayout : public FilterBase<Relayout> {
+#   define lookup(name, type) type name(type data) const { return data; }
+    lookup(mode, string);
+    lookup(tile_size, int);
+    lookup(filetype, string);
+    lookup(pixel_format, PixelFormatEnum);
+    lookup(channel_type, ChannelTypeEnum);
+#   undef lookup
+
+  inline void init(PlateFile& output, const PlateFile& /*input*/, TransactionOrNeg /* input_transaction_id */) { output.write_request(); }
+  inline void fini(PlateFile& output, const PlateFile& /*input*/) { output.write_complete(); }
+
+  inline void operator()( PlateFile& output, const PlateFile& input, int32 col, int32 row, int32 level, TransactionOrNeg input_transaction_id) {
+    std::pair<TileHeader, TileData> tile = input.read(col, row, level, input_transaction_id, true);
+    output.write_update(&tile.second->operator[](0), tile.second->size(), col, row, level, tile.first.filetype());
+  }
+};
+
 struct ToastDem : public FilterBase<ToastDem> {
   string mode(string) const { return "toast_dem"; }
   int tile_size(int)  const { return 32; }
@@ -136,11 +158,13 @@ struct Options {
   ChannelTypeEnum channel_type;
   uint32 bottom_level;
   bool skim_mode;
+  string blob_placement;
+  uint32 blob_placement_level;
 
   string filter;
 
   Options() :
-    tile_size(0), pixel_format(VW_PIXEL_UNKNOWN), channel_type(VW_CHANNEL_UNKNOWN) {}
+    tile_size(0), pixel_format(VW_PIXEL_UNKNOWN), channel_type(VW_CHANNEL_UNKNOWN), blob_placement_level(0) {}
 };
 
 VW_DEFINE_EXCEPTION(Usage, Exception);
@@ -153,7 +177,9 @@ void handle_arguments(int argc, char *argv[], Options& opt) {
     ("file-type",        po::value(&opt.filetype),     "Output file type")
     ("mode",             po::value(&opt.mode),         "Output mode [toast, kml]")
     ("tile-size",        po::value(&opt.tile_size),    "Output size, in pixels")
-    ("filter",           po::value(&opt.filter),       "Filters to run [identity, toast_dem]")
+    ("filter",           po::value(&opt.filter),       "Filters to run [identity, toast_dem, relayout]")
+    ("blob-placement",   po::value(&opt.blob_placement), "How a new output plate assigns tiles to blobs [size, morton, hilbert]")
+    ("blob-placement-level", po::value(&opt.blob_placement_level)->default_value(4), "Level whose tiles each get their own blobs (with morton or hilbert placement)")
     ("bottom-level",     po::value(&opt.bottom_level)->default_value(999), "Bottom level to process")
     ("skim-last-id-only", "Only process the last transaction id from the input")
     ("help,h",           "Display this help message.");
@@ -193,7 +219,23 @@ void run(Options& opt, FilterBase<FilterT>& filter) {
   if (opt.channel_type == VW_CHANNEL_UNKNOWN)
     opt.channel_type = filter.channel_type(input.channel_type());
 
-  PlateFile output(opt.output_name, opt.mode, opt.description, opt.tile_size, opt.filetype, opt.pixel_format, opt.channel_type);
+  IndexHeader hdr;
+  hdr.set_type(opt.mode);
+  hdr.set_description(opt.description);
+  hdr.set_tile_size(opt.tile_size);
+  hdr.set_tile_filetype(opt.filetype);
+  hdr.set_pixel_format(opt.pixel_format);
+  hdr.set_channel_type(opt.channel_type);
+  if (!opt.blob_placement.empty()) {
+    hdr.set_blob_placement(opt.blob_placement);
+    hdr.set_blob_placement_level(opt.blob_placement_level);
+  }
+
+  PlateFile output(opt.output_name, hdr);
+
+  // Feed tiles to the filter in curve order, so that they are written
+  // contiguously into the output blobs.
+  BlobPlacement placement = blob_placement_from_string(output.index_header().blob_placement());
 
   output.transaction_begin("plate2plate, reporting for duty", -1);
 
@@ -228,6 +270,8 @@ void run(Options& opt, FilterBase<FilterT>& filter) {
         tiles = input.search_by_region(level, region1, TransactionRange(0, input.transaction_id()));
       else
         tiles = input.search_by_region(level, region1, TransactionRange(-1));
+      if (placement != PLACE_BY_SIZE)
+        tiles.sort(OrderHeaderByCurve(placement));
 
       //      if (tiles.size() > 0)
       //      std::cout << "\t--> Region " << region1 << " has " << tiles.size() << " tiles.\n";
@@ -269,6 +313,9 @@ int main(int argc, char *argv[])
     } else if (opt.filter == "toast_dem") {
       ToastDem f;
       run(opt, f);
+    } else if (opt.filter == "relayout") {
+      Relayout f;
+      run(opt, f);
     }
   } catch (const Usage& e) {
     std::cout << e.what() << std::endl;
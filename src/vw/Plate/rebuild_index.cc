@@ -26,9 +26,11 @@ namespace fs = boost::filesystem;
 int main( int argc, char *argv[] ) {
 
   std::string filename;
+  uint32 num_threads;
 
   po::options_description general_options("\nRebuild a platefile index.\n");
   general_options.add_options()
+    ("threads,t", po::value(&num_threads)->default_value(0), "Number of threads (one blob per thread). 0 means the vw default.")
     ("help,h", "Display this help message");
 
   po::options_description hidden_options("");
@@ -87,7 +89,7 @@ int main( int argc, char *argv[] ) {
     }
 
     detail::LocalIndex index(filename);
-    index.rebuild_index();
+    index.rebuild_index(num_threads);
 
  }  catch (const vw::Exception& e) {
     std::cout << "An error occured: " << e.what() << "\nExiting.\n\n";
@@ -117,3 +117,44 @@ TEST_F(BlobManagerTest, Scan) {
   EXPECT_EQ(4, bm->blob_size(id2));
   EXPECT_EQ(6, bm->blob_size(id3));
 }
+
+TEST_F(BlobManagerTest, Locality) {
+  ASSERT_EQ( 0, bm->num_blobs() );
+
+  // Each new key gets its own blob
+  uint32 a = bm->request_lock(1),
+         b = bm->request_lock(2);
+  EXPECT_NE(a, b);
+  EXPECT_EQ(1u, bm->blob_locality(a));
+  EXPECT_EQ(2u, bm->blob_locality(b));
+  bm->release_lock(a);
+  bm->release_lock(b);
+
+  // ... and comes back to it once it's unlocked
+  EXPECT_EQ(a, bm->request_lock(1));
+
+  // A second writer with the same key can't share the locked blob
+  uint32 c = bm->request_lock(1);
+  EXPECT_NE(a, c);
+  EXPECT_EQ(1u, bm->blob_locality(c));
+  bm->release_lock(a);
+  bm->release_lock(c);
+  EXPECT_EQ(3, bm->num_blobs());
+
+  // The bindings survive a restart
+  write_to_blob(a, "abc", 3);
+  ASSERT_NO_FATAL_FAILURE();
+  write_to_blob(b, "abc", 3);
+  ASSERT_NO_FATAL_FAILURE();
+  write_to_blob(c, "abc", 3);
+  ASSERT_NO_FATAL_FAILURE();
+
+  bm.reset(new BlobManager(blob_dir));
+  EXPECT_EQ(1u, bm->blob_locality(a));
+  EXPECT_EQ(2u, bm->blob_locality(b));
+  EXPECT_EQ(NO_LOCALITY, bm->blob_locality(4));
+
+  uint32 d = bm->request_lock(2);
+  EXPECT_EQ(b, d);
+  bm->release_lock(d);
+}
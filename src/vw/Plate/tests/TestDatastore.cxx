@@ -10,6 +10,8 @@
 #include <vw/Plate/Datastore.h>
 #include <vw/FileIO/TemporaryFile.h>
 #include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/convenience.hpp>
+#include <boost/foreach.hpp>
 namespace fs = boost::filesystem;
 
 using namespace std;
@@ -193,6 +195,53 @@ TEST_P(IDatastore, Logging) {
   store->error_log()() << "This should produce output" << std::endl;
 }
 
+TEST(Blobstore, CurvePlacement) {
+  TemporaryDir tmpdir(TEST_OBJDIR);
+  Url url;
+  url.scheme("file");
+  url.path(tmpdir.filename() + "/test.plate");
+
+  IndexHeader hdr;
+  hdr.set_tile_size(256);
+  hdr.set_tile_filetype("jpg");
+  hdr.set_pixel_format(VW_PIXEL_RGBA);
+  hdr.set_channel_type(VW_CHANNEL_UINT8);
+  hdr.set_type("test");
+  hdr.set_blob_placement("hilbert");
+  hdr.set_blob_placement_level(1);
+
+  boost::scoped_ptr<Datastore> store;
+  ASSERT_NO_THROW(store.reset(Datastore::open(url, hdr)));
+  EXPECT_EQ("hilbert", store->index_header().blob_placement());
+
+  Transaction id = store->transaction_begin("placement test");
+  boost::scoped_ptr<WriteState> state(store->write_request(id));
+
+  // One tile at the top, and a full level 2 written in row-major order
+  store->write_update(*state, 0, 0, 0, TYPE1, reinterpret_cast<const uint8*>(&vA), sizeof(val_t));
+  for (val_t row = 0; row < 4; ++row)
+    for (val_t col = 0; col < 4; ++col) {
+      val_t v = row * 4 + col;
+      store->write_update(*state, 2, row, col, TYPE1, reinterpret_cast<const uint8*>(&v), sizeof(val_t));
+    }
+
+  store->write_complete(*state);
+  store->transaction_end(id, true);
+
+  // One blob for the top of the pyramid, and one per level-1 quadrant
+  size_t blobs = 0;
+  for (fs::directory_iterator i(url.path()), end; i != end; ++i)
+    if (fs::extension(*i) == ".blob")
+      blobs++;
+  EXPECT_EQ(5u, blobs);
+
+  Datastore::TileSearch r;
+  store->get(r, 2, BBox2u(0,0,4,4), TransactionRange(-1));
+  ASSERT_EQ(16u, r.size());
+  BOOST_FOREACH(const Tile& t, r)
+    EXPECT_EQ(t.hdr.row() * 4 + t.hdr.col(), *reinterpret_cast<val_t*>(&t.data->operator[](0)));
+}
+
 std::vector<string> test_urls() {
   std::vector<string> v;
   v.push_back("file");
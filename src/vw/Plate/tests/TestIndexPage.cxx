@@ -158,3 +158,47 @@ TEST_F(IndexPageTest, Serialization) {
   EXPECT_EQ( rec[2].blob_id(),     out_rec.blob_id() );
   EXPECT_EQ( rec[2].blob_offset(), out_rec.blob_offset() );
 }
+
+TEST_F(IndexPageTest, BulkSet) {
+  typedef IndexPage::bulk_value_type bulk_t;
+  typedef IndexPage::value_type value_t;
+
+  IndexRecord rec[4];
+  for (uint32 i = 0; i < 4; ++i) {
+    rec[i].set_blob_id(i);
+    rec[i].set_blob_offset(1000 + i);
+  }
+
+  // Something already on the page to merge with
+  TileHeader hdr;
+  hdr.set_col(3);
+  hdr.set_row(5);
+  hdr.set_transaction_id(5);
+  page->set(hdr, rec[0]);
+
+  const uint32 elmnt = 5*1024 + 3;
+  std::vector<bulk_t> entries;
+  entries.push_back(bulk_t(elmnt,  value_t(2, rec[1])));
+  entries.push_back(bulk_t(7,      value_t(1, rec[2])));
+  entries.push_back(bulk_t(elmnt,  value_t(9, rec[2])));
+  // Same location and transaction: the later entry wins
+  entries.push_back(bulk_t(elmnt,  value_t(2, rec[3])));
+  page->bulk_set(entries);
+
+  EXPECT_EQ(2, page->sparse_size());
+
+  EXPECT_EQ(2u, page->get(7, 0, -1).blob_id());
+  EXPECT_EQ(2u, page->get(3, 5, -1).blob_id());
+  EXPECT_EQ(0u, page->get(3, 5, 8).blob_id());
+  EXPECT_EQ(3u, page->get(3, 5, 4).blob_id());
+  EXPECT_EQ(3u, page->get(3, 5, 2, true).blob_id());
+  EXPECT_THROW(page->get(3, 5, 1), TileNotFoundErr);
+
+  EXPECT_EQ(3u, page->search_by_location(3, 5, 0, 100).size());
+
+  // And it has to be saved like any other change
+  page->sync();
+  LocalIndexPage page2(page_path,0,0,0,1024,1024);
+  EXPECT_EQ(2, page2.sparse_size());
+  EXPECT_EQ(3u, page2.get(3, 5, 4).blob_id());
+}
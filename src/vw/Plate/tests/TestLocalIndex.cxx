@@ -360,3 +360,39 @@ TEST_F(LocalIndexTiles, ValidTiles) {
   tiles = index->search_by_region(1, BBox2i(0,0,2,2), tid.minimum(), tid.maximum());
   EXPECT_EQ(4, tiles.size());
 }
+
+TEST_F(LocalIndexTiles, Rebuild) {
+  const std::string blob0 = plate_path + "/plate_0.blob",
+                    blob1 = plate_path + "/plate_1.blob";
+
+  uint64 offset[5], dup_offset;
+  {
+    Blob b0(blob0), b1(blob1);
+    for (int i = 0; i < 4; ++i)
+      offset[i] = b0.write(hdrs[i], test_data, test_size);
+    offset[4] = b1.write(hdrs[4], test_data, test_size);
+    // The same tile twice in one blob: the later one should win
+    dup_offset = b1.write(hdrs[4], test_data, test_size);
+  }
+
+  ASSERT_NO_THROW(index->rebuild_index(2));
+
+  EXPECT_EQ(2u, index->num_levels());
+  for (int i = 0; i < 4; ++i) {
+    IndexRecord rec = index->read_request(hdrs[i].col(), hdrs[i].row(), hdrs[i].level(), -1);
+    EXPECT_EQ(0u, rec.blob_id());
+    EXPECT_EQ(offset[i], rec.blob_offset());
+    EXPECT_EQ(hdrs[i].filetype(), rec.filetype());
+  }
+
+  IndexRecord rec = index->read_request(1, 1, 1, -1);
+  EXPECT_EQ(1u, rec.blob_id());
+  EXPECT_NE(offset[4], rec.blob_offset());
+  EXPECT_EQ(dup_offset, rec.blob_offset());
+
+  // The pages made it to disk
+  index.reset(new LocalIndex(plate_path));
+  EXPECT_EQ(2u, index->num_levels());
+  rec = index->read_request(0, 1, 1, -1);
+  EXPECT_EQ(offset[3], rec.blob_offset());
+}
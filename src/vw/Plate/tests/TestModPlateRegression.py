@@ -19,6 +19,7 @@ def parse_args():
     p.add_option('-v', action='store_const', help='Loud',  const=logging.DEBUG, dest='loglevel')
     p.add_option('-w', dest='wtml',     default='http://wwt.nasa.gov/static/wwt_mars.wtml', help='WTML to load [%default]')
     p.add_option('-n', dest='hostport', default=None, help='Replace WTMLs listed hostport')
+    p.add_option('-b', action='store_true', dest='blobs', default=False, help='Server has PlateServeBlobs on')
     global opts, args
     (opts,args) = p.parse_args()
 
@@ -70,23 +71,35 @@ class GetReturn(object):
 def get(url):
     return urllib2.urlopen(url)
 
-def timed_get(url):
-    debug('GET %s' % url)
+class HeadRequest(urllib2.Request):
+    def get_method(self):
+        return 'HEAD'
+
+def timed_get(url, headers={}, head=False):
+    debug('%s %s %s' % (head and 'HEAD' or 'GET', url, headers))
     from time import time
     start = time()
     try:
-        r = urllib2.urlopen(url)
+        if head:
+            r = urllib2.urlopen(HeadRequest(url, headers=headers))
+        else:
+            r = urllib2.urlopen(urllib2.Request(url, headers=headers))
     except urllib2.HTTPError, e:
-        return GetReturn(code=e.code, data=None, headers=None, time=time()-start)
+        return GetReturn(code=e.code, data=None, headers=e.headers, time=time()-start)
 
-    return GetReturn(code=200, data=r.read(), headers=r.headers, time=time()-start)
+    return GetReturn(code=r.code, data=r.read(), headers=r.headers, time=time()-start)
 
-def tile_get(url_template, level, col, row, dem=False):
+def tile_get(url_template, level, col, row, dem=False, headers={}):
     if dem:
         url = url_template.replace('{0}', str(level)).replace('{1}', str(col)).replace('{2}', str(row))
     else:
         url = url_template.replace('{1}', str(level)).replace('{2}', str(col)).replace('{3}', str(row))
-    return timed_get(url)
+    return timed_get(url, headers)
+
+def blob_get(url_template, blob_id, headers={}, head=False):
+    # Blobs live next to the tiles: /<platefile id>/plate_<blob id>.blob
+    url = url_template[:url_template.index('/{')] + '/plate_%d.blob' % blob_id
+    return timed_get(url, headers, head)
 
 '''
 compare against cached proper root tile
@@ -124,6 +137,55 @@ class TestPlate(unittest.TestCase):
         r = tile_get(self.Url, level=0, col=0, row=0)
         self.good_request(r)
         self.content_type(r, self.Url)
+    def test_etag(self):
+        r = tile_get(self.Url, level=0, col=0, row=0)
+        self.good_request(r)
+        etag = r.headers.get('ETag')
+        self.assertTrue(etag)
+        r = tile_get(self.Url, level=0, col=0, row=0, headers={'If-None-Match': etag})
+        self.assertEqual(304, r.code)
+        r = tile_get(self.Url, level=0, col=0, row=0, headers={'If-None-Match': '"not-the-etag"'})
+        self.good_request(r)
+    def test_range(self):
+        whole = tile_get(self.Url, level=0, col=0, row=0)
+        self.good_request(whole)
+        r = tile_get(self.Url, level=0, col=0, row=0, headers={'Range': 'bytes=1-4'})
+        self.assertEqual(206, r.code)
+        self.assertEqual(whole.data[1:5], r.data)
+    def test_blob(self):
+        if not opts.blobs:
+            return
+        r = blob_get(self.Url, 0)
+        self.assertEqual(200, r.code)
+        self.assertTrue(len(r.data) > 0)
+        self.assertEqual('application/octet-stream', r.headers['Content-Type'])
+        etag = r.headers.get('ETag')
+        self.assertTrue(etag)
+        h = blob_get(self.Url, 0, head=True)
+        self.assertEqual(200, h.code)
+        self.assertEqual('', h.data)
+        self.assertEqual(str(len(r.data)), h.headers['Content-Length'])
+        self.assertEqual(etag, h.headers.get('ETag'))
+        self.assertEqual(304, blob_get(self.Url, 0, headers={'If-None-Match': etag}).code)
+        self.assertEqual(200, blob_get(self.Url, 0, headers={'If-None-Match': '"not-the-etag"'}).code)
+    def test_blob_range(self):
+        if not opts.blobs:
+            return
+        whole = blob_get(self.Url, 0)
+        self.assertEqual(200, whole.code)
+        r = blob_get(self.Url, 0, headers={'Range': 'bytes=1-4'})
+        self.assertEqual(206, r.code)
+        self.assertEqual(whole.data[1:5], r.data)
+        r = blob_get(self.Url, 0, headers={'Range': 'bytes=1-4', 'If-None-Match': whole.headers['ETag']})
+        self.assertEqual(304, r.code)
+    def test_blob_disabled(self):
+        if opts.blobs:
+            return
+        # Declined, so nothing else answers it either
+        r = blob_get(self.Url, 0)
+        self.assertEqual(404, r.code)
+        r = blob_get(self.Url, 0, head=True)
+        self.assertEqual(404, r.code)
     def test_out_of_range(self):
         r = tile_get(self.Url, level=self.NumLevels, col=0, row=0)
         self.assertEqual(404, r.code)
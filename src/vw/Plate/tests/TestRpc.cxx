@@ -9,6 +9,7 @@
 #include <test/Helpers.h>
 #include <vw/Plate/Rpc.h>
 #include <vw/Plate/RpcChannel.h>
+#include <vw/Plate/RpcPipeline.h>
 #include <vw/Plate/HTTPUtils.h>
 #include <vw/Plate/Exception.h>
 #include <vw/Plate/tests/TestRpcService.pb.h>
@@ -136,6 +137,73 @@ TEST_P(RpcTest, Err) {
   EXPECT_EQ(1, server->stats().get("server_error"));
 }
 
+namespace {
+  struct CountCalls {
+    uint32 count;
+    CountCalls() : count(0) {}
+    void done() { count++; }
+  };
+}
+
+TEST_P(RpcTest, Pipelined) {
+  ASSERT_NO_FATAL_FAILURE(make_server());
+  RpcPipelineClient<TestService> client(GetParam(), 8);
+  client.set_timeout(TIMEOUT);
+
+  static const uint32 COUNT = 500;
+  vector<DoubleMessage> q(COUNT), a(COUNT);
+  CountCalls calls;
+
+  for (uint32 i = 0; i < COUNT; ++i) {
+    q[i].set_num(i);
+    ASSERT_NO_THROW(client.DoubleRequest(0, &q[i], &a[i], pb::NewCallback(&calls, &CountCalls::done)));
+    ASSERT_NO_THROW(client.poll());
+  }
+  ASSERT_NO_THROW(client.wait());
+  EXPECT_EQ(0u, client.outstanding());
+  EXPECT_EQ(COUNT, calls.count);
+
+  for (uint32 i = 0; i < COUNT; ++i)
+    EXPECT_EQ(i*2, a[i].num());
+  EXPECT_EQ(COUNT, server->stats().get("msgs"));
+}
+
+TEST_P(RpcTest, Batched) {
+  ASSERT_NO_FATAL_FAILURE(make_server());
+  RpcPipelineClient<TestService> client(GetParam(), 4, 10);
+  client.set_timeout(TIMEOUT);
+
+  static const uint32 COUNT = 95;
+  vector<DoubleMessage> q(COUNT), a(COUNT);
+  CountCalls calls;
+
+  for (uint32 i = 0; i < COUNT; ++i) {
+    q[i].set_num(i);
+    ASSERT_NO_THROW(client.DoubleRequest(0, &q[i], &a[i], pb::NewCallback(&calls, &CountCalls::done)));
+  }
+  // the last partial batch goes out here
+  ASSERT_NO_THROW(client.wait());
+  EXPECT_EQ(COUNT, calls.count);
+
+  for (uint32 i = 0; i < COUNT; ++i)
+    EXPECT_EQ(i*2, a[i].num());
+  EXPECT_EQ(COUNT, server->stats().get("msgs"));
+  EXPECT_EQ(10, server->stats().get("batches"));
+
+  // A failed call in a batch doesn't take its neighbors down with it
+  DoubleMessage eq[3], ea[3];
+  eq[0].set_num(1);
+  eq[1].set_num(TestServiceImpl::CLIENT_ERROR);
+  eq[2].set_num(2);
+  for (uint32 i = 0; i < 3; ++i)
+    client.DoubleRequest(0, &eq[i], &ea[i], pb::NewCallback(&calls, &CountCalls::done));
+  EXPECT_THROW(client.wait(), PlatefileErr);
+  EXPECT_EQ(COUNT+3, calls.count);
+  EXPECT_EQ(2, ea[0].num());
+  EXPECT_EQ(4, ea[2].num());
+  EXPECT_EQ(1, server->stats().get("client_error"));
+}
+
 TEST(TestRpc, HAS_ZEROMQ(KillServerDeathTest)) {
   Url u("zmq+ipc://" TEST_OBJDIR "/unittest2");
   Server server;
@@ -0,0 +1,148 @@
+// __BEGIN_LICENSE__
+// Copyright (C) 2006-2011 United States Government as represented by
+// the Administrator of the National Aeronautics and Space Administration.
+// All Rights Reserved.
+// __END_LICENSE__
+
+
+#include <gtest/gtest.h>
+#include <test/Helpers.h>
+#include <vw/Plate/detail/SharedTileCache.h>
+#include <vw/Plate/IndexDataPrivate.pb.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace vw;
+using namespace vw::platefile;
+using namespace vw::platefile::detail;
+
+typedef SharedTileCache::Key Key;
+
+namespace {
+  IndexRecord make_record(uint32 blob_id, uint64 offset, const std::string& filetype = "png") {
+    IndexRecord rec;
+    rec.set_blob_id(blob_id);
+    rec.set_blob_offset(offset);
+    rec.set_filetype(filetype);
+    return rec;
+  }
+}
+
+TEST(SharedTileCache, InsertLookup) {
+  SharedTileCache cache(64*1024, 256);
+
+  IndexRecord rec;
+  bool has_data = true;
+  std::vector<uint8> data;
+
+  Key k(1, 3, 4, 5, 10, false);
+  EXPECT_FALSE(cache.lookup(k, rec, has_data, data));
+
+  const uint8 tile[] = {1,2,3,4,5};
+  EXPECT_TRUE(cache.insert(k, make_record(7, 1024), tile, sizeof(tile)));
+
+  ASSERT_TRUE(cache.lookup(k, rec, has_data, data));
+  EXPECT_EQ(7u,    rec.blob_id());
+  EXPECT_EQ(1024u, rec.blob_offset());
+  EXPECT_EQ("png", rec.filetype());
+  ASSERT_TRUE(has_data);
+  ASSERT_EQ(sizeof(tile), data.size());
+  EXPECT_RANGE_EQ(tile+0, tile+sizeof(tile), data.begin(), data.end());
+
+  // Any part of the key differing is a miss
+  EXPECT_FALSE(cache.lookup(Key(2, 3, 4, 5, 10, false), rec, has_data, data));
+  EXPECT_FALSE(cache.lookup(Key(1, 3, 4, 5, 11, false), rec, has_data, data));
+  EXPECT_FALSE(cache.lookup(Key(1, 3, 4, 5, 10, true),  rec, has_data, data));
+
+  SharedTileCache::Stats s = cache.stats();
+  EXPECT_EQ(1u, s.hits);
+  EXPECT_EQ(4u, s.misses);
+  EXPECT_EQ(1u, s.inserts);
+  EXPECT_EQ(0u, s.evictions);
+}
+
+TEST(SharedTileCache, RecordOnly) {
+  SharedTileCache cache(64*1024, 16);
+
+  IndexRecord rec;
+  bool has_data = true;
+  std::vector<uint8> data(3);
+
+  // Too big for a slot: keep the record, drop the bytes
+  std::vector<uint8> big(17, 42);
+  Key k(1, 0, 0, 0, 1, false);
+  EXPECT_TRUE(cache.insert(k, make_record(1, 24), &big[0], big.size()));
+  ASSERT_TRUE(cache.lookup(k, rec, has_data, data));
+  EXPECT_FALSE(has_data);
+  EXPECT_TRUE(data.empty());
+
+  // Already cached without data, so a record-only insert is a noop...
+  EXPECT_FALSE(cache.insert(k, make_record(1, 24)));
+  // ... but adding data upgrades the slot in place
+  EXPECT_TRUE(cache.insert(k, make_record(1, 24), &big[0], 16));
+  ASSERT_TRUE(cache.lookup(k, rec, has_data, data));
+  EXPECT_TRUE(has_data);
+  EXPECT_EQ(16u, data.size());
+  EXPECT_EQ(0u, cache.stats().evictions);
+
+  // Filetypes have to fit in the slot
+  EXPECT_FALSE(cache.insert(Key(1, 0, 0, 0, 2, false), make_record(1, 24, "averyverylongfiletype")));
+}
+
+TEST(SharedTileCache, Eviction) {
+  SharedTileCache cache(16*1024, 64, 4);
+  const uint64 slots = cache.stats().slots;
+  ASSERT_GT(slots, 0u);
+
+  IndexRecord rec;
+  bool has_data;
+  std::vector<uint8> data;
+
+  // A hot tile that keeps getting looked up should survive a flood of
+  // one-off tiles.
+  Key hot(1, 0, 0, 0, 1, false);
+  EXPECT_TRUE(cache.insert(hot, make_record(99, 24)));
+
+  for (int32 i = 0; i < int32(slots * 4); ++i) {
+    EXPECT_TRUE(cache.lookup(hot, rec, has_data, data));
+    cache.insert(Key(1, 10, i, i, 1, false), make_record(i, 24));
+  }
+
+  EXPECT_TRUE(cache.lookup(hot, rec, has_data, data));
+  EXPECT_EQ(99u, rec.blob_id());
+
+  SharedTileCache::Stats s = cache.stats();
+  EXPECT_GT(s.evictions, 0u);
+  EXPECT_LE(s.inserts - s.evictions, slots);
+}
+
+TEST(SharedTileCache, SharedAcrossFork) {
+  SharedTileCache cache(64*1024, 64);
+
+  const uint8 tile[] = {9,8,7};
+  Key k(5, 1, 1, 0, 3, false);
+
+  pid_t pid = fork();
+  ASSERT_NE(-1, pid);
+  if (pid == 0) {
+    // child: insert and leave without running any gtest teardown
+    bool ok = cache.insert(k, make_record(3, 48), tile, sizeof(tile));
+    _exit(ok ? 0 : 1);
+  }
+
+  int status;
+  ASSERT_EQ(pid, waitpid(pid, &status, 0));
+  ASSERT_TRUE(WIFEXITED(status));
+  ASSERT_EQ(0, WEXITSTATUS(status));
+
+  IndexRecord rec;
+  bool has_data;
+  std::vector<uint8> data;
+  ASSERT_TRUE(cache.lookup(k, rec, has_data, data));
+  EXPECT_EQ(3u,  rec.blob_id());
+  EXPECT_EQ(48u, rec.blob_offset());
+  ASSERT_TRUE(has_data);
+  EXPECT_RANGE_EQ(tile+0, tile+sizeof(tile), data.begin(), data.end());
+  EXPECT_EQ(1u, cache.stats().inserts);
+}
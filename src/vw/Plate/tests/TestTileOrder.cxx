@@ -0,0 +1,95 @@
+// __BEGIN_LICENSE__
+// Copyright (C) 2006-2011 United States Government as represented by
+// the Administrator of the National Aeronautics and Space Administration.
+// All Rights Reserved.
+// __END_LICENSE__
+
+
+#include <gtest/gtest.h>
+#include <test/Helpers.h>
+#include <vw/Plate/TileOrder.h>
+#include <vw/Plate/IndexData.pb.h>
+#include <boost/foreach.hpp>
+#include <set>
+
+using namespace vw;
+using namespace vw::platefile;
+
+TEST(TileOrder, Names) {
+  EXPECT_EQ(PLACE_BY_SIZE,    blob_placement_from_string("size"));
+  EXPECT_EQ(PLACE_BY_MORTON,  blob_placement_from_string("Morton"));
+  EXPECT_EQ(PLACE_BY_HILBERT, blob_placement_from_string("hilbert"));
+  EXPECT_THROW(blob_placement_from_string("peano"), ArgumentErr);
+  EXPECT_EQ("hilbert", blob_placement_name(PLACE_BY_HILBERT));
+}
+
+TEST(TileOrder, Morton) {
+  EXPECT_EQ(0u, morton_index(0,0));
+  EXPECT_EQ(1u, morton_index(1,0));
+  EXPECT_EQ(2u, morton_index(0,1));
+  EXPECT_EQ(3u, morton_index(1,1));
+  EXPECT_EQ(4u, morton_index(2,0));
+  EXPECT_EQ(0xffffffffffffffffULL, morton_index(0xffffffff, 0xffffffff));
+}
+
+TEST(TileOrder, Hilbert) {
+  // The order-1 curve visits (0,0) (0,1) (1,1) (1,0)
+  EXPECT_EQ(0u, hilbert_index(1, 0, 0));
+  EXPECT_EQ(1u, hilbert_index(1, 0, 1));
+  EXPECT_EQ(2u, hilbert_index(1, 1, 1));
+  EXPECT_EQ(3u, hilbert_index(1, 1, 0));
+
+  // The curve visits every cell once, and each step moves to a neighbor
+  const uint32 order = 4, n = 1 << order;
+  std::vector<std::pair<uint32, uint32> > cells(n*n, std::make_pair(n, n));
+  for (uint32 row = 0; row < n; ++row)
+    for (uint32 col = 0; col < n; ++col) {
+      uint64 d = hilbert_index(order, col, row);
+      ASSERT_LT(d, n*n);
+      ASSERT_EQ(n, cells[d].first) << "visited twice: " << d;
+      cells[d] = std::make_pair(col, row);
+    }
+  for (size_t i = 1; i < cells.size(); ++i) {
+    int dc = std::abs(int(cells[i].first)  - int(cells[i-1].first)),
+        dr = std::abs(int(cells[i].second) - int(cells[i-1].second));
+    EXPECT_EQ(1, dc + dr) << "step " << i;
+  }
+}
+
+TEST(TileOrder, Locality) {
+  EXPECT_EQ(NO_LOCALITY, tile_locality(PLACE_BY_SIZE, 3, 3, 5, 2));
+
+  // Everything above the bucket level shares a key
+  EXPECT_EQ(0u, tile_locality(PLACE_BY_HILBERT, 0, 0, 0, 2));
+  EXPECT_EQ(0u, tile_locality(PLACE_BY_HILBERT, 1, 1, 1, 2));
+
+  // Descendants share their ancestor's key
+  std::set<uint64> keys;
+  for (uint32 row = 0; row < 16; ++row)
+    for (uint32 col = 0; col < 16; ++col) {
+      uint64 key = tile_locality(PLACE_BY_MORTON, col, row, 4, 2);
+      EXPECT_EQ(key, tile_locality(PLACE_BY_MORTON, col/4, row/4, 2, 2));
+      EXPECT_EQ(key, tile_locality(PLACE_BY_MORTON, col*2+1, row*2, 5, 2));
+      keys.insert(key);
+    }
+  EXPECT_EQ(16u, keys.size());
+}
+
+TEST(TileOrder, Sort) {
+  std::vector<TileHeader> hdrs;
+  for (uint32 level = 2; level > 0; --level)
+    for (uint32 row = 0; row < (1u << level); ++row)
+      for (uint32 col = 0; col < (1u << level); ++col) {
+        TileHeader h;
+        h.set_col(col); h.set_row(row); h.set_level(level); h.set_transaction_id(1);
+        hdrs.push_back(h);
+      }
+
+  std::sort(hdrs.begin(), hdrs.end(), OrderHeaderByCurve(PLACE_BY_HILBERT));
+  for (size_t i = 1; i < hdrs.size(); ++i) {
+    ASSERT_LE(hdrs[i-1].level(), hdrs[i].level());
+    if (hdrs[i-1].level() == hdrs[i].level())
+      EXPECT_LT(hilbert_index(hdrs[i].level(), hdrs[i-1].col(), hdrs[i-1].row()),
+                hilbert_index(hdrs[i].level(), hdrs[i].col(),   hdrs[i].row()));
+  }
+}
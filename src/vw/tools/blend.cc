@@ -38,12 +38,14 @@ std::string mosaic_name;
 std::string file_type;
 int tile_size;
 bool draft;
+bool reuse_masks;
 bool qtree;
 
 template <class PixelT>
 void do_blend() {
   mosaic::ImageComposite<PixelT> composite;
   if( draft ) composite.set_draft_mode( true );
+  if( reuse_masks ) composite.set_reuse_masks( true );
 
   std::map<std::string,fs::path> image_files;
   std::map<std::string,fs::path> offset_files;
@@ -63,7 +65,7 @@ void do_blend() {
       offset >> x >> y;
       std::cout << "Importing image file " << ifi->second.string()
                 << " at offet (" << x << "," << y << ")" << std::endl;
-      composite.insert( DiskImageView<PixelT>( ifi->second.string() ), x, y );
+      composite.insert( DiskImageView<PixelT>( ifi->second.string() ), x, y, ifi->second.string() );
     }
   }
 
@@ -96,6 +98,7 @@ int main( int argc, char *argv[] ) {
       ("tile-size", po::value<int>(&tile_size)->default_value(256),
        "Tile size, in pixels")
       ("draft", "Draft mode (no blending)")
+      ("reuse-masks", "Keep blending masks from an earlier run whose sources have not changed")
       ("qtree", "Output in quadtree format")
       ("grayscale", "Process in grayscale only")
       ("help,h", "Display this help message");
@@ -125,6 +128,7 @@ int main( int argc, char *argv[] ) {
     }
 
     if( vm.count("draft") ) draft = true; else draft = false;
+    if( vm.count("reuse-masks") ) reuse_masks = true; else reuse_masks = false;
     if( vm.count("qtree") ) qtree = true; else qtree = false;
 
     if( tile_size <= 0 ) {
@@ -0,0 +1,118 @@
+// __BEGIN_LICENSE__
+// Copyright (C) 2006-2011 United States Government as represented by
+// the Administrator of the National Aeronautics and Space Administration.
+// All Rights Reserved.
+// __END_LICENSE__
+
+
+/// \file gdal_read_perftest.cc
+///
+/// Reads every block of an image through DiskImageResourceGDAL with an
+/// increasing number of threads, once holding the global GDAL lock and once
+/// in concurrent read mode, and reports the throughput of each. Point it at
+/// a large tiled GeoTIFF on local disk.
+///
+
+#include <vw/Core/Settings.h>
+#include <vw/Core/Stopwatch.h>
+#include <vw/Core/ThreadPool.h>
+#include <vw/Image/Algorithms.h>
+#include <vw/FileIO/DiskImageResourceGDAL.h>
+
+#include <boost/program_options.hpp>
+#include <boost/foreach.hpp>
+#include <boost/scoped_array.hpp>
+#include <iostream>
+#include <iomanip>
+
+namespace po = boost::program_options;
+using namespace vw;
+
+class ReadBlockTask : public Task {
+    const DiskImageResourceGDAL& m_rsrc;
+    BBox2i m_bbox;
+  public:
+    ReadBlockTask(const DiskImageResourceGDAL& rsrc, BBox2i const& bbox) : m_rsrc(rsrc), m_bbox(bbox) {}
+
+    void operator()() {
+      ImageFormat fmt = m_rsrc.format();
+      fmt.cols = m_bbox.width();
+      fmt.rows = m_bbox.height();
+      boost::scoped_array<uint8> data(new uint8[fmt.byte_size()]);
+      m_rsrc.read(ImageBuffer(fmt, data.get()), m_bbox);
+    }
+};
+
+// Returns MB/s
+double read_all(DiskImageResourceGDAL& rsrc, std::vector<BBox2i> const& blocks, uint32 threads, size_t bytes) {
+  Stopwatch sw;
+  sw.start();
+  {
+    FifoWorkQueue queue(threads);
+    BOOST_FOREACH(BBox2i const& b, blocks)
+      queue.add_task(boost::shared_ptr<Task>(new ReadBlockTask(rsrc, b)));
+    queue.join_all();
+  }
+  sw.stop();
+  return double(bytes) / (1024.*1024.) / sw.elapsed_seconds();
+}
+
+int main( int argc, char *argv[] ) {
+  std::string filename;
+  uint32 max_threads, passes;
+  Vector2i block_size;
+
+  po::options_description general_options("Options");
+  general_options.add_options()
+    ("threads,t", po::value(&max_threads)->default_value(vw_settings().default_num_threads()), "Largest thread count to try (doubling from 1)")
+    ("passes,p",  po::value(&passes)->default_value(3), "Reads per configuration; the best one is reported")
+    ("block-cols", po::value(&block_size[0])->default_value(0), "Read block width (default: the file's block size)")
+    ("block-rows", po::value(&block_size[1])->default_value(0), "Read block height (default: the file's block size)")
+    ("help,h", "Display this help message");
+
+  po::options_description hidden_options("");
+  hidden_options.add_options()
+    ("input-file", po::value(&filename), "Input image");
+
+  po::options_description options("Allowed Options");
+  options.add(general_options).add(hidden_options);
+
+  po::positional_options_description p;
+  p.add("input-file", 1);
+
+  po::variables_map vm;
+  po::store( po::command_line_parser( argc, argv ).options(options).positional(p).run(), vm );
+  po::notify( vm );
+
+  if( vm.count("help") || filename.empty() || max_threads == 0 || passes == 0 ) {
+    std::cout << "Usage: " << argv[0] << " [options] <image>\n\n" << general_options << std::endl;
+    return 1;
+  }
+
+  DiskImageResourceGDAL rsrc(filename);
+  if (block_size[0] <= 0 || block_size[1] <= 0)
+    block_size = rsrc.block_read_size();
+
+  std::vector<BBox2i> blocks = image_blocks(rsrc, block_size[0], block_size[1]);
+  const size_t bytes = rsrc.format().byte_size();
+
+  std::cout << filename << ": " << rsrc.cols() << "x" << rsrc.rows() << ", "
+            << bytes / (1024*1024) << " MB in " << blocks.size() << " blocks of "
+            << block_size[0] << "x" << block_size[1] << "\n"
+            << "(the first pass also warms the OS file cache)\n\n";
+
+  std::cout << std::setw(8) << "threads" << std::setw(14) << "locked MB/s" << std::setw(18) << "concurrent MB/s" << std::endl;
+  for (uint32 threads = 1; threads <= max_threads; threads = (threads == max_threads) ? threads + 1 : std::min(threads * 2, max_threads)) {
+    double locked = 0, concurrent = 0;
+    for (uint32 i = 0; i < passes; ++i) {
+      rsrc.set_concurrent_read(false);
+      locked = std::max(locked, read_all(rsrc, blocks, threads, bytes));
+      rsrc.set_concurrent_read(true);
+      concurrent = std::max(concurrent, read_all(rsrc, blocks, threads, bytes));
+    }
+    std::cout << std::setw(8) << threads << std::fixed << std::setprecision(1)
+              << std::setw(14) << locked << std::setw(18) << concurrent << std::endl;
+  }
+
+  return 0;
+}
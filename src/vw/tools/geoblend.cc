@@ -33,6 +33,8 @@ std::string mosaic_name;
 std::string output_file_type;
 std::string channel_type_str;
 bool draft;
+bool reuse_masks = false;
+bool ignore_alpha = false;
 unsigned int tilesize;
 bool tile_output = false;
 unsigned int patch_size, patch_overlap;
@@ -112,6 +114,7 @@ void do_blend() {
 
   vw::mosaic::ImageComposite<float_pixel_type> composite;
   if( draft ) composite.set_draft_mode( true );
+  if( reuse_masks ) composite.set_reuse_masks( true );
 
   double smallest_x_scale = vw::ScalarTypeLimits<float>::highest();
   double smallest_y_scale = vw::ScalarTypeLimits<float>::highest();
@@ -175,6 +178,18 @@ void do_blend() {
   read_georeference( output_georef, image_files[0] );
   output_georef.set_transform(output_affine);
 
+  // The masks also depend on how the sources are masked and where they
+  // are resampled to, which the composite can't see for itself.
+  std::ostringstream mask_key;
+  mask_key << "nodata-value ";
+  if (has_nodata_value) mask_key << nodata_value;
+  else mask_key << "none";
+  mask_key << "\nignore-alpha " << ignore_alpha
+           << "\npixel type " << pixel_format_name(PixelFormatID<PixelT>::value)
+           << ":" << channel_type_name(ChannelTypeID<typename PixelChannelType<PixelT>::type>::value)
+           << "\n" << output_georef;
+  composite.set_mask_key( mask_key.str() );
+
   tpc.set_progress_text( "Status (assembling): " );
   SubProgressCallback assembling_pc( tpc, 0.05, 0.1 );
   // Second pass: add files to the image composite.
@@ -194,10 +209,10 @@ void do_blend() {
     // missing pixels in DEMs. -mbroxton
     if (has_nodata_value) {
       ImageViewRef<alpha_pixel_type> masked_source = crop( transform( nodata_to_mask(source_disk_image, (typename PixelChannelType<PixelT>::type)(nodata_value) ), trans, ZeroEdgeExtension(), NearestPixelInterpolation() ), output_bbox );
-      composite.insert( channel_cast_rescale<float32>(masked_source), (int)output_bbox.min().x(), (int)output_bbox.min().y() );
+      composite.insert( channel_cast_rescale<float32>(masked_source), (int)output_bbox.min().x(), (int)output_bbox.min().y(), image_files[i] );
     } else {
      ImageViewRef<alpha_pixel_type> masked_source = crop( transform( pixel_cast<alpha_pixel_type>(source_disk_image), trans, ZeroEdgeExtension(), NearestPixelInterpolation() ), output_bbox );
-     composite.insert( channel_cast_rescale<float32>(masked_source), (int)output_bbox.min().x(), (int)output_bbox.min().y() );
+     composite.insert( channel_cast_rescale<float32>(masked_source), (int)output_bbox.min().x(), (int)output_bbox.min().y(), image_files[i] );
     }
 
   }
@@ -287,6 +302,7 @@ int main( int argc, char *argv[] ) {
       ("patch-size", po::value<unsigned int>(&patch_size)->default_value(256), "Patch size for tiled output, in pixels")
       ("patch-overlap", po::value<unsigned int>(&patch_overlap)->default_value(0), "Patch overlap for tiled output, in pixels")
       ("draft", "Draft mode (no blending)")
+      ("reuse-masks", "Keep blending masks from an earlier run whose sources have not changed")
       ("ignore-alpha", "Ignore the alpha channel of the input images, and don't write an alpha channel in output.")
       ("nodata-value", po::value<float>(&nodata_value), "Pixel value to use for nodata in input and output (when there's no alpha channel)")
       ("channel-type", po::value<std::string>(&channel_type_str), "Images' channel type. One of [uint8, uint16, int16, float].")
@@ -327,6 +343,7 @@ int main( int argc, char *argv[] ) {
     if( vm.count("draft") ) {
       draft = true;
     }
+    if( vm.count("reuse-masks") ) reuse_masks = true;
 
     if( vm.count("input-files") < 1 ) {
       std::cerr << "Error: Must specify at least one input file!" << std::endl << std::endl;
@@ -379,6 +396,7 @@ int main( int argc, char *argv[] ) {
     }
 
     if (vm.count("ignore-alpha")) {
+      ignore_alpha = true;
       if (fmt.pixel_format == VW_PIXEL_RGBA)  fmt.pixel_format = VW_PIXEL_RGB;
       if (fmt.pixel_format == VW_PIXEL_GRAYA) fmt.pixel_format = VW_PIXEL_GRAY;
     }
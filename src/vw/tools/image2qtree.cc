@@ -18,6 +18,7 @@
 #include <iostream>
 #include <fstream>
 #include <map>
+#include <algorithm>
 
 #include <boost/program_options.hpp>
 #include <boost/algorithm/string.hpp>
@@ -77,6 +78,7 @@ struct Options {
     output_file_type("png"),
     module_name("", true),
     tile_size(256),
+    num_threads(1),
     jpeg_quality(0, true),
     png_compression(0, true),
     pixel_scale(1),
@@ -98,10 +100,13 @@ struct Options {
   std::vector<string> input_files;
 
   string output_file_name;
+  string manifest_file;
+  std::vector<string> changed_files;
   Tristate<string> output_file_type;
   Tristate<string> module_name;
   Tristate<double> nudge_x, nudge_y;
   Tristate<uint32> tile_size;
+  uint32 num_threads;
   Tristate<float>  jpeg_quality;
   Tristate<uint32> png_compression;
   Tristate<float>  pixel_scale, pixel_offset;
@@ -224,7 +229,11 @@ void do_normal_mosaic(const Options& opt, const ProgressCallback *progress) {
     DiskImageView<PixelT> img(opt.input_files[0]);
     QuadTreeGenerator quadtree(img, opt.output_file_name);
     quadtree.set_tile_size( opt.tile_size );
+    quadtree.set_num_threads( opt.num_threads );
     quadtree.set_file_type( opt.output_file_type );
+    quadtree.set_manifest_file( opt.manifest_file );
+    if( ! opt.changed_files.empty() )
+      quadtree.add_changed_region( bounding_box(img) );
 
     if (opt.mode == Mode::GIGAPAN_NOPROJ) {
       GigapanQuadTreeConfig config;
@@ -361,6 +370,7 @@ void do_mosaic(const Options& opt, const ProgressCallback *progress)
   ImageComposite<PixelT> composite;
 
   // Add the transformed image files to the composite.
+  std::vector<BBox2i> changed_bboxes;
   for(unsigned i=0; i < opt.input_files.size(); i++) {
     const std::string& filename = opt.input_files[i];
     const GeoReference& input_ref = georeferences[i];
@@ -431,14 +441,18 @@ void do_mosaic(const Options& opt, const ProgressCallback *progress)
       }
     }
 
+    bool changed = std::find( opt.changed_files.begin(), opt.changed_files.end(), filename ) != opt.changed_files.end();
+
     // Images that wrap the date line must be added to the composite
     // on both sides.
     if( bbox.max().x() > total_resolution ) {
       composite.insert( source, bbox.min().x()-total_resolution, bbox.min().y() );
+      if( changed ) changed_bboxes.push_back( bbox - Vector2i(total_resolution,0) );
     }
     // Images that are in the 180-360 range *only* go on the other side.
     if( bbox.min().x() < xresolution ) {
       composite.insert( source, bbox.min().x(), bbox.min().y() );
+      if( changed ) changed_bboxes.push_back( bbox );
     }
   }
 
@@ -468,6 +482,9 @@ void do_mosaic(const Options& opt, const ProgressCallback *progress)
   // Prepare the composite.
   if(!opt.multiband)
     composite.set_draft_mode( true );
+  // The quadtree already generates its tiles in parallel
+  if(opt.num_threads != 1)
+    composite.set_num_threads( 1 );
   composite.prepare( total_bbox, *progress );
   VW_ASSERT(composite.rows() > 0 && composite.cols() > 0,
             LogicErr() << "Composite image is empty. Georeference calculation is probably incorrect.");
@@ -508,6 +525,13 @@ void do_mosaic(const Options& opt, const ProgressCallback *progress)
     quadtree.set_tile_size(opt.tile_size);
   if (opt.output_file_type.set())
     quadtree.set_file_type(opt.output_file_type);
+  quadtree.set_num_threads(opt.num_threads);
+
+  // The composite has been shifted so that total_bbox.min() is the
+  // origin, and the changed inputs with it.
+  quadtree.set_manifest_file(opt.manifest_file);
+  for (unsigned i = 0; i < changed_bboxes.size(); i++)
+    quadtree.add_changed_region(changed_bboxes[i] - total_bbox.min());
 
   // This box represents the input data, shifted such that total_bbox.min() is
   // the origin, and cropped to the size of the output resolution.
@@ -553,6 +577,9 @@ int handle_options(int argc, char *argv[], Options& opt) {
     ("jpeg-quality"     , po::value(&opt.jpeg_quality)                           , "JPEG quality factor (0.0 to 1.0)")
     ("png-compression"  , po::value(&opt.png_compression)                        , "PNG compression level (0 to 9)")
     ("tile-size"        , po::value(&opt.tile_size)                              , "Tile size in pixels")
+    ("threads"          , po::value(&opt.num_threads)->default_value(1)          , "Number of threads to generate tiles with, or 0 for the system default")
+    ("manifest"         , po::value(&opt.manifest_file)                          , "Record finished tiles in this file, and only generate tiles it does not list (resumes an interrupted run)")
+    ("changed"          , po::value(&opt.changed_files)                          , "An input file that has changed since the manifest was written; the tiles it covers are regenerated. May be given more than once.")
     ("max-lod-pixels"   , po::value(&opt.kml.max_lod_pixels)->default_value(1024), "Max LoD in pixels, or -1 for none (kml only)")
     ("draw-order-offset", po::value(&opt.kml.draw_order_offset)->default_value(0), "Offset for the <drawOrder> tag for this overlay (kml only)")
     ("multiband"        , po::bool_switch(&opt.multiband)                        , "Composite images using multi-band blending")